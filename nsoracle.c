@@ -68,10 +68,18 @@ DynamicBindIn(dvoid * ictxp,
         value = fbPtr->buf;
     }
 
-    *bufpp = (void *)value;
-    *alenp = (ub4)strlen(value) + 1;
+    if (value == NULL) {
+        /* nothing to send, e.g. a pure OUT bind of exec_plsql */
+        fbPtr->is_null = -1;
+        *bufpp = NULL;
+        *alenp = 0;
+        *indpp = &fbPtr->is_null;
+    } else {
+        *bufpp = (void *)value;
+        *alenp = (ub4)strlen(value) + 1;
+        *indpp = NULL;
+    }
     *piecep = OCI_ONE_PIECE;
-    *indpp = NULL;
 
     fbPtr->inout = BIND_IN;
 
@@ -104,24 +112,36 @@ DynamicBindOut(dvoid * ctxp, OCIBind * UNUSED(bindp),
     }
 
     if (*piecep == OCI_ONE_PIECE || *piecep == OCI_FIRST_PIECE) {
-        fetchbuf->fetch_length = 0;
+        fetchbuf->piece_offset = 0;
+        if (!fetchbuf->pooled) {
+            /* buf may hold the IN value, the OUT value goes into a
+               buffer from the pool of the connection */
+            Ns_Free(fetchbuf->buf);
+            fetchbuf->buf = ora_buffer_get(fetchbuf->connection,
+                                           fetchbuf->size_hint > EXEC_PLSQL_BUFFER_SIZE
+                                           ? fetchbuf->size_hint : EXEC_PLSQL_BUFFER_SIZE,
+                                           &fetchbuf->buf_size);
+            fetchbuf->pooled = NS_TRUE;
+        }
+        fetchbuf->buf[0] = '\0';
     } else if (*piecep == OCI_NEXT_PIECE) {
-        fetchbuf->fetch_length += fetchbuf->piecewise_fetch_length;
+        fetchbuf->piece_offset += fetchbuf->piecewise_fetch_length;
     }
 
-    if (fetchbuf->fetch_length >= fetchbuf->buf_size / 2) {
-        fetchbuf->buf_size += EXEC_PLSQL_BUFFER_SIZE;
+    /* grow geometrically, a large value costs a few reallocs only */
+    if (fetchbuf->piece_offset >= fetchbuf->buf_size / 2) {
+        fetchbuf->buf_size *= 2;
         fetchbuf->buf = Ns_Realloc (fetchbuf->buf, fetchbuf->buf_size);
     }
 
-    fetchbuf->piecewise_fetch_length = fetchbuf->buf_size - fetchbuf->fetch_length;
+    fetchbuf->piecewise_fetch_length = fetchbuf->buf_size - fetchbuf->piece_offset;
 
     ns_ora_log(lexpos(), "%d, %d, %d",
         fetchbuf->buf_size,
-        fetchbuf->fetch_length,
+        fetchbuf->piece_offset,
         fetchbuf->piecewise_fetch_length);
 
-    *bufpp = &fetchbuf->buf[fetchbuf->fetch_length];
+    *bufpp = &fetchbuf->buf[fetchbuf->piece_offset];
     *alenpp = &fetchbuf->piecewise_fetch_length;
     *indpp = &fetchbuf->is_null;
     *rcodepp = &rc;
@@ -158,6 +178,12 @@ OracleObjCmd(ClientData UNUSED(clientData), Tcl_Interp *interp, int objc, Tcl_Ob
         "clob_dml", "clob_dml_file",
         "blob_dml", "blob_dml_file",
         "write_clob", "write_blob",
+        "lob_cache",
+        "clob_dml_conn", "blob_dml_conn",
+        "lob_open", "lob_append", "lob_close", "lob_channel",
+        "lob_get", "lazy_lobs", "rows", "call", "dbms_output",
+        "prepare", "exec", "close", "register", "run",
+        "open_cursor", "getrow", "fetch",
         NULL
     };
 
@@ -169,7 +195,13 @@ OracleObjCmd(ClientData UNUSED(clientData), Tcl_Interp *interp, int objc, Tcl_Ob
         CBlobDMLBind, CBlobDMLFileBind,
         CClobDML, CClobDMLFile,
         CBlobDML, CBlobDMLFile,
-        CWriteClob, CWriteBlob
+        CWriteClob, CWriteBlob,
+        CLobCache,
+        CClobDMLConn, CBlobDMLConn,
+        CLobOpen, CLobAppend, CLobClose, CLobChannel,
+        CLobGet, CLazyLobs, CRows, CCall, CDbmsOutput,
+        CPrepare, CExec, CClose, CRegister, CRun,
+        COpenCursor, CGetRow, CFetch
     } subcmd;
 
     if (objc < 2) {
@@ -182,6 +214,49 @@ OracleObjCmd(ClientData UNUSED(clientData), Tcl_Interp *interp, int objc, Tcl_Ob
         return TCL_ERROR;
     }
 
+    /* subcommands not operating on a db handle */
+    switch (subcmd) {
+        case CLobCache:
+
+            return OracleLobCache(interp, objc, objv, NULL);
+
+        case CLobAppend:
+
+            return OracleLobAppend(interp, objc, objv, NULL);
+
+        case CLobClose:
+
+            return OracleLobClose(interp, objc, objv, NULL);
+
+        case CExec:
+
+            return OracleExec(interp, objc, objv, NULL);
+
+        case CClose:
+
+            return OracleClose(interp, objc, objv, NULL);
+
+        case CRegister:
+
+            return OracleRegister(interp, objc, objv, NULL);
+
+        case CGetRow:
+
+            return OracleGetRow(interp, objc, objv, NULL);
+
+        case CFetch:
+
+            return OracleFetch(interp, objc, objv, NULL);
+
+        default:
+            break;
+    }
+
+    if (objc < 3) {
+        Tcl_WrongNumArgs(interp, 2, objv, "dbhandle ?args?");
+        return TCL_ERROR;
+    }
+
     if (Ns_TclDbGetHandle(interp, Tcl_GetString(objv[2]), &dbh) != TCL_OK) {
         return TCL_ERROR;
     }
@@ -224,6 +299,7 @@ OracleObjCmd(ClientData UNUSED(clientData), Tcl_Interp *interp, int objc, Tcl_Ob
         case CSelect:
         case C1Row:
         case C0or1Row:
+        case CRows:
 
             Ns_OracleFlush(dbh);
             return OracleSelect(interp, objc, objv, dbh);
@@ -241,6 +317,8 @@ OracleObjCmd(ClientData UNUSED(clientData), Tcl_Interp *interp, int objc, Tcl_Ob
         case CClobDMLFile:
         case CBlobDML:
         case CBlobDMLFile:
+        case CClobDMLConn:
+        case CBlobDMLConn:
 
             Ns_OracleFlush(dbh);
             return OracleLobDML(interp, objc, objv, dbh);
@@ -261,6 +339,45 @@ OracleObjCmd(ClientData UNUSED(clientData), Tcl_Interp *interp, int objc, Tcl_Ob
             Ns_OracleFlush(dbh);
             return OracleLobSelect(interp, objc, objv, dbh);
 
+        case CLobOpen:
+
+            Ns_OracleFlush(dbh);
+            return OracleLobOpen(interp, objc, objv, dbh);
+
+        case CLobChannel:
+
+            Ns_OracleFlush(dbh);
+            return OracleLobChannel(interp, objc, objv, dbh);
+
+        case CLobGet:
+
+            return OracleLobGet(interp, objc, objv, dbh);
+
+        case CLazyLobs:
+
+            return OracleLazyLobs(interp, objc, objv, dbh);
+
+        case CCall:
+
+            Ns_OracleFlush(dbh);
+            return OracleCall(interp, objc, objv, dbh);
+
+        case CDbmsOutput:
+
+            return OracleDbmsOutput(interp, objc, objv, dbh);
+
+        case CPrepare:
+
+            return OraclePrepare(interp, objc, objv, dbh);
+
+        case CRun:
+
+            return OracleRun(interp, objc, objv, dbh);
+
+        case COpenCursor:
+
+            return OracleOpenCursor(interp, objc, objv, dbh);
+
         default:
 
             Tcl_AppendStringsToObj(Tcl_GetObjResult(interp),
@@ -283,11 +400,24 @@ OracleObjCmd(ClientData UNUSED(clientData), Tcl_Interp *interp, int objc, Tcl_Ob
  *
  *      Implements [ns_ora plsql] command.
  *
- *      ns_oracle plsql dbhandle sql ?ref?
+ *      ns_oracle plsql dbhandle ?-sizehint bytes? ?-cursors names? ?-arrays names? sql ?ref?
+ *
+ *      OUT values are read into buffers growing as needed; -sizehint
+ *      gives their initial size when large values are expected.
+ *
+ *      The REF CURSOR ref replaces the statement of the handle, its
+ *      rows are read with [ns_db getrow].  The REF CURSORs in the list
+ *      -cursors are fetched right away, the result is a dict of their
+ *      names and rows, a list of dicts as returned by [ns_ora rows].
+ *      Implicit results (DBMS_SQL.RETURN_RESULT) are added to the dict
+ *      as ":1", ":2" and so on.
+ *
+ *      The variables in the list -arrays hold Tcl lists, which are bound
+ *      to IN PL/SQL index-by tables with all their elements at once.
  *
  * Results:
  *
- *      Nothing.
+ *      The rows of the -cursors REF CURSORs and implicit results, if any.
  *
  * Side effects:
  *
@@ -305,16 +435,51 @@ OraclePLSQL(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHandle *dbh
                       *var_p;
     char              *query;
     const char        *ref;
-    int                i, refcursor_count = 0;
+    int                i, refcursor_count = 0, argbase = 3, size_hint = 0;
+    TCL_SIZE_T         n_cursors = 0, n_results = 0, n_arrays = 0, j;
+    Tcl_Obj          **cursors = NULL, **arrays = NULL, **results,
+                      *resultObj = NULL, *implicitObj;
+    Ns_Time            start;
 
-    if (objc < 4) {
-        Tcl_WrongNumArgs(interp, 2, objv, "dbhandle sql ?ref?");
+    while (objc >= argbase + 3) {
+        const char *option = Tcl_GetString(objv[argbase]);
+
+        if (strcmp(option, "-sizehint") == 0) {
+            if (Tcl_GetIntFromObj(interp, objv[argbase + 1], &size_hint) != TCL_OK) {
+                return TCL_ERROR;
+            }
+            if (size_hint < 0) {
+                Tcl_AppendResult(interp, "-sizehint must not be negative", (char*)0L);
+                return TCL_ERROR;
+            }
+            if (size_hint > MAX_DYNAMIC_BUFFER) {
+                size_hint = MAX_DYNAMIC_BUFFER;
+            }
+        } else if (strcmp(option, "-cursors") == 0) {
+            if (Tcl_ListObjGetElements(interp, objv[argbase + 1],
+                                       &n_cursors, &cursors) != TCL_OK) {
+                return TCL_ERROR;
+            }
+        } else if (strcmp(option, "-arrays") == 0) {
+            if (Tcl_ListObjGetElements(interp, objv[argbase + 1],
+                                       &n_arrays, &arrays) != TCL_OK) {
+                return TCL_ERROR;
+            }
+        } else {
+            break;
+        }
+        argbase += 2;
+    }
+
+    if (objc < argbase + 1 || objc > argbase + 2) {
+        Tcl_WrongNumArgs(interp, 2, objv,
+                         "dbhandle ?-sizehint bytes? ?-cursors names? ?-arrays names? sql ?ref?");
         return TCL_ERROR;
     }
 
     connection = dbh->connection;
     connection->interp = interp;
-    query = Tcl_GetString(objv[3]);
+    query = Tcl_GetString(objv[argbase]);
 
     oci_status = OCIHandleAlloc(connection->env,
                                 (oci_handle_t **) & connection->stmt,
@@ -334,8 +499,8 @@ OraclePLSQL(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHandle *dbh
         return TCL_ERROR;
     }
 
-    if (objc == 5) {
-        ref = Tcl_GetString(objv[4]);
+    if (objc == argbase + 2) {
+        ref = Tcl_GetString(objv[argbase + 1]);
     } else {
         ref = "";
     }
@@ -355,14 +520,29 @@ OraclePLSQL(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHandle *dbh
 
         fetch_buffer_t *fetchbuf = &connection->fetch_buffers[i];
         const char *value;
+        int         cursor_p = NS_FALSE, array_p = NS_FALSE;
 
         fetchbuf->type = (OCITypeCode)-1;
 
         value = Tcl_GetVar(interp, var_p->string, 0);
         fetchbuf->name = var_p->string;
 
+        for (j = 0; j < n_cursors; j++) {
+            if (strcmp(var_p->string, Tcl_GetString(cursors[j])) == 0) {
+                cursor_p = NS_TRUE;
+                break;
+            }
+        }
+        for (j = 0; j < n_arrays; j++) {
+            if (strcmp(var_p->string, Tcl_GetString(arrays[j])) == 0) {
+                array_p = NS_TRUE;
+                break;
+            }
+        }
+
         if ((value == NULL)
             && (strcmp(var_p->string, ref) != 0)
+            && !cursor_p
             ) {
             /* The only time a bind variable can not exist is if its strictly
                an OUT variable, or if its a REF CURSOR.  */
@@ -372,15 +552,19 @@ OraclePLSQL(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHandle *dbh
             string_list_free_list(bind_variables);
             free_fetch_buffers(connection);
             return TCL_ERROR;
-        } else if ( strcmp(var_p->string, ref) == 0 ) {
+        } else if (strcmp(var_p->string, ref) == 0 || cursor_p) {
             /* Handle REF CURSOR */
 
-            if (refcursor_count == 1) {
-                Tcl_SetObjResult(interp, Tcl_NewStringObj("invalid plsql statement, you"
-                        " can only have a single ref cursors. ", TCL_INDEX_NONE));
-                return TCL_ERROR;
-            } else {
-                refcursor_count = 1;
+            if (!cursor_p) {
+                if (refcursor_count == 1) {
+                    Tcl_SetObjResult(interp, Tcl_NewStringObj("invalid plsql statement, you"
+                            " can only have a single ref cursors. ", TCL_INDEX_NONE));
+                    Ns_OracleFlush(dbh);
+                    string_list_free_list(bind_variables);
+                    return TCL_ERROR;
+                } else {
+                    refcursor_count = 1;
+                }
             }
 
             fetchbuf->external_type = SQLT_RSET;
@@ -429,6 +613,42 @@ OraclePLSQL(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHandle *dbh
                 return TCL_ERROR;
             }
 
+        } else if (array_p) {
+            /* Handle index-by tables, all elements go with the execute */
+
+            if (ora_table_values(interp, fetchbuf,
+                                 Tcl_GetVar2Ex(interp, var_p->string, NULL, 0),
+                                 0, var_p->string) != TCL_OK) {
+                Ns_OracleFlush(dbh);
+                string_list_free_list(bind_variables);
+                free_fetch_buffers(connection);
+                return TCL_ERROR;
+            }
+
+            oci_status = OCIBindByName(connection->stmt,
+                                       &fetchbuf->bind,
+                                       connection->err,
+                                       (const OraText *)var_p->string,
+                                       (sb4) strlen(var_p->string),
+                                       fetchbuf->buf,
+                                       (sb4) fetchbuf->size,
+                                       fetchbuf->external_type,
+                                       fetchbuf->is_nulls,
+                                       fetchbuf->fetch_lengths,
+                                       NULL,
+                                       fetchbuf->curele > 0u ? fetchbuf->curele : 1u,
+                                       &fetchbuf->curele,
+                                       OCI_DEFAULT);
+
+            if (oci_error_p(lexpos(), dbh, "OCIBindByName", query, oci_status)) {
+                Tcl_SetResult(interp, dbh->dsExceptionMsg.string,
+                              TCL_VOLATILE);
+                Ns_OracleFlush(dbh);
+                string_list_free_list(bind_variables);
+                free_fetch_buffers(connection);
+                return TCL_ERROR;
+            }
+
         } else {
             /* Handle everything else.  If we get this far then
              * we don't have a REF CURSOR at this bind location so we
@@ -440,6 +660,7 @@ OraclePLSQL(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHandle *dbh
 
             fetchbuf->external_type = SQLT_STR;
             fetchbuf->is_null = 0;
+            fetchbuf->size_hint = (ub4)size_hint;
 
             oci_status = OCIBindByName(connection->stmt,
                                        &fetchbuf->bind,
@@ -483,6 +704,7 @@ OraclePLSQL(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHandle *dbh
 
     }
 
+    Ns_GetTime(&start);
     oci_status = OCIStmtExecute(connection->svc,
                                 connection->stmt,
                                 connection->err,
@@ -493,10 +715,41 @@ OraclePLSQL(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHandle *dbh
                                  OCI_DEFAULT));
 
     if (oci_error_p(lexpos(), dbh, "OCIStmtExecute", query, oci_status)) {
+        Tcl_SetResult(interp, dbh->dsExceptionMsg.string, TCL_VOLATILE);
+        ora_dbms_output_log(dbh, &start, query);
+        Ns_OracleFlush(dbh);
+        string_list_free_list(bind_variables);
+        free_fetch_buffers(connection);
+        return TCL_ERROR;
+    }
+
+    ora_dbms_output_log(dbh, &start, query);
+
+    /* implicit results go first, they belong to connection->stmt */
+#ifdef OCI_ATTR_IMPLICIT_RESULT_COUNT
+    implicitObj = ora_implicit_results(interp, dbh, connection->stmt, query);
+#else
+    /* the block runs all the same, its implicit results are left out */
+    implicitObj = Tcl_NewListObj(0, NULL);
+#endif
+    if (implicitObj == NULL) {
         Ns_OracleFlush(dbh);
+        string_list_free_list(bind_variables);
         free_fetch_buffers(connection);
         return TCL_ERROR;
     }
+    Tcl_ListObjGetElements(NULL, implicitObj, &n_results, &results);
+
+    if (n_cursors > 0 || n_results > 0) {
+        resultObj = Tcl_NewDictObj();
+    }
+    for (j = 0; j < n_results; j++) {
+        /* ":1" and so on, no bind variable can have that name */
+        Tcl_DictObjPut(NULL, resultObj,
+                       Tcl_ObjPrintf(":%d", (int)(j + 1)),
+                       results[j]);
+    }
+    Tcl_DecrRefCount(implicitObj);
 
     /*
      * Loop through bind variables again this time pulling out the
@@ -516,15 +769,44 @@ OraclePLSQL(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHandle *dbh
 
                 case SQLT_RSET:
 
+                    if (strcmp(var_p->string, ref) != 0) {
+                        Tcl_Obj *rowsObj;
+
+                        /* a NULL cursor was never opened, it has no rows */
+                        if (fetchbuf->is_null == -1) {
+                            rowsObj = Tcl_NewListObj(0, NULL);
+                        } else {
+                            rowsObj = ora_cursor_rows(interp, dbh,
+                                                      fetchbuf->stmt,
+                                                      CURSOR_FETCH_ROWS, query);
+                        }
+                        if (rowsObj == NULL) {
+                            Tcl_DecrRefCount(resultObj);
+                            Ns_OracleFlush(dbh);
+                            string_list_free_list(bind_variables);
+                            free_fetch_buffers(connection);
+                            return TCL_ERROR;
+                        }
+                        Tcl_DictObjPut(NULL, resultObj,
+                                       Tcl_NewStringObj(var_p->string, TCL_INDEX_NONE),
+                                       rowsObj);
+                        break;
+                    }
+
                     oci_status = OCIHandleFree (connection->stmt,
                                                 OCI_HTYPE_STMT);
                     if (tcl_error_p(lexpos(), interp, dbh, "OCIStmtExecute", query, oci_status)) {
+                        if (resultObj != NULL) {
+                            Tcl_DecrRefCount(resultObj);
+                        }
                         Ns_OracleFlush(dbh);
+                        string_list_free_list(bind_variables);
                         free_fetch_buffers(connection);
                         return TCL_ERROR;
                     }
 
                     connection->stmt = fetchbuf->stmt;
+                    fetchbuf->stmt = NULL;
                     break;
             }
         }
@@ -533,6 +815,10 @@ OraclePLSQL(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHandle *dbh
     string_list_free_list(bind_variables);
     free_fetch_buffers(connection);
 
+    if (resultObj != NULL) {
+        Tcl_SetObjResult(interp, resultObj);
+    }
+
     return NS_OK;
 }
 /*}}}*/
@@ -554,20 +840,11 @@ OraclePLSQL(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHandle *dbh
 int
 OracleExecPLSQL(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHandle *dbh)
 {
-    OCIBind           *bind;
     ora_connection_t  *connection;
+    fetch_buffer_t    *fetchbuf;
     oci_status_t       oci_status;
-    char              *query, *buf;
-
-    /* This indicator variable is a dummy.  We don't actually check the
-     * status.  Previously, we set the indp parameter to OCIBindByPos to
-     * 0.  Oracle would throw ORA-01405 and we would specifically ignore
-     * it in tcl_error_p().  Now we pass this dummy variable, and Oracle
-     * returns OCI_SUCCESS whether or not the returned value is NULL.
-     * This eliminates the need for explicitly handling ORA-01405 in
-     * tcl_error_p(). */
-
-    sb2               null_indicator = OCI_IND_NULL;
+    char              *query;
+    Ns_Time            start;
 
     if (objc != 4) {
         Tcl_WrongNumArgs(interp, 2, objv,
@@ -608,29 +885,49 @@ OracleExecPLSQL(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHandle
         return TCL_ERROR;
     }
 
-    buf = Ns_Malloc(EXEC_PLSQL_BUFFER_SIZE);
+    /* The result is bound at execution time, DynamicBindOut hands out
+     * a buffer from the connection pool and grows it as long as Oracle
+     * has more pieces, so the result is not limited to a fixed size.
+     * A NULL result is reported through fetchbuf->is_null and is no
+     * error (ORA-01405). */
+
+    connection->n_columns = 1;
+    malloc_fetch_buffers (connection);
+
+    fetchbuf = &connection->fetch_buffers[0];
+    fetchbuf->type = (OCITypeCode)-1;
+    fetchbuf->external_type = SQLT_STR;
 
     oci_status = OCIBindByPos (connection->stmt,
-                               &bind,
+                               &fetchbuf->bind,
                                connection->err,
                                1,
-                               buf,
-                               EXEC_PLSQL_BUFFER_SIZE,
-                               SQLT_STR,
-                               &null_indicator,
-                               0,
-                               0,
-                               0,
-                               0,
-                               OCI_DEFAULT);
+                               NULL,                     /* valuep */
+                               MAX_DYNAMIC_BUFFER,       /* value_sz */
+                               fetchbuf->external_type,  /* dty */
+                               &fetchbuf->is_null,       /* indp */
+                               0,                        /* alenp */
+                               0, 0, 0,
+                               OCI_DATA_AT_EXEC);
     if (tcl_error_p(lexpos(), interp, dbh, "OCIBindByPos",
                     query, oci_status)) {
         Ns_OracleFlush (dbh);
-        Ns_Free(buf);
+        return TCL_ERROR;
+    }
 
+    oci_status = OCIBindDynamic(fetchbuf->bind,
+                                connection->err,
+                                fetchbuf,
+                                DynamicBindIn,
+                                fetchbuf,
+                                DynamicBindOut);
+    if (tcl_error_p(lexpos(), interp, dbh, "OCIBindDynamic",
+                    query, oci_status)) {
+        Ns_OracleFlush (dbh);
         return TCL_ERROR;
     }
 
+    Ns_GetTime(&start);
     oci_status = OCIStmtExecute(connection->svc,
                                 connection->stmt,
                                 connection->err,
@@ -639,14 +936,16 @@ OracleExecPLSQL(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHandle
                                 );
     if (tcl_error_p(lexpos(), interp, dbh, "OCIStmtExecute",
                 query, oci_status)) {
+        ora_dbms_output_log(dbh, &start, query);
         Ns_OracleFlush (dbh);
-        Ns_Free(buf);
-
         return TCL_ERROR;
     }
+    ora_dbms_output_log(dbh, &start, query);
 
-    Tcl_AppendResult(interp, buf, (char*)0L);
-    Ns_Free(buf);
+    if (fetchbuf->inout == BIND_OUT && fetchbuf->is_null != -1) {
+        Tcl_AppendResult(interp, fetchbuf->buf, (char*)0L);
+    }
+    free_fetch_buffers (connection);
 
     return NS_OK;
 }
@@ -673,7 +972,9 @@ OracleExecPLSQLBind(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHan
     oci_status_t       oci_status;
     string_list_elt_t *bind_variables, *var_p;
     int                argv_base, i;
-    char               *retvar, *retbuf, *nbuf, *query;;
+    char               *retvar, *nbuf, *query;
+    fetch_buffer_t     *retbuf;
+    Ns_Time             start;
 
     if (objc < 5) {
         Tcl_AppendResult(interp, "wrong number of args: should be `",
@@ -725,6 +1026,7 @@ OracleExecPLSQLBind(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHan
     ns_ora_log(lexpos(), "%d bind variables", connection->n_columns);
 
     malloc_fetch_buffers (connection);
+    connection->interp = interp;
 
     for (var_p = bind_variables, i=0; var_p != NULL; var_p = var_p->next, i++) {
         fetch_buffer_t *fetchbuf = &connection->fetch_buffers[i];
@@ -787,11 +1089,13 @@ OracleExecPLSQLBind(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHan
         if (strcmp(var_p->string, retvar) == 0) {
 
             /*  This is the variable we're going to return
-             *  as the result.
+             *  as the result.  It is bound at execution time,
+             *  buf holds the IN value until DynamicBindOut
+             *  replaces it with a buffer that grows as needed.
              */
-            retbuf = fetchbuf->buf = ns_calloc(1, EXEC_PLSQL_BUFFER_SIZE);
-            strncpy(retbuf, value, EXEC_PLSQL_BUFFER_SIZE);
-            fetchbuf->fetch_length = EXEC_PLSQL_BUFFER_SIZE;
+            retbuf = fetchbuf;
+            fetchbuf->buf = Ns_StrDup(value);
+            fetchbuf->external_type = SQLT_STR;
             fetchbuf->is_null = 0;
 
         } else {
@@ -804,20 +1108,41 @@ OracleExecPLSQLBind(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHan
         ns_ora_log(lexpos(), "ns_ora exec_plsql_bind:  binding variable %s",
                 var_p->string);
 
-        oci_status = OCIBindByName(connection->stmt,
-                                   &fetchbuf->bind,
-                                   connection->err,
-                                   (const OraText *)var_p->string,
-                                   (sb4) strlen(var_p->string),
-                                   fetchbuf->buf,
-                                   fetchbuf->fetch_length,
-                                   SQLT_STR,
-                                   &fetchbuf->is_null,
-                                   0,
-                                   0,
-                                   0,
-                                   0,
-                                   OCI_DEFAULT);
+        if (fetchbuf == retbuf) {
+            oci_status = OCIBindByName(connection->stmt,
+                                       &fetchbuf->bind,
+                                       connection->err,
+                                       (const OraText *)var_p->string,
+                                       (sb4) strlen(var_p->string),
+                                       NULL,                     /* valuep */
+                                       MAX_DYNAMIC_BUFFER,       /* value_sz */
+                                       fetchbuf->external_type,  /* dty */
+                                       &fetchbuf->is_null,       /* indp */
+                                       0,                        /* alenp */
+                                       0, 0, 0,
+                                       OCI_DATA_AT_EXEC);
+            if (oci_status == OCI_SUCCESS) {
+                oci_status = OCIBindDynamic(fetchbuf->bind,
+                                            connection->err,
+                                            fetchbuf, DynamicBindIn,
+                                            fetchbuf, DynamicBindOut);
+            }
+        } else {
+            oci_status = OCIBindByName(connection->stmt,
+                                       &fetchbuf->bind,
+                                       connection->err,
+                                       (const OraText *)var_p->string,
+                                       (sb4) strlen(var_p->string),
+                                       fetchbuf->buf,
+                                       fetchbuf->fetch_length,
+                                       SQLT_STR,
+                                       &fetchbuf->is_null,
+                                       0,
+                                       0,
+                                       0,
+                                       0,
+                                       OCI_DEFAULT);
+        }
 
         if (oci_error_p(lexpos(), dbh, "OCIBindByName", query, oci_status)) {
             Tcl_SetResult(interp, dbh->dsExceptionMsg.string, TCL_VOLATILE);
@@ -838,6 +1163,7 @@ OracleExecPLSQLBind(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHan
         return TCL_ERROR;
     }
 
+    Ns_GetTime(&start);
     oci_status = OCIStmtExecute(connection->svc,
                                 connection->stmt,
                                 connection->err,
@@ -848,11 +1174,17 @@ OracleExecPLSQLBind(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHan
     string_list_free_list(bind_variables);
 
     if (tcl_error_p(lexpos(), interp, dbh, "OCIStmtExecute", query, oci_status)) {
+        ora_dbms_output_log(dbh, &start, query);
         Ns_OracleFlush (dbh);
         return TCL_ERROR;
     }
+    ora_dbms_output_log(dbh, &start, query);
+
+    if (retbuf->inout != BIND_OUT || retbuf->is_null == -1) {
+        retbuf->buf[0] = '\0';
+    }
 
-    Tcl_AppendResult(interp, retbuf, (char*)0L);
+    Tcl_AppendResult(interp, retbuf->buf, (char*)0L);
 
     /* Check to see if return variable was a Tcl variable */
 
@@ -860,7 +1192,7 @@ OracleExecPLSQLBind(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHan
 
     if (*nbuf != '\0') {
           /* It was a variable name. */
-        Tcl_SetVar(interp, retvar, retbuf, 0);
+        Tcl_SetVar(interp, retvar, retbuf->buf, 0);
     }
 
     return NS_OK;
@@ -883,6 +1215,9 @@ OracleExecPLSQLBind(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHan
  *      ns_ora 1row      dbhandle sql
  *      ns_ora 0or1row   dbhandle sql
  *
+ *      For a PL/SQL block, rows returns the implicit results of the
+ *      block (DBMS_SQL.RETURN_RESULT), a list of lists of rows.
+ *
  * Results:
  *
  *      Nothing.
@@ -904,10 +1239,14 @@ OracleSelect(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHandle *db
     int                array_p;      /* Array DML */
     int                argv_base;    /* Index of the SQL statement argument (necessary to support -bind) */
     Ns_Set            *set = NULL;   /* If we're binding to an ns_set, a pointer to the struct */
+    Tcl_Obj          **lists = NULL; /* Bind variables with list values bound as collections */
+    TCL_SIZE_T         n_lists = 0, j;
+    int                number_p = NS_FALSE;
 
-    if (objc < 4 || (!strcmp("-bind", Tcl_GetString(objv[3])) && objc < 6)) {
+    if (objc < 4 || (!strcmp("-bind", Tcl_GetString(objv[3])) && objc < 6)
+        || (!strcmp("-bindlist", Tcl_GetString(objv[3])) && objc < 6)) {
         Tcl_WrongNumArgs(interp, 2, objv,
-                "dbhandle ?-bind set? sql ?arg1 .. argN?");
+                "dbhandle ?-bind set? ?-bindlist names? sql ?arg1 .. argN?");
         return TCL_ERROR;
     }
 
@@ -933,17 +1272,51 @@ OracleSelect(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHandle *db
         array_p = 0;
     }
 
-    if (!strcmp("-bind", Tcl_GetString(objv[3]))) {
-        /* Binding to a set. The query is argv[5]. */
-        argv_base = 5;
-        set = Ns_TclGetSet(interp, Tcl_GetString(objv[4]));
-        if (set == NULL) {
-            Tcl_AppendResult(interp, "invalid set id `", Tcl_GetString(objv[4]), "'", (char*)0L);
-            return TCL_ERROR;
+    /* Without options the query is argv[3]. */
+    argv_base = 3;
+    while (objc > argv_base + 2) {
+        const char *option = Tcl_GetString(objv[argv_base]);
+
+        if (!strcmp("-bind", option)) {
+            /* Binding to a set. */
+            set = Ns_TclGetSet(interp, Tcl_GetString(objv[argv_base + 1]));
+            if (set == NULL) {
+                Tcl_AppendResult(interp, "invalid set id `",
+                                 Tcl_GetString(objv[argv_base + 1]), "'", (char*)0L);
+                return TCL_ERROR;
+            }
+        } else if (!strcmp("-bindlist", option)) {
+            if (Tcl_ListObjGetElements(interp, objv[argv_base + 1],
+                                       &n_lists, &lists) != TCL_OK) {
+                return TCL_ERROR;
+            }
+            if (array_p && n_lists > 0) {
+                Tcl_AppendResult(interp, "-bindlist is not supported by array_dml",
+                                 (char*)0L);
+                return TCL_ERROR;
+            }
+            /* each is a name, or a name and number or string */
+            for (j = 0; j < n_lists; j++) {
+                Tcl_Obj  **spec;
+                TCL_SIZE_T n_spec;
+
+                if (Tcl_ListObjGetElements(interp, lists[j], &n_spec, &spec) != TCL_OK) {
+                    return TCL_ERROR;
+                }
+                if (n_spec < 1 || n_spec > 2
+                    || (n_spec == 2 && strcmp(Tcl_GetString(spec[1]), "number") != 0
+                        && strcmp(Tcl_GetString(spec[1]), "string") != 0)) {
+                    Tcl_AppendResult(interp, "bad -bindlist element \"",
+                                     Tcl_GetString(lists[j]),
+                                     "\": should be name ?number|string?",
+                                     (char*)0L);
+                    return TCL_ERROR;
+                }
+            }
+        } else {
+            break;
         }
-    } else {
-        /* Not binding to a set. The query is argv[3]. */
-        argv_base = 3;
+        argv_base += 2;
     }
 
     query = Tcl_GetString(objv[argv_base]);
@@ -1016,11 +1389,15 @@ OracleSelect(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHandle *db
      */
     if (type == OCI_STMT_SELECT) {
         iters = 0;
-        if (prefetch_rows > 0) {
+        connection->describe = ora_describe_get(connection, query);
+        if (prefetch_rows > 0 || prefetch_memory == 0) {
+            ub4 rows = (ub4) (prefetch_rows > 0
+                              ? prefetch_rows : MIN_PREFETCH_ROWS);
+
             /* Set prefetch rows attr for selects. */
             oci_status = OCIAttrSet(connection->stmt,
                                     OCI_HTYPE_STMT,
-                                    (dvoid *) & prefetch_rows,
+                                    (dvoid *) & rows,
                                     0,
                                     OCI_ATTR_PREFETCH_ROWS,
                                     connection->err);
@@ -1050,8 +1427,11 @@ OracleSelect(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHandle *db
         iters = 1;
     }
 
-    /* Check for statement type mismatch */
-    if (type != OCI_STMT_SELECT && !dml_p) {
+    /* Check for statement type mismatch; rows runs PL/SQL blocks for
+     * their implicit results.  select doesn't, its result is a set. */
+    if (type != OCI_STMT_SELECT && !dml_p
+        && !((type == OCI_STMT_BEGIN || type == OCI_STMT_DECLARE)
+             && !strcmp(subcommand, "rows"))) {
         Ns_DbSetException(dbh, "ORA",
                 "Query was not a statement returning rows.");
         Tcl_SetResult(interp, dbh->dsExceptionMsg.string,
@@ -1158,6 +1538,27 @@ OracleSelect(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHandle *db
             }
         }
 
+        for (j = 0; j < n_lists; j++) {
+            Tcl_Obj  **spec;
+            TCL_SIZE_T n_spec;
+
+            (void) Tcl_ListObjGetElements(NULL, lists[j], &n_spec, &spec);
+            if (!strcmp(var_p->string, Tcl_GetString(spec[0]))) {
+                number_p = (n_spec == 2 && !strcmp(Tcl_GetString(spec[1]), "number"));
+                break;
+            }
+        }
+        if (j < n_lists) {
+            /* A list, bound as a collection in one piece */
+            if (ora_list_bind(interp, dbh, fetchbuf, var_p->string,
+                              value, number_p, query) != TCL_OK) {
+                Ns_OracleFlush(dbh);
+                string_list_free_list(bind_variables);
+                return TCL_ERROR;
+            }
+            continue;
+        }
+
         if (array_p) {
             int j;
 
@@ -1315,8 +1716,8 @@ OracleSelect(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHandle *db
     if (connection->n_columns > 0) {
         if (connection->fetch_buffers != NULL) {
             for (i = 0; i < connection->n_columns; i++) {
-                Ns_Free(connection->fetch_buffers[i].buf);
-                connection->fetch_buffers[i].buf = NULL;
+                fetch_buffer_free_buf(&connection->fetch_buffers[i]);
+                fetch_buffer_free_coll(&connection->fetch_buffers[i]);
                 Ns_Free(connection->fetch_buffers[i].array_values);
                 if (connection->fetch_buffers[i].array_values != 0) {
                     ns_ora_log(lexpos(), "*** Freeing buffer %p",
@@ -1336,6 +1737,34 @@ OracleSelect(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHandle *db
         return TCL_ERROR;
     }
 
+    if (!dml_p && (type == OCI_STMT_BEGIN || type == OCI_STMT_DECLARE)
+        && !strcmp(subcommand, "rows")) {
+        /* A PL/SQL block, its rows are the implicit results */
+        Tcl_Obj *resultsObj;
+
+        resultsObj = ora_implicit_results(interp, dbh, connection->stmt, query);
+        if (resultsObj == NULL) {
+            Ns_OracleFlush(dbh);
+            return TCL_ERROR;
+        }
+        Tcl_IncrRefCount(resultsObj);
+        if (connection->mode == autocommit) {
+            oci_status = OCITransCommit(connection->svc,
+                                        connection->err, OCI_DEFAULT);
+            if (oci_error_p(lexpos(), dbh, "OCITransCommit", query, oci_status)) {
+                Tcl_SetResult(interp, dbh->dsExceptionMsg.string,
+                              TCL_VOLATILE);
+                Tcl_DecrRefCount(resultsObj);
+                Ns_OracleFlush(dbh);
+                return TCL_ERROR;
+            }
+        }
+        Ns_OracleFlush(dbh);
+        Tcl_SetObjResult(interp, resultsObj);
+        Tcl_DecrRefCount(resultsObj);
+        return TCL_OK;
+    }
+
     if (dml_p) {
         if (connection->mode == autocommit) {
             oci_status = OCITransCommit(connection->svc,
@@ -1354,6 +1783,21 @@ OracleSelect(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHandle *db
 
         ns_ora_log(lexpos(), "ns_ora dml:  doing bind for select");
         Ns_SetTrunc(dbh->row, 0);
+
+        if (!strcmp(subcommand, "rows")) {
+            int result = TCL_ERROR;
+
+            connection->fetch_objs = NS_TRUE;
+            setPtr = Ns_OracleBindRow(dbh);
+            if (setPtr != NULL) {
+                result = ora_rows_fetch(interp, dbh, setPtr);
+            } else {
+                Tcl_SetResult(interp, dbh->dsExceptionMsg.string, TCL_VOLATILE);
+            }
+            connection->fetch_objs = NS_FALSE;
+            return result;
+        }
+
         setPtr = Ns_OracleBindRow(dbh);
 
         if (!strcmp(subcommand, "1row") ||
@@ -1468,13 +1912,19 @@ OracleLobDML(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHandle *db
     oci_status_t       oci_status;
     ora_connection_t  *connection;
     char              *query;
+    const char        *value = NULL;
     sb4                k;
     sb4                colNum;
     int                files_p = NS_FALSE;
+    int                conn_p = NS_FALSE;
     int                blob_p = NS_FALSE;
 
-    if (objc < 5) {
-        Tcl_WrongNumArgs(interp, 2, objv, \
+    if (!strcmp(Tcl_GetString(objv[1]), "clob_dml_conn") ||
+        !strcmp(Tcl_GetString(objv[1]), "blob_dml_conn"))
+        conn_p = NS_TRUE;
+
+    if (conn_p ? objc != 4 : objc < 5) {
+        Tcl_WrongNumArgs(interp, 2, objv, conn_p ? "dbId query" :
                 "dbId query clobList [clobValues | filenames] ...");
         return TCL_ERROR;
     }
@@ -1516,7 +1966,7 @@ OracleLobDML(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHandle *db
     }
 
     data = &objv[4];
-    connection->n_columns = objc - 4;
+    connection->n_columns = conn_p ? 1 : objc - 4;
 
     if (files_p) {
         for (colNum = 0; colNum < connection->n_columns; colNum++) {
@@ -1573,14 +2023,18 @@ OracleLobDML(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHandle *db
         fetch_buffer_t *fetchbuf = &connection->fetch_buffers[colNum];
         ub4 length = (ub4)-1;
 
-        if (files_p) {
+        if (conn_p) {
+            Ns_Log(Debug, "  CLOB # %d, request content", colNum);
+        } else if (files_p) {
             Ns_Log(Debug, "  CLOB # %d, filename %s", colNum,
                    Tcl_GetString(data[colNum]));
         } else {
-            length = (ub4) strlen(Tcl_GetString(data[colNum]));
-            Ns_Log(Debug, "  CLOB # %d, length %d: %s", colNum, length,
-                   (length == 0) ? "(NULL)" :
-                   Tcl_GetString(data[colNum]));
+            TCL_SIZE_T value_length;
+
+            value = lob_value_bytes(data[colNum], blob_p, &value_length);
+            length = (ub4) value_length;
+            Ns_Log(Debug, "  %s # %d, length %d", blob_p ? "BLOB" : "CLOB",
+                   colNum, length);
         }
 
         /* if length is zero, that's an empty string.  Bypass the LobWrite
@@ -1590,6 +2044,15 @@ OracleLobDML(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHandle *db
             continue;
 
         for (k = 0; k < (sb4)fetchbuf->n_rows; k++) {
+            if (conn_p) {
+                if (stream_read_conn_lob(interp, dbh, fetchbuf->lobs[k],
+                                         connection) != NS_OK) {
+                    tcl_error_p(lexpos(), interp, dbh, "stream_read_conn_lob",
+                                query, oci_status);
+                    return TCL_ERROR;
+                }
+                continue;
+            }
             if (files_p) {
                 if (stream_read_lob
                     (interp, dbh, 1, fetchbuf->lobs[k], Tcl_GetString(data[colNum]),
@@ -1607,7 +2070,7 @@ OracleLobDML(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHandle *db
                                      fetchbuf->lobs[k],
                                      &length,
                                      1,
-                                     Tcl_GetString(data[colNum]),
+                                     (dvoid *) value,
                                      length,
                                      OCI_ONE_PIECE, 0, 0, 0,
                                      SQLCS_IMPLICIT);
@@ -1732,6 +2195,8 @@ OracleLobDMLBind(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHandle
         fetch_buffer_t *fetchbuf = &connection->fetch_buffers[i];
         char           *nbuf;
         const char   *value = NULL;
+        Tcl_Obj        *valueObj;
+        TCL_SIZE_T      value_length;
         int             lob_i;
         long            index;
 
@@ -1757,10 +2222,10 @@ OracleLobDMLBind(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHandle
                 Tcl_Free((char *) lob_argv);
                 return TCL_ERROR;
             }
-            value = Tcl_GetString(objv[argv_base + index]);
+            valueObj = objv[argv_base + index];
         } else {
-            value = Tcl_GetVar(interp, var_p->string, 0);
-            if (value == NULL) {
+            valueObj = Tcl_GetVar2Ex(interp, var_p->string, NULL, 0);
+            if (valueObj == NULL) {
                 Tcl_AppendResult(interp, "undefined variable `",
                                  var_p->string, "'", (char*)0L);
                 Ns_OracleFlush(dbh);
@@ -1770,15 +2235,6 @@ OracleLobDMLBind(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHandle
             }
         }
 
-
-        fetchbuf->buf = Ns_StrDup(value);
-        fetchbuf->fetch_length = (ub2) strlen(fetchbuf->buf) + 1;
-        fetchbuf->is_null = 0;
-
-        Ns_Log(Debug, "bind variable '%s' = '%s'", var_p->string, value);
-        ns_ora_log(lexpos(), "ns_ora clob_dml:  binding variable %s",
-            var_p->string);
-
         for (lob_i = 0; lob_i < lob_argc; lob_i++) {
             if (strcmp(lob_argv[lob_i], var_p->string) == 0) {
                 fetchbuf->is_lob = 1;
@@ -1787,6 +2243,21 @@ OracleLobDMLBind(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHandle
             }
         }
 
+        /* the LOB value is kept with its length, it may contain NULs */
+        value = lob_value_bytes(valueObj, blob_p && fetchbuf->is_lob && !files_p,
+                                &value_length);
+        fetchbuf->buf = Ns_Malloc((size_t)value_length + 1u);
+        memcpy(fetchbuf->buf, value, (size_t)value_length);
+        fetchbuf->buf[value_length] = '\0';
+        fetchbuf->buf_size = (unsigned)value_length;
+        fetchbuf->fetch_length = (ub2) strlen(fetchbuf->buf) + 1;
+        fetchbuf->is_null = 0;
+
+        Ns_Log(Debug, "bind variable '%s' = '%s'", var_p->string,
+               fetchbuf->buf);
+        ns_ora_log(lexpos(), "ns_ora clob_dml:  binding variable %s",
+            var_p->string);
+
         oci_status = OCIBindByName(connection->stmt,
                                    &fetchbuf->bind,
                                    connection->err,
@@ -1856,9 +2327,9 @@ OracleLobDMLBind(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHandle
         if (files_p) {
             Ns_Log(Debug, "  CLOB # %d, filename %s", i, fetchbuf->buf);
         } else {
-            length = (ub4) strlen(fetchbuf->buf);
-            Ns_Log(Debug, "  CLOB # %d, length %d: %s", i, length,
-                   (length == 0) ? "(NULL)" : fetchbuf->buf);
+            length = (ub4) fetchbuf->buf_size;
+            Ns_Log(Debug, "  %s # %d, length %d", blob_p ? "BLOB" : "CLOB",
+                   i, length);
         }
 
         /* if length is zero, that's an empty string.  Bypass the LobWrite
@@ -1954,6 +2425,9 @@ OracleLobSelect(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHandle
     int                nbytes = INT_MAX;
     int                result = TCL_ERROR;
     int                write_lob_status = NS_ERROR;
+    int                argi = 3;
+    Tcl_Obj           *cache_version = NULL;
+    Tcl_DString        cache_key;
 
     if (objc < 4 ) {
         Tcl_WrongNumArgs(interp, 2, objv, "dbhandle ?-bind set? sql ?ref?");
@@ -1962,22 +2436,28 @@ OracleLobSelect(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHandle
 
     subcommand = Tcl_GetString(objv[1]);
     connection = dbh->connection;
+    Tcl_DStringInit(&cache_key);
 
     if (!strncmp(subcommand, "write", 5))
         to_conn_p = NS_TRUE;
 
     if (to_conn_p) {
-        if (objc < 4 || objc > 5) {
+        if (objc > 5 && !strcmp(Tcl_GetString(objv[3]), "-cache")) {
+            cache_version = objv[4];
+            argi = 5;
+        }
+
+        if (objc < argi + 1 || objc > argi + 2) {
             Tcl_AppendResult(interp,
                              "wrong number of args: should be '",
                              Tcl_GetString(objv[0]),
-                             subcommand, " dbId query ?nbytes?",
+                             subcommand, " dbId ?-cache version? query ?nbytes?",
                              (char*)0L);
             goto write_lob_cleanup;
         }
 
-        if (objc == 5) {
-            if (Tcl_GetIntFromObj(interp, objv[4], &nbytes) != TCL_OK) {
+        if (objc == argi + 2) {
+            if (Tcl_GetIntFromObj(interp, objv[argi + 1], &nbytes) != TCL_OK) {
                 goto write_lob_cleanup;
             }
         }
@@ -1995,7 +2475,7 @@ OracleLobSelect(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHandle
     if (!strncmp(subcommand, "blob", 4) || !strcmp(subcommand, "write_blob"))
         blob_p = NS_TRUE;
 
-    query = Tcl_GetString(objv[3]);
+    query = Tcl_GetString(objv[argi]);
 
     if (!allow_sql_p(dbh, query, NS_TRUE)) {
         Tcl_AppendResult(interp, "SQL ", query, " has been rejected "
@@ -2003,6 +2483,36 @@ OracleLobSelect(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHandle
         goto write_lob_cleanup;
     }
 
+    /* The cache can only be used while we may still send the headers.
+       Hits don't touch the database at all. */
+    if (cache_version != NULL && lob_cache.dir != NULL) {
+        Ns_Conn *conn = Ns_TclGetConn(interp);
+
+        if (conn != NULL && (conn->flags & NS_CONN_SENTHDRS) == 0u
+            && Ns_SetIGet(Ns_ConnHeaders(conn), "range") == NULL) {
+            TCL_SIZE_T length;
+            const char *version = Tcl_GetStringFromObj(cache_version, &length);
+            char        prefix[32];
+
+            /* the cache is shared by all pools: the same query may read
+               other data in another database or schema */
+            Tcl_DStringAppend(&cache_key, dbh->datasource != NULL
+                              ? dbh->datasource : "", TCL_INDEX_NONE);
+            Tcl_DStringAppend(&cache_key, "\t", 1);
+            Tcl_DStringAppend(&cache_key, dbh->user, TCL_INDEX_NONE);
+            Tcl_DStringAppend(&cache_key, "\t", 1);
+            snprintf(prefix, sizeof(prefix), "%ld:", (long) length);
+            Tcl_DStringAppend(&cache_key, prefix, TCL_INDEX_NONE);
+            Tcl_DStringAppend(&cache_key, version, length);
+            Tcl_DStringAppend(&cache_key, query, TCL_INDEX_NONE);
+
+            if (lob_cache_return(conn, Tcl_DStringValue(&cache_key), blob_p)) {
+                Tcl_DStringFree(&cache_key);
+                return TCL_OK;
+            }
+        }
+    }
+
     Ns_Log(Debug, "SQL():  %s", query);
 
     oci_status = OCIDescriptorAlloc(connection->env,
@@ -2057,9 +2567,24 @@ OracleLobSelect(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHandle
         filename = Tcl_GetString(objv[4]);
     }
 
-    write_lob_status =
-        stream_write_lob(interp, dbh, 0, lob, filename, to_conn_p,
-                         connection->svc, connection->err);
+    if (to_conn_p && Tcl_DStringLength(&cache_key) == 0) {
+        lob_set_compression(Ns_TclGetConn(interp), blob_p);
+    }
+
+    if (Tcl_DStringLength(&cache_key) > 0) {
+        write_lob_status =
+            spool_write_lob(interp, dbh, lob, blob_p,
+                            Tcl_DStringValue(&cache_key),
+                            connection->svc, connection->err);
+    } else if (to_conn_p && lob_spool_p) {
+        write_lob_status =
+            spool_write_lob(interp, dbh, lob, blob_p, NULL,
+                            connection->svc, connection->err);
+    } else {
+        write_lob_status =
+            stream_write_lob(interp, dbh, blob_p, lob, filename, to_conn_p,
+                             connection->svc, connection->err);
+    }
     if (write_lob_status == STREAM_WRITE_LOB_ERROR) {
         tcl_error_p(lexpos(), interp, dbh, "stream_write_lob",
                     query, oci_status);
@@ -2071,6 +2596,8 @@ OracleLobSelect(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHandle
 
   write_lob_cleanup:
 
+    Tcl_DStringFree(&cache_key);
+
     if (lob != NULL) {
         oci_status = OCIDescriptorFree(lob, OCI_DTYPE_LOB);
         oci_error_p(lexpos(), dbh, "OCIDescriptorFree", 0, oci_status);
@@ -2078,11 +2605,13 @@ OracleLobSelect(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHandle
 
     Ns_OracleFlush(dbh);
 
-    /* this is a hack.  If we don't drain a multi-part LOB, we'll get
-     * an error next time we use the handle.  This works around the problem
-     * for now until we find a better cleanup mechanism
+    /* An interrupted multi-part LOB read is normally terminated by
+     * stream_write_lob.  Only if that failed, the session is unusable
+     * and we have to reconnect.
      */
-    if (write_lob_status != NS_OK) {
+    if (connection->lob_read_pending) {
+        Ns_Log(Warning, "%s:%d:%s: unterminated LOB read, reopening connection",
+               lexpos());
         Ns_OracleCloseDb(dbh);
         Ns_OracleOpenDb(dbh);
     }
@@ -2091,254 +2620,639 @@ OracleLobSelect(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHandle
 }
 /*}}}*/
 
-/*{{{ OracleGetCols
+/*{{{ OracleLobOpen
  *----------------------------------------------------------------------
- * OracleGetCols --
+ * OracleLobOpen --
  *
- *      Implements [ns_ora getcols] command.
+ *      Implements [ns_ora lob_open] command.
  *
- *      ns_ora getcols dbhandle sql
+ *      ns_ora lob_open dbhandle sql
+ *
+ *      The query selects the LOB to write to, usually with FOR UPDATE.
  *
  * Results:
  *
- *      Tcl list of columns in select-list.
+ *      The id of a LOB writer for lob_append and lob_close.
  *
  *----------------------------------------------------------------------
  */
 int
-OracleGetCols(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHandle *dbh)
+OracleLobOpen(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHandle *dbh)
 {
-    ora_connection_t  *connection;
     oci_status_t       oci_status;
+    ora_connection_t  *connection;
+    OCILobLocator     *lob;
+    ora_object_t      *object;
+    lob_writer_t      *writer;
     char              *query;
-    int                i;
+    ub2                type;
 
-    if (objc < 4) {
-        Tcl_AppendResult(interp, "wrong number of args: should be `",
-                         Tcl_GetString(objv[0]), " getcols dbId sql'", (char*)0L);
+    if (objc != 4) {
+        Tcl_WrongNumArgs(interp, 2, objv, "dbhandle sql");
         return TCL_ERROR;
     }
 
+    connection = dbh->connection;
     query = Tcl_GetString(objv[3]);
 
-    connection = dbh->connection;
-    oci_status = OCIHandleAlloc(connection->env,
-                                (oci_handle_t **) & connection->stmt,
-                                OCI_HTYPE_STMT, 0, NULL);
-    if (tcl_error_p(lexpos(), interp, dbh, "OCIHandleAlloc", query, oci_status)) {
-        Ns_OracleFlush(dbh);
+    lob = lob_select_locator(interp, dbh, query, &type);
+    if (lob == NULL) {
         return TCL_ERROR;
     }
 
-    oci_status = OCIStmtPrepare(connection->stmt,
-                                connection->err,
-                                (const OraText *)query,
-                                (ub4) strlen(query),
-                                OCI_NTV_SYNTAX, OCI_DEFAULT);
-    if (tcl_error_p(lexpos(), interp, dbh, "OCIStmtPrepare", query, oci_status)) {
-        Ns_OracleFlush(dbh);
+    /* Defer index maintenance and LOB triggers to lob_close. */
+    oci_status = OCILobOpen(connection->svc, connection->err,
+                            lob, OCI_LOB_READWRITE);
+    if (tcl_error_p(lexpos(), interp, dbh, "OCILobOpen", query, oci_status)) {
+        OCIDescriptorFree(lob, OCI_DTYPE_LOB);
         return TCL_ERROR;
     }
 
-    /* Execute Query in DESCRIBE_ONLY mode. */
-    oci_status = OCIStmtExecute(connection->svc,
-                                connection->stmt,
-                                connection->err,
-                                1, 0, 0, 0, OCI_DESCRIBE_ONLY);
-    if (tcl_error_p(lexpos(), interp, dbh, "OCIStmtExecute",
-                    query, oci_status)) {
+    writer = Ns_Malloc(sizeof(lob_writer_t));
+    writer->lob = lob;
+    writer->blob_p = (type == SQLT_BLOB);
+    writer->open_p = NS_TRUE;
+    /* coalesce appends into writes of whole chunks */
+    writer->buf_size = (size_t)lob_chunks_per_buffer(connection, lob);
+    writer->buf = Ns_Malloc(writer->buf_size);
+    writer->fill = 0u;
+    writer->length = 0u;
+
+    object = ora_object_new(connection, Tcl_GetString(objv[2]),
+                            ORA_OBJECT_LOB_WRITER, "lob",
+                            writer, lob_writer_free);
+    Tcl_SetObjResult(interp, ora_object_id(object));
+    return TCL_OK;
+}
+/*}}}*/
+
+/*{{{ OracleLobChannel
+ *----------------------------------------------------------------------
+ * OracleLobChannel --
+ *
+ *      Implements [ns_ora lob_channel] command.
+ *
+ *      ns_ora lob_channel dbhandle sql
+ *
+ * Results:
+ *
+ *      A read-only Tcl channel over the selected CLOB or BLOB.  The
+ *      channel has to be closed by the caller; it can't be read any
+ *      more after the db handle is released.
+ *
+ *----------------------------------------------------------------------
+ */
+int
+OracleLobChannel(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHandle *dbh)
+{
+    oci_status_t       oci_status;
+    ora_connection_t  *connection;
+    OCILobLocator     *lob;
+    lob_channel_t     *state;
+    Tcl_Obj           *idObj;
+    char              *query;
+    ub2                type;
+    oraub8             length = 0;
+
+    if (objc != 4) {
+        Tcl_WrongNumArgs(interp, 2, objv, "dbhandle sql");
         return TCL_ERROR;
     }
 
-    /* Get total number of columns. */
-    oci_status = OCIAttrGet(connection->stmt,
-                            OCI_HTYPE_STMT,
-                            (oci_attribute_t *) & connection->n_columns,
-                            NULL, OCI_ATTR_PARAM_COUNT,
-                            connection->err);
+    connection = dbh->connection;
+    query = Tcl_GetString(objv[3]);
 
-    for (i = 0; i < connection->n_columns; i++) {
-        OCIParam *param;
-        char name[512];
-        char *name1 = 0;
-        ub2 coltype;
-        ub4 name1_size = 0;
-        sword result;
+    lob = lob_select_locator(interp, dbh, query, &type);
+    if (lob == NULL) {
+        return TCL_ERROR;
+    }
 
-        result = OCIParamGet(connection->stmt,
-                                 OCI_HTYPE_STMT,
-                                 connection->err,
-                             (oci_param_t *) & param, (ub4)i + 1);
-        if (oci_error_p(lexpos(), dbh, "OCIParamGet", 0, result)) {
-            Ns_OracleFlush(dbh);
-            return TCL_ERROR;
-        }
+    /* in characters for CLOBs */
+    oci_status = OCILobGetLength2(connection->svc, connection->err,
+                                  lob, &length);
+    if (tcl_error_p(lexpos(), interp, dbh, "OCILobGetLength2", query, oci_status)) {
+        OCIDescriptorFree(lob, OCI_DTYPE_LOB);
+        return TCL_ERROR;
+    }
 
-        oci_status = OCIAttrGet(param,
-                                OCI_DTYPE_PARAM,
-                                (oci_attribute_t *) & name1,
-                                &name1_size,
-                                OCI_ATTR_NAME, connection->err);
-        if (oci_error_p(lexpos(), dbh, "OCIAttrGet", 0, oci_status)) {
-            Ns_OracleFlush(dbh);
-            return TCL_ERROR;
-        }
+    state = Ns_Malloc(sizeof(lob_channel_t));
+    state->connection = connection;
+    state->lob = lob;
+    state->blob_p = (type == SQLT_BLOB);
+    state->offset = 1u;
+    state->length = length;
+    state->timer = NULL;
+
+    state->object = ora_object_new(connection, Tcl_GetString(objv[2]),
+                                   ORA_OBJECT_LOB_CHANNEL, "lobchan",
+                                   state, lob_channel_release);
+
+    /* the channel is named like the object */
+    idObj = ora_object_id(state->object);
+    state->chan = Tcl_CreateChannel(&lob_channel_type, Tcl_GetString(idObj),
+                                    state, TCL_READABLE);
+    Tcl_RegisterChannel(interp, state->chan);
+
+    /* reads map to OCILobRead2 calls of whole chunks */
+    Tcl_SetChannelBufferSize(state->chan,
+                             (TCL_SIZE_T)lob_chunks_per_buffer(connection, lob));
+    if (state->blob_p) {
+        Tcl_SetChannelOption(interp, state->chan, "-translation", "binary");
+    } else {
+        Tcl_SetChannelOption(interp, state->chan, "-encoding", "utf-8");
+    }
 
-        oci_status = OCIAttrGet(param,
-                                OCI_DTYPE_PARAM,
-                                (oci_attribute_t *) &coltype,
-                                0,
-                                OCI_ATTR_DATA_TYPE, connection->err);
-        if (oci_error_p(lexpos(), dbh, "OCIAttrGet", 0, oci_status)) {
-            Ns_OracleFlush(dbh);
-            return TCL_ERROR;
-        }
+    Tcl_SetObjResult(interp, idObj);
 
-        /* Oracle gives us back a pointer to a string that is not null-terminated
-         * so we copy it into our local var and add a 0 at the end.
-         */
-        memcpy(name, name1, name1_size);
-        name[name1_size] = 0;
-        downcase(name);
+    return TCL_OK;
+}
+/*}}}*/
+
+/*{{{ OracleLobAppend
+ *----------------------------------------------------------------------
+ * OracleLobAppend --
+ *
+ *      Implements [ns_ora lob_append] command.
+ *
+ *      ns_ora lob_append lobid data
+ *
+ * Results:
+ *
+ *      Nothing.  Data is buffered and appended to the LOB in chunk
+ *      sized writes.
+ *
+ *----------------------------------------------------------------------
+ */
+int
+OracleLobAppend(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHandle *UNUSED(dbh))
+{
+    ora_object_t  *object;
+    lob_writer_t  *writer;
+    const char    *data;
+    TCL_SIZE_T     length;
+    size_t         n;
 
-        Tcl_ListObjAppendElement(interp,
-                                 Tcl_GetObjResult(interp), Tcl_NewIntObj(coltype));
+    if (objc != 4) {
+        Tcl_WrongNumArgs(interp, 2, objv, "lobid data");
+        return TCL_ERROR;
+    }
 
-        Tcl_ListObjAppendElement(interp,
-                                 Tcl_GetObjResult(interp), Tcl_NewStringObj(name, (TCL_SIZE_T)name1_size));
+    object = ora_object_get(interp, objv[2], ORA_OBJECT_LOB_WRITER, "lob");
+    if (object == NULL) {
+        return TCL_ERROR;
+    }
+    writer = object->data;
 
+    if (writer->blob_p) {
+        data = (const char *)Tcl_GetByteArrayFromObj(objv[3], &length);
+    } else {
+        data = Tcl_GetStringFromObj(objv[3], &length);
     }
 
-    Ns_OracleFlush(dbh);
+    while (length > 0) {
+        n = writer->buf_size - writer->fill;
+        if (n > (size_t)length) {
+            n = (size_t)length;
+        }
+        memcpy(writer->buf + writer->fill, data, n);
+        writer->fill += n;
+        data += n;
+        length -= (TCL_SIZE_T)n;
+
+        if (writer->fill == writer->buf_size
+            && lob_writer_flush(interp, object->connection, writer, NS_FALSE) != NS_OK) {
+            return TCL_ERROR;
+        }
+    }
 
     return TCL_OK;
 }
 /*}}}*/
 
-/*{{{ OracleResultRows
+/*{{{ OracleLobClose
  *----------------------------------------------------------------------
- * OracleResultRows --
+ * OracleLobClose --
  *
- *      Implements [ns_ora resultrows] command.
+ *      Implements [ns_ora lob_close] command.
  *
- *      ns_ora resultrows dbhandle sql
+ *      ns_ora lob_close lobid
  *
  * Results:
  *
- *      ...
+ *      The number of bytes written.  The LOB is closed and, in
+ *      autocommit mode, the transaction committed.  The id is
+ *      invalid afterwards, also in case of an error.
  *
  *----------------------------------------------------------------------
  */
 int
-OracleResultRows(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHandle *dbh)
+OracleLobClose(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHandle *UNUSED(dbh))
 {
+    ora_object_t      *object;
     ora_connection_t  *connection;
+    Ns_DbHandle       *handle;
+    lob_writer_t      *writer;
     oci_status_t       oci_status;
-    ub4                count;
-    char               buf[1024];
+    int                result = TCL_ERROR;
 
     if (objc != 3) {
-        Tcl_WrongNumArgs(interp, 2, objv, "dbId object");
+        Tcl_WrongNumArgs(interp, 2, objv, "lobid");
         return TCL_ERROR;
     }
 
-    connection = dbh->connection;
-    if (connection->stmt == 0) {
-        Tcl_AppendResult(interp, "no active statement", (char*)0L);
+    object = ora_object_get(interp, objv[2], ORA_OBJECT_LOB_WRITER, "lob");
+    if (object == NULL) {
         return TCL_ERROR;
     }
+    writer = object->data;
+    connection = object->connection;
+    handle = connection->dbh;
 
-    oci_status = OCIAttrGet(connection->stmt,
-                            OCI_HTYPE_STMT,
-                            (oci_attribute_t *) &count,
-                            NULL, OCI_ATTR_ROW_COUNT, connection->err);
-    if (tcl_error_p(lexpos(), interp, dbh, "OCIAttrGet", 0, oci_status)) {
-        Ns_OracleFlush(dbh);
-        return TCL_ERROR;
+    if (lob_writer_flush(interp, connection, writer, NS_TRUE) != NS_OK) {
+        goto done;
     }
 
-    snprintf(buf, 1024, "%ld", (long) count);
-    Tcl_AppendResult(interp, buf, (char*)0L);
+    oci_status = OCILobClose(connection->svc, connection->err, writer->lob);
+    if (tcl_error_p(lexpos(), interp, connection->dbh, "OCILobClose", 0, oci_status)) {
+        goto done;
+    }
+    writer->open_p = NS_FALSE;
 
-    return TCL_OK;
+    if (connection->mode == autocommit) {
+        oci_status = OCITransCommit(connection->svc,
+                                    connection->err, OCI_DEFAULT);
+        if (tcl_error_p(lexpos(), interp, connection->dbh, "OCITransCommit", 0, oci_status)) {
+            goto done;
+        }
+    }
+
+    Tcl_SetObjResult(interp, Tcl_NewWideIntObj((Tcl_WideInt)writer->length));
+    result = TCL_OK;
+
+  done:
+    /* a fatal error closed the connection, which freed its objects */
+    if (handle->connection != NULL) {
+        ora_object_free(object);
+    }
+
+    return result;
 }
 /*}}}*/
 
-/*{{{ OracleDesc
+/*{{{ OracleLobGet
  *----------------------------------------------------------------------
- * OracleDesc --
+ * OracleLobGet --
  *
- *      Implements [ns_oracle desc] command.
+ *      Implements [ns_ora lob_get] command.
  *
- *      ns_oracle desc_pkg dbhandle object_name
+ *      ns_ora lob_get dbhandle token ?-offset offset? ?-length length?
+ *
+ *      The token is a LOB column value fetched in lazy LOB mode.
+ *      Offset and length count characters for CLOBs, bytes for BLOBs.
+ *
+ * Results:
+ *
+ *      The LOB value (a byte array for BLOBs), or the requested part
+ *      of it.
  *
  *----------------------------------------------------------------------
  */
 int
-OracleDesc(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHandle *dbh)
+OracleLobGet(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHandle *dbh)
 {
-    ora_connection_t  *connection;
-    oci_status_t       oci_status;
-    OCIDescribe       *descHandlePtr;
-    OCIParam          *paramHandlePtr;
-    char              *package;
-    ub1                ptype;
-    int                resolve;
+    ora_connection_t  *connection = dbh->connection;
+    Tcl_HashEntry     *hPtr;
+    ora_object_t      *object = NULL;
+    lob_token_t       *token;
+    Tcl_WideInt        offset = 0, length = 0;
+    Tcl_Obj           *valueObj;
+    int                i;
 
-    if (objc < 4) {
-        Tcl_WrongNumArgs(interp, 2, objv, "dbhandle package");
+    if (objc < 4 || (objc % 2) != 0) {
+        Tcl_WrongNumArgs(interp, 2, objv,
+                         "dbhandle token ?-offset offset? ?-length length?");
         return TCL_ERROR;
     }
 
-    if (objc == 5) {
-        Tcl_GetIntFromObj(interp, objv[4], &resolve);
-    } else {
-        resolve = 1;
-    }
+    for (i = 4; i < objc; i += 2) {
+        const char *option = Tcl_GetString(objv[i]);
+        Tcl_WideInt *valuePtr;
 
-    connection = dbh->connection;
-    if (connection == NULL) {
-        Tcl_SetObjResult(interp, Tcl_NewStringObj("error: no connection", TCL_INDEX_NONE));
-        return TCL_ERROR;
+        if (strcmp(option, "-offset") == 0) {
+            valuePtr = &offset;
+        } else if (strcmp(option, "-length") == 0) {
+            valuePtr = &length;
+        } else {
+            Tcl_AppendResult(interp, "bad option \"", option,
+                             "\": must be -offset or -length", (char*)0L);
+            return TCL_ERROR;
+        }
+        if (Tcl_GetWideIntFromObj(interp, objv[i + 1], valuePtr) != TCL_OK) {
+            return TCL_ERROR;
+        }
+        if (*valuePtr < 0) {
+            Tcl_AppendResult(interp, option, " must not be negative", (char*)0L);
+            return TCL_ERROR;
+        }
     }
 
-    package = Tcl_GetString(objv[3]);
-
-    oci_status = OCIHandleAlloc(connection->env,
-                                (dvoid *)&descHandlePtr,
-                                OCI_HTYPE_DESCRIBE, 0, NULL);
-    if (tcl_error_p(lexpos(), interp, dbh, "OCIHandleAlloc", package, oci_status)) {
-        Ns_OracleFlush(dbh);
-        return TCL_ERROR;
+    hPtr = Tcl_FindHashEntry(&connection->objects, Tcl_GetString(objv[3]));
+    if (hPtr != NULL) {
+        object = Tcl_GetHashValue(hPtr);
     }
-
-    oci_status = OCIAttrSet(descHandlePtr,
-                            OCI_HTYPE_DESCRIBE,
-                            (dvoid *) 1, 0,
-                            OCI_ATTR_DESC_PUBLIC,
-                            connection->err);
-    if (tcl_error_p(lexpos(), interp, dbh, "OCIAttrSet", package, oci_status)) {
-        Ns_OracleFlush(dbh);
+    if (object == NULL || object->type != ORA_OBJECT_LOB_TOKEN) {
+        Tcl_AppendResult(interp, "invalid LOB token \"",
+                         Tcl_GetString(objv[3]), "\"", (char*)0L);
         return TCL_ERROR;
     }
+    token = object->data;
 
-    oci_status = OCIDescribeAny(connection->svc,
-                                connection->err,
-                                package,
-                                (ub4) strlen(package),
-                                OCI_OTYPE_NAME,
-                                (ub1) 0,
-                                OCI_PTYPE_UNK,
-                                descHandlePtr);
-    if (tcl_error_p(lexpos(), interp, dbh, "OCIDescribeAny", package, oci_status)) {
-        Ns_OracleFlush(dbh);
+    valueObj = lob_read_obj(interp, dbh, token->lob, token->blob_p,
+                            (oraub8)offset, (oraub8)length);
+    if (valueObj == NULL) {
         return TCL_ERROR;
     }
+    Tcl_SetObjResult(interp, valueObj);
 
-    /* Get parameter handle */
-    oci_status = OCIAttrGet(descHandlePtr,
-                            OCI_HTYPE_DESCRIBE,
-                            &paramHandlePtr,
+    return TCL_OK;
+}
+/*}}}*/
+
+/*{{{ OracleLazyLobs
+ *----------------------------------------------------------------------
+ * OracleLazyLobs --
+ *
+ *      Implements [ns_ora lazy_lobs] command.
+ *
+ *      ns_ora lazy_lobs dbhandle ?boolean?
+ *
+ *      In lazy LOB mode, rows contain a token instead of the value of
+ *      LOB columns, see [ns_ora lob_get].  The mode is reset to the
+ *      LazyLobs driver parameter when the handle is released.
+ *
+ * Results:
+ *
+ *      The current mode.
+ *
+ *----------------------------------------------------------------------
+ */
+int
+OracleLazyLobs(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHandle *dbh)
+{
+    ora_connection_t *connection = dbh->connection;
+    int               lazy_p;
+
+    if (objc != 3 && objc != 4) {
+        Tcl_WrongNumArgs(interp, 2, objv, "dbhandle ?boolean?");
+        return TCL_ERROR;
+    }
+
+    if (objc == 4) {
+        if (Tcl_GetBooleanFromObj(interp, objv[3], &lazy_p) != TCL_OK) {
+            return TCL_ERROR;
+        }
+        connection->lazy_lobs = lazy_p;
+    }
+
+    Tcl_SetObjResult(interp, Tcl_NewBooleanObj(connection->lazy_lobs));
+
+    return TCL_OK;
+}
+/*}}}*/
+
+/*{{{ OracleGetCols
+ *----------------------------------------------------------------------
+ * OracleGetCols --
+ *
+ *      Implements [ns_ora getcols] command.
+ *
+ *      ns_ora getcols dbhandle sql
+ *
+ * Results:
+ *
+ *      Tcl list of columns in select-list.
+ *
+ *----------------------------------------------------------------------
+ */
+int
+OracleGetCols(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHandle *dbh)
+{
+    ora_connection_t  *connection;
+    ora_describe_t    *describe;
+    oci_status_t       oci_status;
+    char              *query;
+    int                i, cached_p;
+
+    if (objc < 4) {
+        Tcl_AppendResult(interp, "wrong number of args: should be `",
+                         Tcl_GetString(objv[0]), " getcols dbId sql'", (char*)0L);
+        return TCL_ERROR;
+    }
+
+    query = Tcl_GetString(objv[3]);
+
+    connection = dbh->connection;
+
+    /* a query run or described before is answered from its select list */
+    describe = ora_describe_get(connection, query);
+    cached_p = (describe->hPtr != NULL);
+    if (describe->n_columns < 0) {
+        oci_status = OCIHandleAlloc(connection->env,
+                                    (oci_handle_t **) & connection->stmt,
+                                    OCI_HTYPE_STMT, 0, NULL);
+        if (tcl_error_p(lexpos(), interp, dbh, "OCIHandleAlloc", query, oci_status)) {
+            Ns_OracleFlush(dbh);
+            goto error;
+        }
+
+        oci_status = OCIStmtPrepare(connection->stmt,
+                                    connection->err,
+                                    (const OraText *)query,
+                                    (ub4) strlen(query),
+                                    OCI_NTV_SYNTAX, OCI_DEFAULT);
+        if (tcl_error_p(lexpos(), interp, dbh, "OCIStmtPrepare", query, oci_status)) {
+            Ns_OracleFlush(dbh);
+            goto error;
+        }
+
+        /* Execute Query in DESCRIBE_ONLY mode. */
+        oci_status = OCIStmtExecute(connection->svc,
+                                    connection->stmt,
+                                    connection->err,
+                                    1, 0, 0, 0, OCI_DESCRIBE_ONLY);
+        if (tcl_error_p(lexpos(), interp, dbh, "OCIStmtExecute",
+                        query, oci_status)) {
+            goto error;
+        }
+
+        if (ora_describe_columns(dbh, connection->stmt, describe, query) != NS_OK) {
+            Tcl_SetResult(interp, dbh->dsExceptionMsg.string, TCL_VOLATILE);
+            Ns_OracleFlush(dbh);
+            goto error;
+        }
+    }
+
+    for (i = 0; i < describe->n_columns; i++) {
+        Tcl_ListObjAppendElement(interp, Tcl_GetObjResult(interp),
+                                 Tcl_NewIntObj(describe->columns[i].type));
+        Tcl_ListObjAppendElement(interp, Tcl_GetObjResult(interp),
+                                 Tcl_NewStringObj(describe->columns[i].name, -1));
+    }
+
+    if (!cached_p) {
+        ora_describe_forget(connection, describe);
+    }
+
+    Ns_OracleFlush(dbh);
+
+    return TCL_OK;
+
+  error:
+    /* an error closing the connection freed the cached select lists */
+    if (dbh->connection != NULL) {
+        ora_describe_forget(connection, describe);
+    } else if (!cached_p) {
+        ora_describe_clear(describe);
+        ns_free(describe);
+    }
+
+    return TCL_ERROR;
+}
+/*}}}*/
+
+/*{{{ OracleResultRows
+ *----------------------------------------------------------------------
+ * OracleResultRows --
+ *
+ *      Implements [ns_ora resultrows] command.
+ *
+ *      ns_ora resultrows dbhandle sql
+ *
+ * Results:
+ *
+ *      ...
+ *
+ *----------------------------------------------------------------------
+ */
+int
+OracleResultRows(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHandle *dbh)
+{
+    ora_connection_t  *connection;
+    oci_status_t       oci_status;
+    ub4                count;
+    char               buf[1024];
+
+    if (objc != 3) {
+        Tcl_WrongNumArgs(interp, 2, objv, "dbId object");
+        return TCL_ERROR;
+    }
+
+    connection = dbh->connection;
+    if (connection->stmt == 0) {
+        Tcl_AppendResult(interp, "no active statement", (char*)0L);
+        return TCL_ERROR;
+    }
+
+    oci_status = OCIAttrGet(connection->stmt,
+                            OCI_HTYPE_STMT,
+                            (oci_attribute_t *) &count,
+                            NULL, OCI_ATTR_ROW_COUNT, connection->err);
+    if (tcl_error_p(lexpos(), interp, dbh, "OCIAttrGet", 0, oci_status)) {
+        Ns_OracleFlush(dbh);
+        return TCL_ERROR;
+    }
+
+    snprintf(buf, 1024, "%ld", (long) count);
+    Tcl_AppendResult(interp, buf, (char*)0L);
+
+    return TCL_OK;
+}
+/*}}}*/
+
+/*{{{ OracleDesc
+ *----------------------------------------------------------------------
+ * OracleDesc --
+ *
+ *      Implements [ns_oracle desc] command.
+ *
+ *      ns_oracle desc_pkg dbhandle object_name
+ *
+ *----------------------------------------------------------------------
+ */
+int
+OracleDesc(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHandle *dbh)
+{
+    ora_connection_t  *connection;
+    oci_status_t       oci_status;
+    OCIDescribe       *descHandlePtr;
+    OCIParam          *paramHandlePtr;
+    char              *package;
+    ub1                ptype;
+    int                resolve, status = TCL_OK;
+
+    if (objc < 4) {
+        Tcl_WrongNumArgs(interp, 2, objv, "dbhandle package");
+        return TCL_ERROR;
+    }
+
+    if (objc == 5) {
+        Tcl_GetIntFromObj(interp, objv[4], &resolve);
+    } else {
+        resolve = 1;
+    }
+
+    connection = dbh->connection;
+    if (connection == NULL) {
+        Tcl_SetObjResult(interp, Tcl_NewStringObj("error: no connection", TCL_INDEX_NONE));
+        return TCL_ERROR;
+    }
+
+    package = Tcl_GetString(objv[3]);
+
+    if (desc_catalog_p && resolve) {
+        Tcl_Obj *descObj = desc_catalog_get(dbh, package);
+
+        if (descObj != NULL) {
+            Tcl_SetObjResult(interp, descObj);
+            return NS_OK;
+        }
+    }
+
+    oci_status = OCIHandleAlloc(connection->env,
+                                (dvoid *)&descHandlePtr,
+                                OCI_HTYPE_DESCRIBE, 0, NULL);
+    if (tcl_error_p(lexpos(), interp, dbh, "OCIHandleAlloc", package, oci_status)) {
+        Ns_OracleFlush(dbh);
+        return TCL_ERROR;
+    }
+
+    oci_status = OCIAttrSet(descHandlePtr,
+                            OCI_HTYPE_DESCRIBE,
+                            (dvoid *) 1, 0,
+                            OCI_ATTR_DESC_PUBLIC,
+                            connection->err);
+    if (tcl_error_p(lexpos(), interp, dbh, "OCIAttrSet", package, oci_status)) {
+        Ns_OracleFlush(dbh);
+        return TCL_ERROR;
+    }
+
+    oci_status = OCIDescribeAny(connection->svc,
+                                connection->err,
+                                package,
+                                (ub4) strlen(package),
+                                OCI_OTYPE_NAME,
+                                (ub1) 0,
+                                OCI_PTYPE_UNK,
+                                descHandlePtr);
+    if (tcl_error_p(lexpos(), interp, dbh, "OCIDescribeAny", package, oci_status)) {
+        Ns_OracleFlush(dbh);
+        return TCL_ERROR;
+    }
+
+    /* Get parameter handle */
+    oci_status = OCIAttrGet(descHandlePtr,
+                            OCI_HTYPE_DESCRIBE,
+                            &paramHandlePtr,
                             (ub4 *)0,
                             OCI_ATTR_PARAM,
                             connection->err);
@@ -2440,10 +3354,16 @@ OracleDesc(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHandle *dbh)
     switch (ptype) {
 
         case OCI_PTYPE_PKG:
-            OracleDescribePackage(descHandlePtr,
-                                  paramHandlePtr,
-                                  connection, dbh, package,
-                                  interp);
+            status = OracleDescribePackage(descHandlePtr,
+                                           paramHandlePtr,
+                                           connection, dbh, package,
+                                           interp);
+            /* a failed description must not be cached */
+            if (status == TCL_OK && desc_catalog_p && resolve
+                && dbh->connection != NULL) {
+                desc_catalog_put(dbh, package, paramHandlePtr,
+                                 Tcl_GetObjResult(interp));
+            }
             break;
 
         case OCI_PTYPE_SYN:
@@ -2460,7 +3380,7 @@ OracleDesc(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHandle *dbh)
     OCIHandleFree(descHandlePtr, OCI_HTYPE_DESCRIBE);
     OCIHandleFree(paramHandlePtr, OCI_DTYPE_PARAM);
 
-    return NS_OK;
+    return status;
 }
 /*}}}*/
 
@@ -2507,7 +3427,7 @@ OracleDescribeSynonym(OCIDescribe *UNUSED(descHandlePtr),
 /*}}}*/
 
 /*{{{ OracleDescribePackage */
-void
+int
 OracleDescribePackage(OCIDescribe      *descHandlePtr,
                       OCIParam         *paramHandlePtr,
                       ora_connection_t *connection,
@@ -2520,19 +3440,19 @@ OracleDescribePackage(OCIDescribe      *descHandlePtr,
     ub2           numProcs;
     ub4           namelen;
     const char   *name;
-    int           i;
+    int           i, status;
 
     oci_status = OCIAttrGet (paramHandlePtr, OCI_DTYPE_PARAM, &procListPtr, 0,
                              OCI_ATTR_LIST_SUBPROGRAMS, connection->err);
     if (tcl_error_p(lexpos(), interp, dbh, "OCIAttrGet", "", oci_status)) {
         Ns_OracleFlush(dbh);
-        return;
+        return TCL_ERROR;
     }
 
     oci_status = OCIAttrGet (procListPtr, OCI_DTYPE_PARAM, &numProcs, 0, OCI_ATTR_NUM_PARAMS, connection->err);
     if (tcl_error_p(lexpos(), interp, dbh, "OCIAttrGet", "", oci_status)) {
         Ns_OracleFlush(dbh);
-        return;
+        return TCL_ERROR;
     }
 
     for (i = 0; i < numProcs; i++) {
@@ -2544,14 +3464,20 @@ OracleDescribePackage(OCIDescribe      *descHandlePtr,
 
         Tcl_ListObjAppendElement(interp, procObj, Tcl_NewStringObj(name, (TCL_SIZE_T)namelen));
 
-        OracleDescribeArguments(descHandlePtr, arg1, connection, dbh, interp, procObj);
+        Tcl_IncrRefCount(procObj);
+        status = OracleDescribeArguments(descHandlePtr, arg1, connection, dbh, interp, procObj);
+        Tcl_DecrRefCount(procObj);
+        if (status != TCL_OK) {
+            return TCL_ERROR;
+        }
     }
 
+    return TCL_OK;
 }
 /*}}}*/
 
 /*{{{ OracleDescribeArguments */
-void
+int
 OracleDescribeArguments (OCIDescribe       *UNUSED(descHandlePtr),
                          OCIParam          *paramHandlePtr,
                          ora_connection_t  *connection,
@@ -2574,7 +3500,7 @@ OracleDescribeArguments (OCIDescribe       *UNUSED(descHandlePtr),
     oci_status = OCIAttrGet (paramHandlePtr, OCI_DTYPE_PARAM, &numargs, 0, OCI_ATTR_NUM_PARAMS, connection->err);
     if (tcl_error_p(lexpos(), interp, dbh, "OCIAttrGet", "", oci_status)) {
         Ns_OracleFlush(dbh);
-        return;
+        return TCL_ERROR;
     }
 
     for (i = 0; i < numargs; i++) {
@@ -2642,6 +3568,22 @@ OracleDescribeArguments (OCIDescribe       *UNUSED(descHandlePtr),
                 Tcl_ListObjAppendElement(interp, argument, Tcl_NewStringObj("REF CURSOR", -1));
                 break;
 
+            case OCI_TYPECODE_ITABLE: {
+                ub2 elem_type = ora_table_elem_type(connection, arg);
+
+                /* index-by tables, bound as arrays */
+                if (ora_call_number_type_p(elem_type)) {
+                    Tcl_ListObjAppendElement(interp, argument, Tcl_NewStringObj("TABLE OF NUMBER", -1));
+                } else if (elem_type == SQLT_DAT) {
+                    Tcl_ListObjAppendElement(interp, argument, Tcl_NewStringObj("TABLE OF DATE", -1));
+                } else if (elem_type == SQLT_CHR || elem_type == SQLT_AFC) {
+                    Tcl_ListObjAppendElement(interp, argument, Tcl_NewStringObj("TABLE OF VARCHAR2", -1));
+                } else {
+                    Tcl_ListObjAppendElement(interp, argument, Tcl_NewStringObj("TABLE", -1));
+                }
+                break;
+            }
+
             default:
                 Ns_Log(Warning, "Unknown Oracle Type: %d", data_type);
                 Tcl_ListObjAppendElement(interp, argument, Tcl_NewStringObj("", -1));
@@ -2657,1253 +3599,1736 @@ OracleDescribeArguments (OCIDescribe       *UNUSED(descHandlePtr),
         Tcl_ListObjAppendElement(interp, Tcl_GetObjResult(interp), list);
     }
 
+    return TCL_OK;
 }
 /*}}}*/
 
-/*
- * AOLserver [ns_db] implementation.
+/*{{{ OracleCall
+ *----------------------------------------------------------------------
+ * OracleCall --
+ *
+ *      Implements [ns_ora call] command.
+ *
+ *      ns_ora call dbhandle package.proc ?arg1 ... argN?
+ *
+ *      Calls a stored procedure or function.  Its arguments are
+ *      described once per pool and bound with their declared types,
+ *      the anonymous block for each combination of arguments is
+ *      generated once and prepared through the statement cache.
+ *
+ *      Arguments are passed by position: the value of IN arguments,
+ *      the name of a variable for OUT and IN OUT arguments.  "--"
+ *      passes the default of an argument that has one, trailing
+ *      arguments with defaults may be left out.  Of overloaded
+ *      procedures, the first one the arguments fit is called.
+ *
+ * Results:
+ *
+ *      The return value of a function, nothing for a procedure.
+ *
+ * Side effects:
  *
+ *      The variables of OUT and IN OUT arguments are set.
+ *
+ *----------------------------------------------------------------------
  */
-
-/*{{{ Ns_DbDriverInit */
-/* Entry point (called by AOLserver when driver loaded)
-
-   note that this does not leave behind any structures or state outside
-   of reading the configuration parameters, as well as
-   initializing OCI and registering our functions
-*/
-NS_EXPORT Ns_ReturnCode
-Ns_DbDriverInit (const char *hdriver, const char *config_path)
+int
+OracleCall(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHandle *dbh)
 {
-    Ns_ReturnCode ns_status;
+    ora_connection_t *connection = dbh->connection;
+    oci_status_t      oci_status;
+    ora_call_entry_t *entry;
+    ora_call_sig_t   *sig = NULL;
+    ora_call_bind_t  *binds;
+    Tcl_Obj *const   *args = objv + 4;
+    const char       *name, *query;
+    Tcl_DString       ds;
+    int               n_given = objc - 4, n_binds = 0;
+    int               i, forget_p = NS_FALSE, result = TCL_ERROR;
+    int               executed_p = NS_FALSE;
+    ub4               position = 1u;
+    Ns_Time           start;
 
-    debug_p = Ns_ConfigBool(config_path, "Debug", DEFAULT_DEBUG);
-    convert_encoding_p = Ns_ConfigBool(config_path, "ConvertEncoding", NS_FALSE);
+    if (objc < 4) {
+        Tcl_WrongNumArgs(interp, 2, objv, "dbhandle package.proc ?arg ...?");
+        return TCL_ERROR;
+    }
 
-    max_string_log_length = Ns_ConfigIntRange(config_path, "MaxStringLogLength", DEFAULT_MAX_STRING_LOG_LENGTH,
-                                              100, INT_MAX);
-    char_expansion = Ns_ConfigIntRange(config_path, "CharExpansion", DEFAULT_CHAR_EXPANSION, 1, 4);
+    name = Tcl_GetString(objv[3]);
+    if (!ora_call_name_p(name)) {
+        Tcl_AppendResult(interp, "invalid procedure name \"", name, "\"",
+                         (char*)0L);
+        return TCL_ERROR;
+    }
 
-    lob_buffer_size = (unsigned int)Ns_ConfigIntRange(config_path, "LobBufferSize", 16384, 1, 128000);
-    Ns_Log(Notice, "%s driver LobBufferSize = %d", hdriver, lob_buffer_size);
+    connection->interp = interp;
 
-    prefetch_rows = Ns_ConfigIntRange(config_path, "PrefetchRows", 0, 0, 1000000);
-    Ns_Log(Notice, "%s driver PrefetchRows = %d", hdriver, prefetch_rows);
+    entry = ora_call_lookup(interp, dbh, name);
+    if (entry == NULL) {
+        return TCL_ERROR;
+    }
 
-    prefetch_memory = Ns_ConfigIntRange(config_path, "PrefetchMemory", 0, 0, INT_MAX);
-    Ns_Log(Notice, "%s driver PrefetchMemory = %d", hdriver, prefetch_memory);
+    for (i = 0; i < entry->n_sigs; i++) {
+        if (ora_call_match_p(&entry->sigs[i], n_given, args)) {
+            sig = &entry->sigs[i];
+            break;
+        }
+    }
+    if (sig == NULL) {
+        Tcl_AppendResult(interp, "wrong number or types of arguments in call to ",
+                         name, (char*)0L);
+        ora_call_release(entry, NS_FALSE);
+        return TCL_ERROR;
+    }
 
-    ns_ora_log(lexpos(), "entry (hdriver %p, config_path %s)", hdriver, nilp(config_path));
+    Tcl_DStringInit(&ds);
+    ora_call_block(entry, sig, n_given, args, &ds);
+    query = Tcl_DStringValue(&ds);
+    binds = ns_calloc((size_t)n_given + 1u, sizeof(ora_call_bind_t));
 
-    ns_status = Ns_DbRegisterDriver(hdriver, ora_procs);
-    if (ns_status != NS_OK) {
-        error(lexpos(), "Could not register driver `%s'.",
-              nilp(ora_driver_name));
-        return NS_ERROR;
+    if (!allow_sql_p(dbh, Tcl_DStringValue(&ds), NS_TRUE)) {
+        Tcl_AppendResult(interp, "SQL ", query, " has been rejected "
+                         "by the Oracle driver", (char*)0L);
+        goto bailout;
     }
 
-    Ns_Log(Notice, "Loaded %s, built on %s/%s",
-           ora_driver_version, __TIME__, __DATE__);
+    oci_status = OCIStmtPrepare2(connection->svc,
+                                 &connection->stmt,
+                                 connection->err,
+                                 (const OraText *)query,
+                                 (ub4) Tcl_DStringLength(&ds),
+                                 NULL, 0,
+                                 OCI_NTV_SYNTAX, OCI_DEFAULT);
+    if (tcl_error_p(lexpos(), interp, dbh, "OCIStmtPrepare2", query, oci_status)) {
+        goto bailout;
+    }
+    connection->stmt_cached = NS_TRUE;
 
-#if defined(FOR_CASSANDRACLE)
-    Ns_Log(Notice,
-           "    This Oracle Driver is a reduced-functionality Cassandracle driver");
-#endif
+    if (sig->ret != NULL) {
+        binds[n_binds].arg = sig->ret;
+        if (ora_call_bind(interp, dbh, &binds[n_binds++], NULL,
+                          position++, query) != TCL_OK) {
+            goto bailout;
+        }
+    }
+    for (i = 0; i < n_given; i++) {
+        if (sig->args[i].has_default
+            && strcmp(Tcl_GetString(args[i]), "--") == 0) {
+            continue;
+        }
+        binds[n_binds].arg = &sig->args[i];
+        if (ora_call_bind(interp, dbh, &binds[n_binds++], args[i],
+                          position++, query) != TCL_OK) {
+            goto bailout;
+        }
+    }
 
-    ns_ora_log(lexpos(), "driver `%s' loaded.", nilp(ora_driver_name));
+    Ns_GetTime(&start);
+    oci_status = OCIStmtExecute(connection->svc,
+                                connection->stmt,
+                                connection->err,
+                                1, 0, NULL, NULL,
+                                (connection->mode == autocommit
+                                 ? OCI_COMMIT_ON_SUCCESS : OCI_DEFAULT));
+    executed_p = NS_TRUE;
+    if (oci_status == OCI_ERROR) {
+        sb4 errorcode = 0;
 
-    return NS_OK;
-}
-/*}}}*/
+        /* PLS errors: the procedure changed since it was described */
+        OCIErrorGet(connection->err, 1, NULL, &errorcode, NULL, 0,
+                    OCI_HTYPE_ERROR);
+        forget_p = (errorcode == 6550);
+    }
+    if (tcl_error_p(lexpos(), interp, dbh, "OCIStmtExecute", query, oci_status)) {
+        goto bailout;
+    }
 
-/*{{{ Ns_OracleInterpInit */
-static int
-Ns_OracleInterpInit(Tcl_Interp *interp, const void *UNUSED(dummy))
-{
-    Tcl_CreateObjCommand (interp, "ns_ora", OracleObjCmd,
-            (ClientData) NULL, (Tcl_CmdDeleteProc *) NULL);
+    for (i = 0; i < n_binds; i++) {
+        ora_call_bind_t *bind = &binds[i];
+        Tcl_Obj         *valueObj;
 
-    Tcl_CreateObjCommand (interp, "ns_oracle", OracleObjCmd,
-            (ClientData) NULL, (Tcl_CmdDeleteProc *) NULL);
+        if (bind->arg->mode == OCI_TYPEPARAM_IN) {
+            continue;
+        }
+        valueObj = ora_call_value(interp, dbh, bind);
+        if (valueObj == NULL) {
+            goto bailout;
+        }
+        if (bind->varObj == NULL) {
+            Tcl_SetObjResult(interp, valueObj);
+        } else if (Tcl_ObjSetVar2(interp, bind->varObj, NULL, valueObj,
+                                  TCL_LEAVE_ERR_MSG) == NULL) {
+            goto bailout;
+        }
+    }
 
-#if defined(NS_AOLSERVER_3_PLUS)
-    Tcl_CreateCommand(interp, "ns_column", ora_column_command, NULL, NULL);
-    Tcl_CreateCommand(interp, "ns_table", ora_table_command, NULL, NULL);
-#endif
+    result = TCL_OK;
 
-    return NS_OK;
+ bailout:
+    if (executed_p) {
+        ora_dbms_output_log(dbh, &start, query);
+    }
+    for (i = 0; i < n_binds; i++) {
+        ora_call_unbind(dbh->connection, &binds[i]);
+    }
+    ns_free(binds);
+    Tcl_DStringFree(&ds);
+    Ns_OracleFlush(dbh);
+    ora_call_release(entry, forget_p);
+
+    return result;
 }
 /*}}}*/
 
-/*{{{ Ns_OracleServerInit */
-static Ns_ReturnCode
-Ns_OracleServerInit(char *hserver, char *hmodule, char *hdriver)
+/*{{{ OracleDbmsOutput
+ *----------------------------------------------------------------------
+ * OracleDbmsOutput --
+ *
+ *      Implements [ns_ora dbms_output].
+ *
+ *      ns_ora dbms_output dbhandle ?-enable bytes? ?-log ms?
+ *
+ *      Fetches the lines DBMS_OUTPUT has pending, DBMS_OUTPUT_LINES at
+ *      a time with DBMS_OUTPUT.GET_LINES.  -enable then enables the
+ *      output of the session with a buffer of the given size, or
+ *      disables it for 0.  With -log, the lines pending after call,
+ *      plsql, exec_plsql and exec_plsql_bind taking at least ms
+ *      milliseconds are logged with severity Debug; negative ms turn
+ *      this off.  Logged lines are consumed, a later dbms_output
+ *      doesn't return them.
+ *
+ * Results:
+ *
+ *      The list of pending lines.
+ *
+ *----------------------------------------------------------------------
+ */
+int
+OracleDbmsOutput(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHandle *dbh)
 {
-    ns_ora_log(lexpos(), "entry (%s, %s, %s)", nilp(hserver), nilp(hmodule),
-        nilp(hdriver));
+    ora_connection_t *connection = dbh->connection;
+    oci_status_t      oci_status;
+    OCIStmt          *stmt = NULL;
+    OCIBind          *bind = NULL;
+    Tcl_Obj          *listObj;
+    const char       *query;
+    int               argbase, bytes = INT_MIN, log = connection->dbms_output_log;
+    sb4               size;
+
+    for (argbase = 3; argbase < objc; argbase += 2) {
+        const char *option = Tcl_GetString(objv[argbase]);
+        int        *valuePtr;
+
+        if (!strcmp(option, "-enable")) {
+            valuePtr = &bytes;
+        } else if (!strcmp(option, "-log")) {
+            valuePtr = &log;
+        } else {
+            break;
+        }
+        if (argbase + 1 >= objc) {
+            break;
+        }
+        if (Tcl_GetIntFromObj(interp, objv[argbase + 1], valuePtr) != TCL_OK) {
+            return TCL_ERROR;
+        }
+    }
+    if (argbase != objc) {
+        Tcl_WrongNumArgs(interp, 2, objv, "dbhandle ?-enable bytes? ?-log ms?");
+        return TCL_ERROR;
+    }
+    if (bytes != INT_MIN && bytes < 0) {
+        Tcl_AppendResult(interp, "-enable must not be negative", (char*)0L);
+        return TCL_ERROR;
+    }
 
-    return Ns_TclRegisterTrace(hserver, Ns_OracleInterpInit, NULL, NS_TCL_TRACE_CREATE);
+    listObj = Tcl_NewListObj(0, NULL);
+    Tcl_IncrRefCount(listObj);
+    if (ora_dbms_output_lines(dbh, listObj) != TCL_OK) {
+        Tcl_SetResult(interp, dbh->dsExceptionMsg.string, TCL_VOLATILE);
+        Tcl_DecrRefCount(listObj);
+        return TCL_ERROR;
+    }
+
+    if (bytes >= 0) {
+        query = (bytes > 0)
+            ? "begin dbms_output.enable(:1); end;"
+            : "begin dbms_output.disable; end;";
+        size = (sb4)bytes;
+
+        oci_status = OCIStmtPrepare2(connection->svc, &stmt, connection->err,
+                                     (const OraText *)query, (ub4)strlen(query),
+                                     NULL, 0, OCI_NTV_SYNTAX, OCI_DEFAULT);
+        if (!oci_error_p(lexpos(), dbh, "OCIStmtPrepare2", query, oci_status)) {
+            if (bytes > 0) {
+                oci_status = OCIBindByPos(stmt, &bind, connection->err, 1,
+                                          &size, (sb4)sizeof(size), SQLT_INT,
+                                          NULL, NULL, NULL, 0, NULL, OCI_DEFAULT);
+            }
+            if (!oci_error_p(lexpos(), dbh, "OCIBindByPos", query, oci_status)) {
+                oci_status = OCIStmtExecute(connection->svc, stmt, connection->err,
+                                            1, 0, NULL, NULL, OCI_DEFAULT);
+                (void) oci_error_p(lexpos(), dbh, "OCIStmtExecute", query, oci_status);
+            }
+            (void) OCIStmtRelease(stmt, connection->err, NULL, 0, OCI_DEFAULT);
+        }
+        if (oci_status != OCI_SUCCESS && oci_status != OCI_SUCCESS_WITH_INFO) {
+            Tcl_SetResult(interp, dbh->dsExceptionMsg.string, TCL_VOLATILE);
+            Tcl_DecrRefCount(listObj);
+            return TCL_ERROR;
+        }
+        connection->dbms_output_p = (bytes > 0);
+    }
+    connection->dbms_output_log = log;
+
+    Tcl_SetObjResult(interp, listObj);
+    Tcl_DecrRefCount(listObj);
+
+    return TCL_OK;
 }
 /*}}}*/
 
-/*{{{ Ns_OracleName */
-/*----------------------------------------------------------------------
- * Ns_OracleName --
+/*{{{ OraclePrepare
+ *----------------------------------------------------------------------
+ * OraclePrepare --
  *
- *      Return name of database driver.
+ *      Implements [ns_ora prepare].
+ *
+ *      ns_ora prepare dbhandle sql
+ *
+ *      Prepares the statement on a statement handle of its own and
+ *      binds its bind variables, to be executed any number of times
+ *      with [ns_ora exec] until [ns_ora close] or the release of the
+ *      handle.
+ *
+ * Results:
+ *
+ *      The id of the statement.
  *
  *----------------------------------------------------------------------
  */
-static const char *
-Ns_OracleName (Ns_DbHandle *dummy)
+int
+OraclePrepare(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHandle *dbh)
 {
-    ns_ora_log(lexpos(), "entry (dummy %p)", dummy);
+    ora_connection_t  *connection = dbh->connection;
+    oci_status_t       oci_status;
+    ora_prepared_t    *prepared;
+    ora_object_t      *object;
+    char              *query;
 
-    return ora_driver_name;
+    if (objc != 4) {
+        Tcl_WrongNumArgs(interp, 2, objv, "dbhandle sql");
+        return TCL_ERROR;
+    }
+
+    query = Tcl_GetString(objv[3]);
+
+    if (!allow_sql_p(dbh, query, NS_TRUE)) {
+        Tcl_AppendResult(interp, "SQL ", query, " has been rejected "
+                         "by the Oracle driver", (char*)0L);
+        return TCL_ERROR;
+    }
+
+    prepared = ns_calloc(1u, sizeof(ora_prepared_t));
+    prepared->query = Ns_StrDup(query);
+
+    oci_status = OCIHandleAlloc(connection->env,
+                                (oci_handle_t **) &prepared->stmt,
+                                OCI_HTYPE_STMT, 0, NULL);
+    if (tcl_error_p(lexpos(), interp, dbh, "OCIHandleAlloc", query, oci_status)) {
+        prepared->stmt = NULL;
+        goto bailout;
+    }
+
+    oci_status = OCIStmtPrepare(prepared->stmt, connection->err,
+                                (const OraText *)query, (ub4)strlen(query),
+                                OCI_NTV_SYNTAX, OCI_DEFAULT);
+    if (tcl_error_p(lexpos(), interp, dbh, "OCIStmtPrepare", query, oci_status)) {
+        goto bailout;
+    }
+
+    oci_status = OCIAttrGet(prepared->stmt, OCI_HTYPE_STMT,
+                            (oci_attribute_t *) &prepared->type, NULL,
+                            OCI_ATTR_STMT_TYPE, connection->err);
+    if (tcl_error_p(lexpos(), interp, dbh, "OCIAttrGet", query, oci_status)) {
+        goto bailout;
+    }
+
+    prepared->bind_variables = parse_bind_variables(prepared->query);
+    prepared->n_binds = string_list_len(prepared->bind_variables);
+    prepared->binds = ns_calloc((size_t)prepared->n_binds + 1u,
+                                sizeof(fetch_buffer_t));
+
+    if (ora_prepared_bind(interp, dbh, prepared->stmt, query,
+                          prepared->bind_variables, prepared->binds) != TCL_OK) {
+        goto bailout;
+    }
+
+    object = ora_object_new(connection, Tcl_GetString(objv[2]),
+                            ORA_OBJECT_STATEMENT, "stmt",
+                            prepared, ora_prepared_free);
+    Tcl_SetObjResult(interp, ora_object_id(object));
+    return TCL_OK;
+
+  bailout:
+    ora_prepared_free(connection, prepared);
+
+    return TCL_ERROR;
 }
 /*}}}*/
 
-/*{{{ Ns_OracleDbType */
-/*----------------------------------------------------------------------
- * Ns_OracleDbType --
+/*{{{ OracleExec
+ *----------------------------------------------------------------------
+ * OracleExec --
  *
- *      This function returns the string which identifies the database
- *      type.
+ *      Implements [ns_ora exec].
  *
- *      Implements [ns_db dbtype]
+ *      ns_ora exec stmtid ?-bind set|dict? ?arg1 .. argN?
+ *
+ *      Executes a statement of [ns_ora prepare] with new values for its
+ *      bind variables, taken as by [ns_ora dml]: positional variables
+ *      from the arguments, named ones from the ns_set or dict of -bind
+ *      or else from Tcl variables.  OUT values of PL/SQL blocks are set
+ *      to the Tcl variables.
+ *
+ * Results:
+ *
+ *      The rows of a query as returned by [ns_ora rows], the number of
+ *      rows processed by other statements.
  *
  *----------------------------------------------------------------------
  */
-static const char *
-Ns_OracleDbType (Ns_DbHandle *dummy)
+int
+OracleExec(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHandle *UNUSED(dbh))
 {
-    ns_ora_log(lexpos(), "entry (dummy %p)", dummy);
+    ora_object_t      *object;
+    ora_prepared_t    *prepared;
 
-    return ora_driver_name;
+    if (objc < 3 || (objc > 3 && !strcmp(Tcl_GetString(objv[3]), "-bind") && objc < 5)) {
+        Tcl_WrongNumArgs(interp, 2, objv, "stmtid ?-bind set|dict? ?arg1 .. argN?");
+        return TCL_ERROR;
+    }
+
+    object = ora_object_get(interp, objv[2], ORA_OBJECT_STATEMENT, "statement");
+    if (object == NULL) {
+        return TCL_ERROR;
+    }
+    prepared = object->data;
+
+    return ora_prepared_exec(interp, object->connection->dbh, prepared->stmt,
+                             prepared->type, prepared->query,
+                             prepared->bind_variables, prepared->binds,
+                             CURSOR_FETCH_ROWS, objc - 3, objv + 3);
 }
 /*}}}*/
 
-/*{{{ Ns_OracleOpenDb */
-/*----------------------------------------------------------------------
- * Ns_OracleOpenDb --
+/*{{{ OracleClose
+ *----------------------------------------------------------------------
+ * OracleClose --
  *
- *      Opens a database connection.
+ *      Implements [ns_ora close].
  *
- *      Implements [ns_db open]
+ *      ns_ora close stmtid|cursorid
+ *
+ *      Frees a statement of [ns_ora prepare] or a cursor of
+ *      [ns_ora open_cursor].
+ *
+ * Results:
+ *
+ *      Nothing.
  *
  *----------------------------------------------------------------------
  */
-static Ns_ReturnCode
-Ns_OracleOpenDb (Ns_DbHandle *dbh)
+int
+OracleClose(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHandle *UNUSED(dbh))
 {
-    oci_status_t oci_status;
-    ora_connection_t *connection;
+    ora_object_t *object;
 
-    ns_ora_log(lexpos(), "entry (dbh %p)", dbh);
-
-    if (dbh == NULL) {
-        error(lexpos(), "invalid args.");
-        return NS_ERROR;
+    if (objc != 3) {
+        Tcl_WrongNumArgs(interp, 2, objv, "stmtid|cursorid");
+        return TCL_ERROR;
     }
 
-    if (! dbh->password) {
-        error(lexpos(),
-              "Missing Password parameter in configuration file for pool %s.",
-              dbh->poolname );
-        return NS_ERROR;
+    object = ora_object_get(interp, objv[2], ORA_OBJECT_STATEMENT, "statement");
+    if (object == NULL) {
+        Tcl_ResetResult(interp);
+        object = ora_object_get(interp, objv[2], ORA_OBJECT_CURSOR,
+                                "statement or cursor");
     }
-
-    if (! dbh->user) {
-        error(lexpos(),
-              "Missing User parameter in configuration file for pool %s.",
-              dbh->poolname);
-        return NS_ERROR;
+    if (object == NULL) {
+        return TCL_ERROR;
     }
+    ora_object_free(object);
 
-    connection = Ns_Malloc(sizeof *connection);
+    return TCL_OK;
+}
+/*}}}*/
 
-    connection->dbh = dbh;
-    connection->env = NULL;
-    connection->err = NULL;
-    connection->srv = NULL;
-    connection->svc = NULL;
-    connection->auth = NULL;
-    connection->stmt = NULL;
-    connection->mode = autocommit;
-    connection->n_columns = 0;
-    connection->fetch_buffers = NULL;
+/*{{{ OracleOpenCursor
+ *----------------------------------------------------------------------
+ * OracleOpenCursor --
+ *
+ *      Implements [ns_ora open_cursor].
+ *
+ *      ns_ora open_cursor dbhandle ?-scrollable? sql ?-bind set|dict? ?arg1 .. argN?
+ *
+ *      Executes the query on a statement of its own, with bind values
+ *      taken as by [ns_ora exec].  Its rows are read with [ns_ora
+ *      getrow] or [ns_ora fetch] while the handle runs other statements,
+ *      including other cursors; the handle is not flushed.  The rows of
+ *      a -scrollable cursor may be fetched in any order.
+ *
+ * Results:
+ *
+ *      The id of the cursor, freed by [ns_ora close] or the release of
+ *      the handle.
+ *
+ *----------------------------------------------------------------------
+ */
+int
+OracleOpenCursor(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHandle *dbh)
+{
+    ora_connection_t  *connection = dbh->connection;
+    oci_status_t       oci_status;
+    ora_cursor_t      *cursor;
+    ora_object_t      *object;
+    string_list_elt_t *bind_variables = NULL;
+    fetch_buffer_t    *binds = NULL;
+    char              *query;
+    ub2                type = 0;
+    int                i, n_binds = 0, argbase = 3, scrollable_p = NS_FALSE;
 
-    /*  AOLserver, in their database handle structure, gives us one field
-     *  to store our connection structure.
-     */
-    dbh->connection = connection;
+    if (objc > 4 && !strcmp(Tcl_GetString(objv[3]), "-scrollable")) {
+        scrollable_p = NS_TRUE;
+        argbase++;
+    }
+    if (objc < argbase + 1
+        || (objc > argbase + 1 && !strcmp(Tcl_GetString(objv[argbase + 1]), "-bind")
+            && objc < argbase + 3)) {
+        Tcl_WrongNumArgs(interp, 2, objv,
+                         "dbhandle ?-scrollable? sql ?-bind set|dict? ?arg1 .. argN?");
+        return TCL_ERROR;
+    }
 
-    if (convert_encoding_p) {
-        /*
-         * Value for the character set IDs. Since the client side (Tcl) is
-         * always converting from and to UTF-8, we tell Oracle that the client
-         * is UTF-8 and not necessarily the same as the database
-         * encoding. Since the interface requires the ID to be set when
-         * establishing the connection, we provide here the value hard-coded
-         * (which seems common practice).
-         *
-         * The ID can be obtained from Oracle via the following SQL statement.
-         *
-         *    col nls_charset_id for 9999
-         *    col value for a20
-         *    select nls_charset_id(value) nls_charset_id, value from v$nls_valid_values
-         *           where parameter = 'CHARACTERSET' and value like '%UTF%';
-         */
-        const ub2 AL32UTF8 = 873;
+    query = Tcl_GetString(objv[argbase]);
 
-        oci_status = OCIEnvNlsCreate(&connection->env,
-                                     OCI_THREADED|OCI_ENV_NO_MUTEX,
-                                     NULL,
-                                     Ns_OracleMalloc,
-                                     Ns_OracleRealloc,
-                                     Ns_OracleFree,
-                                     0, NULL,
-                                     AL32UTF8, AL32UTF8
-                                     );
-        if (oci_error_p(lexpos(), NULL, "OCIEnvNlsCreate", 0, oci_status)) {
-            return NS_ERROR;
-        }
-    } else {
-        oci_status = OCIEnvCreate(&connection->env,
-                                  OCI_THREADED|OCI_ENV_NO_MUTEX,
-                                  NULL,
-                                  Ns_OracleMalloc,
-                                  Ns_OracleRealloc,
-                                  Ns_OracleFree,
-                                  0, NULL);
-        if (oci_error_p(lexpos(), NULL, "OCIEnvCreate", 0, oci_status)) {
-            return NS_ERROR;
-        }
+    if (!allow_sql_p(dbh, query, NS_TRUE)) {
+        Tcl_AppendResult(interp, "SQL ", query, " has been rejected "
+                         "by the Oracle driver", (char*)0L);
+        return TCL_ERROR;
     }
 
-    /* sets connection->err */
-    oci_status = OCIHandleAlloc(connection->env,
-                                (oci_handle_t **) & connection->err,
-                                OCI_HTYPE_ERROR, 0, NULL);
-    if (oci_error_p(lexpos(), dbh, "OCIHandleAlloc", 0, oci_status))
-        return NS_ERROR;
-
-    /* sets connection->srv */
-    oci_status = OCIHandleAlloc(connection->env,
-                                (oci_handle_t **) & connection->srv,
-                                OCI_HTYPE_SERVER, 0, NULL);
-    if (oci_error_p(lexpos(), dbh, "OCIHandleAlloc", 0, oci_status))
-        return NS_ERROR;
+    cursor = ns_calloc(1u, sizeof(ora_cursor_t));
+    cursor->query = Ns_StrDup(query);
+    cursor->array_size = CURSOR_FETCH_ROWS;
+    cursor->scrollable_p = scrollable_p;
 
-    /* sets connection->svc */
     oci_status = OCIHandleAlloc(connection->env,
-                                (oci_handle_t **) & connection->svc,
-                                OCI_HTYPE_SVCCTX, 0, NULL);
-    if (oci_error_p(lexpos(), dbh, "OCIHandleAlloc", 0, oci_status))
-        return NS_ERROR;
+                                (oci_handle_t **) &cursor->stmt,
+                                OCI_HTYPE_STMT, 0, NULL);
+    if (tcl_error_p(lexpos(), interp, dbh, "OCIHandleAlloc", query, oci_status)) {
+        cursor->stmt = NULL;
+        goto bailout;
+    }
 
-    /*
-     * Create association between server handle and access path (datasource;
-     * a string from the configuration file).
-     */
-    oci_status = OCIServerAttach(connection->srv, connection->err,
-                                 (const OraText *)dbh->datasource,
-                                 (sb4) strlen(dbh->datasource), OCI_DEFAULT);
-    if (oci_error_p(lexpos(), dbh, "OCIServerAttach", 0, oci_status))
-        return NS_ERROR;
+    oci_status = OCIStmtPrepare(cursor->stmt, connection->err,
+                                (const OraText *)query, (ub4)strlen(query),
+                                OCI_NTV_SYNTAX, OCI_DEFAULT);
+    if (tcl_error_p(lexpos(), interp, dbh, "OCIStmtPrepare", query, oci_status)) {
+        goto bailout;
+    }
 
-    /* tell OCI to associate the server handle with the context handle */
-    oci_status = OCIAttrSet(connection->svc,
-                            OCI_HTYPE_SVCCTX,
-                            (void *)connection->srv,
-                            0, OCI_ATTR_SERVER, connection->err);
-    if (oci_error_p(lexpos(), dbh, "OCIAttrSet", 0, oci_status))
-        return NS_ERROR;
+    oci_status = OCIAttrGet(cursor->stmt, OCI_HTYPE_STMT,
+                            (oci_attribute_t *) &type, NULL,
+                            OCI_ATTR_STMT_TYPE, connection->err);
+    if (tcl_error_p(lexpos(), interp, dbh, "OCIAttrGet", query, oci_status)) {
+        goto bailout;
+    }
+    if (type != OCI_STMT_SELECT) {
+        Tcl_AppendResult(interp, "open_cursor needs a query, got `",
+                         query, "'", (char*)0L);
+        goto bailout;
+    }
 
-    /* allocate connection->auth */
-    oci_status = OCIHandleAlloc(connection->env,
-                                (oci_handle_t **) & connection->auth,
-                                OCI_HTYPE_SESSION, 0, NULL);
-    if (oci_error_p(lexpos(), dbh, "OCIHandleAlloc", 0, oci_status))
-        return NS_ERROR;
+    /* the values are sent with the execute, the binds are not needed
+       for the fetches */
+    bind_variables = parse_bind_variables(cursor->query);
+    n_binds = string_list_len(bind_variables);
+    binds = ns_calloc((size_t)n_binds + 1u, sizeof(fetch_buffer_t));
+    connection->interp = interp;
 
-    /* give OCI the username from the nsd.ini file */
-    oci_status = OCIAttrSet(connection->auth,
-                            OCI_HTYPE_SESSION,
-                            (void *)dbh->user,
-                            (ub4) strlen(dbh->user),
-                            OCI_ATTR_USERNAME, connection->err);
-    if (oci_error_p(lexpos(), dbh, "OCIAttrSet", 0, oci_status))
-        return NS_ERROR;
+    if (ora_prepared_bind(interp, dbh, cursor->stmt, query,
+                          bind_variables, binds) != TCL_OK
+        || ora_prepared_values(interp, bind_variables, binds,
+                               objc - argbase - 1, objv + argbase + 1) != TCL_OK) {
+        goto bailout;
+    }
 
-    /* give OCI the password from the nsd.ini file */
-    oci_status = OCIAttrSet(connection->auth,
-                            OCI_HTYPE_SESSION,
-                            (void *)dbh->password,
-                            (ub4) strlen(dbh->password),
-                            OCI_ATTR_PASSWORD, connection->err);
-    if (oci_error_p(lexpos(), dbh, "OCIAttrSet", 0, oci_status))
-        return NS_ERROR;
+    oci_status = OCIStmtExecute(connection->svc, cursor->stmt, connection->err,
+                                0, 0, NULL, NULL,
+                                scrollable_p ? OCI_STMT_SCROLLABLE_READONLY : OCI_DEFAULT);
+    if (tcl_error_p(lexpos(), interp, dbh, "OCIStmtExecute", query, oci_status)) {
+        goto bailout;
+    }
 
-    /* the OCI docs say this "creates a user session and begins a
-       user session for a given server */
-    oci_status = OCISessionBegin(connection->svc,
-                                 connection->err,
-                                 connection->auth,
-                                 OCI_CRED_RDBMS, OCI_DEFAULT);
-    if (oci_error_p(lexpos(), dbh, "OCISessionBegin", 0, oci_status))
-        return NS_ERROR;
+    cursor->fetchbufs = ora_cursor_define(interp, dbh, cursor->stmt,
+                                          cursor->array_size, query,
+                                          &cursor->n_columns);
+    if (cursor->fetchbufs == NULL) {
+        goto bailout;
+    }
 
-    /* associate the particular authentications with a particular context */
-    oci_status = OCIAttrSet(connection->svc,
-                            OCI_HTYPE_SVCCTX,
-                            connection->auth,
-                            0, OCI_ATTR_SESSION, connection->err);
-    if (oci_error_p(lexpos(), dbh, "OCIAttrSet", 0, oci_status))
-        return NS_ERROR;
+    for (i = 0; i < n_binds; i++) {
+        fetch_buffer_free_buf(&binds[i]);
+    }
+    ns_free(binds);
+    string_list_free_list(bind_variables);
 
-    ns_ora_log(lexpos(), "(dbh %p); return NS_OK;", dbh);
+    object = ora_object_new(connection, Tcl_GetString(objv[2]),
+                            ORA_OBJECT_CURSOR, "cursor",
+                            cursor, ora_cursor_object_free);
+    Tcl_SetObjResult(interp, ora_object_id(object));
+    return TCL_OK;
 
-    dbh->connected = NS_TRUE;
+  bailout:
+    for (i = 0; i < n_binds; i++) {
+        fetch_buffer_free_buf(&binds[i]);
+    }
+    ns_free(binds);
+    string_list_free_list(bind_variables);
+    ora_cursor_object_free(connection, cursor);
 
-    return NS_OK;
+    return TCL_ERROR;
 }
 /*}}}*/
 
-/*{{{ Ns_OracleCloseDb */
-/*----------------------------------------------------------------------
- * Ns_OracleCloseDb --
+/*{{{ OracleGetRow
+ *----------------------------------------------------------------------
+ * OracleGetRow --
  *
- *      Closes a database connection and clean up handle.
+ *      Implements [ns_ora getrow].
  *
- *      Implements [ns_db close]
+ *      ns_ora getrow cursorid varName
+ *
+ *      Sets varName to the next row of a cursor of [ns_ora open_cursor],
+ *      a dict of column names and values as in [ns_ora rows].  A new
+ *      batch of rows is fetched when the last one is used up.
+ *
+ * Results:
+ *
+ *      1 if there was a row, 0 at the end of the rows.
  *
  *----------------------------------------------------------------------
  */
-static Ns_ReturnCode
-Ns_OracleCloseDb (Ns_DbHandle *dbh)
+int
+OracleGetRow(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHandle *UNUSED(dbh))
 {
-    oci_status_t oci_status;
+    ora_object_t     *object;
+    ora_cursor_t     *cursor;
     ora_connection_t *connection;
+    Tcl_Obj          *rowObj;
 
-    ns_ora_log(lexpos(), "entry (dbh %p)", dbh);
-
-    if (dbh == NULL) {
-        error(lexpos(), "invalid args.");
-        return NS_ERROR;
+    if (objc != 4) {
+        Tcl_WrongNumArgs(interp, 2, objv, "cursorid varName");
+        return TCL_ERROR;
     }
 
-    connection = dbh->connection;
-    if (!connection) {
-        error(lexpos(), "no connection.");
-        return NS_ERROR;
+    object = ora_object_get(interp, objv[2], ORA_OBJECT_CURSOR, "cursor");
+    if (object == NULL) {
+        return TCL_ERROR;
     }
+    cursor = object->data;
+    connection = object->connection;
 
-    /* don't return on error; just clean up the best we can */
-    oci_status = OCIServerDetach(connection->srv,
-                                 connection->err, OCI_DEFAULT);
-    oci_error_p(lexpos(), dbh, "OCIServerDetach", 0, oci_status);
-
-    oci_status = OCIHandleFree(connection->svc, OCI_HTYPE_SVCCTX);
-    oci_error_p(lexpos(), dbh, "OCIHandleFree", 0, oci_status);
-    connection->svc = 0;
-
-    oci_status = OCIHandleFree(connection->srv, OCI_HTYPE_SERVER);
-    oci_error_p(lexpos(), dbh, "OCIHandleFree", 0, oci_status);
-    connection->srv = 0;
-
-    oci_status = OCIHandleFree(connection->err, OCI_HTYPE_ERROR);
-    oci_error_p(lexpos(), dbh, "OCIHandleFree", 0, oci_status);
-    connection->err = 0;
-
-    oci_status = OCIHandleFree(connection->auth, OCI_HTYPE_SESSION);
-    oci_error_p(lexpos(), dbh, "OCIHandleFree", 0, oci_status);
-    connection->auth = 0;
-
-    oci_status = OCIHandleFree(connection->env, OCI_HTYPE_ENV);
-    oci_error_p(lexpos(), dbh, "OCIHandleFree", 0, oci_status);
-    connection->env = 0;
+    while (cursor->row >= cursor->n_rows) {
+        if (cursor->end_p) {
+            Tcl_SetObjResult(interp, Tcl_NewIntObj(0));
+            return TCL_OK;
+        }
+        if (ora_cursor_fetch(interp, connection, cursor, cursor->array_size,
+                             OCI_FETCH_NEXT, 0) != TCL_OK) {
+            return TCL_ERROR;
+        }
+    }
 
-    Ns_Free(connection);
-    dbh->connection = NULL;
-    dbh->connected = NS_FALSE;
+    rowObj = ora_cursor_row(interp, connection->dbh, cursor->fetchbufs,
+                            cursor->n_columns, cursor->row++);
+    if (rowObj == NULL) {
+        return TCL_ERROR;
+    }
+    if (Tcl_ObjSetVar2(interp, objv[3], NULL, rowObj, TCL_LEAVE_ERR_MSG) == NULL) {
+        return TCL_ERROR;
+    }
 
-    return NS_OK;
+    Tcl_SetObjResult(interp, Tcl_NewIntObj(1));
+    return TCL_OK;
 }
 /*}}}*/
 
-/*{{{ Ns_OracleSelect */
-/*----------------------------------------------------------------------
- * Ns_OracleSelect --
+/*{{{ OracleFetch
+ *----------------------------------------------------------------------
+ * OracleFetch --
  *
- *      Execute a select statement and bindrow it.
+ *      Implements [ns_ora fetch].
  *
- *      Implements [ns_db select]
+ *      ns_ora fetch cursorid ?-absolute n|-relative n|-last? ?-count n?
+ *
+ *      Fetches count rows (1 by default) of a cursor of [ns_ora
+ *      open_cursor] with one OCIStmtFetch2 per CURSOR_FETCH_MAX rows,
+ *      so that the fetch buffers stay bounded.  Without options the rows
+ *      follow the last row fetched.  The positions of -absolute (from
+ *      1), -relative (from the last row fetched) and -last need a
+ *      -scrollable cursor.  Rows of the current [ns_ora getrow] batch
+ *      not read yet are skipped.
+ *
+ * Results:
+ *
+ *      The list of rows fetched, dicts as in [ns_ora rows]; fewer than
+ *      count rows at the end of the rows.
  *
  *----------------------------------------------------------------------
  */
-static Ns_Set *
-Ns_OracleSelect (Ns_DbHandle *dbh, char *sql)
+int
+OracleFetch(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHandle *UNUSED(dbh))
 {
-    int ns_status;
+    ora_object_t     *object;
+    ora_cursor_t     *cursor;
+    ora_connection_t *connection;
+    Tcl_Obj          *rowsObj, *rowObj;
+    ub2               orientation = OCI_FETCH_NEXT;
+    int               i, offset = 0, count = 1;
 
-    ns_ora_log(lexpos(), "entry (dbh %p, sql %s)", dbh, nilp(sql));
+    if (objc < 3) {
+        Tcl_WrongNumArgs(interp, 2, objv,
+                         "cursorid ?-absolute n|-relative n|-last? ?-count n?");
+        return TCL_ERROR;
+    }
 
-    if (dbh  == NULL || sql == NULL) {
-        error(lexpos(), "invalid args.");
-        return 0;
+    for (i = 3; i < objc; i++) {
+        const char *option = Tcl_GetString(objv[i]);
+
+        if (!strcmp(option, "-last")) {
+            orientation = OCI_FETCH_LAST;
+            continue;
+        }
+        if (strcmp(option, "-absolute") && strcmp(option, "-relative")
+            && strcmp(option, "-count")) {
+            Tcl_AppendResult(interp, "bad option \"", option, "\": must be "
+                             "-absolute, -relative, -last or -count", (char*)0L);
+            return TCL_ERROR;
+        }
+        if (i + 1 >= objc) {
+            Tcl_AppendResult(interp, "missing value of ", option, (char*)0L);
+            return TCL_ERROR;
+        }
+        if (!strcmp(option, "-count")) {
+            if (Tcl_GetIntFromObj(interp, objv[++i], &count) != TCL_OK) {
+                return TCL_ERROR;
+            }
+            if (count < 1) {
+                Tcl_AppendResult(interp, "-count must be positive", (char*)0L);
+                return TCL_ERROR;
+            }
+        } else {
+            if (Tcl_GetIntFromObj(interp, objv[++i], &offset) != TCL_OK) {
+                return TCL_ERROR;
+            }
+            orientation = (option[1] == 'a') ? OCI_FETCH_ABSOLUTE : OCI_FETCH_RELATIVE;
+        }
     }
 
-    ns_status = Ns_OracleExec(dbh, sql);
-    if (ns_status != NS_ROWS) {
-        Ns_OracleFlush(dbh);
-        return 0;
+    object = ora_object_get(interp, objv[2], ORA_OBJECT_CURSOR, "cursor");
+    if (object == NULL) {
+        return TCL_ERROR;
     }
+    cursor = object->data;
+    connection = object->connection;
 
-    return Ns_OracleBindRow(dbh);
+    if (orientation != OCI_FETCH_NEXT && !cursor->scrollable_p) {
+        Tcl_AppendResult(interp, "cursor \"", Tcl_GetString(objv[2]),
+                         "\" is not scrollable", (char*)0L);
+        return TCL_ERROR;
+    }
+
+    rowsObj = Tcl_NewListObj(0, NULL);
+
+    while (count > 0 && !(cursor->end_p && orientation == OCI_FETCH_NEXT)) {
+        int n = (count > CURSOR_FETCH_MAX) ? CURSOR_FETCH_MAX : count;
+
+        if (ora_cursor_fetch(interp, connection, cursor, (ub4)n,
+                             orientation, (sb4)offset) != TCL_OK) {
+            Tcl_DecrRefCount(rowsObj);
+            return TCL_ERROR;
+        }
+        for (; cursor->row < cursor->n_rows; cursor->row++) {
+            rowObj = ora_cursor_row(interp, connection->dbh, cursor->fetchbufs,
+                                    cursor->n_columns, cursor->row);
+            if (rowObj == NULL) {
+                Tcl_DecrRefCount(rowsObj);
+                return TCL_ERROR;
+            }
+            Tcl_ListObjAppendElement(NULL, rowsObj, rowObj);
+        }
+
+        /* the next batch follows the rows just fetched */
+        count -= n;
+        orientation = OCI_FETCH_NEXT;
+        offset = 0;
+    }
+
+    Tcl_SetObjResult(interp, rowsObj);
+    return TCL_OK;
 }
 /*}}}*/
 
-/*{{{ Ns_OracleDML */
-/*----------------------------------------------------------------------
- * Ns_OracleDML --
+/*{{{ OracleRegister
+ *----------------------------------------------------------------------
+ * OracleRegister --
  *
- *      Execute a DML statement.
+ *      Implements [ns_ora register].
  *
- *      Implements [ns_db dml]
+ *      ns_ora register name sql ?-prefetch rows? ?-arraysize rows?
+ *                                ?-timeout ms? ?-warm?
+ *
+ *      Registers the query under name for [ns_ora run], for all interps,
+ *      replacing a query of that name.  The bind variables are parsed
+ *      once here.  -prefetch sets the prefetch rows of the statement,
+ *      -arraysize the rows fetched per round trip by run, -timeout the
+ *      OCI call timeout.  Queries registered with -warm are prepared
+ *      into the statement cache of every session opened afterwards.
+ *
+ * Results:
+ *
+ *      Nothing.
  *
  *----------------------------------------------------------------------
  */
-static int
-Ns_OracleDML (Ns_DbHandle *dbh, char *sql)
+int
+OracleRegister(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHandle *UNUSED(dbh))
 {
-    int ns_status;
+    ora_query_t   *query, *oldQuery = NULL;
+    Tcl_HashEntry *hPtr;
+    int            i, value, isNew, free_p = NS_FALSE;
+    int            prefetch = 0, array_size = CURSOR_FETCH_ROWS, timeout = 0, warm_p = NS_FALSE;
 
-    ns_status = Ns_OracleExec(dbh, sql);
-    if (ns_status != NS_DML) {
-        Ns_OracleFlush(dbh);
-        return NS_ERROR;
+    if (objc < 4) {
+        Tcl_WrongNumArgs(interp, 2, objv,
+                         "name sql ?-prefetch rows? ?-arraysize rows? ?-timeout ms? ?-warm?");
+        return TCL_ERROR;
     }
 
-    return NS_OK;
+    for (i = 4; i < objc; i++) {
+        const char *option = Tcl_GetString(objv[i]);
+
+        if (!strcmp(option, "-warm")) {
+            warm_p = NS_TRUE;
+            continue;
+        }
+        if (strcmp(option, "-prefetch") && strcmp(option, "-arraysize")
+            && strcmp(option, "-timeout")) {
+            Tcl_AppendResult(interp, "bad option \"", option, "\": must be "
+                             "-prefetch, -arraysize, -timeout or -warm", (char*)0L);
+            return TCL_ERROR;
+        }
+        if (i + 1 >= objc) {
+            Tcl_AppendResult(interp, "missing value of ", option, (char*)0L);
+            return TCL_ERROR;
+        }
+        if (Tcl_GetIntFromObj(interp, objv[++i], &value) != TCL_OK) {
+            return TCL_ERROR;
+        }
+        if (value < 0 || (value == 0 && !strcmp(option, "-arraysize"))) {
+            Tcl_AppendResult(interp, "invalid value of ", option, (char*)0L);
+            return TCL_ERROR;
+        }
+        if (!strcmp(option, "-prefetch")) {
+            prefetch = value;
+        } else if (!strcmp(option, "-arraysize")) {
+            array_size = value;
+        } else {
+#ifdef OCI_ATTR_CALL_TIMEOUT
+            timeout = value;
+#else
+            Tcl_AppendResult(interp, "-timeout needs OCI 18c or later", (char*)0L);
+            return TCL_ERROR;
+#endif
+        }
+    }
+
+    query = ns_calloc(1u, sizeof(ora_query_t));
+    query->name = Ns_StrDup(Tcl_GetString(objv[2]));
+    query->sql = Ns_StrDup(Tcl_GetString(objv[3]));
+    query->bind_variables = parse_bind_variables(query->sql);
+    query->n_binds = string_list_len(query->bind_variables);
+    query->prefetch = (ub4)prefetch;
+    query->array_size = (ub4)array_size;
+    query->timeout = (ub4)timeout;
+    query->warm_p = warm_p;
+
+    Ns_MutexLock(&query_registry.lock);
+    query->key = ns_malloc(strlen(query->name) + TCL_INTEGER_SPACE + 2u);
+    sprintf(query->key, "%s#%lu", query->name, ++query_registry.generation);
+    hPtr = Tcl_CreateHashEntry(&query_registry.table, query->name, &isNew);
+    if (!isNew) {
+        /* freed by the last run still using it */
+        oldQuery = Tcl_GetHashValue(hPtr);
+        oldQuery->hPtr = NULL;
+        free_p = (oldQuery->refcount == 0);
+    }
+    query->hPtr = hPtr;
+    Tcl_SetHashValue(hPtr, query);
+    Ns_MutexUnlock(&query_registry.lock);
+
+    if (free_p) {
+        ora_query_free(oldQuery);
+    }
+
+    return TCL_OK;
 }
 /*}}}*/
 
-/*{{{ Ns_OracleExec */
-/*----------------------------------------------------------------------
- * Ns_OracleExec --
+/*{{{ OracleRun
+ *----------------------------------------------------------------------
+ * OracleRun --
  *
- *      Execute a query regardless of type.
+ *      Implements [ns_ora run].
  *
- *      Implements [ns_db exec]
+ *      ns_ora run dbhandle name ?-bind set|dict? ?arg1 .. argN?
+ *
+ *      Executes a query of [ns_ora register] as [ns_ora exec] does.  The
+ *      statement is looked up in the statement cache of the session by
+ *      the key of the query, the SQL is only given to OCI when it is not
+ *      cached yet.
+ *
+ * Results:
+ *
+ *      The rows of a query as returned by [ns_ora rows], the number of
+ *      rows processed by other statements.
  *
  *----------------------------------------------------------------------
  */
-static int
-Ns_OracleExec (Ns_DbHandle *dbh, char *sql)
+int
+OracleRun(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHandle *dbh)
 {
-    oci_status_t oci_status;
-    ora_connection_t *connection;
-    ub4 iters;
-    ub2 type;
-
-    ns_ora_log(lexpos(), "generate simple message");
-    ns_ora_log(lexpos(), "entry (dbh %p, sql %s)", dbh, nilp(sql));
-
-    if (dbh == NULL || sql == NULL) {
-        error(lexpos(), "invalid args.");
-        return NS_ERROR;
+    ora_connection_t *connection = dbh->connection;
+    oci_status_t      oci_status;
+    ora_query_t      *query;
+    OCIStmt          *stmt = NULL;
+    fetch_buffer_t   *binds;
+    ub2               type;
+    int               i, result = TCL_ERROR;
+
+    if (objc < 4 || (objc > 4 && !strcmp(Tcl_GetString(objv[4]), "-bind") && objc < 6)) {
+        Tcl_WrongNumArgs(interp, 2, objv, "dbhandle name ?-bind set|dict? ?arg1 .. argN?");
+        return TCL_ERROR;
     }
 
-    connection = dbh->connection;
-    if (connection == 0) {
-        error(lexpos(), "no connection.");
-        return NS_ERROR;
+    query = ora_query_get(interp, Tcl_GetString(objv[3]));
+    if (query == NULL) {
+        return TCL_ERROR;
     }
 
-    /* nuke any previously executing stmt */
-    Ns_OracleFlush(dbh);
-
-    /* handle_builtins will flush the handles on an ERROR exit */
-
-    switch (handle_builtins(dbh, sql)) {
-    case NS_DML:
-        /* handled */
-        return NS_DML;
-
-    case NS_ERROR:
-        return NS_ERROR;
+    if (!allow_sql_p(dbh, query->sql, NS_TRUE)) {
+        Tcl_AppendResult(interp, "SQL ", query->sql, " has been rejected "
+                         "by the Oracle driver", (char*)0L);
+        ora_query_release(query);
+        return TCL_ERROR;
+    }
 
-    case NS_OK:
-        break;
+    binds = ns_calloc((size_t)query->n_binds + 1u, sizeof(fetch_buffer_t));
 
-    default:
-        error(lexpos(), "internal error");
-        return NS_ERROR;
+    oci_status = OCIStmtPrepare2(connection->svc, &stmt, connection->err,
+                                 (const OraText *)query->sql,
+                                 (ub4)strlen(query->sql),
+                                 (const OraText *)query->key,
+                                 (ub4)strlen(query->key),
+                                 OCI_NTV_SYNTAX, OCI_DEFAULT);
+    if (tcl_error_p(lexpos(), interp, dbh, "OCIStmtPrepare2", query->sql, oci_status)) {
+        stmt = NULL;
+        goto bailout;
     }
 
-    /* allocate a new handle and stuff in connection->stmt */
-    oci_status = OCIHandleAlloc(connection->env,
-                                (oci_handle_t **) & connection->stmt,
-                                OCI_HTYPE_STMT, 0, NULL);
-    if (oci_error_p(lexpos(), dbh, "OCIHandleAlloc", sql, oci_status)) {
-        Ns_OracleFlush(dbh);
-        return NS_ERROR;
+    Ns_MutexLock(&query_registry.lock);
+    type = query->type;
+    Ns_MutexUnlock(&query_registry.lock);
+    if (type == 0) {
+        oci_status = OCIAttrGet(stmt, OCI_HTYPE_STMT,
+                                (oci_attribute_t *) &type, NULL,
+                                OCI_ATTR_STMT_TYPE, connection->err);
+        if (tcl_error_p(lexpos(), interp, dbh, "OCIAttrGet", query->sql, oci_status)) {
+            goto bailout;
+        }
+        Ns_MutexLock(&query_registry.lock);
+        query->type = type;
+        Ns_MutexUnlock(&query_registry.lock);
     }
 
-    /* purely a local call to "prepare statement for execution" */
-    oci_status = OCIStmtPrepare(connection->stmt,
-                                connection->err,
-                                (const OraText *)sql,
-                                (ub4) strlen(sql),
-                                OCI_NTV_SYNTAX, OCI_DEFAULT);
-    if (oci_error_p(lexpos(), dbh, "OCIStmtPrepare", sql, oci_status)) {
-        Ns_OracleFlush(dbh);
-        return NS_ERROR;
+    if (type == OCI_STMT_SELECT && query->prefetch > 0u) {
+        oci_status = OCIAttrSet(stmt, OCI_HTYPE_STMT,
+                                (dvoid *) &query->prefetch, 0,
+                                OCI_ATTR_PREFETCH_ROWS, connection->err);
+        if (tcl_error_p(lexpos(), interp, dbh, "OCIAttrSet", query->sql, oci_status)) {
+            goto bailout;
+        }
     }
 
-    /* check what type of statement it is, this will affect how
-       many times we expect to execute it */
-    oci_status = OCIAttrGet(connection->stmt,
-                            OCI_HTYPE_STMT,
-                            (oci_attribute_t *) & type,
-                            NULL, OCI_ATTR_STMT_TYPE, connection->err);
-    if (oci_error_p(lexpos(), dbh, "OCIAttrGet", sql, oci_status)) {
-        /* got error asking Oracle for the statement type */
-        Ns_OracleFlush(dbh);
-        return NS_ERROR;
+    if (ora_prepared_bind(interp, dbh, stmt, query->sql,
+                          query->bind_variables, binds) != TCL_OK) {
+        goto bailout;
     }
 
-    if (type == OCI_STMT_SELECT) {
-        iters = 0;
-        if (prefetch_rows > 0) {
-            /* Set prefetch rows attr for selects. */
-            oci_status = OCIAttrSet(connection->stmt,
-                                    OCI_HTYPE_STMT,
-                                    (dvoid *) &prefetch_rows,
-                                    0,
-                                    OCI_ATTR_PREFETCH_ROWS,
-                                    connection->err);
-            if (oci_error_p(lexpos(), dbh, "OCIAttrSet", sql, oci_status)) {
-                Ns_OracleFlush(dbh);
-                return NS_ERROR;
-            }
-        }
-        if (prefetch_memory > 0) {
-            /* Set prefetch memory attr for selects. */
-            oci_status = OCIAttrSet(connection->stmt,
-                                    OCI_HTYPE_STMT,
-                                    (dvoid *) &prefetch_memory,
-                                    0,
-                                    OCI_ATTR_PREFETCH_MEMORY,
-                                    connection->err);
-            if (oci_error_p(lexpos(), dbh, "OCIAttrSet", sql, oci_status)) {
-                Ns_OracleFlush(dbh);
-                return NS_ERROR;
-            }
+#ifdef OCI_ATTR_CALL_TIMEOUT
+    if (query->timeout > 0u) {
+        oci_status = OCIAttrSet(connection->svc, OCI_HTYPE_SVCCTX,
+                                (dvoid *) &query->timeout, 0,
+                                OCI_ATTR_CALL_TIMEOUT, connection->err);
+        if (tcl_error_p(lexpos(), interp, dbh, "OCIAttrSet", query->sql, oci_status)) {
+            goto bailout;
         }
-    } else {
-        iters = 1;
     }
+#endif
 
-    /* actually go to server and execute statement */
-    oci_status = OCIStmtExecute(connection->svc,
-                                connection->stmt,
-                                connection->err,
-                                iters,
-                                0, NULL, NULL,
-                                (connection->mode == autocommit
-                                 ? OCI_COMMIT_ON_SUCCESS : OCI_DEFAULT));
-    if (oci_status == OCI_ERROR) {
-        oci_status_t oci_status1;
-        sb4 errorcode;
+    result = ora_prepared_exec(interp, dbh, stmt, type, query->sql,
+                               query->bind_variables, binds,
+                               query->array_size, objc - 4, objv + 4);
 
-        oci_status1 = OCIErrorGet(connection->err,
-                                  1,
-                                  NULL, &errorcode, 0, 0, OCI_HTYPE_ERROR);
+    /* a fatal error of the execute closes the connection */
+    connection = dbh->connection;
 
-        if (oci_error_p(lexpos(), dbh, "OCIErrorGet", sql, oci_status1)) {
-            /* the error getter got an error; let's bail */
-            Ns_OracleFlush(dbh);
-            return NS_ERROR;
-        } else if (oci_error_p(lexpos(), dbh, "OCIStmtExecute", sql, oci_status)) {
-            /* this is where we end up for an ordinary error-producing SQL statement
-               we call oci_error_p() above so that crud ends up in the log */
-            Ns_OracleFlush(dbh);
-            return NS_ERROR;
-        }
-    } else
-        if (oci_error_p(lexpos(), dbh, "OCIStmtExecute", sql, oci_status))
-    {
-        /* we got some weird error that wasn't OCI_ERROR; we hardly ever get here */
-        Ns_OracleFlush(dbh);
-        return NS_ERROR;
+#ifdef OCI_ATTR_CALL_TIMEOUT
+    if (query->timeout > 0u && connection != NULL) {
+        ub4 none = 0u;
+
+        (void) oci_error_p(lexpos(), dbh, "OCIAttrSet", query->sql,
+                           OCIAttrSet(connection->svc, OCI_HTYPE_SVCCTX,
+                                      (dvoid *) &none, 0,
+                                      OCI_ATTR_CALL_TIMEOUT, connection->err));
     }
+#endif
 
-    ns_ora_log(lexpos(), "query type `%d'", type);
+  bailout:
+    connection = dbh->connection;
+    if (stmt != NULL && connection != NULL) {
+        (void) oci_error_p(lexpos(), dbh, "OCIStmtRelease", query->sql,
+                           OCIStmtRelease(stmt, connection->err,
+                                          (const OraText *)query->key,
+                                          (ub4)strlen(query->key),
+                                          OCI_DEFAULT));
+    }
+    for (i = 0; i < query->n_binds; i++) {
+        fetch_buffer_free_buf(&binds[i]);
+    }
+    ns_free(binds);
+    ora_query_release(query);
 
-    if (type == OCI_STMT_SELECT)
-        return NS_ROWS;
-    else
-        return NS_DML;
+    return result;
 }
 /*}}}*/
 
-/*{{{ Ns_OracleBindRow */
-/*----------------------------------------------------------------------
- * Ns_OracleBindRow --
- *
- *      Return a list of column names in an Ns_Set.  This is used
- *      later to fetch rows into.
- *
- *      Implements [ns_db bindrow]
+/*
+ * AOLserver [ns_db] implementation.
  *
- *----------------------------------------------------------------------
  */
-static Ns_Set *
-Ns_OracleBindRow (Ns_DbHandle *dbh)
-{
-    oci_status_t oci_status;
-    ora_connection_t *connection;
-    Ns_Set *row = 0;
-    int i;
 
-    ns_ora_log(lexpos(), "entry (dbh %p)", dbh);
+/*{{{ Ns_DbDriverInit */
+/* Entry point (called by AOLserver when driver loaded)
 
-    if (dbh == NULL) {
-        error(lexpos(), "invalid args.");
-        return 0;
-    }
+   note that this does not leave behind any structures or state outside
+   of reading the configuration parameters, as well as
+   initializing OCI and registering our functions
+*/
+NS_EXPORT Ns_ReturnCode
+Ns_DbDriverInit (const char *hdriver, const char *config_path)
+{
+    Ns_ReturnCode ns_status;
 
-    connection = dbh->connection;
-    if (connection == 0) {
-        error(lexpos(), "no connection.");
-        return 0;
-    }
+    debug_p = Ns_ConfigBool(config_path, "Debug", DEFAULT_DEBUG);
+    convert_encoding_p = Ns_ConfigBool(config_path, "ConvertEncoding", NS_FALSE);
 
-    if (connection->stmt == 0) {
-        error(lexpos(), "no active query statement executing");
-        return 0;
-    }
+    max_string_log_length = Ns_ConfigIntRange(config_path, "MaxStringLogLength", DEFAULT_MAX_STRING_LOG_LENGTH,
+                                              100, INT_MAX);
+    char_expansion = Ns_ConfigIntRange(config_path, "CharExpansion", DEFAULT_CHAR_EXPANSION, 1, 4);
 
-    if (connection->fetch_buffers != 0) {
-        error(lexpos(), "query already bound");
-        Ns_OracleFlush(dbh);
-        return 0;
-    }
+    lob_buffer_size = (unsigned int)Ns_ConfigIntRange(config_path, "LobBufferSize", 16384, 1, 128000);
+    Ns_Log(Notice, "%s driver LobBufferSize = %d", hdriver, lob_buffer_size);
 
-    row = dbh->row;
+    prefetch_rows = Ns_ConfigIntRange(config_path, "PrefetchRows", 0, 0, 1000000);
+    Ns_Log(Notice, "%s driver PrefetchRows = %d", hdriver, prefetch_rows);
 
-    /* get number of columns returned by query; sets connection->n_columns */
-    oci_status = OCIAttrGet(connection->stmt,
-                            OCI_HTYPE_STMT,
-                            (oci_attribute_t *) & connection->n_columns,
-                            NULL, OCI_ATTR_PARAM_COUNT, connection->err);
-    if (oci_error_p(lexpos(), dbh, "OCIAttrGet", 0, oci_status)) {
-        Ns_OracleFlush(dbh);
-        return 0;
+    prefetch_memory = Ns_ConfigIntRange(config_path, "PrefetchMemory", 0, 0, INT_MAX);
+    Ns_Log(Notice, "%s driver PrefetchMemory = %d", hdriver, prefetch_memory);
+
+    lob_cache_dir = Ns_ConfigString(config_path, "LobCacheDir", NULL);
+    if (lob_cache_dir != NULL && *lob_cache_dir != '\0') {
+        Tcl_WideInt lob_cache_size = Ns_ConfigWideIntRange(config_path, "LobCacheSize",
+                                                           100 * 1024 * 1024, 0, LLONG_MAX);
+        lob_cache_init(lob_cache_dir, lob_cache_size);
+        Ns_Log(Notice, "%s driver LobCacheDir = %s, LobCacheSize = %" TCL_LL_MODIFIER "d",
+               hdriver, lob_cache_dir, lob_cache_size);
     }
 
-    ns_ora_log(lexpos(), "n_columns: %d", connection->n_columns);
+    lob_drain_limit = Ns_ConfigIntRange(config_path, "LobDrainLimit", 1048576, 0, INT_MAX);
 
-    /* allocate N fetch buffers, this proc pulls N from connection->n_columns */
-    malloc_fetch_buffers(connection);
+    byte_array_type = Tcl_GetObjType("bytearray");
 
-    for (i = 0; i < connection->n_columns; i++) {
-        fetch_buffer_t *fetchbuf;
-        OCIParam *param;
+    lob_compress_level = Ns_ConfigIntRange(config_path, "LobCompressLevel", 0, 0, 9);
+    Ns_Log(Notice, "%s driver LobCompressLevel = %d", hdriver, lob_compress_level);
 
-        /* 512 is large enough because Oracle sends back table_name.column_name and
-           neither right now can be larger than 30 chars */
-        char name[512];
-        char *name1 = NULL;
-        ub4 name1_size = 0;
-        const char *caseLabel;
+    lazy_lobs_p = Ns_ConfigBool(config_path, "LazyLobs", NS_FALSE);
+    Ns_Log(Notice, "%s driver LazyLobs = %d", hdriver, lazy_lobs_p);
 
-        /* set current fetch buffer */
-        fetchbuf = &connection->fetch_buffers[i];
+    statement_cache_size = Ns_ConfigIntRange(config_path, "StatementCacheSize", 20, 0, 10000);
+    Ns_Log(Notice, "%s driver StatementCacheSize = %d", hdriver, statement_cache_size);
 
-        oci_status = OCIParamGet(connection->stmt,
-                                 OCI_HTYPE_STMT,
-                                 connection->err,
-                                 (oci_param_t *) & param, (ub4)i + 1);
-        if (oci_error_p(lexpos(), dbh, "OCIParamGet", 0, oci_status)) {
-            Ns_OracleFlush(dbh);
-            return 0;
-        }
+    describe_cache_size = Ns_ConfigIntRange(config_path, "DescribeCacheSize", 100, 0, 10000);
+    Ns_Log(Notice, "%s driver DescribeCacheSize = %d", hdriver, describe_cache_size);
 
-        oci_status = OCIAttrGet(param,
-                                OCI_DTYPE_PARAM,
-                                (oci_attribute_t *) & name1,
-                                &name1_size, OCI_ATTR_NAME,
-                                connection->err);
-        if (oci_error_p(lexpos(), dbh, "OCIAttrGet", 0, oci_status)) {
-            Ns_OracleFlush(dbh);
-            return 0;
-        }
+    number_list_type = Ns_ConfigString(config_path, "NumberListType", "SYS.ODCINUMBERLIST");
+    string_list_type = Ns_ConfigString(config_path, "StringListType", "SYS.ODCIVARCHAR2LIST");
+    Ns_Log(Notice, "%s driver NumberListType = %s, StringListType = %s",
+           hdriver, number_list_type, string_list_type);
 
-        /* Oracle gives us back a pointer to a string that is not null-terminated
-           so we copy it into our local var and add a 0 at the end */
-        memcpy(name, name1, name1_size);
-        name[name1_size] = 0;
-        /* we downcase the column name for backward-compatibility with philg's
-           AOLserver Tcl scripts written for the case-sensitive Illustra
-           RDBMS.  philg was lucky in that he always used lowercase.  You might want
-           to change this to leave everything all-uppercase if you're a traditional
-           Oracle shop */
-        downcase(name);
+    desc_catalog_p = Ns_ConfigBool(config_path, "DescCatalog", NS_FALSE);
+    desc_catalog_check = Ns_ConfigIntRange(config_path, "DescCatalogCheck", 60, 0, INT_MAX);
+    desc_catalog_file = Ns_ConfigString(config_path, "DescCatalogFile", NULL);
+    if (desc_catalog_file != NULL && *desc_catalog_file == '\0') {
+        desc_catalog_file = NULL;
+    }
+    Ns_Log(Notice, "%s driver DescCatalog = %d, DescCatalogCheck = %d, DescCatalogFile = %s",
+           hdriver, desc_catalog_p, desc_catalog_check, nilp(desc_catalog_file));
+    desc_catalog_init(desc_catalog_p ? desc_catalog_file : NULL);
 
-        ns_ora_log(lexpos(), "name %d `%s'", name1_size, name);
-        Ns_SetPut(row, name, 0);
+    Ns_MutexInit(&call_cache.lock);
+    Ns_MutexSetName(&call_cache.lock, "nsoracle:callcache");
+    Tcl_InitHashTable(&call_cache.table, TCL_STRING_KEYS);
 
-        /* get the column type */
-        oci_status = OCIAttrGet(param,
-                                OCI_DTYPE_PARAM,
-                                (oci_attribute_t *) & fetchbuf->type,
-                                NULL, OCI_ATTR_DATA_TYPE, connection->err);
-        if (oci_error_p(lexpos(), dbh, "OCIAttrGet", 0, oci_status)) {
-            Ns_OracleFlush(dbh);
-            return 0;
-        }
+    Ns_MutexInit(&query_registry.lock);
+    Ns_MutexSetName(&query_registry.lock, "nsoracle:queries");
+    Tcl_InitHashTable(&query_registry.table, TCL_STRING_KEYS);
 
-        /* ns_ora_log(lexpos(), "%d: column `%s' type `%d'", i. name, fetchbuf->type);*/
+    lob_spool_p = Ns_ConfigBool(config_path, "LobSpool", NS_FALSE);
+    lob_spool_memory = Ns_ConfigIntRange(config_path, "LobSpoolMemory", 65536, 0, INT_MAX);
+    lob_spool_dir = Ns_ConfigString(config_path, "LobSpoolDir", P_tmpdir);
+    if (lob_spool_p) {
+        Ns_Log(Notice, "%s driver LobSpool enabled, LobSpoolMemory = %d, LobSpoolDir = %s",
+               hdriver, lob_spool_memory, lob_spool_dir);
+    }
 
-        switch (fetchbuf->type) {
-            /* we handle LOBs in the loop below */
-        case OCI_TYPECODE_CLOB:
-        case OCI_TYPECODE_BLOB:
-            caseLabel = "lob";
-            break;
+    ns_ora_log(lexpos(), "entry (hdriver %p, config_path %s)", hdriver, nilp(config_path));
 
-            /* RDD is Oracle's happy fun name for ROWID (18 chars long
-               but if you ask Oracle the usual way, it will give you a
-               number that is too small) */
-        case SQLT_RDD:
-            caseLabel = "rdd";
-            fetchbuf->size = 18;
-            fetchbuf->buf_size = fetchbuf->size + 8;
-            fetchbuf->buf = Ns_Malloc(fetchbuf->buf_size);
-            break;
+    ns_status = Ns_DbRegisterDriver(hdriver, ora_procs);
+    if (ns_status != NS_OK) {
+        error(lexpos(), "Could not register driver `%s'.",
+              nilp(ora_driver_name));
+        return NS_ERROR;
+    }
 
-        case SQLT_NUM:
-            /* OCI reports that all NUMBER values has a size of 22, the size
-               of its internal storage format for numbers. We are fetching
-               all values out as strings, so we need more space. Empirically,
-               it seems to return 41 characters when it does the NUMBER to STRING
-               conversion. */
-            caseLabel = "num";
-            fetchbuf->size = 81;
-            fetchbuf->buf_size = fetchbuf->size + 8;
-            fetchbuf->buf = Ns_Malloc(fetchbuf->buf_size);
-            break;
+    Ns_Log(Notice, "Loaded %s, built on %s/%s",
+           ora_driver_version, __TIME__, __DATE__);
 
-            /* this might work if the rest of our LONG stuff worked */
-        case SQLT_LNG:
-            caseLabel = "long";
-            fetchbuf->buf_size = lob_buffer_size;
-            fetchbuf->buf = Ns_Malloc(fetchbuf->buf_size);
-            break;
+#if defined(FOR_CASSANDRACLE)
+    Ns_Log(Notice,
+           "    This Oracle Driver is a reduced-functionality Cassandracle driver");
+#endif
 
-        case SQLT_DAT:
-        case SQLT_TIMESTAMP:
-        case SQLT_TIMESTAMP_TZ:
-            if (fetchbuf->type == SQLT_DAT) {
-                /*
-                 * date with format "YYYY-MM-DD HH24:MI:SS",
-                 * 20 bytes
-                 */
-                caseLabel = "date";
-                fetchbuf->size = 20;
-            } else if (fetchbuf->type == SQLT_TIMESTAMP) {
-                /*
-                 * timestamp with format "YYYY-MM-DD HH24:MI:SS.FF6",
-                 * 26 bytes
-                 */
-                caseLabel = "timestamp";
-                fetchbuf->size = 26;
-            } else {
-                /*
-                 * timestamp tz with format "YYYY-MM-DD HH24:MI:SS.FF6 TZH:TZM",
-                 * 33 bytes
-                 */
-               caseLabel = "timestamp tz";
-               fetchbuf->size = 33;
-            }
-            fetchbuf->buf_size = fetchbuf->size + 8;
-            fetchbuf->buf = Ns_Malloc(fetchbuf->buf_size);
-            break;
+    ns_ora_log(lexpos(), "driver `%s' loaded.", nilp(ora_driver_name));
 
-        default:
-            caseLabel = "default";
-            /* get the size */
-            oci_status = OCIAttrGet(param,
-                                    OCI_DTYPE_PARAM,
-                                    (oci_attribute_t *) & fetchbuf->size,
-                                    NULL,
-                                    OCI_ATTR_DATA_SIZE, connection->err);
-            if (oci_error_p(lexpos(), dbh, "OCIAttrGet", 0, oci_status)) {
-                Ns_OracleFlush(dbh);
-                return 0;
-            }
+    return NS_OK;
+}
+/*}}}*/
 
-            /*ns_ora_log(lexpos(), "column `%s' size `%d'", name, fetchbuf->size);*/
+/*{{{ Ns_OracleInterpInit */
+static int
+Ns_OracleInterpInit(Tcl_Interp *interp, const void *UNUSED(dummy))
+{
+    Tcl_CreateObjCommand (interp, "ns_ora", OracleObjCmd,
+            (ClientData) NULL, (Tcl_CmdDeleteProc *) NULL);
 
-            /* this is the important part, we allocate buf to be 8 bytes
-               more than Oracle says are necessary (for null
-               termination) */
-            fetchbuf->buf_size = fetchbuf->size + 8;
+    Tcl_CreateObjCommand (interp, "ns_oracle", OracleObjCmd,
+            (ClientData) NULL, (Tcl_CmdDeleteProc *) NULL);
 
-            if (fetchbuf->type == SQLT_BIN) {
-                fetchbuf->buf_size = fetchbuf->size * 2 + 8;
-            } else {
-                fetchbuf->buf_size = fetchbuf->size + 8;
-            }
+#if defined(NS_AOLSERVER_3_PLUS)
+    Tcl_CreateCommand(interp, "ns_column", ora_column_command, NULL, NULL);
+    Tcl_CreateCommand(interp, "ns_table", ora_table_command, NULL, NULL);
+#endif
 
-            fetchbuf->buf_size *= (unsigned int)char_expansion;
-            fetchbuf->buf = Ns_Malloc (fetchbuf->buf_size);
+    return NS_OK;
+}
+/*}}}*/
 
-            break;
-        }
+/*{{{ Ns_OracleServerInit */
+static Ns_ReturnCode
+Ns_OracleServerInit(char *hserver, char *hmodule, char *hdriver)
+{
+    ns_ora_log(lexpos(), "entry (%s, %s, %s)", nilp(hserver), nilp(hmodule),
+        nilp(hdriver));
 
-        ns_ora_log(lexpos(), "%d: column `%s' type %d size %d (%s)",
-                   i, name, fetchbuf->type, fetchbuf->size, caseLabel);
+    return Ns_TclRegisterTrace(hserver, Ns_OracleInterpInit, NULL, NS_TCL_TRACE_CREATE);
+}
+/*}}}*/
 
-    }
+/*{{{ Ns_OracleName */
+/*----------------------------------------------------------------------
+ * Ns_OracleName --
+ *
+ *      Return name of database driver.
+ *
+ *----------------------------------------------------------------------
+ */
+static const char *
+Ns_OracleName (Ns_DbHandle *dummy)
+{
+    ns_ora_log(lexpos(), "entry (dummy %p)", dummy);
 
-    /* loop over the columns again; this could now be in the loop above
-       but we originally did things this way to permit resizing of
-       buffers
+    return ora_driver_name;
+}
+/*}}}*/
 
-       Now we're telling Oracle to associate the buffers we just
-       allocated with their respective columns */
-    for (i = 0; i < connection->n_columns; i++) {
-        fetch_buffer_t *fetchbuf;
+/*{{{ Ns_OracleDbType */
+/*----------------------------------------------------------------------
+ * Ns_OracleDbType --
+ *
+ *      This function returns the string which identifies the database
+ *      type.
+ *
+ *      Implements [ns_db dbtype]
+ *
+ *----------------------------------------------------------------------
+ */
+static const char *
+Ns_OracleDbType (Ns_DbHandle *dummy)
+{
+    ns_ora_log(lexpos(), "entry (dummy %p)", dummy);
 
-        fetchbuf = &connection->fetch_buffers[i];
+    return ora_driver_name;
+}
+/*}}}*/
 
-        switch (fetchbuf->type) {
-        case OCI_TYPECODE_CLOB:
-        case OCI_TYPECODE_BLOB:
-            /* we allocate descriptors for CLOBs; these are essentially
-               pointers.  We will not allocate any buffers for them
-               until we're actually fetching data from individual
-               rows. */
-            oci_status = OCIDescriptorAlloc(connection->env,
-                                            (oci_descriptor_t *) &
-                                            fetchbuf->lob, OCI_DTYPE_LOB,
-                                            0, 0);
-            if (oci_error_p(lexpos(), dbh, "OCIDescriptorAlloc", 0, oci_status)) {
-                Ns_OracleFlush(dbh);
-                return 0;
-            }
+/*{{{ Ns_OracleOpenDb */
+/*----------------------------------------------------------------------
+ * Ns_OracleOpenDb --
+ *
+ *      Opens a database connection.
+ *
+ *      Implements [ns_db open]
+ *
+ *----------------------------------------------------------------------
+ */
+static Ns_ReturnCode
+Ns_OracleOpenDb (Ns_DbHandle *dbh)
+{
+    oci_status_t oci_status;
+    ora_connection_t *connection;
 
-            oci_status = OCIDefineByPos(connection->stmt,
-                                        &fetchbuf->def,
-                                        connection->err,
-                                        (ub4)i + 1,
-                                        &fetchbuf->lob,
-                                        -1,
-                                        fetchbuf->type,
-                                        &fetchbuf->is_null,
-                                        0, 0, OCI_DEFAULT);
-            if (oci_error_p(lexpos(), dbh, "OCIDefineByPos", 0, oci_status)) {
-                Ns_OracleFlush(dbh);
-                return 0;
-            }
-            break;
+    ns_ora_log(lexpos(), "entry (dbh %p)", dbh);
 
-        case SQLT_LNG:
-            oci_status = OCIDefineByPos(connection->stmt,
-                                        &fetchbuf->def,
-                                        connection->err,
-                                        (ub4)i + 1,
-                                        0,
-                                        (sb4)SB4MAXVAL,
-                                        fetchbuf->type,
-                                        &fetchbuf->is_null,
-                                        &fetchbuf->fetch_length,
-                                        0, OCI_DYNAMIC_FETCH);
+    if (dbh == NULL) {
+        error(lexpos(), "invalid args.");
+        return NS_ERROR;
+    }
 
-            if (oci_error_p(lexpos(), dbh, "OCIDefineByPos", 0, oci_status)) {
-                Ns_OracleFlush(dbh);
-                return 0;
-            }
+    if (! dbh->password) {
+        error(lexpos(),
+              "Missing Password parameter in configuration file for pool %s.",
+              dbh->poolname );
+        return NS_ERROR;
+    }
 
-            ns_ora_log(lexpos(), "`OCIDefineDynamic ()' success");
-            break;
+    if (! dbh->user) {
+        error(lexpos(),
+              "Missing User parameter in configuration file for pool %s.",
+              dbh->poolname);
+        return NS_ERROR;
+    }
 
-        default:
-            oci_status = OCIDefineByPos(connection->stmt,
-                                        &fetchbuf->def,
-                                        connection->err,
-                                        (ub4)i + 1,
-                                        fetchbuf->buf,
-                                        (sb4)fetchbuf->buf_size,
-                                        SQLT_STR,
-                                        &fetchbuf->is_null,
-                                        &fetchbuf->fetch_length,
-                                        NULL, OCI_DEFAULT);
+    connection = Ns_Malloc(sizeof *connection);
 
-            if (oci_error_p(lexpos(), dbh, "OCIDefineByPos", 0, oci_status)) {
-                Ns_OracleFlush(dbh);
-                return 0;
-            }
-            break;
+    connection->dbh = dbh;
+    connection->env = NULL;
+    connection->err = NULL;
+    connection->srv = NULL;
+    connection->svc = NULL;
+    connection->auth = NULL;
+    connection->stmt = NULL;
+    connection->mode = autocommit;
+    connection->n_columns = 0;
+    connection->fetch_buffers = NULL;
+    connection->lob_read_pending = NS_FALSE;
+    connection->object_serial = 0u;
+    Tcl_InitHashTable(&connection->objects, TCL_STRING_KEYS);
+    connection->lazy_lobs = lazy_lobs_p;
+    connection->fetch_objs = NS_FALSE;
+    connection->stmt_cached = NS_FALSE;
+    connection->number_list_tdo = NULL;
+    connection->string_list_tdo = NULL;
+    connection->dbms_output_p = NS_FALSE;
+    connection->dbms_output_log = -1;
+    Tcl_InitHashTable(&connection->describes, TCL_STRING_KEYS);
+    connection->describe_first = NULL;
+    connection->describe_last = NULL;
+    connection->describe = NULL;
+    memset(connection->buffer_pool, 0, sizeof(connection->buffer_pool));
+
+    /*  AOLserver, in their database handle structure, gives us one field
+     *  to store our connection structure.
+     */
+    dbh->connection = connection;
+
+    if (convert_encoding_p) {
+        /*
+         * Value for the character set IDs. Since the client side (Tcl) is
+         * always converting from and to UTF-8, we tell Oracle that the client
+         * is UTF-8 and not necessarily the same as the database
+         * encoding. Since the interface requires the ID to be set when
+         * establishing the connection, we provide here the value hard-coded
+         * (which seems common practice).
+         *
+         * The ID can be obtained from Oracle via the following SQL statement.
+         *
+         *    col nls_charset_id for 9999
+         *    col value for a20
+         *    select nls_charset_id(value) nls_charset_id, value from v$nls_valid_values
+         *           where parameter = 'CHARACTERSET' and value like '%UTF%';
+         */
+        const ub2 AL32UTF8 = 873;
+
+        oci_status = OCIEnvNlsCreate(&connection->env,
+                                     OCI_THREADED|OCI_ENV_NO_MUTEX|OCI_OBJECT,
+                                     NULL,
+                                     Ns_OracleMalloc,
+                                     Ns_OracleRealloc,
+                                     Ns_OracleFree,
+                                     0, NULL,
+                                     AL32UTF8, AL32UTF8
+                                     );
+        if (oci_error_p(lexpos(), NULL, "OCIEnvNlsCreate", 0, oci_status)) {
+            return NS_ERROR;
+        }
+    } else {
+        oci_status = OCIEnvCreate(&connection->env,
+                                  OCI_THREADED|OCI_ENV_NO_MUTEX|OCI_OBJECT,
+                                  NULL,
+                                  Ns_OracleMalloc,
+                                  Ns_OracleRealloc,
+                                  Ns_OracleFree,
+                                  0, NULL);
+        if (oci_error_p(lexpos(), NULL, "OCIEnvCreate", 0, oci_status)) {
+            return NS_ERROR;
         }
     }
 
-    return row;
+    /* sets connection->err */
+    oci_status = OCIHandleAlloc(connection->env,
+                                (oci_handle_t **) & connection->err,
+                                OCI_HTYPE_ERROR, 0, NULL);
+    if (oci_error_p(lexpos(), dbh, "OCIHandleAlloc", 0, oci_status))
+        return NS_ERROR;
+
+    /* sets connection->srv */
+    oci_status = OCIHandleAlloc(connection->env,
+                                (oci_handle_t **) & connection->srv,
+                                OCI_HTYPE_SERVER, 0, NULL);
+    if (oci_error_p(lexpos(), dbh, "OCIHandleAlloc", 0, oci_status))
+        return NS_ERROR;
+
+    /* sets connection->svc */
+    oci_status = OCIHandleAlloc(connection->env,
+                                (oci_handle_t **) & connection->svc,
+                                OCI_HTYPE_SVCCTX, 0, NULL);
+    if (oci_error_p(lexpos(), dbh, "OCIHandleAlloc", 0, oci_status))
+        return NS_ERROR;
+
+    /*
+     * Create association between server handle and access path (datasource;
+     * a string from the configuration file).
+     */
+    oci_status = OCIServerAttach(connection->srv, connection->err,
+                                 (const OraText *)dbh->datasource,
+                                 (sb4) strlen(dbh->datasource), OCI_DEFAULT);
+    if (oci_error_p(lexpos(), dbh, "OCIServerAttach", 0, oci_status))
+        return NS_ERROR;
+
+    /* tell OCI to associate the server handle with the context handle */
+    oci_status = OCIAttrSet(connection->svc,
+                            OCI_HTYPE_SVCCTX,
+                            (void *)connection->srv,
+                            0, OCI_ATTR_SERVER, connection->err);
+    if (oci_error_p(lexpos(), dbh, "OCIAttrSet", 0, oci_status))
+        return NS_ERROR;
+
+    /* allocate connection->auth */
+    oci_status = OCIHandleAlloc(connection->env,
+                                (oci_handle_t **) & connection->auth,
+                                OCI_HTYPE_SESSION, 0, NULL);
+    if (oci_error_p(lexpos(), dbh, "OCIHandleAlloc", 0, oci_status))
+        return NS_ERROR;
+
+    /* give OCI the username from the nsd.ini file */
+    oci_status = OCIAttrSet(connection->auth,
+                            OCI_HTYPE_SESSION,
+                            (void *)dbh->user,
+                            (ub4) strlen(dbh->user),
+                            OCI_ATTR_USERNAME, connection->err);
+    if (oci_error_p(lexpos(), dbh, "OCIAttrSet", 0, oci_status))
+        return NS_ERROR;
+
+    /* give OCI the password from the nsd.ini file */
+    oci_status = OCIAttrSet(connection->auth,
+                            OCI_HTYPE_SESSION,
+                            (void *)dbh->password,
+                            (ub4) strlen(dbh->password),
+                            OCI_ATTR_PASSWORD, connection->err);
+    if (oci_error_p(lexpos(), dbh, "OCIAttrSet", 0, oci_status))
+        return NS_ERROR;
+
+    /* the OCI docs say this "creates a user session and begins a
+       user session for a given server */
+    oci_status = OCISessionBegin(connection->svc,
+                                 connection->err,
+                                 connection->auth,
+                                 OCI_CRED_RDBMS,
+                                 statement_cache_size > 0
+                                 ? OCI_STMT_CACHE : OCI_DEFAULT);
+    if (oci_error_p(lexpos(), dbh, "OCISessionBegin", 0, oci_status))
+        return NS_ERROR;
+
+    /* associate the particular authentications with a particular context */
+    oci_status = OCIAttrSet(connection->svc,
+                            OCI_HTYPE_SVCCTX,
+                            connection->auth,
+                            0, OCI_ATTR_SESSION, connection->err);
+    if (oci_error_p(lexpos(), dbh, "OCIAttrSet", 0, oci_status))
+        return NS_ERROR;
+
+    if (statement_cache_size > 0) {
+        ub4 cache_size = (ub4) statement_cache_size;
+
+        oci_status = OCIAttrSet(connection->svc,
+                                OCI_HTYPE_SVCCTX,
+                                &cache_size,
+                                0, OCI_ATTR_STMTCACHESIZE, connection->err);
+        if (oci_error_p(lexpos(), dbh, "OCIAttrSet", 0, oci_status))
+            return NS_ERROR;
+    }
+
+    if (ora_queries_warm(dbh) != NS_OK)
+        return NS_ERROR;
+
+    ns_ora_log(lexpos(), "(dbh %p); return NS_OK;", dbh);
+
+    dbh->connected = NS_TRUE;
+
+    return NS_OK;
 }
 /*}}}*/
 
-/*{{{ Ns_OracleGetRow */
+/*{{{ Ns_OracleCloseDb */
 /*----------------------------------------------------------------------
- * Ns_OracleGetRow --
+ * Ns_OracleCloseDb --
  *
- *      Fetch the next row of the result set into the row Ns_Set.
+ *      Closes a database connection and clean up handle.
  *
- *      Implements [ns_db getrow]
+ *      Implements [ns_db close]
  *
  *----------------------------------------------------------------------
  */
-static int
-Ns_OracleGetRow (Ns_DbHandle *dbh, Ns_Set *row)
+static Ns_ReturnCode
+Ns_OracleCloseDb (Ns_DbHandle *dbh)
 {
     oci_status_t oci_status;
     ora_connection_t *connection;
-    int i;
-    ub4 ret_len = 0;
 
-    ns_ora_log(lexpos(), "entry (dbh %p, row %p)", dbh, row);
+    ns_ora_log(lexpos(), "entry (dbh %p)", dbh);
 
-    if (dbh == NULL || row == NULL) {
+    if (dbh == NULL) {
         error(lexpos(), "invalid args.");
         return NS_ERROR;
     }
 
     connection = dbh->connection;
-    if (connection == 0) {
+    if (!connection) {
         error(lexpos(), "no connection.");
         return NS_ERROR;
     }
 
-    if (row == 0) {
-        error(lexpos(), "invalid argument, `NULL' row");
-        Ns_OracleFlush(dbh);
-        return NS_ERROR;
-    }
+    ora_objects_free_all(connection);
+    Tcl_DeleteHashTable(&connection->objects);
+    ora_buffers_free(connection);
+    ora_describes_free(connection);
 
-    if (connection->stmt == 0) {
-        error(lexpos(), "no active select");
-        Ns_OracleFlush(dbh);
-        return NS_ERROR;
-    }
+    /* don't return on error; just clean up the best we can */
+    oci_status = OCIServerDetach(connection->srv,
+                                 connection->err, OCI_DEFAULT);
+    oci_error_p(lexpos(), dbh, "OCIServerDetach", 0, oci_status);
 
-    /* fetch */
-    oci_status = OCIStmtFetch(connection->stmt,
-                              connection->err,
-                              1, OCI_FETCH_NEXT, OCI_DEFAULT);
+    oci_status = OCIHandleFree(connection->svc, OCI_HTYPE_SVCCTX);
+    oci_error_p(lexpos(), dbh, "OCIHandleFree", 0, oci_status);
+    connection->svc = 0;
 
-    if (oci_status == OCI_NEED_DATA) {
-        ;
-    } else if (oci_status == OCI_NO_DATA) {
-        /*  We've reached beyond the last row of the select, so flush the
-         *  statement and tell AOLserver that it isn't going to get
-         *  anything more out of us.
-         */
-        ns_ora_log(lexpos(), "return NS_END_DATA;");
-
-        if (Ns_OracleFlush(dbh) != NS_OK)
-            return NS_ERROR;
-        else
-            return NS_END_DATA;
-    } else if (oci_error_p(lexpos(), dbh, "OCIStmtFetch", 0, oci_status)) {
-        /* We got some other kind of error */
-        Ns_OracleFlush(dbh);
-        return NS_ERROR;
-    }
-
-    /* Fetched succeeded; copy fetch buffers (one/column) into the ns_set */
-    for (i = 0; i < connection->n_columns; i++) {
-        fetch_buffer_t *fetchbuf = &connection->fetch_buffers[i];
-
-        switch (fetchbuf->type) {
-        case OCI_TYPECODE_CLOB:
-        case OCI_TYPECODE_BLOB:
-
-            if (fetchbuf->is_null == -1) {
-                Ns_SetPutValue(row, (size_t)i, "");
-            } else if (fetchbuf->is_null != 0) {
-                error(lexpos(), "invalid fetch buffer is_null");
-                Ns_OracleFlush(dbh);
-                return NS_ERROR;
-            } else {
-                /* CLOB is not null, let's grab it. We use an Ns_DString
-                   to do this, because when dealing with variable width
-                   character sets, a single character can be many bytes long
-                   (in UTF8, up to six). */
-                ub4 lob_length = 0;
-                Tcl_DString retval;
-                ub1 *bufp;
-
-                /* Get length of LOB, in characters for CLOBs and bytes
-                   for BLOBs. */
-                oci_status = OCILobGetLength(connection->svc,
-                                             connection->err,
-                                             fetchbuf->lob, &lob_length);
-                if (oci_error_p(lexpos(), dbh, "OCILobGetLength",
-                                0, oci_status)) {
-                    Ns_OracleFlush(dbh);
-                    return NS_ERROR;
-                }
-
-                /* Initialize the buffer we're going to use for the value. */
-                bufp = (ub1 *) Ns_Malloc(lob_buffer_size);
-                Tcl_DStringInit(&retval);
-
-                /* Do the read. */
-                oci_status = OCILobRead(connection->svc,
-                                        connection->err,
-                                        fetchbuf->lob,
-                                        &lob_length,
-                                        (ub4) 1,
-                                        bufp,
-                                        lob_buffer_size,
-                                        &retval, (OCICallbackLobRead)
-                                        ora_append_buf_to_dstring, (ub2) 0,
-                                        (ub1) SQLCS_IMPLICIT);
-
-                if (oci_error_p(lexpos(), dbh, "OCILobRead", 0, oci_status)) {
-                    Ns_OracleFlush(dbh);
-                    Tcl_DStringFree(&retval);
-                    Ns_Free(bufp);
-                    return NS_ERROR;
-                }
-
-                Ns_SetPutValue(row, (size_t)i, Ns_DStringValue(&retval));
-                Tcl_DStringFree(&retval);
-                Ns_Free(bufp);
-            }
-            break;
-
-        case SQLT_LNG:
-            /* this is broken for multi-part LONGs.  LONGs are being deprecated
-             * by Oracle anyway, so no big loss
-             *
-             * Maybe fixed by davis@arsdigita.com
-             */
-            if (fetchbuf->is_null == -1)
-                fetchbuf->buf[0] = 0;
-            else if (fetchbuf->is_null != 0) {
-                error(lexpos(), "invalid fetch buffer is_null");
-                Ns_OracleFlush(dbh);
-                return NS_ERROR;
-            } else {
-                fetchbuf->buf[0] = 0;
-                fetchbuf->fetch_length = 0;
-                ret_len = 0;
-
-                ns_ora_log(lexpos(), "LONG start: buf_size=%d fetched=%d\n",
-                    fetchbuf->buf_size, fetchbuf->fetch_length);
-
-                do {
-                    //dvoid *def;
-                    ub1 inoutp;
-                    ub1 piece;
-                    ub4 type;
-                    ub4 iterp;
-                    ub4 idxp;
-
-                    fetchbuf->fetch_length += ret_len;
-                    if (fetchbuf->fetch_length > fetchbuf->buf_size / 2) {
-                        fetchbuf->buf_size *= 2;
-                        fetchbuf->buf =
-                            ns_realloc(fetchbuf->buf, fetchbuf->buf_size);
-                    }
-                    ret_len = fetchbuf->buf_size - fetchbuf->fetch_length;
-
-                    oci_status = OCIStmtGetPieceInfo(connection->stmt,
-                                                     connection->err,
-                                                     (dvoid **) &
-                                                     fetchbuf->def, &type,
-                                                     &inoutp, &iterp,
-                                                     &idxp, &piece);
-
-                    if (oci_error_p(lexpos(), dbh, "OCIStmtGetPieceInfo", 0,
-                         oci_status)) {
-                        Ns_OracleFlush(dbh);
-                        return NS_ERROR;
-                    }
-
-                    oci_status = OCIStmtSetPieceInfo(fetchbuf->def,
-                                                     OCI_HTYPE_DEFINE,
-                                                     connection->err,
-                                                     (void *) (fetchbuf->
-                                                               buf +
-                                                               fetchbuf->
-                                                               fetch_length),
-                                                     &ret_len, piece,
-                                                     &fetchbuf->is_null,
-                                                     NULL);
-
-                    if (oci_error_p(lexpos(), dbh, "OCIStmtGetPieceInfo", 0,
-                         oci_status)) {
-                        Ns_OracleFlush(dbh);
-                        return NS_ERROR;
-                    }
+    oci_status = OCIHandleFree(connection->srv, OCI_HTYPE_SERVER);
+    oci_error_p(lexpos(), dbh, "OCIHandleFree", 0, oci_status);
+    connection->srv = 0;
 
-                    oci_status = OCIStmtFetch(connection->stmt,
-                                              connection->err,
-                                              1,
-                                              OCI_FETCH_NEXT, OCI_DEFAULT);
+    oci_status = OCIHandleFree(connection->err, OCI_HTYPE_ERROR);
+    oci_error_p(lexpos(), dbh, "OCIHandleFree", 0, oci_status);
+    connection->err = 0;
 
-                    ns_ora_log(lexpos(),
-                        "LONG: status=%d ret_len=%d buf_size=%d fetched=%d\n",
-                        oci_status, ret_len, fetchbuf->buf_size,
-                        fetchbuf->fetch_length);
+    oci_status = OCIHandleFree(connection->auth, OCI_HTYPE_SESSION);
+    oci_error_p(lexpos(), dbh, "OCIHandleFree", 0, oci_status);
+    connection->auth = 0;
 
-                    if (oci_status != OCI_NEED_DATA
-                        && oci_error_p(lexpos(), dbh, "OCIStmtFetch", 0,
-                                       oci_status)) {
-                        Ns_OracleFlush(dbh);
-                        return NS_ERROR;
-                    }
+    oci_status = OCIHandleFree(connection->env, OCI_HTYPE_ENV);
+    oci_error_p(lexpos(), dbh, "OCIHandleFree", 0, oci_status);
+    connection->env = 0;
 
-                    if (oci_status == OCI_NO_DATA)
-                        break;
+    Ns_Free(connection);
+    dbh->connection = NULL;
+    dbh->connected = NS_FALSE;
 
-                } while (oci_status == OCI_SUCCESS_WITH_INFO ||
-                         oci_status == OCI_NEED_DATA);
+    return NS_OK;
+}
+/*}}}*/
 
-            }
+/*{{{ Ns_OracleSelect */
+/*----------------------------------------------------------------------
+ * Ns_OracleSelect --
+ *
+ *      Execute a select statement and bindrow it.
+ *
+ *      Implements [ns_db select]
+ *
+ *----------------------------------------------------------------------
+ */
+static Ns_Set *
+Ns_OracleSelect (Ns_DbHandle *dbh, char *sql)
+{
+    int ns_status;
 
-            fetchbuf->buf[fetchbuf->fetch_length] = 0;
-            ns_ora_log(lexpos(), "LONG done: status=%d buf_size=%d fetched=%d\n",
-                oci_status, fetchbuf->buf_size, fetchbuf->fetch_length);
+    ns_ora_log(lexpos(), "entry (dbh %p, sql %s)", dbh, nilp(sql));
 
-            Ns_SetPutValue(row, (size_t)i, fetchbuf->buf);
+    if (dbh  == NULL || sql == NULL) {
+        error(lexpos(), "invalid args.");
+        return 0;
+    }
 
-            break;
+    ns_status = Ns_OracleExec(dbh, sql);
+    if (ns_status != NS_ROWS) {
+        Ns_OracleFlush(dbh);
+        return 0;
+    }
 
-        default:
-            /* add null termination and then do an ns_set put */
-            if (fetchbuf->is_null == -1)
-                fetchbuf->buf[0] = 0;
-            else if (fetchbuf->is_null != 0) {
-                error(lexpos(), "invalid fetch buffer is_null");
-                Ns_OracleFlush(dbh);
-                return NS_ERROR;
-            } else
-                fetchbuf->buf[fetchbuf->fetch_length] = 0;
+    return Ns_OracleBindRow(dbh);
+}
+/*}}}*/
 
-            Ns_SetPutValue(row, (size_t)i, fetchbuf->buf);
+/*{{{ Ns_OracleDML */
+/*----------------------------------------------------------------------
+ * Ns_OracleDML --
+ *
+ *      Execute a DML statement.
+ *
+ *      Implements [ns_db dml]
+ *
+ *----------------------------------------------------------------------
+ */
+static int
+Ns_OracleDML (Ns_DbHandle *dbh, char *sql)
+{
+    int ns_status;
 
-            break;
-        }
+    ns_status = Ns_OracleExec(dbh, sql);
+    if (ns_status != NS_DML) {
+        Ns_OracleFlush(dbh);
+        return NS_ERROR;
     }
 
     return NS_OK;
 }
 /*}}}*/
 
-/*{{{ Ns_OracleFlush */
+/*{{{ Ns_OracleExec */
 /*----------------------------------------------------------------------
- * Ns_OracleFlush --
+ * Ns_OracleExec --
  *
- *      Used to clean up after an error or after we've reached the
- *      end of a result set.  Frees fetch buffers.
+ *      Execute a query regardless of type.
  *
- *      Implements [ns_db flush]
+ *      Implements [ns_db exec]
  *
  *----------------------------------------------------------------------
  */
-static Ns_ReturnCode
-Ns_OracleFlush (Ns_DbHandle *dbh)
+static int
+Ns_OracleExec (Ns_DbHandle *dbh, char *sql)
 {
+    oci_status_t oci_status;
     ora_connection_t *connection;
-    oci_status_t      oci_status;
+    ub4 iters;
+    ub2 type;
 
-    ns_ora_log(lexpos(), "entry (dbh %p, row %p)", dbh, 0);
+    ns_ora_log(lexpos(), "generate simple message");
+    ns_ora_log(lexpos(), "entry (dbh %p, sql %s)", dbh, nilp(sql));
 
-    if (dbh == NULL) {
-        error(lexpos(), "invalid args, `NULL' database handle");
+    if (dbh == NULL || sql == NULL) {
+        error(lexpos(), "invalid args.");
         return NS_ERROR;
     }
 
     connection = dbh->connection;
-
-    if (connection == NULL) {
-        /* Connection is closed.  That's as good as flushed to me */
-        return NS_OK;
+    if (connection == 0) {
+        error(lexpos(), "no connection.");
+        return NS_ERROR;
     }
 
-    if (connection->stmt != 0) {
-        oci_status = OCIHandleFree(connection->stmt, OCI_HTYPE_STMT);
-        if (oci_error_p(lexpos(), dbh, "OCIHandleFree", 0, oci_status))
-            return NS_ERROR;
-        connection->stmt = 0;
-    }
+    /* nuke any previously executing stmt */
+    Ns_OracleFlush(dbh);
 
-    connection->interp = NULL;
+    /* handle_builtins will flush the handles on an ERROR exit */
 
-    if (connection->fetch_buffers != 0) {
-        int i;
+    switch (handle_builtins(dbh, sql)) {
+    case NS_DML:
+        /* handled */
+        return NS_DML;
 
-        for (i = 0; i < connection->n_columns; i++) {
-            fetch_buffer_t *fetchbuf = &connection->fetch_buffers[i];
+    case NS_ERROR:
+        return NS_ERROR;
 
-            ns_ora_log(lexpos(), "fetchbuf %d, %p, %d, %p, %p, %p", i, fetchbuf,
-                fetchbuf->type, fetchbuf->lob, fetchbuf->buf,
-                fetchbuf->lobs);
+    case NS_OK:
+        break;
 
-            if (fetchbuf->lob != 0) {
-                oci_status =
-                    OCIDescriptorFree(fetchbuf->lob, OCI_DTYPE_LOB);
-                oci_error_p(lexpos(), dbh, "OCIDescriptorFree", 0,
-                            oci_status);
-                fetchbuf->lob = 0;
-            }
+    default:
+        error(lexpos(), "internal error");
+        return NS_ERROR;
+    }
 
-            Ns_Free(fetchbuf->buf);
-            fetchbuf->buf = NULL;
-            Ns_Free(fetchbuf->array_values);
-            fetchbuf->array_values = NULL;
+    /* allocate a new handle and stuff in connection->stmt */
+    oci_status = OCIHandleAlloc(connection->env,
+                                (oci_handle_t **) & connection->stmt,
+                                OCI_HTYPE_STMT, 0, NULL);
+    if (oci_error_p(lexpos(), dbh, "OCIHandleAlloc", sql, oci_status)) {
+        Ns_OracleFlush(dbh);
+        return NS_ERROR;
+    }
 
-            if (fetchbuf->lobs != 0) {
-                int k;
-                for (k = 0; k < (int) fetchbuf->n_rows; k++) {
-                    oci_status = OCIDescriptorFree(fetchbuf->lobs[k],
-                                                   OCI_DTYPE_LOB);
-                    oci_error_p(lexpos(), dbh, "OCIDescriptorFree", 0,
-                                oci_status);
-                }
-                Ns_Free(fetchbuf->lobs);
-                fetchbuf->lobs = NULL;
-                fetchbuf->n_rows = 0;
+    /* purely a local call to "prepare statement for execution" */
+    oci_status = OCIStmtPrepare(connection->stmt,
+                                connection->err,
+                                (const OraText *)sql,
+                                (ub4) strlen(sql),
+                                OCI_NTV_SYNTAX, OCI_DEFAULT);
+    if (oci_error_p(lexpos(), dbh, "OCIStmtPrepare", sql, oci_status)) {
+        Ns_OracleFlush(dbh);
+        return NS_ERROR;
+    }
+
+    /* check what type of statement it is, this will affect how
+       many times we expect to execute it */
+    oci_status = OCIAttrGet(connection->stmt,
+                            OCI_HTYPE_STMT,
+                            (oci_attribute_t *) & type,
+                            NULL, OCI_ATTR_STMT_TYPE, connection->err);
+    if (oci_error_p(lexpos(), dbh, "OCIAttrGet", sql, oci_status)) {
+        /* got error asking Oracle for the statement type */
+        Ns_OracleFlush(dbh);
+        return NS_ERROR;
+    }
+
+    if (type == OCI_STMT_SELECT) {
+        iters = 0;
+        connection->describe = ora_describe_get(connection, sql);
+        if (prefetch_rows > 0 || prefetch_memory == 0) {
+            ub4 rows = (ub4) (prefetch_rows > 0
+                              ? prefetch_rows : MIN_PREFETCH_ROWS);
+
+            /* Set prefetch rows attr for selects. */
+            oci_status = OCIAttrSet(connection->stmt,
+                                    OCI_HTYPE_STMT,
+                                    (dvoid *) &rows,
+                                    0,
+                                    OCI_ATTR_PREFETCH_ROWS,
+                                    connection->err);
+            if (oci_error_p(lexpos(), dbh, "OCIAttrSet", sql, oci_status)) {
+                Ns_OracleFlush(dbh);
+                return NS_ERROR;
+            }
+        }
+        if (prefetch_memory > 0) {
+            /* Set prefetch memory attr for selects. */
+            oci_status = OCIAttrSet(connection->stmt,
+                                    OCI_HTYPE_STMT,
+                                    (dvoid *) &prefetch_memory,
+                                    0,
+                                    OCI_ATTR_PREFETCH_MEMORY,
+                                    connection->err);
+            if (oci_error_p(lexpos(), dbh, "OCIAttrSet", sql, oci_status)) {
+                Ns_OracleFlush(dbh);
+                return NS_ERROR;
             }
         }
+    } else {
+        iters = 1;
+    }
 
-        Ns_Free(connection->fetch_buffers);
-        connection->fetch_buffers = 0;
+    /* actually go to server and execute statement */
+    oci_status = OCIStmtExecute(connection->svc,
+                                connection->stmt,
+                                connection->err,
+                                iters,
+                                0, NULL, NULL,
+                                (connection->mode == autocommit
+                                 ? OCI_COMMIT_ON_SUCCESS : OCI_DEFAULT));
+    if (oci_status == OCI_ERROR) {
+        oci_status_t oci_status1;
+        sb4 errorcode;
+
+        oci_status1 = OCIErrorGet(connection->err,
+                                  1,
+                                  NULL, &errorcode, 0, 0, OCI_HTYPE_ERROR);
+
+        if (oci_error_p(lexpos(), dbh, "OCIErrorGet", sql, oci_status1)) {
+            /* the error getter got an error; let's bail */
+            Ns_OracleFlush(dbh);
+            return NS_ERROR;
+        } else if (oci_error_p(lexpos(), dbh, "OCIStmtExecute", sql, oci_status)) {
+            /* this is where we end up for an ordinary error-producing SQL statement
+               we call oci_error_p() above so that crud ends up in the log */
+            Ns_OracleFlush(dbh);
+            return NS_ERROR;
+        }
+    } else
+        if (oci_error_p(lexpos(), dbh, "OCIStmtExecute", sql, oci_status))
+    {
+        /* we got some weird error that wasn't OCI_ERROR; we hardly ever get here */
+        Ns_OracleFlush(dbh);
+        return NS_ERROR;
     }
 
-    return NS_OK;
+    ns_ora_log(lexpos(), "query type `%d'", type);
+
+    if (type == OCI_STMT_SELECT)
+        return NS_ROWS;
+    else
+        return NS_DML;
 }
 /*}}}*/
 
-/*{{{ Ns_OracleResetHandle */
+/*{{{ Ns_OracleBindRow */
 /*----------------------------------------------------------------------
- * Ns_OracleResetHandle --
+ * Ns_OracleBindRow --
  *
- *      Called by AOLserver when a handle is returned to the
- *      database pool.
+ *      Return a list of column names in an Ns_Set.  This is used
+ *      later to fetch rows into.
+ *
+ *      Implements [ns_db bindrow]
  *
  *----------------------------------------------------------------------
  */
-static Ns_ReturnCode
-Ns_OracleResetHandle (Ns_DbHandle *dbh)
+static Ns_Set *
+Ns_OracleBindRow (Ns_DbHandle *dbh)
 {
+    oci_status_t oci_status;
     ora_connection_t *connection;
+    ora_describe_t *describe;
+    Ns_Set *row = 0;
+    int i;
 
     ns_ora_log(lexpos(), "entry (dbh %p)", dbh);
 
@@ -3913,1320 +5338,6023 @@ Ns_OracleResetHandle (Ns_DbHandle *dbh)
     }
 
     connection = dbh->connection;
-    if (!connection) {
+    if (connection == 0) {
         error(lexpos(), "no connection.");
         return 0;
     }
 
-    if (connection->mode == transaction) {
-        oci_status_t oci_status;
-
-        oci_status = OCITransRollback(connection->svc,
-                                      connection->err, OCI_DEFAULT);
-        if (oci_error_p(lexpos(), dbh, "OCITransRollback", 0, oci_status))
-            return NS_ERROR;
-
-        connection->mode = autocommit;
+    if (connection->stmt == 0) {
+        error(lexpos(), "no active query statement executing");
+        return 0;
     }
 
-    return NS_OK;
-}
-/*}}}*/
-
-/*
- * Utility functions for dealing with string lists.
- *
- */
+    if (connection->fetch_buffers != 0) {
+        error(lexpos(), "query already bound");
+        Ns_OracleFlush(dbh);
+        return 0;
+    }
 
-/* NaviServer includes snprintf() as ns_snprintf() in "naviserver/nsthread/error.c". */
+    /* LOB tokens of the previous query are valid up to the next one */
+    ora_objects_free_type(connection, ORA_OBJECT_LOB_TOKEN);
 
-/*{{{ string_list_elt_t */
-static string_list_elt_t *
-string_list_elt_new(char *string)
-{
-    string_list_elt_t *elt =
-        (string_list_elt_t *) Ns_Malloc(sizeof(string_list_elt_t));
-    elt->string = string;
-    elt->next = 0;
+    row = dbh->row;
 
-    return elt;
-}
-/*}}}*/
+    /* get number of columns returned by query; sets connection->n_columns */
+    oci_status = OCIAttrGet(connection->stmt,
+                            OCI_HTYPE_STMT,
+                            (oci_attribute_t *) & connection->n_columns,
+                            NULL, OCI_ATTR_PARAM_COUNT, connection->err);
+    if (oci_error_p(lexpos(), dbh, "OCIAttrGet", 0, oci_status)) {
+        Ns_OracleFlush(dbh);
+        return 0;
+    }
 
-/*{{{ string_list_len */
-static int
-string_list_len(string_list_elt_t * head)
-{
-    int i = 0;
+    ns_ora_log(lexpos(), "n_columns: %d", connection->n_columns);
 
-    while (head != NULL) {
-        i++;
-        head = head->next;
+    /* the select list as described by an earlier run of the query,
+       unless the executed statement disagrees with it by now */
+    if (connection->describe == NULL) {
+        connection->describe = ora_describe_get(connection, NULL);
+    }
+    describe = connection->describe;
+    if ((describe->n_columns != connection->n_columns
+         || !ora_describe_current_p(connection, connection->stmt, describe))
+        && ora_describe_columns(dbh, connection->stmt, describe, 0) != NS_OK) {
+        Ns_OracleFlush(dbh);
+        return 0;
     }
 
-    return i;
-}
-/*}}}*/
+    /* allocate N fetch buffers, this proc pulls N from connection->n_columns */
+    malloc_fetch_buffers(connection);
 
-/*{{{ string_list_free_list */
-static void
-string_list_free_list(string_list_elt_t * head)
-{
-    string_list_elt_t *elt;
+    for (i = 0; i < connection->n_columns; i++) {
+        fetch_buffer_t *fetchbuf = &connection->fetch_buffers[i];
+        ora_column_t   *column = &describe->columns[i];
 
-    while (head) {
-        Ns_Free(head->string);
-        elt = head->next;
-        Ns_Free(head);
-        head = elt;
-    }
+        fetchbuf->type = column->type;
+        fetchbuf->size = column->size;
+        Ns_SetPut(row, column->name, 0);
 
-}
-/*}}}*/
+        switch (fetchbuf->type) {
+            /* we handle LOBs in the loop below */
+        case OCI_TYPECODE_CLOB:
+        case OCI_TYPECODE_BLOB:
+            break;
 
-/*{{{ parse_bind_variables  */
-static string_list_elt_t *
-parse_bind_variables(char *input)
-{
-    char *p, lastchar;
-    enum { base_state, instr_state, bind_state } state;
+            /* this might work if the rest of our LONG stuff worked */
+        case SQLT_LNG:
+            fetchbuf->buf_size = lob_buffer_size;
+            fetchbuf->buf = Ns_Malloc(fetchbuf->buf_size);
+            break;
+
+        case SQLT_RDD:
+        case SQLT_NUM:
+        case SQLT_DAT:
+        case SQLT_TIMESTAMP:
+        case SQLT_TIMESTAMP_TZ:
+            fetchbuf->buf_size = fetchbuf->size + 8u;
+            fetchbuf->buf = Ns_Malloc(fetchbuf->buf_size);
+            break;
+
+        default:
+            /* this is the important part, we allocate buf to be 8 bytes
+               more than Oracle says are necessary (for null
+               termination) */
+            if (fetchbuf->type == SQLT_BIN && connection->fetch_objs) {
+                /* fetched as is for ora_rows_fetch() */
+                fetchbuf->buf_size = fetchbuf->size + 8u;
+            } else if (fetchbuf->type == SQLT_BIN) {
+                fetchbuf->buf_size = fetchbuf->size * 2u + 8u;
+            } else {
+                fetchbuf->buf_size = fetchbuf->size + 8u;
+            }
+
+            fetchbuf->buf_size *= (unsigned int)char_expansion;
+            fetchbuf->buf = Ns_Malloc (fetchbuf->buf_size);
+
+            break;
+        }
+    }
+
+    /* loop over the columns again; this could now be in the loop above
+       but we originally did things this way to permit resizing of
+       buffers
+
+       Now we're telling Oracle to associate the buffers we just
+       allocated with their respective columns */
+    for (i = 0; i < connection->n_columns; i++) {
+        fetch_buffer_t *fetchbuf;
+
+        fetchbuf = &connection->fetch_buffers[i];
+
+        switch (fetchbuf->type) {
+        case OCI_TYPECODE_CLOB:
+        case OCI_TYPECODE_BLOB:
+            /* we allocate descriptors for CLOBs; these are essentially
+               pointers.  We will not allocate any buffers for them
+               until we're actually fetching data from individual
+               rows. */
+            oci_status = OCIDescriptorAlloc(connection->env,
+                                            (oci_descriptor_t *) &
+                                            fetchbuf->lob, OCI_DTYPE_LOB,
+                                            0, 0);
+            if (oci_error_p(lexpos(), dbh, "OCIDescriptorAlloc", 0, oci_status)) {
+                Ns_OracleFlush(dbh);
+                return 0;
+            }
+
+            oci_status = OCIDefineByPos(connection->stmt,
+                                        &fetchbuf->def,
+                                        connection->err,
+                                        (ub4)i + 1,
+                                        &fetchbuf->lob,
+                                        -1,
+                                        fetchbuf->type,
+                                        &fetchbuf->is_null,
+                                        0, 0, OCI_DEFAULT);
+            ora_describe_check(connection, oci_status);
+            if (oci_error_p(lexpos(), dbh, "OCIDefineByPos", 0, oci_status)) {
+                Ns_OracleFlush(dbh);
+                return 0;
+            }
+            break;
+
+        case SQLT_LNG:
+            oci_status = OCIDefineByPos(connection->stmt,
+                                        &fetchbuf->def,
+                                        connection->err,
+                                        (ub4)i + 1,
+                                        0,
+                                        (sb4)SB4MAXVAL,
+                                        fetchbuf->type,
+                                        &fetchbuf->is_null,
+                                        &fetchbuf->fetch_length,
+                                        0, OCI_DYNAMIC_FETCH);
+
+            ora_describe_check(connection, oci_status);
+            if (oci_error_p(lexpos(), dbh, "OCIDefineByPos", 0, oci_status)) {
+                Ns_OracleFlush(dbh);
+                return 0;
+            }
+
+            ns_ora_log(lexpos(), "`OCIDefineDynamic ()' success");
+            break;
+
+        default:
+            oci_status = OCIDefineByPos(connection->stmt,
+                                        &fetchbuf->def,
+                                        connection->err,
+                                        (ub4)i + 1,
+                                        fetchbuf->buf,
+                                        (sb4)fetchbuf->buf_size,
+                                        (fetchbuf->type == SQLT_BIN
+                                         && connection->fetch_objs)
+                                        ? SQLT_BIN : SQLT_STR,
+                                        &fetchbuf->is_null,
+                                        &fetchbuf->fetch_length,
+                                        NULL, OCI_DEFAULT);
+
+            ora_describe_check(connection, oci_status);
+            if (oci_error_p(lexpos(), dbh, "OCIDefineByPos", 0, oci_status)) {
+                Ns_OracleFlush(dbh);
+                return 0;
+            }
+            break;
+        }
+    }
+
+    return row;
+}
+/*}}}*/
+
+/*{{{ Ns_OracleGetRow */
+/*----------------------------------------------------------------------
+ * Ns_OracleGetRow --
+ *
+ *      Fetch the next row of the result set into the row Ns_Set.
+ *
+ *      Implements [ns_db getrow]
+ *
+ *----------------------------------------------------------------------
+ */
+static int
+Ns_OracleGetRow (Ns_DbHandle *dbh, Ns_Set *row)
+{
+    oci_status_t oci_status;
+    ora_connection_t *connection;
+    int i;
+    ub4 ret_len = 0;
+
+    ns_ora_log(lexpos(), "entry (dbh %p, row %p)", dbh, row);
+
+    if (dbh == NULL || row == NULL) {
+        error(lexpos(), "invalid args.");
+        return NS_ERROR;
+    }
+
+    connection = dbh->connection;
+    if (connection == 0) {
+        error(lexpos(), "no connection.");
+        return NS_ERROR;
+    }
+
+    if (row == 0) {
+        error(lexpos(), "invalid argument, `NULL' row");
+        Ns_OracleFlush(dbh);
+        return NS_ERROR;
+    }
+
+    if (connection->stmt == 0) {
+        error(lexpos(), "no active select");
+        Ns_OracleFlush(dbh);
+        return NS_ERROR;
+    }
+
+    /* fetch */
+    oci_status = OCIStmtFetch(connection->stmt,
+                              connection->err,
+                              1, OCI_FETCH_NEXT, OCI_DEFAULT);
+    ora_describe_check(connection, oci_status);
+
+    if (oci_status == OCI_NEED_DATA) {
+        ;
+    } else if (oci_status == OCI_NO_DATA) {
+        /*  We've reached beyond the last row of the select, so flush the
+         *  statement and tell AOLserver that it isn't going to get
+         *  anything more out of us.
+         */
+        ns_ora_log(lexpos(), "return NS_END_DATA;");
+
+        if (Ns_OracleFlush(dbh) != NS_OK)
+            return NS_ERROR;
+        else
+            return NS_END_DATA;
+    } else if (oci_error_p(lexpos(), dbh, "OCIStmtFetch", 0, oci_status)) {
+        /* We got some other kind of error */
+        Ns_OracleFlush(dbh);
+        return NS_ERROR;
+    }
+
+    /* Fetched succeeded; copy fetch buffers (one/column) into the ns_set */
+    for (i = 0; i < connection->n_columns; i++) {
+        fetch_buffer_t *fetchbuf = &connection->fetch_buffers[i];
+
+        switch (fetchbuf->type) {
+        case OCI_TYPECODE_CLOB:
+        case OCI_TYPECODE_BLOB:
+
+            if (fetchbuf->is_null == -1) {
+                Ns_SetPutValue(row, (size_t)i, "");
+            } else if (fetchbuf->is_null != 0) {
+                error(lexpos(), "invalid fetch buffer is_null");
+                Ns_OracleFlush(dbh);
+                return NS_ERROR;
+            } else if (connection->fetch_objs
+                       && fetchbuf->type == OCI_TYPECODE_BLOB
+                       && !connection->lazy_lobs) {
+                /* read into a byte array by ora_rows_fetch() */
+                Ns_SetPutValue(row, (size_t)i, "");
+            } else if (connection->lazy_lobs) {
+                /* leave a token for [ns_ora lob_get] instead of the value */
+                const char *token = lob_token_new(dbh, fetchbuf->lob,
+                                                  fetchbuf->type == OCI_TYPECODE_BLOB);
+                if (token == NULL) {
+                    Ns_OracleFlush(dbh);
+                    return NS_ERROR;
+                }
+                Ns_SetPutValue(row, (size_t)i, token);
+            } else {
+                /* CLOB is not null, let's grab it. We use an Ns_DString
+                   to do this, because when dealing with variable width
+                   character sets, a single character can be many bytes long
+                   (in UTF8, up to six). */
+                oraub8 lob_length = 0;
+                oraub8 byte_amt, char_amt;
+                Tcl_DString retval;
+                ub1 *bufp;
+
+                /* Get length of LOB, in characters for CLOBs and bytes
+                   for BLOBs. */
+                oci_status = OCILobGetLength2(connection->svc,
+                                              connection->err,
+                                              fetchbuf->lob, &lob_length);
+                if (oci_error_p(lexpos(), dbh, "OCILobGetLength2",
+                                0, oci_status)) {
+                    Ns_OracleFlush(dbh);
+                    return NS_ERROR;
+                }
+
+                /* Initialize the buffer we're going to use for the value. */
+                bufp = (ub1 *) Ns_Malloc(lob_buffer_size);
+                Tcl_DStringInit(&retval);
+
+                /* Do the read. */
+                byte_amt = fetchbuf->type == OCI_TYPECODE_BLOB ? lob_length : 0u;
+                char_amt = fetchbuf->type == OCI_TYPECODE_BLOB ? 0u : lob_length;
+                oci_status = OCILobRead2(connection->svc,
+                                         connection->err,
+                                         fetchbuf->lob,
+                                         &byte_amt,
+                                         &char_amt,
+                                         (oraub8) 1,
+                                         bufp,
+                                         (oraub8) lob_buffer_size,
+                                         OCI_FIRST_PIECE,
+                                         &retval,
+                                         ora_append_buf_to_dstring, (ub2) 0,
+                                         (ub1) SQLCS_IMPLICIT);
+
+                if (oci_error_p(lexpos(), dbh, "OCILobRead2", 0, oci_status)) {
+                    Ns_OracleFlush(dbh);
+                    Tcl_DStringFree(&retval);
+                    Ns_Free(bufp);
+                    return NS_ERROR;
+                }
+
+                Ns_SetPutValue(row, (size_t)i, Ns_DStringValue(&retval));
+                Tcl_DStringFree(&retval);
+                Ns_Free(bufp);
+            }
+            break;
+
+        case SQLT_LNG:
+            /* this is broken for multi-part LONGs.  LONGs are being deprecated
+             * by Oracle anyway, so no big loss
+             *
+             * Maybe fixed by davis@arsdigita.com
+             */
+            if (fetchbuf->is_null == -1)
+                fetchbuf->buf[0] = 0;
+            else if (fetchbuf->is_null != 0) {
+                error(lexpos(), "invalid fetch buffer is_null");
+                Ns_OracleFlush(dbh);
+                return NS_ERROR;
+            } else {
+                fetchbuf->buf[0] = 0;
+                fetchbuf->fetch_length = 0;
+                ret_len = 0;
+
+                ns_ora_log(lexpos(), "LONG start: buf_size=%d fetched=%d\n",
+                    fetchbuf->buf_size, fetchbuf->fetch_length);
+
+                do {
+                    //dvoid *def;
+                    ub1 inoutp;
+                    ub1 piece;
+                    ub4 type;
+                    ub4 iterp;
+                    ub4 idxp;
+
+                    fetchbuf->fetch_length += ret_len;
+                    if (fetchbuf->fetch_length > fetchbuf->buf_size / 2) {
+                        fetchbuf->buf_size *= 2;
+                        fetchbuf->buf =
+                            ns_realloc(fetchbuf->buf, fetchbuf->buf_size);
+                    }
+                    ret_len = fetchbuf->buf_size - fetchbuf->fetch_length;
+
+                    oci_status = OCIStmtGetPieceInfo(connection->stmt,
+                                                     connection->err,
+                                                     (dvoid **) &
+                                                     fetchbuf->def, &type,
+                                                     &inoutp, &iterp,
+                                                     &idxp, &piece);
+
+                    if (oci_error_p(lexpos(), dbh, "OCIStmtGetPieceInfo", 0,
+                         oci_status)) {
+                        Ns_OracleFlush(dbh);
+                        return NS_ERROR;
+                    }
+
+                    oci_status = OCIStmtSetPieceInfo(fetchbuf->def,
+                                                     OCI_HTYPE_DEFINE,
+                                                     connection->err,
+                                                     (void *) (fetchbuf->
+                                                               buf +
+                                                               fetchbuf->
+                                                               fetch_length),
+                                                     &ret_len, piece,
+                                                     &fetchbuf->is_null,
+                                                     NULL);
+
+                    if (oci_error_p(lexpos(), dbh, "OCIStmtGetPieceInfo", 0,
+                         oci_status)) {
+                        Ns_OracleFlush(dbh);
+                        return NS_ERROR;
+                    }
+
+                    oci_status = OCIStmtFetch(connection->stmt,
+                                              connection->err,
+                                              1,
+                                              OCI_FETCH_NEXT, OCI_DEFAULT);
+
+                    ns_ora_log(lexpos(),
+                        "LONG: status=%d ret_len=%d buf_size=%d fetched=%d\n",
+                        oci_status, ret_len, fetchbuf->buf_size,
+                        fetchbuf->fetch_length);
+
+                    if (oci_status != OCI_NEED_DATA
+                        && oci_error_p(lexpos(), dbh, "OCIStmtFetch", 0,
+                                       oci_status)) {
+                        Ns_OracleFlush(dbh);
+                        return NS_ERROR;
+                    }
+
+                    if (oci_status == OCI_NO_DATA)
+                        break;
+
+                } while (oci_status == OCI_SUCCESS_WITH_INFO ||
+                         oci_status == OCI_NEED_DATA);
+
+            }
+
+            fetchbuf->buf[fetchbuf->fetch_length] = 0;
+            ns_ora_log(lexpos(), "LONG done: status=%d buf_size=%d fetched=%d\n",
+                oci_status, fetchbuf->buf_size, fetchbuf->fetch_length);
+
+            Ns_SetPutValue(row, (size_t)i, fetchbuf->buf);
+
+            break;
+
+        default:
+            /* add null termination and then do an ns_set put */
+            if (fetchbuf->is_null == -1)
+                fetchbuf->buf[0] = 0;
+            else if (fetchbuf->is_null != 0) {
+                /* truncated: the value is longer than its column
+                   was described */
+                error(lexpos(), "invalid fetch buffer is_null");
+                ora_describe_forget(connection, connection->describe);
+                Ns_OracleFlush(dbh);
+                return NS_ERROR;
+            } else
+                fetchbuf->buf[fetchbuf->fetch_length] = 0;
+
+            Ns_SetPutValue(row, (size_t)i, fetchbuf->buf);
+
+            break;
+        }
+    }
+
+    return NS_OK;
+}
+/*}}}*/
+
+/*{{{ Ns_OracleFlush */
+/*----------------------------------------------------------------------
+ * Ns_OracleFlush --
+ *
+ *      Used to clean up after an error or after we've reached the
+ *      end of a result set.  Frees fetch buffers.
+ *
+ *      Implements [ns_db flush]
+ *
+ *----------------------------------------------------------------------
+ */
+static Ns_ReturnCode
+Ns_OracleFlush (Ns_DbHandle *dbh)
+{
+    ora_connection_t *connection;
+    oci_status_t      oci_status;
+
+    ns_ora_log(lexpos(), "entry (dbh %p, row %p)", dbh, 0);
+
+    if (dbh == NULL) {
+        error(lexpos(), "invalid args, `NULL' database handle");
+        return NS_ERROR;
+    }
+
+    connection = dbh->connection;
+
+    if (connection == NULL) {
+        /* Connection is closed.  That's as good as flushed to me */
+        return NS_OK;
+    }
+
+    if (connection->stmt != 0) {
+        if (connection->stmt_cached) {
+            connection->stmt_cached = NS_FALSE;
+            oci_status = OCIStmtRelease(connection->stmt, connection->err,
+                                        NULL, 0, OCI_DEFAULT);
+            if (oci_error_p(lexpos(), dbh, "OCIStmtRelease", 0, oci_status))
+                return NS_ERROR;
+        } else {
+            oci_status = OCIHandleFree(connection->stmt, OCI_HTYPE_STMT);
+            if (oci_error_p(lexpos(), dbh, "OCIHandleFree", 0, oci_status))
+                return NS_ERROR;
+        }
+        connection->stmt = 0;
+    }
+
+    if (connection->describe != NULL) {
+        if (connection->describe->hPtr == NULL) {
+            ora_describe_forget(connection, connection->describe);
+        }
+        connection->describe = NULL;
+    }
+
+    connection->interp = NULL;
+
+    if (connection->fetch_buffers != 0) {
+        int i;
+
+        for (i = 0; i < connection->n_columns; i++) {
+            fetch_buffer_t *fetchbuf = &connection->fetch_buffers[i];
+
+            ns_ora_log(lexpos(), "fetchbuf %d, %p, %d, %p, %p, %p", i, fetchbuf,
+                fetchbuf->type, fetchbuf->lob, fetchbuf->buf,
+                fetchbuf->lobs);
+
+            if (fetchbuf->lob != 0) {
+                oci_status =
+                    OCIDescriptorFree(fetchbuf->lob, OCI_DTYPE_LOB);
+                oci_error_p(lexpos(), dbh, "OCIDescriptorFree", 0,
+                            oci_status);
+                fetchbuf->lob = 0;
+            }
+
+            if (fetchbuf->stmt != 0) {
+                oci_status = OCIHandleFree(fetchbuf->stmt, OCI_HTYPE_STMT);
+                oci_error_p(lexpos(), dbh, "OCIHandleFree", 0, oci_status);
+                fetchbuf->stmt = 0;
+            }
+
+            Ns_Free(fetchbuf->is_nulls);
+            fetchbuf->is_nulls = NULL;
+            Ns_Free(fetchbuf->fetch_lengths);
+            fetchbuf->fetch_lengths = NULL;
+            fetch_buffer_free_coll(fetchbuf);
+
+            fetch_buffer_free_buf(fetchbuf);
+            Ns_Free(fetchbuf->array_values);
+            fetchbuf->array_values = NULL;
+
+            if (fetchbuf->lobs != 0) {
+                int k;
+                for (k = 0; k < (int) fetchbuf->n_rows; k++) {
+                    oci_status = OCIDescriptorFree(fetchbuf->lobs[k],
+                                                   OCI_DTYPE_LOB);
+                    oci_error_p(lexpos(), dbh, "OCIDescriptorFree", 0,
+                                oci_status);
+                }
+                Ns_Free(fetchbuf->lobs);
+                fetchbuf->lobs = NULL;
+                fetchbuf->n_rows = 0;
+            }
+        }
+
+        Ns_Free(connection->fetch_buffers);
+        connection->fetch_buffers = 0;
+    }
+
+    return NS_OK;
+}
+/*}}}*/
+
+/*{{{ Ns_OracleResetHandle */
+/*----------------------------------------------------------------------
+ * Ns_OracleResetHandle --
+ *
+ *      Called by AOLserver when a handle is returned to the
+ *      database pool.
+ *
+ *----------------------------------------------------------------------
+ */
+static Ns_ReturnCode
+Ns_OracleResetHandle (Ns_DbHandle *dbh)
+{
+    ora_connection_t *connection;
+
+    ns_ora_log(lexpos(), "entry (dbh %p)", dbh);
+
+    if (dbh == NULL) {
+        error(lexpos(), "invalid args.");
+        return 0;
+    }
+
+    connection = dbh->connection;
+    if (!connection) {
+        error(lexpos(), "no connection.");
+        return 0;
+    }
+
+    ora_objects_free_all(connection);
+    connection->lazy_lobs = lazy_lobs_p;
+    /* DBMS_OUTPUT stays enabled in the session, logging is per page */
+    connection->dbms_output_log = -1;
+
+    if (connection->mode == transaction) {
+        oci_status_t oci_status;
+
+        oci_status = OCITransRollback(connection->svc,
+                                      connection->err, OCI_DEFAULT);
+        if (oci_error_p(lexpos(), dbh, "OCITransRollback", 0, oci_status))
+            return NS_ERROR;
+
+        connection->mode = autocommit;
+    }
+
+    return NS_OK;
+}
+/*}}}*/
+
+/*
+ * Utility functions for dealing with string lists.
+ *
+ */
+
+/* NaviServer includes snprintf() as ns_snprintf() in "naviserver/nsthread/error.c". */
+
+/*{{{ string_list_elt_t */
+static string_list_elt_t *
+string_list_elt_new(char *string)
+{
+    string_list_elt_t *elt =
+        (string_list_elt_t *) Ns_Malloc(sizeof(string_list_elt_t));
+    elt->string = string;
+    elt->next = 0;
+
+    return elt;
+}
+/*}}}*/
+
+/*{{{ string_list_len */
+static int
+string_list_len(string_list_elt_t * head)
+{
+    int i = 0;
+
+    while (head != NULL) {
+        i++;
+        head = head->next;
+    }
+
+    return i;
+}
+/*}}}*/
+
+/*{{{ string_list_free_list */
+static void
+string_list_free_list(string_list_elt_t * head)
+{
+    string_list_elt_t *elt;
+
+    while (head) {
+        Ns_Free(head->string);
+        elt = head->next;
+        Ns_Free(head);
+        head = elt;
+    }
+
+}
+/*}}}*/
+
+/*{{{ parse_bind_variables  */
+static string_list_elt_t *
+parse_bind_variables(char *input)
+{
+    char *p, lastchar;
+    enum { base_state, instr_state, bind_state } state;
     char bindbuf[1024], *bp = bindbuf;
     string_list_elt_t *elt, *head = 0, *tail = 0;
     int current_string_length = 0;
 
-    for (p = input, state = base_state, lastchar = '\0'; *p != '\0';
-         lastchar = *p, p++) {
+    for (p = input, state = base_state, lastchar = '\0'; *p != '\0';
+         lastchar = *p, p++) {
+
+        switch (state) {
+        case base_state:
+            if (*p == '\'') {
+                state = instr_state;
+                current_string_length = 0;
+            } else if (*p == ':') {
+                bp = bindbuf;
+                state = bind_state;
+            }
+            break;
+
+        case instr_state:
+            if (*p == '\''
+                && (lastchar != '\'' || current_string_length == 0)) {
+                state = base_state;
+            }
+            current_string_length++;
+            break;
+
+        case bind_state:
+            if (*p == '=') {
+                state = base_state;
+                bp = bindbuf;
+            } else if (!
+                       (*p == '_' || *p == '$' || *p == '#'
+                        || isalnum((int) *p))) {
+                *bp = '\0';
+                elt = string_list_elt_new(Ns_StrDup(bindbuf));
+                if (tail == 0) {
+                    head = tail = elt;
+                } else {
+                    tail->next = elt;
+                    tail = elt;
+                }
+                state = base_state;
+                p--;
+            } else {
+                *bp++ = *p;
+            }
+            break;
+        }
+    }
+
+    if (state == bind_state) {
+        *bp = '\0';
+        elt = string_list_elt_new(Ns_StrDup(bindbuf));
+        if (tail == 0) {
+            head = tail = elt;
+        } else {
+            tail->next = elt;
+            tail = elt;
+        }
+    }
+
+    return head;
+}
+/*}}}*/
+
+/*{{{ downcase */
+static void
+downcase(char *s)
+{
+    for (; *s; s++)
+        *s = (char)tolower(*s);
+}
+/*}}}*/
+
+/*{{{ nilp */
+/* nilp is misnamed to some extent; handle empty or overly long strings
+ *  before printing them out to logs
+ */
+static const char *
+nilp(const char *s)
+{
+    if (s == 0)
+        return "[nil]";
+
+    if ((int) strlen(s) > max_string_log_length)
+        return "[too long]";
+
+    return s;
+}
+/*}}}*/
+
+/*
+ * Several helper functions that get used everywhere.
+ */
+
+#ifdef FOR_CASSANDRACLE
+/*{{{ allow_sql_p*/
+
+/*
+ * Because Cassandracle (http://www.arsdigita.com/free-tools/cassandracle.html)
+ * runs with DBA privileges, we need to prevent anything
+ * Bad from happening, whether through malicious intent or just plain
+ * human sloppiness.  Selects are pretty safe, so only those are allowed
+ * if FOR_CASSANDRACLE is defined, disallow any sql that does not
+ * begin with "select".
+ *
+ */
+
+static int allow_sql_p(Ns_DbHandle * dbh, char *sql, int display_sql_p)
+{
+    char *trimmedSql = sql;
+
+    /* trim off leading white space. (the int cast is necessary for the HP) */
+    while (*trimmedSql && isspace((int) *trimmedSql)) {
+        trimmedSql++;
+    }
+
+
+    /* (damned if you do, damned if you don't.  doing a
+     * strlen("select") each time here is wasteful of CPU which
+     * would offend the sensibilities of half the world.  hard-coding
+     * the "6" offends the other half)
+     */
+    if (strncasecmp(trimmedSql, "select", 6) != 0) {
+        int bufsize = strlen(sql) + 4096;
+
+        /* don't put a 20,000 byte buffer on the stack here, since this case
+         * should be very rare.  allocate enough space for the sql
+         * plus some to handle the other text.  (4K should be enough to
+         * handle the lexpos() call)
+         */
+        char *buf = Ns_Malloc(bufsize);
+
+        /* means someone is trying to do something other than a select.
+         * Bad!  Very Bad!
+         */
+        if (display_sql_p) {
+            snprintf(buf, bufsize, "%s:%d:%s: Sql Rejected: %s",
+                     lexpos(), trimmedSql);
+        } else {
+            snprintf(buf, bufsize, "%s:%d:%s: Sql Rejected", lexpos());
+        }
+
+        Ns_Log(Error, "%s", buf);
+
+        Ns_DbSetException(dbh, "ORA", buf);
+
+        Ns_Free(buf);
+
+        return NS_FALSE;
+    }
+
+    return NS_TRUE;
+
+}                               /* allow_sql_p */
+/*}}}*/
+#endif
+
+/*{{{ oci_error_p */
+/* we call this after every OCI call, i.e., a couple of times during
+   each fetch of a row
+*/
+static int
+oci_error_p(const char *file, int line, const char *fn,
+            Ns_DbHandle *dbh, const char *ocifn, const char *query,
+            oci_status_t oci_status)
+{
+    ora_connection_t *connection = 0;
+    ub2               offset = 0;
+    sb4               errorcode = 0;
+
+    char             *msgbuf;
+    char             *buf;
+
+    if (dbh) {
+        connection = dbh->connection;
+    }
+
+    if (oci_status == OCI_SUCCESS)
+        return 0;
+
+    /* Until we get the logging situation worked out, return
+     * OCI_SUCCESS_WITH_INFO as a pure success.
+     */
+    if (oci_status == OCI_SUCCESS_WITH_INFO)
+        return 0;
+
+    /* If the query is long, nilp will return "[too long]";
+     * if null (we're not doing a query yet, e.g., could
+     * be opening db), then "[nil]"
+     */
+    query = nilp(query);
+
+    msgbuf = (char *) Ns_Malloc(STACK_BUFFER_SIZE * sizeof(char));
+    buf = (char *) Ns_Malloc(STACK_BUFFER_SIZE * sizeof(char));
+    *msgbuf = 0;
+
+    switch (oci_status) {
+
+        case OCI_NEED_DATA:
+            snprintf(msgbuf, STACK_BUFFER_SIZE, "%s", "Error - OCI_NEED_DATA");
+            break;
+        case OCI_NO_DATA:
+            snprintf(msgbuf, STACK_BUFFER_SIZE, "%s", "Error - OCI_NO_DATA");
+            break;
+        case OCI_ERROR:
+
+            if (connection == 0)
+                snprintf(msgbuf, STACK_BUFFER_SIZE, "%s", "NULL connection");
+            else {
+                oci_status_t oci_status1;
+                char         errorbuf[1024];
+
+                oci_status1 = OCIErrorGet(connection->err,
+                                          1,
+                                          NULL,
+                                          &errorcode,
+                                          (OraText *)errorbuf,
+                                          sizeof errorbuf, OCI_HTYPE_ERROR);
+                if (oci_status1) {
+                    snprintf(msgbuf, STACK_BUFFER_SIZE, "%s",
+                             "`OCIErrorGet ()' error");
+                } else {
+                    snprintf(msgbuf, STACK_BUFFER_SIZE, "%s", errorbuf);
+                }
+
+                oci_status1 = OCIAttrGet(connection->stmt,
+                                         OCI_HTYPE_STMT,
+                                         &offset,
+                                         NULL,
+                                         OCI_ATTR_PARSE_ERROR_OFFSET,
+                                         connection->err);
+
+                if (errorcode == 1041 ||
+                    errorcode == 3113 ||
+                    errorcode == 12571 ||
+                    errorcode == 28 ||
+                    errorcode == 1012 ||
+                    errorcode == 24324) {
+
+                    /* 3113 is 'end-of-file on communications channel', which
+                     *      happens if the oracle process dies
+                     * 12571 is TNS:packet writer failure, which also happens if
+                     *      the oracle process dies
+                     * 1041 is the dreaded "hostdef extension doesn't exist error,
+                     *      which means the db handle is screwed and can't be used
+                     *      for anything else.
+                     *
+                     * In either case, close and re-open the handle to clear the
+                     * error condition
+                     */
+                    Ns_OracleFlush(dbh);
+                    Ns_OracleCloseDb(dbh);
+               } else if (errorcode == 20 || errorcode == 1034) {
+                    /* ora-00020 means 'maximum number of processes exceeded.
+                     * ora-01034 means 'oracle not available'.
+                     *           we want to make sure the oracleSID process
+                     *           goes away so we don't make the problem worse
+                     */
+                    Ns_OracleCloseDb(dbh);
+                } else if (oci_status1) {
+                    Ns_Log(Warning, "nsoracle: Unhandled error status %d after OCIAttrGet()",errorcode);
+                }
+            }
+            break;
+        case OCI_INVALID_HANDLE:
+            snprintf(msgbuf, STACK_BUFFER_SIZE, "%s", "Error - OCI_INVALID_HANDLE");
+            break;
+        case OCI_STILL_EXECUTING:
+            snprintf(msgbuf, STACK_BUFFER_SIZE, "%s", "Error - OCI_STILL_EXECUTING");
+            break;
+        case OCI_CONTINUE:
+            snprintf(msgbuf, STACK_BUFFER_SIZE, "%s", "Error - OCI_CONTINUE");
+            break;
+    }
+
+    if (((errorcode == 900) || (offset > 0)) && (strlen(query) >= offset)) {
+        /* ora-00900 is invalid SQL statement
+         *           it seems to be the msg most likely to be a parse
+         *           error that sets offset to 0
+         */
+        int len;
+        len = snprintf(buf, STACK_BUFFER_SIZE,
+                       "%s:%d:%s: error in `%s ()': %s\nSQL: ",
+                       file, line, fn, ocifn, msgbuf);
+        if (offset > 0)
+            len += snprintf(buf + len, STACK_BUFFER_SIZE - len, "%.*s",
+                            offset - 1, query);
+
+        snprintf(buf + len, STACK_BUFFER_SIZE - len, " !>>>!%s",
+                 query + offset);
+    } else {
+        snprintf(buf, STACK_BUFFER_SIZE,
+                 "%s:%d:%s: error in `%s ()': %s\nSQL: %s",
+                 file, line, fn, ocifn, msgbuf, query);
+    }
+
+    Ns_Log(Error, "%s", buf);
+
+    if (dbh != NULL) {
+        char exceptbuf[EXCEPTION_CODE_SIZE + 1];
+
+        /* We need to call this so that AOLserver will print out the relevant
+         * error on pages served to browsers where ClientDebug is set.
+         */
+        snprintf(exceptbuf, EXCEPTION_CODE_SIZE, "%d", (int) errorcode);
+        Ns_DbSetException(dbh, exceptbuf, buf);
+    }
+
+    Ns_Free(msgbuf);
+    Ns_Free(buf);
+
+    return 1;
+}
+/*}}}*/
+
+/*{{{ tcl_error_p */
+/* tcl_error_p is only used for ns_ora and potentially other new Tcl commands
+   does not log the error and does not Ns_DbSetException but instead just
+   tells the Tcl interpreter about it
+ */
+static int
+tcl_error_p(const char *file, int line, const char *fn,
+            Tcl_Interp *interp,
+            Ns_DbHandle *dbh, const char *ocifn, const char *query,
+            oci_status_t oci_status)
+{
+    char *msgbuf;
+    char *buf;
+    ora_connection_t *connection = 0;
+    ub2 offset = 0;
+    sb4 errorcode = 0;
+
+    if (dbh)
+        connection = dbh->connection;
+
+    /* success */
+    if (oci_status == OCI_SUCCESS)
+        return 0;
+
+    query = nilp(query);
+    msgbuf = (char *) Ns_Malloc(STACK_BUFFER_SIZE * sizeof(char));
+    buf = (char *) Ns_Malloc(STACK_BUFFER_SIZE * sizeof(char));
+    *msgbuf = 0;
+
+    switch (oci_status) {
+    case OCI_SUCCESS_WITH_INFO:
+        snprintf(msgbuf, STACK_BUFFER_SIZE,"%s",
+                 "Error - OCI_SUCCESS_WITH_INFO");
+        break;
+    case OCI_NEED_DATA:
+        snprintf(msgbuf, STACK_BUFFER_SIZE, "%s", "Error - OCI_NEED_DATA");
+        break;
+    case OCI_NO_DATA:
+        snprintf(msgbuf, STACK_BUFFER_SIZE, "%s", "Error - OCI_NO_DATA");
+        break;
+    case OCI_ERROR:
+        if (connection == 0)
+            snprintf(msgbuf, STACK_BUFFER_SIZE, "%s", "NULL connection");
+        else {
+            char errorbuf[512];
+            oci_status_t oci_status1;
+
+            oci_status1 = OCIErrorGet(connection->err,
+                                      1,
+                                      NULL,
+                                      &errorcode,
+                                      (OraText *)errorbuf,
+                                      sizeof errorbuf, OCI_HTYPE_ERROR);
+
+            if (oci_status1) {
+                snprintf(msgbuf, STACK_BUFFER_SIZE, "%s", "`OCIErrorGet ()' error");
+            } else {
+                snprintf(msgbuf, STACK_BUFFER_SIZE, "%s", errorbuf);
+            }
+
+            oci_status1 = OCIAttrGet(connection->stmt,
+                                     OCI_HTYPE_STMT,
+                                     &offset,
+                                     NULL,
+                                     OCI_ATTR_PARSE_ERROR_OFFSET,
+                                     connection->err);
+
+            if (errorcode == 1041 || errorcode == 3113
+                || errorcode == 12571) {
+                /* 3113 is 'end-of-file on communications channel', which
+                 *      happens if the oracle process dies
+                 * 12571 is TNS:packet writer failure, which also happens if
+                 *      the oracle process dies
+                 * 1041 is the dreaded "hostdef extension doesn't exist error,
+                 *      which means the db handle is screwed and can't be used
+                 *      for anything else.
+                 * In either case, close and re-open the handle to clear the
+                 * error condition
+                 */
+                Ns_OracleFlush(dbh);
+                Ns_OracleCloseDb(dbh);
+                Ns_OracleOpenDb(dbh);
+            } else if (oci_status1) {
+                Ns_Log(Warning, "nsoracle: Unhandled error status %d after OCIAttrGet()",errorcode);
+            }
+        }
+        break;
+    case OCI_INVALID_HANDLE:
+        snprintf(msgbuf, STACK_BUFFER_SIZE, "%s", "Error - OCI_INVALID_HANDLE");
+        break;
+    case OCI_STILL_EXECUTING:
+        snprintf(msgbuf, STACK_BUFFER_SIZE, "%s", "Error - OCI_STILL_EXECUTING");
+        break;
+    case OCI_CONTINUE:
+        snprintf(msgbuf, STACK_BUFFER_SIZE, "%s", "Error - OCI_CONTINUE");
+        break;
+    }
+
+    snprintf(buf, STACK_BUFFER_SIZE,
+             "%s:%d:%s: error in `%s ()': %s\nSQL: %s", file, line, fn,
+             ocifn, msgbuf, query);
+
+    Ns_Log(Error, "SQL(): %s", buf);
+
+    Tcl_AppendResult(interp, buf, (char*)0L);
+
+    /* error */
+    Ns_Free(msgbuf);
+    Ns_Free(buf);
+
+    return 1;
+}
+/*}}}*/
+
+/*{{{ error */
+/* For logging errors that come from C code rather than
+ * Oracle unhappiness.
+ */
+static void
+error(const char *file, int line, const char *fn, const char *fmt, ...)
+{
+    char *buf1;
+    char *buf;
+    va_list ap;
+
+    buf1 = (char *) Ns_Malloc(STACK_BUFFER_SIZE * sizeof(char));
+    buf = (char *) Ns_Malloc(STACK_BUFFER_SIZE * sizeof(char));
+
+    va_start(ap, fmt);
+    vsprintf(buf1, fmt, ap);
+    va_end(ap);
+
+    snprintf(buf, STACK_BUFFER_SIZE, "%s:%d:%s: %s", file, line, fn, buf1);
+
+    Ns_Log(Error, "%s", buf);
+
+    Ns_Free(buf1);
+    Ns_Free(buf);
+}
+/*}}}*/
+
+/*{{{ log */
+/*  For optional logging of all kinds of random stuff, turn on
+ *  debug in the [ns/db/driver/drivername] section of your nsd.ini
+ */
+static void
+ns_ora_log(const char *file, int line, const char *fn, const char *fmt, ...)
+{
+    char   *buf, *buf1;
+    va_list ap;
+
+    if (!debug_p) {
+        return;
+    }
+
+    buf1 = (char *) Ns_Malloc(STACK_BUFFER_SIZE * sizeof(char));
+    buf = (char *) Ns_Malloc(STACK_BUFFER_SIZE * sizeof(char));
+
+    va_start(ap, fmt);
+    vsprintf(buf1, fmt, ap);
+    va_end(ap);
+
+    snprintf(buf, STACK_BUFFER_SIZE, "%s:%d:%s: %s", file, line, fn, buf1);
+
+    Ns_Log(Notice, "%s", buf);
+
+    Ns_Free(buf1);
+    Ns_Free(buf);
+}
+/*}}}*/
+
+/*{{{ malloc_fetch_buffers*/
+/*
+ * malloc_fetch_buffers allocates the fetch_buffers array in the
+ * specified connection.  connection->n_columns must be set to the
+ * correct number before calling this function.
+ */
+static void
+malloc_fetch_buffers(ora_connection_t * connection)
+{
+    int i;
+
+    connection->fetch_buffers =
+        Ns_Malloc((size_t)connection->n_columns *
+                  sizeof *connection->fetch_buffers);
+
+    for (i = 0; i < connection->n_columns; i++) {
+        fetch_buffer_t *fetchbuf = &connection->fetch_buffers[i];
+
+        fetchbuf->connection = connection;
+
+        fetchbuf->type = 0;
+        fetchbuf->lob = NULL;
+        fetchbuf->bind = NULL;
+        fetchbuf->def = NULL;
+        fetchbuf->size = 0;
+        fetchbuf->buf_size = 0;
+        fetchbuf->buf = NULL;
+        fetchbuf->stmt = NULL;
+        fetchbuf->array_count = 0;
+        fetchbuf->array_values = NULL;
+        fetchbuf->is_null = 0;
+        fetchbuf->fetch_length = 0;
+        fetchbuf->piecewise_fetch_length = 0;
+        fetchbuf->piece_offset = 0;
+        fetchbuf->size_hint = 0;
+        fetchbuf->pooled = NS_FALSE;
+        fetchbuf->inout = 0;
+        fetchbuf->name = NULL;
+
+        fetchbuf->lobs = NULL;
+        fetchbuf->is_lob = 0;
+        fetchbuf->n_rows = 0;
+        fetchbuf->is_nulls = NULL;
+        fetchbuf->fetch_lengths = NULL;
+        fetchbuf->curele = 0;
+        fetchbuf->coll = NULL;
+    }
+
+}
+/*}}}*/
+
+/*{{{ fetch_buffer_free_buf*/
+/* Free the buffer of a fetch buffer, or give it back to the pool */
+static void
+fetch_buffer_free_buf(fetch_buffer_t * fetchbuf)
+{
+    if (fetchbuf->pooled) {
+        ora_buffer_put(fetchbuf->connection, fetchbuf->buf, fetchbuf->buf_size);
+        fetchbuf->pooled = NS_FALSE;
+    } else {
+        Ns_Free(fetchbuf->buf);
+    }
+    fetchbuf->buf = NULL;
+}
+/*}}}*/
+
+/*{{{ ora_buffer_get*/
+/* Get a buffer of at least size bytes for a dynamic OUT bind.  The
+   smallest fitting buffer of the pool is reused, else the largest one
+   is grown; *sizePtr is set to the size of the buffer. */
+static char *
+ora_buffer_get(ora_connection_t * connection, ub4 size, ub4 * sizePtr)
+{
+    int   i, best = -1, largest = -1;
+    char *buf;
+
+    for (i = 0; i < BUFFER_POOL_SIZE; i++) {
+        ub4 pool_size = connection->buffer_pool[i].size;
+
+        if (connection->buffer_pool[i].buf == NULL) {
+            continue;
+        }
+        if (pool_size >= size
+            && (best < 0 || pool_size < connection->buffer_pool[best].size)) {
+            best = i;
+        }
+        if (largest < 0 || pool_size > connection->buffer_pool[largest].size) {
+            largest = i;
+        }
+    }
+
+    if (best < 0 && largest >= 0) {
+        best = largest;
+        connection->buffer_pool[best].buf =
+            Ns_Realloc(connection->buffer_pool[best].buf, size);
+        connection->buffer_pool[best].size = size;
+    }
+    if (best >= 0) {
+        buf = connection->buffer_pool[best].buf;
+        *sizePtr = connection->buffer_pool[best].size;
+        connection->buffer_pool[best].buf = NULL;
+        connection->buffer_pool[best].size = 0u;
+    } else {
+        buf = Ns_Malloc(size);
+        *sizePtr = size;
+    }
+
+    return buf;
+}
+/*}}}*/
+
+/*{{{ ora_buffer_put*/
+/* Give a buffer back to the pool.  When the pool is full, the larger
+   buffers are kept; buffers above BUFFER_POOL_MAX are freed. */
+static void
+ora_buffer_put(ora_connection_t * connection, char *buf, ub4 size)
+{
+    int i, smallest = -1;
+
+    if (connection == NULL || size > BUFFER_POOL_MAX) {
+        Ns_Free(buf);
+        return;
+    }
+
+    for (i = 0; i < BUFFER_POOL_SIZE; i++) {
+        if (connection->buffer_pool[i].buf == NULL) {
+            smallest = i;
+            break;
+        }
+        if (smallest < 0
+            || connection->buffer_pool[i].size < connection->buffer_pool[smallest].size) {
+            smallest = i;
+        }
+    }
+
+    if (connection->buffer_pool[smallest].buf == NULL
+        || connection->buffer_pool[smallest].size < size) {
+        Ns_Free(connection->buffer_pool[smallest].buf);
+        connection->buffer_pool[smallest].buf = buf;
+        connection->buffer_pool[smallest].size = size;
+    } else {
+        Ns_Free(buf);
+    }
+}
+/*}}}*/
+
+/*{{{ ora_buffers_free*/
+static void
+ora_buffers_free(ora_connection_t * connection)
+{
+    int i;
+
+    for (i = 0; i < BUFFER_POOL_SIZE; i++) {
+        Ns_Free(connection->buffer_pool[i].buf);
+        connection->buffer_pool[i].buf = NULL;
+        connection->buffer_pool[i].size = 0u;
+    }
+}
+/*}}}*/
+
+/*{{{ free_fetch_buffers*/
+/*
+ * free_fetch_buffers frees the fetch_buffers array in the specified
+ * connection.  connection->n_columns must have the same value as it
+ * did when malloc_fetch_buffers was called.  The non-NULL
+ * dynamically-allocated components of each fetchbuf will also be freed.
+ */
+static void
+free_fetch_buffers(ora_connection_t * connection)
+{
+    if (connection != NULL && connection->fetch_buffers != NULL) {
+        Ns_DbHandle *dbh = connection->dbh;
+        int i;
+        unsigned int j;
+        oci_status_t oci_status;
+
+        for (i = 0; i < connection->n_columns; i++) {
+            fetch_buffer_t *fetchbuf = &connection->fetch_buffers[i];
+
+            if (fetchbuf->lob != NULL) {
+                oci_status =
+                    OCIDescriptorFree(fetchbuf->lob, OCI_DTYPE_LOB);
+                oci_error_p(lexpos(), dbh, "OCIDescriptorFree", 0,
+                            oci_status);
+                fetchbuf->lob = NULL;
+            }
+
+            /* REF CURSOR of ns_ora plsql */
+            if (fetchbuf->stmt != NULL) {
+                oci_status = OCIHandleFree(fetchbuf->stmt, OCI_HTYPE_STMT);
+                oci_error_p(lexpos(), dbh, "OCIHandleFree", 0, oci_status);
+                fetchbuf->stmt = NULL;
+            }
+
+            /* array bind of ns_ora plsql -arrays */
+            Ns_Free(fetchbuf->is_nulls);
+            fetchbuf->is_nulls = NULL;
+            Ns_Free(fetchbuf->fetch_lengths);
+            fetchbuf->fetch_lengths = NULL;
+            fetch_buffer_free_coll(fetchbuf);
+
+            /*
+             * fetchbuf->bind is automatically deallocated when its
+             * statement is deallocated.
+             *
+             * Same for fetchbuf->def, I believe, though the manual
+             * doesn't say.
+             */
+
+            if (fetchbuf->buf != NULL) {
+                fetch_buffer_free_buf(fetchbuf);
+                fetchbuf->buf_size = 0;
+            }
+
+            if (fetchbuf->array_values != NULL) {
+                /* allocated from Tcl_SplitList so Tcl_Free it */
+                Tcl_Free((char *) fetchbuf->array_values);
+                fetchbuf->array_values = NULL;
+                fetchbuf->array_count = 0;
+            }
+
+            if (fetchbuf->lobs != 0) {
+                for (j = 0; j < fetchbuf->n_rows; j++) {
+                    oci_status = OCIDescriptorFree(fetchbuf->lobs[j],
+                                                   OCI_DTYPE_LOB);
+                    oci_error_p(lexpos(), dbh, "OCIDescriptorFree", 0,
+                                oci_status);
+                }
+                Ns_Free(fetchbuf->lobs);
+                fetchbuf->lobs = NULL;
+                fetchbuf->n_rows = 0;
+            }
+        }
+
+        Ns_Free(connection->fetch_buffers);
+        connection->fetch_buffers = NULL;
+    }
+}
+/*}}}*/
+
+/*{{{ ora_object_new*/
+/* Register a driver object (e.g. a LOB writer) with the connection.
+   Unless handle is NULL, its id starts with the name of the db handle,
+   so the handle can be found from the id alone. */
+static ora_object_t *
+ora_object_new(ora_connection_t * connection, const char *handle,
+               int type, const char *prefix, void *data,
+               ora_object_free_proc * free_proc)
+{
+    ora_object_t *object;
+    Tcl_Obj      *idObj;
+    int           new;
+
+    if (handle != NULL) {
+        idObj = Tcl_ObjPrintf("%s.%s%lu", handle, prefix,
+                              ++connection->object_serial);
+    } else {
+        idObj = Tcl_ObjPrintf("%s%lu", prefix, ++connection->object_serial);
+    }
+    Tcl_IncrRefCount(idObj);
+
+    object = Ns_Malloc(sizeof(ora_object_t));
+    object->connection = connection;
+    object->type = type;
+    object->data = data;
+    object->free_proc = free_proc;
+    object->hPtr = Tcl_CreateHashEntry(&connection->objects,
+                                       Tcl_GetString(idObj), &new);
+    Tcl_SetHashValue(object->hPtr, object);
+    Tcl_DecrRefCount(idObj);
+
+    return object;
+}
+/*}}}*/
+
+/*{{{ ora_object_id*/
+static Tcl_Obj *
+ora_object_id(ora_object_t * object)
+{
+    return Tcl_NewStringObj(Tcl_GetHashKey(&object->connection->objects,
+                                           object->hPtr), -1);
+}
+/*}}}*/
+
+/*{{{ ora_object_get*/
+/* Find the driver object of the given type by its id.  Leaves an error
+   message in the interpreter when there is none. */
+static ora_object_t *
+ora_object_get(Tcl_Interp * interp, Tcl_Obj * idObj, int type,
+               const char *what)
+{
+    const char       *id = Tcl_GetString(idObj);
+    const char       *dot = strrchr(id, '.');
+    ora_connection_t *connection;
+    ora_object_t     *object = NULL;
+    Tcl_HashEntry    *hPtr;
+    Ns_DbHandle      *dbh;
+    Tcl_DString       ds;
+
+    if (dot != NULL) {
+        Tcl_DStringInit(&ds);
+        Tcl_DStringAppend(&ds, id, (TCL_SIZE_T)(dot - id));
+        if (Ns_TclDbGetHandle(interp, Tcl_DStringValue(&ds), &dbh) == TCL_OK
+            && Ns_DbDriverName(dbh) == ora_driver_name
+            && dbh->connection != NULL) {
+            connection = dbh->connection;
+            hPtr = Tcl_FindHashEntry(&connection->objects, id);
+            if (hPtr != NULL) {
+                object = Tcl_GetHashValue(hPtr);
+                if (object->type != type) {
+                    object = NULL;
+                }
+            }
+        }
+        Tcl_DStringFree(&ds);
+    }
+
+    if (object == NULL) {
+        Tcl_ResetResult(interp);
+        Tcl_AppendResult(interp, "invalid ", what, " id \"", id, "\"",
+                         (char*)0L);
+    }
+
+    return object;
+}
+/*}}}*/
+
+/*{{{ ora_object_free*/
+static void
+ora_object_free(ora_object_t * object)
+{
+    Tcl_DeleteHashEntry(object->hPtr);
+    (*object->free_proc)(object->connection, object->data);
+    Ns_Free(object);
+}
+/*}}}*/
+
+/*{{{ ora_objects_free_all*/
+/* Free the driver objects of a connection; they don't survive the
+   release of the handle. */
+static void
+ora_objects_free_all(ora_connection_t * connection)
+{
+    Tcl_HashEntry  *hPtr;
+    Tcl_HashSearch  search;
+
+    while ((hPtr = Tcl_FirstHashEntry(&connection->objects, &search)) != NULL) {
+        ora_object_free(Tcl_GetHashValue(hPtr));
+    }
+}
+/*}}}*/
+
+/*{{{ ora_objects_free_type*/
+static void
+ora_objects_free_type(ora_connection_t * connection, int type)
+{
+    Tcl_HashEntry  *hPtr;
+    Tcl_HashSearch  search;
+    ora_object_t   *object;
+
+    for (hPtr = Tcl_FirstHashEntry(&connection->objects, &search);
+         hPtr != NULL; hPtr = Tcl_NextHashEntry(&search)) {
+        object = Tcl_GetHashValue(hPtr);
+        if (object->type == type) {
+            ora_object_free(object);
+        }
+    }
+}
+/*}}}*/
+
+/*{{{ lob_token_new*/
+/* Register a copy of a fetched LOB locator and return its token, for
+   rows fetched in LazyLobs mode. */
+static const char *
+lob_token_new(Ns_DbHandle * dbh, OCILobLocator * lob, int blob_p)
+{
+    ora_connection_t *connection = dbh->connection;
+    oci_status_t      oci_status;
+    lob_token_t      *token;
+    ora_object_t     *object;
+
+    token = Ns_Malloc(sizeof(lob_token_t));
+    token->lob = NULL;
+    token->blob_p = blob_p;
+
+    oci_status = OCIDescriptorAlloc(connection->env,
+                                    (oci_descriptor_t *) & token->lob,
+                                    OCI_DTYPE_LOB, 0, 0);
+    if (oci_error_p(lexpos(), dbh, "OCIDescriptorAlloc", 0, oci_status)) {
+        Ns_Free(token);
+        return NULL;
+    }
+
+    oci_status = OCILobLocatorAssign(connection->svc, connection->err,
+                                     lob, &token->lob);
+    if (oci_error_p(lexpos(), dbh, "OCILobLocatorAssign", 0, oci_status)) {
+        OCIDescriptorFree(token->lob, OCI_DTYPE_LOB);
+        Ns_Free(token);
+        return NULL;
+    }
+
+    object = ora_object_new(connection, NULL, ORA_OBJECT_LOB_TOKEN,
+                            "lobtoken", token, lob_token_free);
+
+    return Tcl_GetHashKey(&connection->objects, object->hPtr);
+}
+/*}}}*/
+
+/*{{{ lob_token_free*/
+static void
+lob_token_free(ora_connection_t * connection, void *data)
+{
+    lob_token_t  *token = data;
+    oci_status_t  oci_status;
+
+    oci_status = OCIDescriptorFree(token->lob, OCI_DTYPE_LOB);
+    oci_error_p(lexpos(), connection->dbh, "OCIDescriptorFree", 0, oci_status);
+    Ns_Free(token);
+}
+/*}}}*/
+
+/*{{{ lob_read_obj*/
+/* Read a LOB, or length characters (bytes for BLOBs) of it starting at
+   offset, into a new Tcl object; a byte array for BLOBs.  A length of
+   zero reads up to the end. */
+static Tcl_Obj *
+lob_read_obj(Tcl_Interp * interp, Ns_DbHandle * dbh, OCILobLocator * lob,
+             int blob_p, oraub8 offset, oraub8 length)
+{
+    ora_connection_t *connection = dbh->connection;
+    oci_status_t      oci_status;
+    oraub8            byte_amt, char_amt;
+    ub1               piece = OCI_FIRST_PIECE;
+    ub1              *bufp;
+    Tcl_DString       ds;
+    Tcl_Obj          *valueObj;
+
+    byte_amt = blob_p ? length : 0u;
+    char_amt = blob_p ? 0u : length;
+
+    bufp = Ns_Malloc(lob_buffer_size);
+    Tcl_DStringInit(&ds);
+
+    do {
+        oci_status = OCILobRead2(connection->svc, connection->err,
+                                 lob, &byte_amt, &char_amt,
+                                 offset + 1u, bufp, lob_buffer_size,
+                                 piece, NULL, NULL, 0, SQLCS_IMPLICIT);
+        if (oci_status == OCI_NO_DATA) {
+            /* offset beyond the end */
+            break;
+        }
+        if (oci_status != OCI_NEED_DATA
+            && tcl_error_p(lexpos(), interp, dbh, "OCILobRead2", 0, oci_status)) {
+            if (piece != OCI_FIRST_PIECE && dbh->connection != NULL) {
+                connection->lob_read_pending = NS_TRUE;
+            }
+            Tcl_DStringFree(&ds);
+            Ns_Free(bufp);
+            return NULL;
+        }
+        piece = OCI_NEXT_PIECE;
+        Tcl_DStringAppend(&ds, (char *)bufp, (TCL_SIZE_T)byte_amt);
+    } while (oci_status == OCI_NEED_DATA);
+
+    Ns_Free(bufp);
+
+    if (blob_p) {
+        valueObj = Tcl_NewByteArrayObj((unsigned char *)Tcl_DStringValue(&ds),
+                                       Tcl_DStringLength(&ds));
+    } else {
+        valueObj = Tcl_NewStringObj(Tcl_DStringValue(&ds),
+                                    Tcl_DStringLength(&ds));
+    }
+    Tcl_DStringFree(&ds);
+
+    return valueObj;
+}
+/*}}}*/
+
+/*{{{ lob_value_bytes*/
+/* The bytes to write into a LOB for a Tcl value: the bytes of a byte
+   array for BLOBs, the UTF-8 string otherwise.  Values that are not
+   pure byte arrays are written as strings, like they always were. */
+static const char *
+lob_value_bytes(Tcl_Obj * valueObj, int blob_p, TCL_SIZE_T * lengthPtr)
+{
+    if (blob_p && byte_array_type != NULL
+        && valueObj->typePtr == byte_array_type) {
+        return (const char *)Tcl_GetByteArrayFromObj(valueObj, lengthPtr);
+    }
+
+    return Tcl_GetStringFromObj(valueObj, lengthPtr);
+}
+/*}}}*/
+
+/*{{{ ora_rows_fetch*/
+/* Fetch the rows of the bound statement of [ns_ora rows] into a list
+   of dicts.  RAW columns were defined as SQLT_BIN and BLOBs were left
+   unread by Ns_OracleGetRow, both become byte arrays here. */
+static int
+ora_rows_fetch(Tcl_Interp * interp, Ns_DbHandle * dbh, Ns_Set * row)
+{
+    ora_connection_t *connection = dbh->connection;
+    Tcl_Obj          *rowsObj, *rowObj, *valueObj;
+    int               i, status;
+
+    rowsObj = Tcl_NewListObj(0, NULL);
+
+    while ((status = Ns_OracleGetRow(dbh, row)) == NS_OK) {
+        rowObj = Tcl_NewDictObj();
+
+        for (i = 0; i < connection->n_columns; i++) {
+            fetch_buffer_t *fetchbuf = &connection->fetch_buffers[i];
+
+            if (fetchbuf->is_null == -1) {
+                valueObj = Tcl_NewObj();
+            } else if (fetchbuf->type == SQLT_BIN) {
+                valueObj = Tcl_NewByteArrayObj((unsigned char *)fetchbuf->buf,
+                                               fetchbuf->fetch_length);
+            } else if (fetchbuf->type == OCI_TYPECODE_BLOB
+                       && !connection->lazy_lobs) {
+                valueObj = lob_read_obj(interp, dbh, fetchbuf->lob,
+                                        NS_TRUE, 0u, 0u);
+                if (valueObj == NULL) {
+                    Tcl_DecrRefCount(rowObj);
+                    Tcl_DecrRefCount(rowsObj);
+                    Ns_OracleFlush(dbh);
+                    return TCL_ERROR;
+                }
+            } else {
+                valueObj = Tcl_NewStringObj(Ns_SetValue(row, i), -1);
+            }
+            Tcl_DictObjPut(NULL, rowObj,
+                           Tcl_NewStringObj(Ns_SetKey(row, i), -1), valueObj);
+        }
+
+        Tcl_ListObjAppendElement(NULL, rowsObj, rowObj);
+    }
+
+    if (status != NS_END_DATA) {
+        Tcl_DecrRefCount(rowsObj);
+        Tcl_SetResult(interp, dbh->dsExceptionMsg.string, TCL_VOLATILE);
+        return TCL_ERROR;
+    }
+
+    Tcl_SetObjResult(interp, rowsObj);
+
+    return TCL_OK;
+}
+/*}}}*/
+
+/*{{{ ora_cursor_define*/
+/* Define the columns of an executed query, a REF CURSOR say, into fetch
+   buffers of their own holding array_size rows, so that many rows come
+   with one round trip.  Returns the buffers, to be freed with
+   ora_cursor_free(), or NULL with the error in interp. */
+static fetch_buffer_t *
+ora_cursor_define(Tcl_Interp * interp, Ns_DbHandle * dbh, OCIStmt * stmt,
+                  ub4 array_size, const char *query, int *n_columnsPtr)
+{
+    ora_connection_t *connection = dbh->connection;
+    fetch_buffer_t   *fetchbufs = NULL;
+    oci_status_t      oci_status;
+    ub4               n_columns = 0;
+    int               i, n = 0;
+
+    oci_status = OCIAttrGet(stmt, OCI_HTYPE_STMT,
+                            (oci_attribute_t *) & n_columns, NULL,
+                            OCI_ATTR_PARAM_COUNT, connection->err);
+    if (tcl_error_p(lexpos(), interp, dbh, "OCIAttrGet", query, oci_status)) {
+        return NULL;
+    }
+
+    n = (int) n_columns;
+    fetchbufs = ns_calloc((size_t) n + 1u, sizeof *fetchbufs);
+
+    for (i = 0; i < n; i++) {
+        fetch_buffer_t *fetchbuf = &fetchbufs[i];
+        OCIParam       *param;
+        char           *name = NULL;
+        ub4             name_size = 0, j;
+
+        fetchbuf->connection = connection;
+
+        oci_status = OCIParamGet(stmt, OCI_HTYPE_STMT, connection->err,
+                                 (oci_param_t *) & param, (ub4)i + 1);
+        if (tcl_error_p(lexpos(), interp, dbh, "OCIParamGet", query, oci_status)) {
+            goto bailout;
+        }
+        oci_status = OCIAttrGet(param, OCI_DTYPE_PARAM,
+                                (oci_attribute_t *) & name, &name_size,
+                                OCI_ATTR_NAME, connection->err);
+        if (oci_status == OCI_SUCCESS) {
+            oci_status = OCIAttrGet(param, OCI_DTYPE_PARAM,
+                                    (oci_attribute_t *) & fetchbuf->type, NULL,
+                                    OCI_ATTR_DATA_TYPE, connection->err);
+        }
+        if (oci_status == OCI_SUCCESS) {
+            oci_status = OCIAttrGet(param, OCI_DTYPE_PARAM,
+                                    (oci_attribute_t *) & fetchbuf->size, NULL,
+                                    OCI_ATTR_DATA_SIZE, connection->err);
+        }
+        if (tcl_error_p(lexpos(), interp, dbh, "OCIAttrGet", query, oci_status)) {
+            OCIDescriptorFree(param, OCI_DTYPE_PARAM);
+            goto bailout;
+        }
+
+        /* lower case, as the column names of Ns_OracleBindRow */
+        fetchbuf->name = Ns_Malloc(name_size + 1);
+        memcpy(fetchbuf->name, name, name_size);
+        fetchbuf->name[name_size] = '\0';
+        downcase(fetchbuf->name);
+        OCIDescriptorFree(param, OCI_DTYPE_PARAM);
+
+        fetchbuf->is_nulls = ns_calloc(array_size, sizeof *fetchbuf->is_nulls);
+        fetchbuf->fetch_lengths = ns_calloc(array_size, sizeof *fetchbuf->fetch_lengths);
+
+        switch (fetchbuf->type) {
+        case OCI_TYPECODE_CLOB:
+        case OCI_TYPECODE_BLOB:
+            fetchbuf->lobs = ns_calloc(array_size, sizeof *fetchbuf->lobs);
+            fetchbuf->n_rows = array_size;
+            for (j = 0; j < fetchbuf->n_rows; j++) {
+                oci_status = OCIDescriptorAlloc(connection->env,
+                                                (oci_descriptor_t *) & fetchbuf->lobs[j],
+                                                OCI_DTYPE_LOB, 0, 0);
+                if (tcl_error_p(lexpos(), interp, dbh, "OCIDescriptorAlloc",
+                                query, oci_status)) {
+                    goto bailout;
+                }
+            }
+            oci_status = OCIDefineByPos(stmt, &fetchbuf->def, connection->err,
+                                        (ub4)i + 1,
+                                        fetchbuf->lobs,
+                                        (sb4) sizeof(OCILobLocator *),
+                                        fetchbuf->type,
+                                        fetchbuf->is_nulls,
+                                        0, 0, OCI_DEFAULT);
+            if (tcl_error_p(lexpos(), interp, dbh, "OCIDefineByPos", query, oci_status)) {
+                goto bailout;
+            }
+            continue;
+
+        case SQLT_LNG:
+            Tcl_AppendResult(interp, "LONG column ", fetchbuf->name,
+                             " is not supported here", (char*)0L);
+            goto bailout;
+
+        case SQLT_RDD:
+            fetchbuf->buf_size = 18 + 8;
+            break;
+
+        case SQLT_NUM:
+            /* see Ns_OracleBindRow */
+            fetchbuf->buf_size = 81 + 8;
+            break;
+
+        case SQLT_DAT:
+            fetchbuf->buf_size = 20 + 8;
+            break;
+
+        case SQLT_TIMESTAMP:
+            fetchbuf->buf_size = 26 + 8;
+            break;
+
+        case SQLT_TIMESTAMP_TZ:
+            fetchbuf->buf_size = 33 + 8;
+            break;
+
+        case SQLT_BIN:
+            /* fetched as hex */
+            fetchbuf->buf_size = fetchbuf->size * 2u + 8u;
+            break;
+
+        default:
+            fetchbuf->buf_size = (fetchbuf->size + 8u) * (unsigned int)char_expansion;
+            break;
+        }
+
+        fetchbuf->buf = Ns_Malloc((size_t)fetchbuf->buf_size * array_size);
+
+        oci_status = OCIDefineByPos(stmt, &fetchbuf->def, connection->err,
+                                    (ub4)i + 1,
+                                    fetchbuf->buf,
+                                    (sb4)fetchbuf->buf_size,
+                                    SQLT_STR,
+                                    fetchbuf->is_nulls,
+                                    fetchbuf->fetch_lengths,
+                                    0, OCI_DEFAULT);
+        if (tcl_error_p(lexpos(), interp, dbh, "OCIDefineByPos", query, oci_status)) {
+            goto bailout;
+        }
+    }
+
+    *n_columnsPtr = n;
+
+    return fetchbufs;
+
+  bailout:
+    ora_cursor_free(dbh, fetchbufs, n);
+
+    return NULL;
+}
+/*}}}*/
+
+/*{{{ ora_cursor_row*/
+/* The row of the current batch of ora_cursor_define() buffers as a dict
+   of column names and values.  Returns NULL with the error in interp. */
+static Tcl_Obj *
+ora_cursor_row(Tcl_Interp * interp, Ns_DbHandle * dbh,
+               fetch_buffer_t * fetchbufs, int n_columns, ub4 row)
+{
+    Tcl_Obj *rowObj, *valueObj;
+    int      i;
+
+    rowObj = Tcl_NewDictObj();
+
+    for (i = 0; i < n_columns; i++) {
+        fetch_buffer_t *fetchbuf = &fetchbufs[i];
+
+        if (fetchbuf->is_nulls[row] == -1) {
+            valueObj = Tcl_NewObj();
+        } else if (fetchbuf->lobs != NULL) {
+            valueObj = lob_read_obj(interp, dbh, fetchbuf->lobs[row],
+                                    fetchbuf->type == OCI_TYPECODE_BLOB,
+                                    0u, 0u);
+            if (valueObj == NULL) {
+                Tcl_DecrRefCount(rowObj);
+                return NULL;
+            }
+        } else {
+            valueObj = Tcl_NewStringObj(fetchbuf->buf + row * fetchbuf->buf_size,
+                                        fetchbuf->fetch_lengths[row]);
+        }
+        Tcl_DictObjPut(NULL, rowObj,
+                       Tcl_NewStringObj(fetchbuf->name, TCL_INDEX_NONE),
+                       valueObj);
+    }
+
+    return rowObj;
+}
+/*}}}*/
+
+/*{{{ ora_cursor_rows*/
+/* Fetch all rows of a REF CURSOR of [ns_ora plsql -cursors] into a list
+   of dicts, as [ns_ora rows] does, array_size rows per round trip.
+   Returns NULL with the error in interp. */
+static Tcl_Obj *
+ora_cursor_rows(Tcl_Interp * interp, Ns_DbHandle * dbh, OCIStmt * stmt,
+                ub4 array_size, const char *query)
+{
+    ora_connection_t *connection = dbh->connection;
+    fetch_buffer_t   *fetchbufs;
+    Tcl_Obj          *rowsObj, *rowObj;
+    oci_status_t      oci_status;
+    ub4               rows_fetched = 0, row, rows_done = 0;
+    int               n = 0, end_p = NS_FALSE;
+
+    fetchbufs = ora_cursor_define(interp, dbh, stmt, array_size, query, &n);
+    if (fetchbufs == NULL) {
+        return NULL;
+    }
+
+    rowsObj = Tcl_NewListObj(0, NULL);
+
+    while (!end_p) {
+        oci_status = OCIStmtFetch(stmt, connection->err, array_size,
+                                  OCI_FETCH_NEXT, OCI_DEFAULT);
+        if (oci_status == OCI_NO_DATA) {
+            /* the last rows may still come with it */
+            end_p = NS_TRUE;
+        } else if (tcl_error_p(lexpos(), interp, dbh, "OCIStmtFetch", query, oci_status)) {
+            goto bailout;
+        }
+
+        /* the count is cumulative, over all fetches so far */
+        oci_status = OCIAttrGet(stmt, OCI_HTYPE_STMT,
+                                (oci_attribute_t *) & rows_fetched, NULL,
+                                OCI_ATTR_ROW_COUNT, connection->err);
+        if (tcl_error_p(lexpos(), interp, dbh, "OCIAttrGet", query, oci_status)) {
+            goto bailout;
+        }
+
+        for (row = 0; row < rows_fetched - rows_done; row++) {
+            rowObj = ora_cursor_row(interp, dbh, fetchbufs, n, row);
+            if (rowObj == NULL) {
+                goto bailout;
+            }
+            Tcl_ListObjAppendElement(NULL, rowsObj, rowObj);
+        }
+        rows_done = rows_fetched;
+    }
+
+    ora_cursor_free(dbh, fetchbufs, n);
+
+    return rowsObj;
+
+  bailout:
+    Tcl_DecrRefCount(rowsObj);
+    ora_cursor_free(dbh, fetchbufs, n);
+
+    return NULL;
+}
+/*}}}*/
+
+/*{{{ ora_cursor_free*/
+/* Free the fetch buffers of ora_cursor_define() */
+static void
+ora_cursor_free(Ns_DbHandle * dbh, fetch_buffer_t * fetchbufs, int n_columns)
+{
+    int i;
+    ub4 j;
+
+    for (i = 0; i < n_columns; i++) {
+        fetch_buffer_t *fetchbuf = &fetchbufs[i];
+
+        for (j = 0; j < fetchbuf->n_rows; j++) {
+            if (fetchbuf->lobs[j] != NULL) {
+                oci_error_p(lexpos(), dbh, "OCIDescriptorFree", 0,
+                            OCIDescriptorFree(fetchbuf->lobs[j], OCI_DTYPE_LOB));
+            }
+        }
+        Ns_Free(fetchbuf->lobs);
+        Ns_Free(fetchbuf->buf);
+        Ns_Free(fetchbuf->name);
+        Ns_Free(fetchbuf->is_nulls);
+        Ns_Free(fetchbuf->fetch_lengths);
+    }
+    Ns_Free(fetchbufs);
+}
+/*}}}*/
+
+/*{{{ ora_implicit_results*/
+/* Fetch the implicit results of an executed PL/SQL block, returned by
+   DBMS_SQL.RETURN_RESULT, into a list with the rows of each result as
+   ora_cursor_rows() fetches them.  Without OCI 12c client headers this
+   is an error.  Returns NULL with the error in interp. */
+static Tcl_Obj *
+ora_implicit_results(Tcl_Interp * interp, Ns_DbHandle * dbh, OCIStmt * stmt,
+                     const char *query)
+{
+#ifdef OCI_ATTR_IMPLICIT_RESULT_COUNT
+    Tcl_Obj          *resultsObj = Tcl_NewListObj(0, NULL);
+    ora_connection_t *connection = dbh->connection;
+    oci_status_t      oci_status;
+    Tcl_Obj          *rowsObj;
+    OCIStmt          *result;
+    ub4               count = 0, rtype;
+
+    oci_status = OCIAttrGet(stmt, OCI_HTYPE_STMT,
+                            (oci_attribute_t *) & count, NULL,
+                            OCI_ATTR_IMPLICIT_RESULT_COUNT, connection->err);
+    if (tcl_error_p(lexpos(), interp, dbh, "OCIAttrGet", query, oci_status)) {
+        Tcl_DecrRefCount(resultsObj);
+        return NULL;
+    }
+
+    ns_ora_log(lexpos(), "%u implicit results", count);
+
+    while (count > 0) {
+        oci_status = OCIStmtGetNextResult(stmt, connection->err,
+                                          (dvoid **) & result, &rtype,
+                                          OCI_DEFAULT);
+        if (oci_status == OCI_NO_DATA) {
+            break;
+        }
+        if (tcl_error_p(lexpos(), interp, dbh, "OCIStmtGetNextResult",
+                        query, oci_status)) {
+            Tcl_DecrRefCount(resultsObj);
+            return NULL;
+        }
+        if (rtype != OCI_RESULT_TYPE_SELECT) {
+            continue;
+        }
+
+        /* result belongs to stmt, it is freed along with it */
+        rowsObj = ora_cursor_rows(interp, dbh, result, CURSOR_FETCH_ROWS, query);
+        if (rowsObj == NULL) {
+            Tcl_DecrRefCount(resultsObj);
+            return NULL;
+        }
+        Tcl_ListObjAppendElement(NULL, resultsObj, rowsObj);
+    }
+
+    return resultsObj;
+#else
+    (void) dbh;
+    (void) stmt;
+    (void) query;
+    Tcl_AppendResult(interp, "implicit results need OCI 12c client headers",
+                     (char*)0L);
+    return NULL;
+#endif
+}
+/*}}}*/
+
+/*{{{ lob_select_locator*/
+/* Execute a query selecting one CLOB or BLOB and return its locator,
+   for lob_open and lob_channel.  The statement is done with when this
+   returns; the caller owns the locator. */
+static OCILobLocator *
+lob_select_locator(Tcl_Interp * interp, Ns_DbHandle * dbh,
+                   char *query, ub2 * typep)
+{
+    oci_status_t       oci_status;
+    ora_connection_t  *connection = dbh->connection;
+    OCILobLocator     *lob = NULL;
+    OCIDefine         *def;
+    OCIParam          *param;
+    ub2                type;
+
+    if (!allow_sql_p(dbh, query, NS_TRUE)) {
+        Tcl_AppendResult(interp, "SQL ", query, " has been rejected "
+                         "by the Oracle driver", (char*)0L);
+        return NULL;
+    }
+
+    Ns_Log(Debug, "SQL():  %s", query);
+
+    oci_status = OCIDescriptorAlloc(connection->env,
+                                    (dvoid **) & lob,
+                                    OCI_DTYPE_LOB, 0, 0);
+    if (tcl_error_p(lexpos(), interp, dbh, "OCIDescriptorAlloc",
+                    query, oci_status)) {
+        return NULL;
+    }
+
+    oci_status = OCIHandleAlloc(connection->env,
+                                (oci_handle_t **) & connection->stmt,
+                                OCI_HTYPE_STMT, 0, NULL);
+    if (tcl_error_p(lexpos(), interp, dbh, "OCIHandleAlloc", query, oci_status)) {
+        goto bailout;
+    }
+
+    oci_status = OCIStmtPrepare(connection->stmt,
+                                connection->err,
+                                (const OraText *)query,
+                                (ub4) strlen(query),
+                                OCI_NTV_SYNTAX, OCI_DEFAULT);
+    if (tcl_error_p(lexpos(), interp, dbh, "OCIStmtPrepare", query, oci_status)) {
+        goto bailout;
+    }
+
+    /* execute without fetching, to learn whether it is a CLOB or a BLOB */
+    oci_status = OCIStmtExecute(connection->svc,
+                                connection->stmt,
+                                connection->err,
+                                0, 0, 0, 0, OCI_DEFAULT);
+    if (tcl_error_p(lexpos(), interp, dbh, "OCIStmtExecute", query, oci_status)) {
+        goto bailout;
+    }
+
+    oci_status = OCIParamGet(connection->stmt, OCI_HTYPE_STMT,
+                             connection->err, (oci_param_t *) & param, 1);
+    if (tcl_error_p(lexpos(), interp, dbh, "OCIParamGet", query, oci_status)) {
+        goto bailout;
+    }
+    oci_status = OCIAttrGet(param, OCI_DTYPE_PARAM,
+                            (oci_attribute_t *) & type, NULL,
+                            OCI_ATTR_DATA_TYPE, connection->err);
+    OCIDescriptorFree(param, OCI_DTYPE_PARAM);
+    if (tcl_error_p(lexpos(), interp, dbh, "OCIAttrGet", query, oci_status)) {
+        goto bailout;
+    }
+    if (type != SQLT_CLOB && type != SQLT_BLOB) {
+        Tcl_AppendResult(interp, "query does not select a CLOB or BLOB: ",
+                         query, (char*)0L);
+        goto bailout;
+    }
+
+    oci_status = OCIDefineByPos(connection->stmt,
+                                &def,
+                                connection->err,
+                                1,
+                                &lob,
+                                -1,
+                                type,
+                                0, 0, 0, OCI_DEFAULT);
+    if (tcl_error_p(lexpos(), interp, dbh, "OCIDefineByPos", query, oci_status)) {
+        goto bailout;
+    }
+
+    oci_status = OCIStmtFetch(connection->stmt, connection->err,
+                              1, OCI_FETCH_NEXT, OCI_DEFAULT);
+    if (oci_status == OCI_NO_DATA) {
+        Tcl_AppendResult(interp, "query returned no rows: ", query, (char*)0L);
+        goto bailout;
+    }
+    if (tcl_error_p(lexpos(), interp, dbh, "OCIStmtFetch", query, oci_status)) {
+        goto bailout;
+    }
+
+    Ns_OracleFlush(dbh);
+    *typep = type;
+
+    return lob;
+
+  bailout:
+    OCIDescriptorFree(lob, OCI_DTYPE_LOB);
+    Ns_OracleFlush(dbh);
+
+    return NULL;
+}
+/*}}}*/
+
+/*{{{ lob_chunks_per_buffer*/
+/* The size of a buffer of whole LOB chunks, at least LobBufferSize */
+static ub4
+lob_chunks_per_buffer(ora_connection_t * connection, OCILobLocator * lob)
+{
+    oci_status_t oci_status;
+    ub4          chunk_size = 0;
+
+    oci_status = OCILobGetChunkSize(connection->svc, connection->err,
+                                    lob, &chunk_size);
+    oci_error_p(lexpos(), connection->dbh, "OCILobGetChunkSize", 0, oci_status);
+    if (chunk_size == 0u) {
+        chunk_size = lob_buffer_size;
+    }
+
+    return ((lob_buffer_size + chunk_size - 1u) / chunk_size) * chunk_size;
+}
+/*}}}*/
+
+/*{{{ lob_channel_release*/
+/* Release the LOB of a channel.  This is called when the channel is
+   closed or the db handle is released, whichever comes first; in the
+   latter case the channel stays, but reading fails. */
+static void
+lob_channel_release(ora_connection_t * connection, void *data)
+{
+    lob_channel_t *state = data;
+    oci_status_t   oci_status;
+
+    oci_status = OCIDescriptorFree(state->lob, OCI_DTYPE_LOB);
+    oci_error_p(lexpos(), connection->dbh, "OCIDescriptorFree", 0, oci_status);
+
+    state->lob = NULL;
+    state->connection = NULL;
+    state->object = NULL;
+}
+/*}}}*/
+
+/*{{{ lob_channel_input*/
+static int
+lob_channel_input(ClientData instanceData, char *buf, int toRead,
+                  int *errorCodePtr)
+{
+    lob_channel_t *state = instanceData;
+    oraub8         byte_amt, char_amt = 0;
+    oci_status_t   oci_status;
+
+    if (state->connection == NULL) {
+        *errorCodePtr = EBADF;
+        return -1;
+    }
+    if (state->offset > state->length || toRead <= 0) {
+        return 0;
+    }
+
+    /* For CLOBs, offsets count characters, but the amount is limited
+       by the buffer size in bytes; OCI reads whole characters only. */
+    byte_amt = (oraub8)toRead;
+    oci_status = OCILobRead2(state->connection->svc,
+                             state->connection->err,
+                             state->lob, &byte_amt, &char_amt,
+                             state->offset, buf, (oraub8)toRead,
+                             OCI_ONE_PIECE, NULL, NULL, 0, SQLCS_IMPLICIT);
+    if (oci_error_p(lexpos(), state->connection->dbh, "OCILobRead2", 0,
+                    oci_status)) {
+        *errorCodePtr = EIO;
+        return -1;
+    }
+
+    state->offset += state->blob_p ? byte_amt : char_amt;
+
+    return (int)byte_amt;
+}
+/*}}}*/
+
+/*{{{ lob_channel_close*/
+static int
+lob_channel_close(ClientData instanceData, Tcl_Interp *UNUSED(interp),
+                  int flags)
+{
+    lob_channel_t *state = instanceData;
+
+    if ((flags & (TCL_CLOSE_READ | TCL_CLOSE_WRITE)) != 0) {
+        return EINVAL;
+    }
+    if (state->timer != NULL) {
+        Tcl_DeleteTimerHandler(state->timer);
+    }
+    if (state->object != NULL) {
+        ora_object_free(state->object);
+    }
+    Ns_Free(state);
+
+    return 0;
+}
+/*}}}*/
+
+/*{{{ lob_channel_notify*/
+static void
+lob_channel_notify(ClientData clientData)
+{
+    lob_channel_t *state = clientData;
+
+    state->timer = NULL;
+    Tcl_NotifyChannel(state->chan, TCL_READABLE);
+}
+/*}}}*/
+
+/*{{{ lob_channel_watch*/
+/* The LOB is always readable, so fileevents fire from a timer. */
+static void
+lob_channel_watch(ClientData instanceData, int mask)
+{
+    lob_channel_t *state = instanceData;
+
+    if ((mask & TCL_READABLE) != 0) {
+        if (state->timer == NULL) {
+            state->timer = Tcl_CreateTimerHandler(0, lob_channel_notify, state);
+        }
+    } else if (state->timer != NULL) {
+        Tcl_DeleteTimerHandler(state->timer);
+        state->timer = NULL;
+    }
+}
+/*}}}*/
+
+/*{{{ lob_channel_block_mode*/
+static int
+lob_channel_block_mode(ClientData UNUSED(instanceData), int UNUSED(mode))
+{
+    return 0;
+}
+/*}}}*/
+
+/*{{{ lob_writer_flush*/
+/* Append the buffered data of a LOB writer to the LOB.  Unless this
+   is the final flush, an incomplete UTF-8 character at the end of the
+   buffer of a CLOB is kept for the next write. */
+static int
+lob_writer_flush(Tcl_Interp * interp, ora_connection_t * connection,
+                 lob_writer_t * writer, int final_p)
+{
+    oraub8       byte_amt, char_amt = 0;
+    size_t       n = writer->fill;
+    oci_status_t oci_status;
+
+    if (!writer->blob_p && !final_p && n > 0u) {
+        const unsigned char *p = (unsigned char *)writer->buf;
+        size_t start = n - 1u, need;
+
+        while (start > 0u && (p[start] & 0xC0) == 0x80) {
+            start--;
+        }
+        need = (p[start] >= 0xF0) ? 4u : (p[start] >= 0xE0) ? 3u
+             : (p[start] >= 0xC0) ? 2u : 1u;
+        if (start + need > n) {
+            n = start;
+        }
+    }
+
+    if (n == 0u) {
+        return NS_OK;
+    }
+
+    byte_amt = n;
+    oci_status = OCILobWriteAppend2(connection->svc, connection->err,
+                                    writer->lob, &byte_amt, &char_amt,
+                                    writer->buf, (oraub8)n, OCI_ONE_PIECE,
+                                    NULL, NULL, 0, SQLCS_IMPLICIT);
+    if (tcl_error_p(lexpos(), interp, connection->dbh, "OCILobWriteAppend2",
+                    0, oci_status)) {
+        return NS_ERROR;
+    }
+
+    writer->length += n;
+    writer->fill -= n;
+    if (writer->fill > 0u) {
+        memmove(writer->buf, writer->buf + n, writer->fill);
+    }
+
+    return NS_OK;
+}
+/*}}}*/
+
+/*{{{ lob_writer_free*/
+/* Free a LOB writer.  A writer that was not closed with lob_close is
+   abandoned: in autocommit mode its changes are rolled back, so they
+   are not committed by the next user of the handle. */
+static void
+lob_writer_free(ora_connection_t * connection, void *data)
+{
+    lob_writer_t *writer = data;
+    oci_status_t  oci_status;
+
+    if (writer->open_p) {
+        oci_status = OCILobClose(connection->svc, connection->err, writer->lob);
+        oci_error_p(lexpos(), connection->dbh, "OCILobClose", 0, oci_status);
+
+        if (connection->mode == autocommit) {
+            oci_status = OCITransRollback(connection->svc,
+                                          connection->err, OCI_DEFAULT);
+            oci_error_p(lexpos(), connection->dbh, "OCITransRollback", 0,
+                        oci_status);
+        }
+    }
+
+    oci_status = OCIDescriptorFree(writer->lob, OCI_DTYPE_LOB);
+    oci_error_p(lexpos(), connection->dbh, "OCIDescriptorFree", 0, oci_status);
+
+    Ns_Free(writer->buf);
+    Ns_Free(writer);
+}
+/*}}}*/
+
+/*{{{ ora_call_name_p*/
+/* The name given to [ns_ora call] goes into the generated block, so
+   only plain identifiers separated by dots are accepted. */
+static int
+ora_call_name_p(const char *name)
+{
+    const char *p;
+
+    if (*name == '\0' || *name == '.') {
+        return NS_FALSE;
+    }
+    for (p = name; *p != '\0'; p++) {
+        if (!isalnum((unsigned char)*p) && strchr("_$#.", *p) == NULL) {
+            return NS_FALSE;
+        }
+    }
+
+    return NS_TRUE;
+}
+/*}}}*/
+
+/*{{{ ora_call_lookup*/
+/* Find the signatures of a procedure in the call cache, describing it
+   on first use in the pool.  The entry is referenced until
+   ora_call_release(). */
+static ora_call_entry_t *
+ora_call_lookup(Tcl_Interp * interp, Ns_DbHandle * dbh, const char *name)
+{
+    ora_call_entry_t *entry = NULL, *newEntry;
+    Tcl_HashEntry    *hPtr;
+    Tcl_DString       key;
+    const char       *p;
+    int               isNew;
+
+    Tcl_DStringInit(&key);
+    Tcl_DStringAppend(&key, dbh->poolname, TCL_INDEX_NONE);
+    Tcl_DStringAppend(&key, "\t", 1);
+    for (p = name; *p != '\0'; p++) {
+        char c = (char)toupper((unsigned char)*p);
+
+        Tcl_DStringAppend(&key, &c, 1);
+    }
+
+    Ns_MutexLock(&call_cache.lock);
+    hPtr = Tcl_FindHashEntry(&call_cache.table, Tcl_DStringValue(&key));
+    if (hPtr != NULL) {
+        entry = Tcl_GetHashValue(hPtr);
+        entry->refcount++;
+    }
+    Ns_MutexUnlock(&call_cache.lock);
+
+    if (entry == NULL) {
+        newEntry = ora_call_describe(interp, dbh, name);
+        if (newEntry != NULL) {
+            Ns_MutexLock(&call_cache.lock);
+            hPtr = Tcl_CreateHashEntry(&call_cache.table,
+                                       Tcl_DStringValue(&key), &isNew);
+            if (isNew) {
+                newEntry->hPtr = hPtr;
+                Tcl_SetHashValue(hPtr, newEntry);
+                entry = newEntry;
+                newEntry = NULL;
+            } else {
+                entry = Tcl_GetHashValue(hPtr);
+            }
+            entry->refcount++;
+            Ns_MutexUnlock(&call_cache.lock);
+
+            if (newEntry != NULL) {
+                /* described concurrently by another thread */
+                ora_call_entry_free(newEntry);
+            }
+        }
+    }
+    Tcl_DStringFree(&key);
+
+    return entry;
+}
+/*}}}*/
+
+/*{{{ ora_call_release*/
+/* Drop a reference to a call cache entry.  With forget_p, the entry is
+   removed from the cache, to be described again on the next call. */
+static void
+ora_call_release(ora_call_entry_t * entry, int forget_p)
+{
+    int free_p;
+
+    Ns_MutexLock(&call_cache.lock);
+    if (forget_p && entry->hPtr != NULL) {
+        Tcl_DeleteHashEntry(entry->hPtr);
+        entry->hPtr = NULL;
+    }
+    free_p = (--entry->refcount == 0 && entry->hPtr == NULL);
+    Ns_MutexUnlock(&call_cache.lock);
+
+    if (free_p) {
+        ora_call_entry_free(entry);
+    }
+}
+/*}}}*/
+
+/*{{{ ora_call_entry_free*/
+static void
+ora_call_entry_free(ora_call_entry_t * entry)
+{
+    Tcl_HashSearch search;
+    Tcl_HashEntry *hPtr;
+    int            i, j;
+
+    for (i = 0; i < entry->n_sigs; i++) {
+        ora_call_sig_t *sig = &entry->sigs[i];
+
+        for (j = 0; j < sig->n_args; j++) {
+            Ns_Free(sig->args[j].name);
+        }
+        Ns_Free(sig->args);
+        if (sig->ret != NULL) {
+            Ns_Free(sig->ret->name);
+            Ns_Free(sig->ret);
+        }
+        for (hPtr = Tcl_FirstHashEntry(&sig->blocks, &search); hPtr != NULL;
+             hPtr = Tcl_NextHashEntry(&search)) {
+            Ns_Free(Tcl_GetHashValue(hPtr));
+        }
+        Tcl_DeleteHashTable(&sig->blocks);
+    }
+    Ns_Free(entry->sigs);
+    Ns_Free(entry->name);
+    Ns_Free(entry);
+}
+/*}}}*/
+
+/*{{{ ora_call_describe*/
+/* Describe a standalone procedure or function, or all overloads of a
+   packaged one, into a new call cache entry. */
+static ora_call_entry_t *
+ora_call_describe(Tcl_Interp * interp, Ns_DbHandle * dbh, const char *name)
+{
+    ora_connection_t *connection = dbh->connection;
+    ora_call_entry_t *entry;
+    oci_status_t      oci_status;
+    OCIDescribe      *desc;
+    OCIParam         *param, *argList, *procList, *proc;
+    const char       *dot = strrchr(name, '.');
+    ub1               ptype, public_p = 1;
+    ub2               n_procs, i;
+
+    oci_status = OCIHandleAlloc(connection->env, (dvoid *)&desc,
+                                OCI_HTYPE_DESCRIBE, 0, NULL);
+    if (tcl_error_p(lexpos(), interp, dbh, "OCIHandleAlloc", name, oci_status)) {
+        return NULL;
+    }
+    OCIAttrSet(desc, OCI_HTYPE_DESCRIBE, &public_p, 0,
+               OCI_ATTR_DESC_PUBLIC, connection->err);
+
+    entry = ns_calloc(1u, sizeof(ora_call_entry_t));
+    entry->name = Ns_StrDup(name);
+
+    param = ora_call_describe_object(connection, desc, name, &ptype);
+    if (param != NULL
+        && (ptype == OCI_PTYPE_PROC || ptype == OCI_PTYPE_FUNC)) {
+        if (OCIAttrGet(param, OCI_DTYPE_PARAM, &argList, 0,
+                       OCI_ATTR_LIST_ARGUMENTS, connection->err) == OCI_SUCCESS) {
+            ora_call_add_sig(connection, entry, argList);
+        }
+    } else if (dot != NULL) {
+        const char *proc_name = dot + 1;
+        Tcl_DString ds;
+
+        Tcl_DStringInit(&ds);
+        Tcl_DStringAppend(&ds, name, (TCL_SIZE_T)(dot - name));
+        param = ora_call_describe_object(connection, desc,
+                                         Tcl_DStringValue(&ds), &ptype);
+        Tcl_DStringFree(&ds);
+
+        if (param != NULL && ptype == OCI_PTYPE_PKG
+            && OCIAttrGet(param, OCI_DTYPE_PARAM, &procList, 0,
+                          OCI_ATTR_LIST_SUBPROGRAMS, connection->err) == OCI_SUCCESS
+            && OCIAttrGet(procList, OCI_DTYPE_PARAM, &n_procs, 0,
+                          OCI_ATTR_NUM_PARAMS, connection->err) == OCI_SUCCESS) {
+
+            for (i = 0; i < n_procs; i++) {
+                const char *sub_name;
+                ub4         sub_name_len = 0;
+
+                if (OCIParamGet(procList, OCI_DTYPE_PARAM, connection->err,
+                                (dvoid *)&proc, (ub4)i) != OCI_SUCCESS
+                    || OCIAttrGet(proc, OCI_DTYPE_PARAM, &sub_name, &sub_name_len,
+                                  OCI_ATTR_NAME, connection->err) != OCI_SUCCESS) {
+                    continue;
+                }
+                if (sub_name_len == strlen(proc_name)
+                    && Tcl_UtfNcasecmp(sub_name, proc_name, sub_name_len) == 0
+                    && OCIAttrGet(proc, OCI_DTYPE_PARAM, &argList, 0,
+                                  OCI_ATTR_LIST_ARGUMENTS,
+                                  connection->err) == OCI_SUCCESS) {
+                    ora_call_add_sig(connection, entry, argList);
+                }
+            }
+        }
+    }
+
+    OCIHandleFree(desc, OCI_HTYPE_DESCRIBE);
+
+    if (entry->n_sigs == 0) {
+        Tcl_AppendResult(interp, "procedure or function \"", name,
+                         "\" not found", (char*)0L);
+        ora_call_entry_free(entry);
+        return NULL;
+    }
+
+    return entry;
+}
+/*}}}*/
+
+/*{{{ ora_call_describe_object*/
+/* Describe a schema object by name, following synonyms.  Returns NULL
+   when the object does not exist. */
+static OCIParam *
+ora_call_describe_object(ora_connection_t * connection, OCIDescribe * desc,
+                         const char *name, ub1 * ptypep)
+{
+    OCIParam   *param = NULL;
+    Tcl_DString ds;
+    int         depth;
+
+    Tcl_DStringInit(&ds);
+    Tcl_DStringAppend(&ds, name, TCL_INDEX_NONE);
+
+    for (depth = 0; depth < 8; depth++) {
+        const char *syn_name, *syn_schema;
+        ub4         syn_name_len = 0, syn_schema_len = 0;
+
+        if (OCIDescribeAny(connection->svc, connection->err,
+                           (dvoid *)Tcl_DStringValue(&ds),
+                           (ub4)Tcl_DStringLength(&ds),
+                           OCI_OTYPE_NAME, (ub1) 0, OCI_PTYPE_UNK,
+                           desc) != OCI_SUCCESS
+            || OCIAttrGet(desc, OCI_HTYPE_DESCRIBE, &param, 0,
+                          OCI_ATTR_PARAM, connection->err) != OCI_SUCCESS
+            || OCIAttrGet(param, OCI_DTYPE_PARAM, ptypep, 0,
+                          OCI_ATTR_PTYPE, connection->err) != OCI_SUCCESS) {
+            param = NULL;
+            break;
+        }
+        if (*ptypep != OCI_PTYPE_SYN) {
+            break;
+        }
+
+        if (OCIAttrGet(param, OCI_DTYPE_PARAM, (dvoid *)&syn_name,
+                       &syn_name_len, OCI_ATTR_NAME,
+                       connection->err) != OCI_SUCCESS
+            || OCIAttrGet(param, OCI_DTYPE_PARAM, (dvoid *)&syn_schema,
+                          &syn_schema_len, OCI_ATTR_SCHEMA_NAME,
+                          connection->err) != OCI_SUCCESS) {
+            param = NULL;
+            break;
+        }
+        Tcl_DStringSetLength(&ds, 0);
+        if (syn_schema_len > 0u) {
+            Tcl_DStringAppend(&ds, syn_schema, (TCL_SIZE_T)syn_schema_len);
+            Tcl_DStringAppend(&ds, ".", 1);
+        }
+        Tcl_DStringAppend(&ds, syn_name, (TCL_SIZE_T)syn_name_len);
+        param = NULL;
+    }
+    Tcl_DStringFree(&ds);
+
+    return param;
+}
+/*}}}*/
+
+/*{{{ ora_call_add_sig*/
+/* Add the signature described by the argument list of a subprogram.
+   Position 0 is the return value of a function; a procedure without
+   arguments has a single entry without a name. */
+static void
+ora_call_add_sig(ora_connection_t * connection, ora_call_entry_t * entry,
+                 OCIParam * argList)
+{
+    ora_call_sig_t *sig;
+    OCIParam       *argParam;
+    ub2             n_params = 0;
+    ub4             i, found;
+
+    if (OCIAttrGet(argList, OCI_DTYPE_PARAM, &n_params, 0,
+                   OCI_ATTR_NUM_PARAMS, connection->err) != OCI_SUCCESS) {
+        return;
+    }
+
+    entry->sigs = Ns_Realloc(entry->sigs,
+                             (size_t)(entry->n_sigs + 1) * sizeof(ora_call_sig_t));
+    sig = &entry->sigs[entry->n_sigs++];
+    memset(sig, 0, sizeof(ora_call_sig_t));
+    sig->args = ns_calloc((size_t)n_params + 1u, sizeof(ora_call_arg_t));
+    Tcl_InitHashTable(&sig->blocks, TCL_STRING_KEYS);
+
+    for (i = 0u, found = 0u; found < n_params && i <= n_params; i++) {
+        const char       *name;
+        ub4               namelen = 0;
+        ub2               type = 0;
+        ub1               has_default = 0;
+        OCITypeParamMode  mode = OCI_TYPEPARAM_IN;
+        ora_call_arg_t   *arg;
+
+        if (OCIParamGet(argList, OCI_DTYPE_PARAM, connection->err,
+                        (dvoid *)&argParam, i) != OCI_SUCCESS) {
+            continue;
+        }
+        found++;
+
+        OCIAttrGet(argParam, OCI_DTYPE_PARAM, &name, &namelen,
+                   OCI_ATTR_NAME, connection->err);
+        OCIAttrGet(argParam, OCI_DTYPE_PARAM, &mode, 0,
+                   OCI_ATTR_IOMODE, connection->err);
+        OCIAttrGet(argParam, OCI_DTYPE_PARAM, &type, 0,
+                   OCI_ATTR_DATA_TYPE, connection->err);
+        OCIAttrGet(argParam, OCI_DTYPE_PARAM, &has_default, 0,
+                   OCI_ATTR_HAS_DEFAULT, connection->err);
+
+        if (namelen == 0u) {
+            if (i == 0u && type != 0u && sig->ret == NULL) {
+                sig->ret = ns_calloc(1u, sizeof(ora_call_arg_t));
+                sig->ret->name = Ns_StrDup("");
+                sig->ret->type = type;
+                sig->ret->mode = OCI_TYPEPARAM_OUT;
+            }
+            continue;
+        }
+
+        arg = &sig->args[sig->n_args++];
+        arg->name = Ns_Malloc(namelen + 1u);
+        memcpy(arg->name, name, namelen);
+        arg->name[namelen] = '\0';
+        arg->type = type;
+        if (type == SQLT_TAB) {
+            arg->elem_type = ora_table_elem_type(connection, argParam);
+        }
+        arg->mode = (int)mode;
+        arg->has_default = has_default;
+        if (!has_default) {
+            sig->n_required = sig->n_args;
+        }
+    }
+}
+/*}}}*/
+
+/*{{{ ora_table_elem_type*/
+/* The element type of a PL/SQL index-by table argument, from the
+   argument list describing it.  0 if it cannot be described. */
+static ub2
+ora_table_elem_type(ora_connection_t * connection, OCIParam * argParam)
+{
+    OCIParam *elemList = NULL, *elemParam;
+    ub2       n_params = 0, type = 0;
+    ub4       i;
+
+    if (OCIAttrGet(argParam, OCI_DTYPE_PARAM, &elemList, 0,
+                   OCI_ATTR_LIST_ARGUMENTS, connection->err) != OCI_SUCCESS
+        || elemList == NULL
+        || OCIAttrGet(elemList, OCI_DTYPE_PARAM, &n_params, 0,
+                      OCI_ATTR_NUM_PARAMS, connection->err) != OCI_SUCCESS) {
+        return 0;
+    }
+
+    /* as with argument lists, the first position may be 0 or 1 */
+    for (i = 0u; i <= n_params; i++) {
+        if (OCIParamGet(elemList, OCI_DTYPE_PARAM, connection->err,
+                        (dvoid *)&elemParam, i) == OCI_SUCCESS) {
+            OCIAttrGet(elemParam, OCI_DTYPE_PARAM, &type, 0,
+                       OCI_ATTR_DATA_TYPE, connection->err);
+            break;
+        }
+    }
+
+    return type;
+}
+/*}}}*/
+
+/*{{{ ora_table_values*/
+/* Fill a fetch buffer with the elements of a Tcl list, to be bound as
+   a PL/SQL index-by table in one piece: dates as OCIDates, everything
+   else as strings the size of the longest element.  Empty elements
+   are NULL.  The arrays have room for one element at least, since an
+   array bind needs a maximum of 1 or more. */
+static int
+ora_table_values(Tcl_Interp * interp, fetch_buffer_t * fetchbuf,
+                 Tcl_Obj * listObj, ub2 elem_type, const char *name)
+{
+    Tcl_Obj   **elems;
+    TCL_SIZE_T  n, i, length, max_length = 0;
+
+    if (Tcl_ListObjGetElements(interp, listObj, &n, &elems) != TCL_OK) {
+        return TCL_ERROR;
+    }
+
+    for (i = 0; i < n; i++) {
+        (void) Tcl_GetStringFromObj(elems[i], &length);
+        if (length > max_length) {
+            max_length = length;
+        }
+    }
+    if (max_length >= ORA_CALL_STRING_SIZE) {
+        Tcl_AppendResult(interp, "element of ", name, " too long", (char*)0L);
+        return TCL_ERROR;
+    }
+
+    if (elem_type == SQLT_DAT) {
+        fetchbuf->external_type = SQLT_ODT;
+        fetchbuf->size = (ub2)sizeof(OCIDate);
+    } else {
+        fetchbuf->external_type = SQLT_STR;
+        fetchbuf->size = (ub2)(max_length + 1);
+    }
+
+    fetchbuf->curele = (ub4)n;
+    fetchbuf->buf_size = (unsigned)fetchbuf->size * ((unsigned)n + 1u);
+    fetchbuf->buf = ns_calloc((size_t)n + 1u, fetchbuf->size);
+    fetchbuf->is_nulls = ns_calloc((size_t)n + 1u, sizeof *fetchbuf->is_nulls);
+    fetchbuf->fetch_lengths = ns_calloc((size_t)n + 1u, sizeof *fetchbuf->fetch_lengths);
+
+    for (i = 0; i < n; i++) {
+        const char *value = Tcl_GetStringFromObj(elems[i], &length);
+        char       *elem = fetchbuf->buf + (size_t)i * fetchbuf->size;
+
+        if (length == 0) {
+            fetchbuf->is_nulls[i] = -1;
+        } else if (fetchbuf->external_type == SQLT_ODT) {
+            if (!ora_call_parse_date(value, (OCIDate *)elem)) {
+                Tcl_AppendResult(interp, "invalid date \"", value,
+                                 "\" in ", name, (char*)0L);
+                return TCL_ERROR;
+            }
+            fetchbuf->fetch_lengths[i] = (ub2)sizeof(OCIDate);
+        } else {
+            memcpy(elem, value, (size_t)length + 1u);
+            fetchbuf->fetch_lengths[i] = (ub2)(length + 1);
+        }
+    }
+
+    return TCL_OK;
+}
+/*}}}*/
+
+/*{{{ ora_table_free*/
+/* Free a fetch buffer of ora_table_values() allocated on its own */
+static void
+ora_table_free(fetch_buffer_t * fetchbuf)
+{
+    Ns_Free(fetchbuf->buf);
+    Ns_Free(fetchbuf->is_nulls);
+    Ns_Free(fetchbuf->fetch_lengths);
+    Ns_Free(fetchbuf);
+}
+/*}}}*/
+
+/*{{{ ora_list_type*/
+/* The collection type of -bindlist for numbers or strings, looked up
+   once per connection; the object cache of the environment keeps it
+   pinned for the session. */
+static OCIType *
+ora_list_type(Tcl_Interp * interp, Ns_DbHandle * dbh, int number_p,
+              const char *query)
+{
+    ora_connection_t *connection = dbh->connection;
+    OCIType         **tdop = number_p ? &connection->number_list_tdo
+                                      : &connection->string_list_tdo;
+    const char       *name = number_p ? number_list_type : string_list_type;
+    const char       *dot = strchr(name, '.');
+    oci_status_t      oci_status;
+
+    if (*tdop == NULL) {
+        oci_status = OCITypeByName(connection->env, connection->err,
+                                   connection->svc,
+                                   (const OraText *)(dot != NULL ? name : ""),
+                                   dot != NULL ? (ub4)(dot - name) : 0u,
+                                   (const OraText *)(dot != NULL ? dot + 1 : name),
+                                   (ub4)strlen(dot != NULL ? dot + 1 : name),
+                                   NULL, 0,
+                                   OCI_DURATION_SESSION, OCI_TYPEGET_HEADER,
+                                   tdop);
+        if (tcl_error_p(lexpos(), interp, dbh, "OCITypeByName", query, oci_status)) {
+            *tdop = NULL;
+            return NULL;
+        }
+    }
+
+    return *tdop;
+}
+/*}}}*/
+
+/*{{{ ora_list_bind*/
+/* Bind a Tcl list as a collection, for queries like "where id in
+   (select column_value from table(:ids))".  With number_p the list
+   becomes a NumberListType, otherwise a StringListType; empty elements
+   are NULL. */
+static int
+ora_list_bind(Tcl_Interp * interp, Ns_DbHandle * dbh, fetch_buffer_t * fetchbuf,
+              const char *name, const char *value, int number_p,
+              const char *query)
+{
+    ora_connection_t *connection = dbh->connection;
+    oci_status_t      oci_status;
+    OCIType          *tdo;
+    Tcl_Obj          *listObj, **elems;
+    TCL_SIZE_T        n, i;
+    int               result = TCL_ERROR;
+
+    listObj = Tcl_NewStringObj(value, TCL_INDEX_NONE);
+    Tcl_IncrRefCount(listObj);
+    if (Tcl_ListObjGetElements(interp, listObj, &n, &elems) != TCL_OK) {
+        goto done;
+    }
+
+    tdo = ora_list_type(interp, dbh, number_p, query);
+    if (tdo == NULL) {
+        goto done;
+    }
+
+    oci_status = OCIObjectNew(connection->env, connection->err, connection->svc,
+                              OCITypeCollTypeCode(connection->env, connection->err, tdo),
+                              tdo, NULL, OCI_DURATION_SESSION, NS_TRUE,
+                              (dvoid **) &fetchbuf->coll);
+    if (tcl_error_p(lexpos(), interp, dbh, "OCIObjectNew", query, oci_status)) {
+        fetchbuf->coll = NULL;
+        goto done;
+    }
+
+    for (i = 0; i < n; i++) {
+        TCL_SIZE_T  length;
+        const char *elem = Tcl_GetStringFromObj(elems[i], &length);
+        OCIInd      ind = (length == 0) ? OCI_IND_NULL : OCI_IND_NOTNULL;
+        OCINumber   number;
+        OCIString  *string = NULL;
+        Tcl_WideInt w;
+        double      d;
+
+        if (number_p) {
+            memset(&number, 0, sizeof(number));
+            if (length == 0) {
+                oci_status = OCI_SUCCESS;
+            } else if (Tcl_GetWideIntFromObj(NULL, elems[i], &w) == TCL_OK) {
+                oci_status = OCINumberFromInt(connection->err, &w, sizeof(w),
+                                              OCI_NUMBER_SIGNED, &number);
+            } else if (Tcl_GetDoubleFromObj(interp, elems[i], &d) == TCL_OK) {
+                oci_status = OCINumberFromReal(connection->err, &d, sizeof(d),
+                                               &number);
+            } else {
+                /* not a number, the error is in interp */
+                goto done;
+            }
+            if (oci_status == OCI_SUCCESS) {
+                oci_status = OCICollAppend(connection->env, connection->err,
+                                           &number, &ind, fetchbuf->coll);
+            }
+        } else {
+            oci_status = OCIStringAssignText(connection->env, connection->err,
+                                             (const OraText *)elem, (ub4)length,
+                                             &string);
+            if (oci_status == OCI_SUCCESS) {
+                oci_status = OCICollAppend(connection->env, connection->err,
+                                           string, &ind, fetchbuf->coll);
+            }
+            if (string != NULL) {
+                OCIStringResize(connection->env, connection->err, 0, &string);
+            }
+        }
+        if (tcl_error_p(lexpos(), interp, dbh, "OCICollAppend", query, oci_status)) {
+            goto done;
+        }
+    }
+
+    Ns_Log(Debug, "bind variable '%s' = list of %ld %s", name, (long)n,
+           number_p ? "numbers" : "strings");
+
+    oci_status = OCIBindByName(connection->stmt,
+                               &fetchbuf->bind,
+                               connection->err,
+                               (const OraText *)name,
+                               (sb4) strlen(name),
+                               NULL, 0, SQLT_NTY,
+                               NULL, NULL, NULL, 0, NULL,
+                               OCI_DEFAULT);
+    if (tcl_error_p(lexpos(), interp, dbh, "OCIBindByName", query, oci_status)) {
+        goto done;
+    }
+
+    oci_status = OCIBindObject(fetchbuf->bind, connection->err, tdo,
+                               (dvoid **) &fetchbuf->coll, NULL, NULL, NULL);
+    if (tcl_error_p(lexpos(), interp, dbh, "OCIBindObject", query, oci_status)) {
+        goto done;
+    }
+
+    result = TCL_OK;
+
+  done:
+    Tcl_DecrRefCount(listObj);
+
+    return result;
+}
+/*}}}*/
+
+/*{{{ fetch_buffer_free_coll*/
+/* Free the collection of -bindlist, if any */
+static void
+fetch_buffer_free_coll(fetch_buffer_t * fetchbuf)
+{
+    ora_connection_t *connection = fetchbuf->connection;
+
+    if (fetchbuf->coll != NULL && connection != NULL && connection->env != NULL) {
+        oci_error_p(lexpos(), connection->dbh, "OCIObjectFree", 0,
+                    OCIObjectFree(connection->env, connection->err,
+                                  fetchbuf->coll, OCI_OBJECTFREE_FORCE));
+    }
+    fetchbuf->coll = NULL;
+}
+/*}}}*/
+
+/*{{{ ora_prepared_bind*/
+/* Bind the variables of a statement for values passed at execute time
+   by DynamicBindIn, so that the binds hold for any number of executes.
+   binds has a fetch buffer for each variable. */
+static int
+ora_prepared_bind(Tcl_Interp * interp, Ns_DbHandle * dbh, OCIStmt * stmt,
+                  const char *query, string_list_elt_t * bind_variables,
+                  fetch_buffer_t * binds)
+{
+    ora_connection_t  *connection = dbh->connection;
+    oci_status_t       oci_status;
+    string_list_elt_t *var_p;
+    int                i;
+
+    for (var_p = bind_variables, i = 0; var_p != NULL;
+         var_p = var_p->next, i++) {
+        fetch_buffer_t *fetchbuf = &binds[i];
+
+        fetchbuf->connection = connection;
+        fetchbuf->external_type = SQLT_STR;
+
+        oci_status = OCIBindByName(stmt,
+                                   &fetchbuf->bind,
+                                   connection->err,
+                                   (const OraText *)var_p->string,
+                                   (sb4) strlen(var_p->string),
+                                   NULL, MAX_DYNAMIC_BUFFER, SQLT_STR,
+                                   &fetchbuf->is_null, 0, 0, 0, 0,
+                                   OCI_DATA_AT_EXEC);
+        if (tcl_error_p(lexpos(), interp, dbh, "OCIBindByName", query, oci_status)) {
+            return TCL_ERROR;
+        }
+
+        oci_status = OCIBindDynamic(fetchbuf->bind, connection->err,
+                                    fetchbuf, DynamicBindIn,
+                                    fetchbuf, DynamicBindOut);
+        if (tcl_error_p(lexpos(), interp, dbh, "OCIBindDynamic", query, oci_status)) {
+            return TCL_ERROR;
+        }
+    }
+
+    return TCL_OK;
+}
+/*}}}*/
+
+/*{{{ ora_prepared_values*/
+/* Give the fetch buffers of ora_prepared_bind() the values of
+   "?-bind set|dict? ?arg1 .. argN?" in args, for the next execute */
+static int
+ora_prepared_values(Tcl_Interp * interp, string_list_elt_t * bind_variables,
+                    fetch_buffer_t * binds, int n_args, Tcl_Obj *const* args)
+{
+    string_list_elt_t *var_p;
+    Ns_Set            *set = NULL;
+    Tcl_Obj           *dictObj = NULL, *valueObj;
+    int                i;
+
+    if (n_args > 1 && !strcmp(Tcl_GetString(args[0]), "-bind")) {
+        set = Ns_TclGetSet(interp, Tcl_GetString(args[1]));
+        if (set == NULL) {
+            TCL_SIZE_T size;
+
+            Tcl_ResetResult(interp);
+            if (Tcl_DictObjSize(NULL, args[1], &size) != TCL_OK) {
+                Tcl_AppendResult(interp, "invalid set id or dict `",
+                                 Tcl_GetString(args[1]), "'", (char*)0L);
+                return TCL_ERROR;
+            }
+            dictObj = args[1];
+        }
+        args += 2;
+        n_args -= 2;
+    }
+
+    for (var_p = bind_variables, i = 0; var_p != NULL;
+         var_p = var_p->next, i++) {
+        fetch_buffer_t *fetchbuf = &binds[i];
+        const char     *value = NULL;
+        char           *nbuf;
+        long            index;
+
+        index = strtol(var_p->string, &nbuf, 10);
+
+        if (*nbuf == '\0') {
+            /* ":1" is the first argument */
+            if (index < 1 || index > n_args) {
+                Tcl_AppendResult(interp,
+                                 "not enough arguments for positional variable ':",
+                                 var_p->string, "'", (char*)0L);
+                return TCL_ERROR;
+            }
+            value = Tcl_GetString(args[index - 1]);
+        } else if (set != NULL) {
+            value = Ns_SetGet(set, var_p->string);
+        } else if (dictObj != NULL) {
+            Tcl_Obj *keyObj = Tcl_NewStringObj(var_p->string, TCL_INDEX_NONE);
+
+            Tcl_IncrRefCount(keyObj);
+            if (Tcl_DictObjGet(NULL, dictObj, keyObj, &valueObj) == TCL_OK
+                && valueObj != NULL) {
+                value = Tcl_GetString(valueObj);
+            }
+            Tcl_DecrRefCount(keyObj);
+        } else {
+            value = Tcl_GetVar(interp, var_p->string, 0);
+        }
+
+        if (value == NULL) {
+            Tcl_AppendResult(interp, "undefined bind variable `",
+                             var_p->string, "'", (char*)0L);
+            return TCL_ERROR;
+        }
+
+        /* the value of the last execute, or an OUT value */
+        fetch_buffer_free_buf(fetchbuf);
+        fetchbuf->buf = Ns_StrDup(value);
+        fetchbuf->is_null = 0;
+        fetchbuf->inout = 0;
+    }
+
+    return TCL_OK;
+}
+/*}}}*/
+
+/*{{{ ora_prepared_exec*/
+/* Execute a statement bound by ora_prepared_bind(), with the values of
+   "?-bind set|dict? ?arg1 .. argN?" in args.  Sets the result to the
+   rows of a query, fetched array_size rows at a time, or to the number
+   of rows processed. */
+static int
+ora_prepared_exec(Tcl_Interp * interp, Ns_DbHandle * dbh, OCIStmt * stmt,
+                  ub2 type, const char *query,
+                  string_list_elt_t * bind_variables, fetch_buffer_t * binds,
+                  ub4 array_size, int n_args, Tcl_Obj *const* args)
+{
+    ora_connection_t  *connection = dbh->connection;
+    oci_status_t       oci_status;
+    string_list_elt_t *var_p;
+    Tcl_Obj           *rowsObj;
+    int                i;
+    ub4                rows;
+
+    connection->interp = interp;
+
+    if (ora_prepared_values(interp, bind_variables, binds,
+                            n_args, args) != TCL_OK) {
+        return TCL_ERROR;
+    }
+
+    oci_status = OCIStmtExecute(connection->svc, stmt, connection->err,
+                                type == OCI_STMT_SELECT ? 0u : 1u,
+                                0, NULL, NULL,
+                                (connection->mode == autocommit
+                                 && type != OCI_STMT_SELECT
+                                 ? OCI_COMMIT_ON_SUCCESS : OCI_DEFAULT));
+    if (tcl_error_p(lexpos(), interp, dbh, "OCIStmtExecute", query, oci_status)) {
+        return TCL_ERROR;
+    }
+
+    if (type == OCI_STMT_SELECT) {
+        rowsObj = ora_cursor_rows(interp, dbh, stmt, array_size, query);
+        if (rowsObj == NULL) {
+            return TCL_ERROR;
+        }
+        Tcl_SetObjResult(interp, rowsObj);
+        return TCL_OK;
+    }
+
+    for (var_p = bind_variables, i = 0; var_p != NULL;
+         var_p = var_p->next, i++) {
+        fetch_buffer_t *fetchbuf = &binds[i];
+
+        if (fetchbuf->inout == BIND_OUT) {
+            Tcl_SetVar(interp, var_p->string,
+                       fetchbuf->is_null == -1 ? "" : fetchbuf->buf, 0);
+        }
+    }
+
+    rows = 0u;
+    oci_status = OCIAttrGet(stmt, OCI_HTYPE_STMT,
+                            (oci_attribute_t *) &rows, NULL,
+                            OCI_ATTR_ROW_COUNT, connection->err);
+    if (tcl_error_p(lexpos(), interp, dbh, "OCIAttrGet", query, oci_status)) {
+        return TCL_ERROR;
+    }
+    Tcl_SetObjResult(interp, Tcl_NewWideIntObj((Tcl_WideInt)rows));
+
+    return TCL_OK;
+}
+/*}}}*/
+
+/*{{{ ora_prepared_free*/
+/* Free a statement of [ns_ora prepare] */
+static void
+ora_prepared_free(ora_connection_t * connection, void *data)
+{
+    ora_prepared_t *prepared = data;
+    int             i;
+
+    if (prepared->stmt != NULL) {
+        oci_error_p(lexpos(), connection->dbh, "OCIHandleFree", prepared->query,
+                    OCIHandleFree(prepared->stmt, OCI_HTYPE_STMT));
+    }
+    for (i = 0; i < prepared->n_binds; i++) {
+        fetch_buffer_free_buf(&prepared->binds[i]);
+    }
+    ns_free(prepared->binds);
+    string_list_free_list(prepared->bind_variables);
+    Ns_Free(prepared->query);
+    ns_free(prepared);
+}
+/*}}}*/
+
+/*{{{ ora_cursor_object_free*/
+/* Free a cursor of [ns_ora open_cursor] */
+static void
+ora_cursor_object_free(ora_connection_t * connection, void *data)
+{
+    ora_cursor_t *cursor = data;
+
+    if (cursor->fetchbufs != NULL) {
+        ora_cursor_free(connection->dbh, cursor->fetchbufs, cursor->n_columns);
+    }
+    if (cursor->stmt != NULL) {
+        oci_error_p(lexpos(), connection->dbh, "OCIHandleFree", cursor->query,
+                    OCIHandleFree(cursor->stmt, OCI_HTYPE_STMT));
+    }
+    Ns_Free(cursor->query);
+    ns_free(cursor);
+}
+/*}}}*/
+
+/*{{{ ora_cursor_fetch*/
+/* Fetch the next batch of rows of a cursor, n_rows rows from the given
+   position.  The fetch buffers grow to hold them. */
+static int
+ora_cursor_fetch(Tcl_Interp * interp, ora_connection_t * connection,
+                 ora_cursor_t * cursor, ub4 n_rows, ub2 orientation, sb4 offset)
+{
+    oci_status_t oci_status;
+
+    if (n_rows > cursor->array_size) {
+        ora_cursor_free(connection->dbh, cursor->fetchbufs, cursor->n_columns);
+        cursor->fetchbufs = ora_cursor_define(interp, connection->dbh, cursor->stmt,
+                                              n_rows, cursor->query,
+                                              &cursor->n_columns);
+        if (cursor->fetchbufs == NULL) {
+            cursor->n_columns = 0;
+            cursor->array_size = 0u;
+            return TCL_ERROR;
+        }
+        cursor->array_size = n_rows;
+    }
+
+    cursor->n_rows = 0u;
+    cursor->row = 0u;
+
+    oci_status = OCIStmtFetch2(cursor->stmt, connection->err, n_rows,
+                               orientation, offset, OCI_DEFAULT);
+    if (oci_status == OCI_NO_DATA) {
+        /* the last rows may still come with it */
+        cursor->end_p = NS_TRUE;
+    } else if (tcl_error_p(lexpos(), interp, connection->dbh, "OCIStmtFetch2",
+                           cursor->query, oci_status)) {
+        return TCL_ERROR;
+    } else {
+        cursor->end_p = NS_FALSE;
+    }
+
+    oci_status = OCIAttrGet(cursor->stmt, OCI_HTYPE_STMT,
+                            (oci_attribute_t *) &cursor->n_rows, NULL,
+                            OCI_ATTR_ROWS_FETCHED, connection->err);
+    if (tcl_error_p(lexpos(), interp, connection->dbh, "OCIAttrGet",
+                    cursor->query, oci_status)) {
+        cursor->n_rows = 0u;
+        return TCL_ERROR;
+    }
+
+    return TCL_OK;
+}
+/*}}}*/
+
+/*{{{ ora_query_get*/
+/* The query of [ns_ora register] named name, kept until
+   ora_query_release() */
+static ora_query_t *
+ora_query_get(Tcl_Interp * interp, const char *name)
+{
+    Tcl_HashEntry *hPtr;
+    ora_query_t   *query = NULL;
+
+    Ns_MutexLock(&query_registry.lock);
+    hPtr = Tcl_FindHashEntry(&query_registry.table, name);
+    if (hPtr != NULL) {
+        query = Tcl_GetHashValue(hPtr);
+        query->refcount++;
+    }
+    Ns_MutexUnlock(&query_registry.lock);
+
+    if (query == NULL) {
+        Tcl_AppendResult(interp, "no query registered as \"", name, "\"",
+                         (char*)0L);
+    }
+
+    return query;
+}
+/*}}}*/
+
+/*{{{ ora_query_release*/
+static void
+ora_query_release(ora_query_t * query)
+{
+    int free_p;
+
+    Ns_MutexLock(&query_registry.lock);
+    free_p = (--query->refcount == 0 && query->hPtr == NULL);
+    Ns_MutexUnlock(&query_registry.lock);
+
+    if (free_p) {
+        ora_query_free(query);
+    }
+}
+/*}}}*/
+
+/*{{{ ora_query_free*/
+static void
+ora_query_free(ora_query_t * query)
+{
+    string_list_free_list(query->bind_variables);
+    Ns_Free(query->sql);
+    ns_free(query->key);
+    Ns_Free(query->name);
+    ns_free(query);
+}
+/*}}}*/
+
+/*{{{ ora_queries_warm*/
+/* Prepare the queries registered with -warm into the statement cache
+   of a new session, so that their first run finds them there.  The
+   registry is not locked meanwhile, the queries are held instead.
+   Stops at the first error; returns NS_ERROR if that closed the
+   connection. */
+static int
+ora_queries_warm(Ns_DbHandle * dbh)
+{
+    ora_connection_t *connection = dbh->connection;
+    Tcl_HashEntry    *hPtr;
+    Tcl_HashSearch    search;
+    oci_status_t      oci_status;
+    ora_query_t     **queries;
+    int               n_queries = 0, n = 0, i, error_p = NS_FALSE;
+
+    if (statement_cache_size == 0) {
+        return NS_OK;
+    }
+
+    Ns_MutexLock(&query_registry.lock);
+    queries = ns_calloc((size_t)query_registry.table.numEntries + 1u,
+                        sizeof(ora_query_t *));
+    for (hPtr = Tcl_FirstHashEntry(&query_registry.table, &search); hPtr != NULL;
+         hPtr = Tcl_NextHashEntry(&search)) {
+        ora_query_t *query = Tcl_GetHashValue(hPtr);
+
+        if (query->warm_p) {
+            query->refcount++;
+            queries[n_queries++] = query;
+        }
+    }
+    Ns_MutexUnlock(&query_registry.lock);
+
+    for (i = 0; i < n_queries; i++) {
+        ora_query_t *query = queries[i];
+        OCIStmt     *stmt = NULL;
+
+        if (!error_p) {
+            oci_status = OCIStmtPrepare2(connection->svc, &stmt, connection->err,
+                                         (const OraText *)query->sql,
+                                         (ub4)strlen(query->sql),
+                                         (const OraText *)query->key,
+                                         (ub4)strlen(query->key),
+                                         OCI_NTV_SYNTAX, OCI_DEFAULT);
+            if (!oci_error_p(lexpos(), dbh, "OCIStmtPrepare2", query->sql, oci_status)
+                && !oci_error_p(lexpos(), dbh, "OCIStmtRelease", query->sql,
+                                OCIStmtRelease(stmt, connection->err,
+                                               (const OraText *)query->key,
+                                               (ub4)strlen(query->key),
+                                               OCI_DEFAULT))) {
+                n++;
+            } else {
+                /* connection may be gone */
+                error_p = NS_TRUE;
+            }
+        }
+        ora_query_release(query);
+    }
+    ns_free(queries);
+
+    if (n > 0) {
+        ns_ora_log(lexpos(), "%d registered queries prepared", n);
+    }
+
+    return dbh->connection != NULL ? NS_OK : NS_ERROR;
+}
+/*}}}*/
+
+/*{{{ ora_describe_get*/
+/* The select list entry of sql in the session, created undescribed if
+   there is none yet.  Beyond DescribeCacheSize entries the least
+   recently used ones are dropped, except the one of the current query.
+   With the cache disabled or without sql the entry is private, to be
+   freed with ora_describe_forget(). */
+static ora_describe_t *
+ora_describe_get(ora_connection_t * connection, const char *sql)
+{
+    ora_describe_t *describe;
+    Tcl_HashEntry  *hPtr;
+    int             isNew;
+
+    if (describe_cache_size == 0 || sql == NULL) {
+        describe = ns_calloc(1u, sizeof(ora_describe_t));
+        describe->n_columns = -1;
+        return describe;
+    }
+
+    hPtr = Tcl_CreateHashEntry(&connection->describes, sql, &isNew);
+    if (!isNew) {
+        describe = Tcl_GetHashValue(hPtr);
+        if (describe == connection->describe_first) {
+            return describe;
+        }
+        /* unlink, it is moved to the front below */
+        describe->prev->next = describe->next;
+        if (describe->next != NULL) {
+            describe->next->prev = describe->prev;
+        } else {
+            connection->describe_last = describe->prev;
+        }
+    } else {
+        describe = ns_calloc(1u, sizeof(ora_describe_t));
+        describe->hPtr = hPtr;
+        describe->n_columns = -1;
+        Tcl_SetHashValue(hPtr, describe);
+    }
+
+    describe->prev = NULL;
+    describe->next = connection->describe_first;
+    if (connection->describe_first != NULL) {
+        connection->describe_first->prev = describe;
+    } else {
+        connection->describe_last = describe;
+    }
+    connection->describe_first = describe;
+
+    while (connection->describes.numEntries > describe_cache_size) {
+        ora_describe_t *victim = connection->describe_last;
+
+        if (victim == connection->describe) {
+            victim = victim->prev;
+        }
+        if (victim == describe) {
+            break;
+        }
+        ora_describe_forget(connection, victim);
+    }
+
+    return describe;
+}
+/*}}}*/
+
+/*{{{ ora_describe_columns*/
+/* Describe the select list of the executed (or described) stmt into
+   describe, replacing what it held.  Errors are left in
+   dbh->dsExceptionMsg, describe is undescribed then. */
+static int
+ora_describe_columns(Ns_DbHandle * dbh, OCIStmt * stmt,
+                     ora_describe_t * describe, const char *query)
+{
+    ora_connection_t *connection = dbh->connection;
+    oci_status_t      oci_status;
+    ub4               n_columns = 0, i;
+
+    ora_describe_clear(describe);
+
+    oci_status = OCIAttrGet(stmt, OCI_HTYPE_STMT,
+                            (oci_attribute_t *) & n_columns,
+                            NULL, OCI_ATTR_PARAM_COUNT, connection->err);
+    if (oci_error_p(lexpos(), dbh, "OCIAttrGet", query, oci_status)) {
+        return NS_ERROR;
+    }
+
+    describe->columns = ns_calloc((size_t)n_columns + 1u, sizeof(ora_column_t));
+
+    for (i = 0; i < n_columns; i++) {
+        ora_column_t *column = &describe->columns[i];
+        OCIParam     *param;
+        char         *name1 = NULL;
+        ub4           name1_size = 0;
+        const char   *caseLabel;
+
+        oci_status = OCIParamGet(stmt, OCI_HTYPE_STMT, connection->err,
+                                 (oci_param_t *) & param, i + 1);
+        if (oci_error_p(lexpos(), dbh, "OCIParamGet", query, oci_status)) {
+            break;
+        }
+
+        oci_status = OCIAttrGet(param, OCI_DTYPE_PARAM,
+                                (oci_attribute_t *) & name1,
+                                &name1_size, OCI_ATTR_NAME, connection->err);
+        if (oci_error_p(lexpos(), dbh, "OCIAttrGet", query, oci_status)) {
+            break;
+        }
+
+        /* Oracle gives us back a pointer to a string that is not
+           null-terminated.  We downcase the column name for
+           backward-compatibility with philg's AOLserver Tcl scripts
+           written for the case-sensitive Illustra RDBMS. */
+        column->name = Ns_Malloc((size_t)name1_size + 1u);
+        memcpy(column->name, name1, name1_size);
+        column->name[name1_size] = '\0';
+        downcase(column->name);
+
+        oci_status = OCIAttrGet(param, OCI_DTYPE_PARAM,
+                                (oci_attribute_t *) & column->type,
+                                NULL, OCI_ATTR_DATA_TYPE, connection->err);
+        if (oci_error_p(lexpos(), dbh, "OCIAttrGet", query, oci_status)) {
+            break;
+        }
+
+        /* the sizes of the values as they are fetched, as strings */
+        switch (column->type) {
+        case OCI_TYPECODE_CLOB:
+        case OCI_TYPECODE_BLOB:
+            caseLabel = "lob";
+            break;
+
+            /* RDD is Oracle's happy fun name for ROWID (18 chars long
+               but if you ask Oracle the usual way, it will give you a
+               number that is too small) */
+        case SQLT_RDD:
+            caseLabel = "rdd";
+            column->size = 18;
+            break;
+
+            /* OCI reports that all NUMBER values has a size of 22, the size
+               of its internal storage format for numbers. Empirically,
+               it seems to return 41 characters when it does the NUMBER
+               to STRING conversion. */
+        case SQLT_NUM:
+            caseLabel = "num";
+            column->size = 81;
+            break;
+
+        case SQLT_LNG:
+            caseLabel = "long";
+            break;
+
+            /* "YYYY-MM-DD HH24:MI:SS", "YYYY-MM-DD HH24:MI:SS.FF6" and
+               "YYYY-MM-DD HH24:MI:SS.FF6 TZH:TZM" */
+        case SQLT_DAT:
+            caseLabel = "date";
+            column->size = 20;
+            break;
+
+        case SQLT_TIMESTAMP:
+            caseLabel = "timestamp";
+            column->size = 26;
+            break;
+
+        case SQLT_TIMESTAMP_TZ:
+            caseLabel = "timestamp tz";
+            column->size = 33;
+            break;
+
+        default:
+            caseLabel = "default";
+            oci_status = OCIAttrGet(param, OCI_DTYPE_PARAM,
+                                    (oci_attribute_t *) & column->size,
+                                    NULL, OCI_ATTR_DATA_SIZE, connection->err);
+            break;
+        }
+        if (oci_error_p(lexpos(), dbh, "OCIAttrGet", query, oci_status)) {
+            break;
+        }
+
+        ns_ora_log(lexpos(), "%u: column `%s' type %d size %d (%s)",
+                   i, column->name, column->type, column->size, caseLabel);
+    }
+
+    describe->n_columns = (int)n_columns;
+    if (i < n_columns) {
+        /* forget the partial select list */
+        ora_describe_clear(describe);
+        return NS_ERROR;
+    }
+
+    return NS_OK;
+}
+/*}}}*/
+
+/*{{{ ora_describe_current_p*/
+/* Whether describe still matches the select list of the executed stmt,
+   column by column in name, type and, where the fetch buffer is sized
+   from it, data size.  This reads the attributes OCI got with the
+   execute, without a round trip and without copying the names. */
+static int
+ora_describe_current_p(ora_connection_t * connection, OCIStmt * stmt,
+                       ora_describe_t * describe)
+{
+    oci_status_t oci_status;
+    int          i;
+
+    for (i = 0; i < describe->n_columns; i++) {
+        ora_column_t *column = &describe->columns[i];
+        OCIParam     *param;
+        char         *name1 = NULL;
+        ub4           name1_size = 0;
+        OCITypeCode   type = 0;
+        ub2           size = 0;
+
+        oci_status = OCIParamGet(stmt, OCI_HTYPE_STMT, connection->err,
+                                 (oci_param_t *) & param, (ub4)i + 1u);
+        if (oci_status != OCI_SUCCESS) {
+            return NS_FALSE;
+        }
+
+        oci_status = OCIAttrGet(param, OCI_DTYPE_PARAM,
+                                (oci_attribute_t *) & type,
+                                NULL, OCI_ATTR_DATA_TYPE, connection->err);
+        if (oci_status != OCI_SUCCESS || type != column->type) {
+            return NS_FALSE;
+        }
+
+        oci_status = OCIAttrGet(param, OCI_DTYPE_PARAM,
+                                (oci_attribute_t *) & name1,
+                                &name1_size, OCI_ATTR_NAME, connection->err);
+        if (oci_status != OCI_SUCCESS
+            || strncasecmp(column->name, name1, name1_size) != 0
+            || column->name[name1_size] != '\0') {
+            return NS_FALSE;
+        }
+
+        /* the types ora_describe_columns() gives a fixed size */
+        switch (type) {
+        case OCI_TYPECODE_CLOB:
+        case OCI_TYPECODE_BLOB:
+        case SQLT_RDD:
+        case SQLT_NUM:
+        case SQLT_LNG:
+        case SQLT_DAT:
+        case SQLT_TIMESTAMP:
+        case SQLT_TIMESTAMP_TZ:
+            break;
+
+        default:
+            oci_status = OCIAttrGet(param, OCI_DTYPE_PARAM,
+                                    (oci_attribute_t *) & size,
+                                    NULL, OCI_ATTR_DATA_SIZE, connection->err);
+            if (oci_status != OCI_SUCCESS || size != column->size) {
+                return NS_FALSE;
+            }
+            break;
+        }
+    }
+
+    return NS_TRUE;
+}
+/*}}}*/
+
+/*{{{ ora_describe_clear*/
+/* Make describe undescribed */
+static void
+ora_describe_clear(ora_describe_t * describe)
+{
+    int i;
+
+    for (i = 0; describe->columns != NULL && i < describe->n_columns; i++) {
+        Ns_Free(describe->columns[i].name);
+    }
+    ns_free(describe->columns);
+    describe->columns = NULL;
+    describe->n_columns = -1;
+}
+/*}}}*/
+
+/*{{{ ora_describe_forget*/
+/* Drop describe from the cache of the session and free it; a NULL
+   describe is ignored */
+static void
+ora_describe_forget(ora_connection_t * connection, ora_describe_t * describe)
+{
+    if (describe == NULL) {
+        return;
+    }
+    if (describe->hPtr != NULL) {
+        Tcl_DeleteHashEntry(describe->hPtr);
+        if (describe->prev != NULL) {
+            describe->prev->next = describe->next;
+        } else {
+            connection->describe_first = describe->next;
+        }
+        if (describe->next != NULL) {
+            describe->next->prev = describe->prev;
+        } else {
+            connection->describe_last = describe->prev;
+        }
+    }
+    if (connection->describe == describe) {
+        connection->describe = NULL;
+    }
+    ora_describe_clear(describe);
+    ns_free(describe);
+}
+/*}}}*/
+
+/*{{{ ora_describe_check*/
+/* Forget the select list of the current query when a define or fetch
+   failed in a way a changed select list explains: ORA-01007 variable
+   not in select list, ORA-00932 inconsistent datatypes, ORA-01406
+   fetched column value was truncated.  It is described again on the
+   next run. */
+static void
+ora_describe_check(ora_connection_t * connection, oci_status_t oci_status)
+{
+    sb4 errorcode = 0;
+
+    if (oci_status != OCI_ERROR || connection->describe == NULL) {
+        return;
+    }
+
+    (void) OCIErrorGet(connection->err, 1, NULL, &errorcode, NULL, 0,
+                       OCI_HTYPE_ERROR);
+    if (errorcode == 1007 || errorcode == 932 || errorcode == 1406) {
+        ns_ora_log(lexpos(), "select list changed (ORA-%05d)", (int)errorcode);
+        ora_describe_forget(connection, connection->describe);
+    }
+}
+/*}}}*/
 
-        switch (state) {
-        case base_state:
-            if (*p == '\'') {
-                state = instr_state;
-                current_string_length = 0;
-            } else if (*p == ':') {
-                bp = bindbuf;
-                state = bind_state;
+/*{{{ ora_describes_free*/
+/* Free the select lists of a session at close */
+static void
+ora_describes_free(ora_connection_t * connection)
+{
+    ora_describe_t *describe, *next;
+
+    if (connection->describe != NULL && connection->describe->hPtr == NULL) {
+        ora_describe_forget(connection, connection->describe);
+    }
+    for (describe = connection->describe_first; describe != NULL; describe = next) {
+        next = describe->next;
+        ora_describe_clear(describe);
+        ns_free(describe);
+    }
+    connection->describe_first = connection->describe_last = NULL;
+    connection->describe = NULL;
+    Tcl_DeleteHashTable(&connection->describes);
+}
+/*}}}*/
+
+/*{{{ ora_dbms_output_lines*/
+/* Append the pending DBMS_OUTPUT lines of the session to listObj,
+   fetching them with DBMS_OUTPUT.GET_LINES an array at a time.  The
+   statement is private, connection->stmt is left alone. */
+static int
+ora_dbms_output_lines(Ns_DbHandle * dbh, Tcl_Obj * listObj)
+{
+    static const char *query = "begin dbms_output.get_lines(:1, :2); end;";
+    ora_connection_t  *connection = dbh->connection;
+    oci_status_t       oci_status;
+    OCIStmt           *stmt = NULL;
+    OCIBind           *linesBind = NULL, *countBind = NULL;
+    char              *lines;
+    sb2                is_nulls[DBMS_OUTPUT_LINES];
+    ub2                lengths[DBMS_OUTPUT_LINES];
+    ub4                curele = 0;
+    sb4                count, i;
+    int                result = TCL_ERROR;
+
+    oci_status = OCIStmtPrepare2(connection->svc, &stmt, connection->err,
+                                 (const OraText *)query, (ub4)strlen(query),
+                                 NULL, 0, OCI_NTV_SYNTAX, OCI_DEFAULT);
+    if (oci_error_p(lexpos(), dbh, "OCIStmtPrepare2", query, oci_status)) {
+        return TCL_ERROR;
+    }
+
+    lines = Ns_Malloc(DBMS_OUTPUT_LINES * DBMS_OUTPUT_LINE_SIZE);
+
+    oci_status = OCIBindByPos(stmt, &linesBind, connection->err, 1,
+                              lines, DBMS_OUTPUT_LINE_SIZE, SQLT_STR,
+                              is_nulls, lengths, NULL,
+                              DBMS_OUTPUT_LINES, &curele, OCI_DEFAULT);
+    if (oci_error_p(lexpos(), dbh, "OCIBindByPos", query, oci_status)) {
+        goto bailout;
+    }
+    oci_status = OCIBindByPos(stmt, &countBind, connection->err, 2,
+                              &count, (sb4)sizeof(count), SQLT_INT,
+                              NULL, NULL, NULL, 0, NULL, OCI_DEFAULT);
+    if (oci_error_p(lexpos(), dbh, "OCIBindByPos", query, oci_status)) {
+        goto bailout;
+    }
+
+    /* a short batch is the last one */
+    do {
+        count = DBMS_OUTPUT_LINES;
+        curele = 0;
+        oci_status = OCIStmtExecute(connection->svc, stmt, connection->err,
+                                    1, 0, NULL, NULL, OCI_DEFAULT);
+        if (oci_error_p(lexpos(), dbh, "OCIStmtExecute", query, oci_status)) {
+            goto bailout;
+        }
+        for (i = 0; i < count && i < (sb4)curele; i++) {
+            const char *line = lines + i * DBMS_OUTPUT_LINE_SIZE;
+
+            Tcl_ListObjAppendElement(NULL, listObj,
+                                     Tcl_NewStringObj(is_nulls[i] == -1 ? "" : line,
+                                                      is_nulls[i] == -1 ? 0 : (TCL_SIZE_T)lengths[i]));
+        }
+    } while (count == DBMS_OUTPUT_LINES);
+
+    result = TCL_OK;
+
+  bailout:
+    (void) OCIStmtRelease(stmt, connection->err, NULL, 0, OCI_DEFAULT);
+    Ns_Free(lines);
+
+    return result;
+}
+/*}}}*/
+
+/*{{{ ora_dbms_output_log*/
+/* Log the DBMS_OUTPUT lines of a call that started at start and took
+   at least as long as set with [ns_ora dbms_output -log] */
+static void
+ora_dbms_output_log(Ns_DbHandle * dbh, const Ns_Time * start, const char *query)
+{
+    ora_connection_t *connection = dbh->connection;
+    Ns_Time           now, diff;
+    Tcl_Obj          *listObj, **elems;
+    TCL_SIZE_T        n, i;
+    long              ms;
+
+    /* a fatal error of the call may have closed the connection */
+    if (connection == NULL
+        || !connection->dbms_output_p || connection->dbms_output_log < 0) {
+        return;
+    }
+
+    Ns_GetTime(&now);
+    Ns_DiffTime(&now, start, &diff);
+    ms = diff.sec * 1000 + diff.usec / 1000;
+    if (ms < connection->dbms_output_log) {
+        return;
+    }
+
+    listObj = Tcl_NewListObj(0, NULL);
+    Tcl_IncrRefCount(listObj);
+    if (ora_dbms_output_lines(dbh, listObj) == TCL_OK
+        && Tcl_ListObjGetElements(NULL, listObj, &n, &elems) == TCL_OK
+        && n > 0) {
+        Ns_Log(Debug, "dbms_output of %ld ms call: %s", ms, nilp(query));
+        for (i = 0; i < n; i++) {
+            Ns_Log(Debug, "dbms_output: %s", Tcl_GetString(elems[i]));
+        }
+    }
+    Tcl_DecrRefCount(listObj);
+}
+/*}}}*/
+
+/*{{{ ora_call_number_type_p*/
+static int
+ora_call_number_type_p(ub2 type)
+{
+    switch (type) {
+        case SQLT_NUM:
+        case SQLT_INT:
+        case SQLT_FLT:
+        case SQLT_VNU:
+        case SQLT_UIN:
+        case SQLT_BFLOAT:
+        case SQLT_BDOUBLE:
+        case SQLT_IBFLOAT:
+        case SQLT_IBDOUBLE:
+            return NS_TRUE;
+        default:
+            return NS_FALSE;
+    }
+}
+/*}}}*/
+
+/*{{{ ora_call_match_p*/
+/* Whether the arguments fit a signature: their number, and the values
+   of IN arguments declared as numbers or dates.  This is what chooses
+   between overloads. */
+static int
+ora_call_match_p(ora_call_sig_t * sig, int objc, Tcl_Obj *const* objv)
+{
+    int i;
+
+    if (objc > sig->n_args || objc < sig->n_required) {
+        return NS_FALSE;
+    }
+
+    for (i = 0; i < objc; i++) {
+        ora_call_arg_t *arg = &sig->args[i];
+        const char     *value = Tcl_GetString(objv[i]);
+        char           *end;
+        OCIDate         date;
+
+        if (arg->mode != OCI_TYPEPARAM_IN || *value == '\0'
+            || (arg->has_default && strcmp(value, "--") == 0)) {
+            continue;
+        }
+        if (arg->type == SQLT_TAB) {
+            TCL_SIZE_T length;
+
+            if (Tcl_ListObjLength(NULL, objv[i], &length) != TCL_OK) {
+                return NS_FALSE;
+            }
+        } else if (ora_call_number_type_p(arg->type)) {
+            (void) strtod(value, &end);
+            if (end == value || *end != '\0') {
+                return NS_FALSE;
+            }
+        } else if (arg->type == SQLT_DAT
+                   && !ora_call_parse_date(value, &date)) {
+            return NS_FALSE;
+        }
+    }
+
+    return NS_TRUE;
+}
+/*}}}*/
+
+/*{{{ ora_call_block*/
+/* Get the anonymous block calling a signature with the arguments
+   passed, generating it on first use.  Arguments are passed by name,
+   bind variables are numbered in the order of ora_call_bind(). */
+static void
+ora_call_block(ora_call_entry_t * entry, ora_call_sig_t * sig,
+               int objc, Tcl_Obj *const* objv, Tcl_DString * dsPtr)
+{
+    Tcl_HashEntry *hPtr;
+    Tcl_DString    mask;
+    int            i, isNew;
+
+    Tcl_DStringInit(&mask);
+    for (i = 0; i < sig->n_args; i++) {
+        int given_p = (i < objc
+                       && !(sig->args[i].has_default
+                            && strcmp(Tcl_GetString(objv[i]), "--") == 0));
+
+        Tcl_DStringAppend(&mask, given_p ? "y" : "n", 1);
+    }
+
+    Ns_MutexLock(&call_cache.lock);
+    hPtr = Tcl_CreateHashEntry(&sig->blocks, Tcl_DStringValue(&mask), &isNew);
+    if (isNew) {
+        Tcl_DString block;
+        char        buf[TCL_INTEGER_SPACE + 8];
+        int         n = 0, first;
+
+        Tcl_DStringInit(&block);
+        Tcl_DStringAppend(&block, "BEGIN ", TCL_INDEX_NONE);
+        if (sig->ret != NULL) {
+            snprintf(buf, sizeof(buf), ":%d := ", ++n);
+            Tcl_DStringAppend(&block, buf, TCL_INDEX_NONE);
+        }
+        Tcl_DStringAppend(&block, entry->name, TCL_INDEX_NONE);
+        first = n;
+        for (i = 0; i < sig->n_args; i++) {
+            if (Tcl_DStringValue(&mask)[i] == 'n') {
+                continue;
+            }
+            Tcl_DStringAppend(&block, n == first ? "(\"" : ", \"", TCL_INDEX_NONE);
+            Tcl_DStringAppend(&block, sig->args[i].name, TCL_INDEX_NONE);
+            snprintf(buf, sizeof(buf), "\" => :%d", ++n);
+            Tcl_DStringAppend(&block, buf, TCL_INDEX_NONE);
+        }
+        if (n > first) {
+            Tcl_DStringAppend(&block, ")", 1);
+        }
+        Tcl_DStringAppend(&block, "; END;", TCL_INDEX_NONE);
+
+        Tcl_SetHashValue(hPtr, Ns_StrDup(Tcl_DStringValue(&block)));
+        Tcl_DStringFree(&block);
+    }
+    Tcl_DStringAppend(dsPtr, Tcl_GetHashValue(hPtr), TCL_INDEX_NONE);
+    Ns_MutexUnlock(&call_cache.lock);
+
+    Tcl_DStringFree(&mask);
+}
+/*}}}*/
+
+/*{{{ ora_call_parse_date*/
+/* Parse a date argument of [ns_ora call]: YYYY-MM-DD, optionally
+   followed by HH:MI or HH:MI:SS. */
+static int
+ora_call_parse_date(const char *value, OCIDate * date)
+{
+    int year, month, day, hour = 0, min = 0, sec = 0, n;
+
+    n = sscanf(value, "%d-%d-%d%*[ T]%d:%d:%d",
+               &year, &month, &day, &hour, &min, &sec);
+    if (n != 3 && n != 5 && n != 6) {
+        return NS_FALSE;
+    }
+    if (year < 1 || year > 9999 || month < 1 || month > 12
+        || day < 1 || day > 31 || hour < 0 || hour > 23
+        || min < 0 || min > 59 || sec < 0 || sec > 59) {
+        return NS_FALSE;
+    }
+
+    OCIDateSetDate(date, year, month, day);
+    OCIDateSetTime(date, hour, min, sec);
+
+    return NS_TRUE;
+}
+/*}}}*/
+
+/*{{{ ora_call_bind*/
+/* Bind an argument of [ns_ora call] with its declared type.  valueObj
+   is the value of an IN argument, the variable name of an OUT or IN
+   OUT argument, NULL for the return value.  Empty values and unset IN
+   OUT variables are NULL.  Integers are bound as such, other numbers
+   and strings as text, LOBs as temporary LOBs. */
+static int
+ora_call_bind(Tcl_Interp * interp, Ns_DbHandle * dbh, ora_call_bind_t * bind,
+              Tcl_Obj * valueObj, ub4 position, const char *query)
+{
+    ora_connection_t *connection = dbh->connection;
+    ora_call_arg_t   *arg = bind->arg;
+    oci_status_t      oci_status;
+    Tcl_Obj          *inObj = NULL;
+    const char       *value = NULL;
+    TCL_SIZE_T        length = 0;
+    dvoid            *valuep;
+    sb4               value_sz;
+    ub2               dty;
+    int               out_p = (arg->mode != OCI_TYPEPARAM_IN);
+
+    if (arg->mode == OCI_TYPEPARAM_IN) {
+        inObj = valueObj;
+    } else if (arg->mode == OCI_TYPEPARAM_INOUT) {
+        inObj = Tcl_ObjGetVar2(interp, valueObj, NULL, 0);
+    }
+    bind->varObj = out_p ? valueObj : NULL;
+
+    if (inObj != NULL && arg->type != SQLT_CLOB && arg->type != SQLT_BLOB) {
+        value = Tcl_GetStringFromObj(inObj, &length);
+    }
+    bind->ind = (value == NULL || length == 0) ? -1 : 0;
+
+    if (arg->type == SQLT_TAB) {
+        fetch_buffer_t *table;
+
+        /* an index-by table, bound as an array with all elements */
+        if (out_p) {
+            Tcl_AppendResult(interp, "OUT table argument ", arg->name,
+                             " is not supported by ns_ora call", (char*)0L);
+            return TCL_ERROR;
+        }
+        table = bind->table = ns_calloc(1u, sizeof(fetch_buffer_t));
+        if (ora_table_values(interp, table, valueObj, arg->elem_type,
+                             arg->name) != TCL_OK) {
+            return TCL_ERROR;
+        }
+        oci_status = OCIBindByPos(connection->stmt,
+                                  &bind->bind,
+                                  connection->err,
+                                  position,
+                                  table->buf, (sb4)table->size,
+                                  table->external_type,
+                                  table->is_nulls, table->fetch_lengths, NULL,
+                                  table->curele > 0u ? table->curele : 1u,
+                                  &table->curele, OCI_DEFAULT);
+        if (tcl_error_p(lexpos(), interp, dbh, "OCIBindByPos", query, oci_status)) {
+            return TCL_ERROR;
+        }
+        return TCL_OK;
+    }
+
+    if (ora_call_number_type_p(arg->type) && !out_p && bind->ind == 0) {
+        char *end;
+
+        errno = 0;
+        bind->int_value = (sb8)strtoll(value, &end, 10);
+        if (*end == '\0' && errno == 0) {
+            dty = SQLT_INT;
+            valuep = &bind->int_value;
+            value_sz = (sb4)sizeof(sb8);
+            goto bind_value;
+        }
+    }
+
+    switch (arg->type) {
+        case SQLT_CHR:
+        case SQLT_AFC:
+        case SQLT_VCS:
+        case SQLT_AVC:
+        case SQLT_NUM:
+        case SQLT_INT:
+        case SQLT_FLT:
+        case SQLT_VNU:
+        case SQLT_UIN:
+        case SQLT_BFLOAT:
+        case SQLT_BDOUBLE:
+        case SQLT_IBFLOAT:
+        case SQLT_IBDOUBLE:
+            dty = SQLT_STR;
+            if (out_p) {
+                size_t size = ora_call_number_type_p(arg->type)
+                    ? ORA_CALL_NUMBER_SIZE : ORA_CALL_STRING_SIZE;
+
+                if ((size_t)length >= size) {
+                    Tcl_AppendResult(interp, "value of argument ", arg->name,
+                                     " too long", (char*)0L);
+                    return TCL_ERROR;
+                }
+                bind->buf = Ns_Malloc(size);
+                memcpy(bind->buf, value != NULL ? value : "", (size_t)length + 1u);
+                valuep = bind->buf;
+                value_sz = (sb4)size;
+            } else {
+                valuep = (dvoid *)value;
+                value_sz = (sb4)length + 1;
             }
             break;
 
-        case instr_state:
-            if (*p == '\''
-                && (lastchar != '\'' || current_string_length == 0)) {
-                state = base_state;
+        case SQLT_DAT:
+            if (bind->ind == 0 && !ora_call_parse_date(value, &bind->date_value)) {
+                Tcl_AppendResult(interp, "invalid date \"", value,
+                                 "\" for argument ", arg->name, (char*)0L);
+                return TCL_ERROR;
             }
-            current_string_length++;
+            dty = SQLT_ODT;
+            valuep = &bind->date_value;
+            value_sz = (sb4)sizeof(OCIDate);
             break;
 
-        case bind_state:
-            if (*p == '=') {
-                state = base_state;
-                bp = bindbuf;
-            } else if (!
-                       (*p == '_' || *p == '$' || *p == '#'
-                        || isalnum((int) *p))) {
-                *bp = '\0';
-                elt = string_list_elt_new(Ns_StrDup(bindbuf));
-                if (tail == 0) {
-                    head = tail = elt;
-                } else {
-                    tail->next = elt;
-                    tail = elt;
+        case SQLT_CLOB:
+        case SQLT_BLOB:
+            oci_status = OCIDescriptorAlloc(connection->env,
+                                            (dvoid **)&bind->lob,
+                                            OCI_DTYPE_LOB, 0, NULL);
+            if (tcl_error_p(lexpos(), interp, dbh, "OCIDescriptorAlloc", query, oci_status)) {
+                bind->lob = NULL;
+                return TCL_ERROR;
+            }
+            if (inObj != NULL) {
+                value = lob_value_bytes(inObj, arg->type == SQLT_BLOB, &length);
+                bind->ind = (length == 0) ? -1 : 0;
+            }
+            if (bind->ind == 0) {
+                oraub8 byte_amt = (oraub8)length, char_amt = 0u;
+
+                oci_status = OCILobCreateTemporary(connection->svc,
+                                                   connection->err,
+                                                   bind->lob, 0, SQLCS_IMPLICIT,
+                                                   arg->type == SQLT_BLOB
+                                                   ? OCI_TEMP_BLOB : OCI_TEMP_CLOB,
+                                                   NS_FALSE, OCI_DURATION_SESSION);
+                if (tcl_error_p(lexpos(), interp, dbh, "OCILobCreateTemporary", query, oci_status)) {
+                    return TCL_ERROR;
+                }
+                bind->temporary_p = NS_TRUE;
+
+                oci_status = OCILobWriteAppend2(connection->svc, connection->err,
+                                                bind->lob, &byte_amt, &char_amt,
+                                                (dvoid *)value, (oraub8)length,
+                                                OCI_ONE_PIECE, NULL, NULL, 0,
+                                                SQLCS_IMPLICIT);
+                if (tcl_error_p(lexpos(), interp, dbh, "OCILobWriteAppend2", query, oci_status)) {
+                    return TCL_ERROR;
                 }
-                state = base_state;
-                p--;
-            } else {
-                *bp++ = *p;
             }
+            dty = arg->type;
+            valuep = &bind->lob;
+            value_sz = (sb4)sizeof(OCILobLocator *);
             break;
+
+        default: {
+            char buf[TCL_INTEGER_SPACE];
+
+            snprintf(buf, sizeof(buf), "%u", (unsigned)arg->type);
+            Tcl_AppendResult(interp, *arg->name != '\0' ? arg->name : "return value",
+                             " has a type not supported by ns_ora call (", buf, ")",
+                             (char*)0L);
+            return TCL_ERROR;
         }
     }
 
-    if (state == bind_state) {
-        *bp = '\0';
-        elt = string_list_elt_new(Ns_StrDup(bindbuf));
-        if (tail == 0) {
-            head = tail = elt;
-        } else {
-            tail->next = elt;
-            tail = elt;
-        }
+ bind_value:
+    oci_status = OCIBindByPos(connection->stmt,
+                              &bind->bind,
+                              connection->err,
+                              position,
+                              valuep, value_sz, dty,
+                              &bind->ind,
+                              NULL, NULL, 0, NULL, OCI_DEFAULT);
+    if (tcl_error_p(lexpos(), interp, dbh, "OCIBindByPos", query, oci_status)) {
+        return TCL_ERROR;
     }
 
-    return head;
+    return TCL_OK;
 }
 /*}}}*/
 
-/*{{{ downcase */
-static void
-downcase(char *s)
+/*{{{ ora_call_value*/
+/* The value of an OUT or IN OUT argument after the call */
+static Tcl_Obj *
+ora_call_value(Tcl_Interp * interp, Ns_DbHandle * dbh, ora_call_bind_t * bind)
 {
-    for (; *s; s++)
-        *s = (char)tolower(*s);
+    ora_connection_t *connection = dbh->connection;
+    Tcl_Obj          *valueObj;
+
+    if (bind->ind == -1) {
+        return Tcl_NewObj();
+    }
+
+    switch (bind->arg->type) {
+        case SQLT_DAT: {
+            sb2  year;
+            ub1  month, day, hour, min, sec;
+            char buf[32];
+
+            OCIDateGetDate(&bind->date_value, &year, &month, &day);
+            OCIDateGetTime(&bind->date_value, &hour, &min, &sec);
+            snprintf(buf, sizeof(buf), "%04d-%02d-%02d %02d:%02d:%02d",
+                     year, month, day, hour, min, sec);
+            return Tcl_NewStringObj(buf, TCL_INDEX_NONE);
+        }
+
+        case SQLT_CLOB:
+        case SQLT_BLOB:
+            /* a LOB built by the procedure is a temporary one, too */
+            if (!bind->temporary_p) {
+                OCILobIsTemporary(connection->env, connection->err,
+                                  bind->lob, &bind->temporary_p);
+            }
+            valueObj = lob_read_obj(interp, dbh, bind->lob,
+                                    bind->arg->type == SQLT_BLOB, 0u, 0u);
+            return valueObj;
+
+        default:
+            return Tcl_NewStringObj(bind->buf, TCL_INDEX_NONE);
+    }
 }
 /*}}}*/
 
-/*{{{ nilp */
-/* nilp is misnamed to some extent; handle empty or overly long strings
- *  before printing them out to logs
- */
-static const char *
-nilp(const char *s)
+/*{{{ ora_call_unbind*/
+/* Free what ora_call_bind() allocated.  If the connection was closed
+   after an error, its descriptors went with the environment. */
+static void
+ora_call_unbind(ora_connection_t * connection, ora_call_bind_t * bind)
 {
-    if (s == 0)
-        return "[nil]";
-
-    if ((int) strlen(s) > max_string_log_length)
-        return "[too long]";
+    oci_status_t oci_status;
 
-    return s;
+    if (bind->lob != NULL && connection != NULL) {
+        if (bind->temporary_p) {
+            oci_status = OCILobFreeTemporary(connection->svc, connection->err,
+                                             bind->lob);
+            oci_error_p(lexpos(), connection->dbh, "OCILobFreeTemporary", 0,
+                        oci_status);
+        }
+        oci_status = OCIDescriptorFree(bind->lob, OCI_DTYPE_LOB);
+        oci_error_p(lexpos(), connection->dbh, "OCIDescriptorFree", 0, oci_status);
+    }
+    if (bind->table != NULL) {
+        ora_table_free(bind->table);
+    }
+    Ns_Free(bind->buf);
 }
 /*}}}*/
 
-/*
- * Several helper functions that get used everywhere.
- */
-
-#ifdef FOR_CASSANDRACLE
-/*{{{ allow_sql_p*/
+/*{{{ handle_builtins*/
 
-/*
- * Because Cassandracle (http://www.arsdigita.com/free-tools/cassandracle.html)
- * runs with DBA privileges, we need to prevent anything
- * Bad from happening, whether through malicious intent or just plain
- * human sloppiness.  Selects are pretty safe, so only those are allowed
- * if FOR_CASSANDRACLE is defined, disallow any sql that does not
- * begin with "select".
- *
- */
+/* this gets called on every query or DML.  Usually, it will
+   return NS_OK ("I did nothing").  If the SQL is one of our special
+   cases, e.g., "begin transaction", that aren't supposed to go through
+   to Oracle, we handle it and return NS_DML ("I handled it and nobody
+   else has do anything").
 
-static int allow_sql_p(Ns_DbHandle * dbh, char *sql, int display_sql_p)
+   return NS_ERROR on error
+*/
+static int
+handle_builtins(Ns_DbHandle * dbh, char *sql)
 {
-    char *trimmedSql = sql;
+    oci_status_t oci_status;
+    ora_connection_t *connection;
 
-    /* trim off leading white space. (the int cast is necessary for the HP) */
-    while (*trimmedSql && isspace((int) *trimmedSql)) {
-        trimmedSql++;
-    }
+    ns_ora_log(lexpos(), "entry (dbh %p, sql %s)", dbh, nilp(sql));
 
+    /* args should be correct */
+    connection = dbh->connection;
 
-    /* (damned if you do, damned if you don't.  doing a
-     * strlen("select") each time here is wasteful of CPU which
-     * would offend the sensibilities of half the world.  hard-coding
-     * the "6" offends the other half)
-     */
-    if (strncasecmp(trimmedSql, "select", 6) != 0) {
-        int bufsize = strlen(sql) + 4096;
+    if (!strcasecmp(sql, "begin transaction")) {
+        ns_ora_log(lexpos(), "builtin `begin transaction`");
 
-        /* don't put a 20,000 byte buffer on the stack here, since this case
-         * should be very rare.  allocate enough space for the sql
-         * plus some to handle the other text.  (4K should be enough to
-         * handle the lexpos() call)
-         */
-        char *buf = Ns_Malloc(bufsize);
+        connection->mode = transaction;
 
-        /* means someone is trying to do something other than a select.
-         * Bad!  Very Bad!
-         */
-        if (display_sql_p) {
-            snprintf(buf, bufsize, "%s:%d:%s: Sql Rejected: %s",
-                     lexpos(), trimmedSql);
-        } else {
-            snprintf(buf, bufsize, "%s:%d:%s: Sql Rejected", lexpos());
+        return NS_DML;
+
+    } else if (!strcasecmp(sql, "end transaction")) {
+        ns_ora_log(lexpos(), "builtin `end transaction`");
+
+        oci_status = OCITransCommit(connection->svc,
+                                    connection->err, OCI_DEFAULT);
+        if (oci_error_p(lexpos(), dbh, "OCITransCommit", sql, oci_status)) {
+            Ns_OracleFlush(dbh);
+            return NS_ERROR;
         }
 
-        Ns_Log(Error, "%s", buf);
+        connection->mode = autocommit;
+        return NS_DML;
 
-        Ns_DbSetException(dbh, "ORA", buf);
+    } else if (!strcasecmp(sql, "abort transaction")) {
+        ns_ora_log(lexpos(), "builtin `abort transaction`");
 
-        Ns_Free(buf);
+        oci_status = OCITransRollback(connection->svc,
+                                      connection->err, OCI_DEFAULT);
+        if (oci_error_p(lexpos(), dbh, "OCITransRollback", sql, oci_status)) {
+            Ns_OracleFlush(dbh);
+            return NS_ERROR;
+        }
 
-        return NS_FALSE;
+        connection->mode = autocommit;
+        return NS_DML;
     }
 
-    return NS_TRUE;
+    if (!allow_sql_p(dbh, sql, NS_FALSE)) {
+        Ns_OracleFlush(dbh);
+        return NS_ERROR;
+    }
 
-}                               /* allow_sql_p */
+    /* not handled */
+    return NS_OK;
+}
 /*}}}*/
-#endif
 
-/*{{{ oci_error_p */
-/* we call this after every OCI call, i.e., a couple of times during
-   each fetch of a row
-*/
-static int
-oci_error_p(const char *file, int line, const char *fn,
-            Ns_DbHandle *dbh, const char *ocifn, const char *query,
-            oci_status_t oci_status)
+/*{{{ ora_append_buf_to_dstring*/
+/* OCILobRead2 callback for LOBs read into memory, by ora_get_row and
+   spool_write_lob(). */
+static sb4
+ora_append_buf_to_dstring(dvoid * ctxp, const dvoid *bufp, oraub8 len,
+                          ub1 piece, dvoid ** UNUSED(changed_bufpp),
+                          oraub8 * UNUSED(changed_lenp))
 {
-    ora_connection_t *connection = 0;
-    ub2               offset = 0;
-    sb4               errorcode = 0;
+    Tcl_DString *retval = (Tcl_DString *) ctxp;
 
-    char             *msgbuf;
-    char             *buf;
+    switch (piece) {
+        case OCI_LAST_PIECE:
+        case OCI_FIRST_PIECE:
+        case OCI_NEXT_PIECE:
+            Tcl_DStringAppend(retval, (char *) bufp, (TCL_SIZE_T)len);
+            return OCI_CONTINUE;
 
-    if (dbh) {
-        connection = dbh->connection;
+        default:
+            return OCI_ERROR;
     }
+}
+/*}}}*/
 
-    if (oci_status == OCI_SUCCESS)
-        return 0;
-
-    /* Until we get the logging situation worked out, return
-     * OCI_SUCCESS_WITH_INFO as a pure success.
-     */
-    if (oci_status == OCI_SUCCESS_WITH_INFO)
-        return 0;
+/*{{{ no_data*/
 
-    /* If the query is long, nilp will return "[too long]";
-     * if null (we're not doing a query yet, e.g., could
-     * be opening db), then "[nil]"
-     */
-    query = nilp(query);
+/*  This is a function that we register as a callback with Oracle for
+ *  DML statements that do RETURNING FOOBAR INTO ... (this was
+ *  necessitated by the clob_dml statement which was necessitated by
+ *  Oracle's stupid SQL parser that can't handle string literals longer
+ *  than 4000 chars)
+ */
 
-    msgbuf = (char *) Ns_Malloc(STACK_BUFFER_SIZE * sizeof(char));
-    buf = (char *) Ns_Malloc(STACK_BUFFER_SIZE * sizeof(char));
-    *msgbuf = 0;
+static sb4
+no_data(dvoid *UNUSED(ctxp), OCIBind *UNUSED(bindp),
+        ub4 UNUSED(iter), ub4 UNUSED(index), dvoid **bufpp, ub4 *alenpp, ub1 *piecep,
+        dvoid **indpp)
+{
+    ns_ora_log(lexpos(), "entry");
 
-    switch (oci_status) {
+    *bufpp = (dvoid *) 0;
+    *alenpp = 0;
+    null_ind = -1;
+    *indpp = (dvoid *) & null_ind;
+    *piecep = OCI_ONE_PIECE;
 
-        case OCI_NEED_DATA:
-            snprintf(msgbuf, STACK_BUFFER_SIZE, "%s", "Error - OCI_NEED_DATA");
-            break;
-        case OCI_NO_DATA:
-            snprintf(msgbuf, STACK_BUFFER_SIZE, "%s", "Error - OCI_NO_DATA");
-            break;
-        case OCI_ERROR:
+    return OCI_CONTINUE;
+}
+/*}}}*/
 
-            if (connection == 0)
-                snprintf(msgbuf, STACK_BUFFER_SIZE, "%s", "NULL connection");
-            else {
-                oci_status_t oci_status1;
-                char         errorbuf[1024];
+/*{{{ lob_spool_write*/
+/* Append to the spool file of spool_write_lob(), gzipped when the spool
+   compresses; flush writes the rest of the gzip stream.  Short writes
+   are retried; any other error is remembered in the spool context. */
+static int
+lob_spool_write(lob_spool_t * spool, const char *p, size_t len, int flush)
+{
+    ssize_t written;
+
+    if (spool->compress_level > 0) {
+        struct iovec iov;
+
+        iov.iov_base = (void *)p;
+        iov.iov_len = len;
+        Tcl_DStringSetLength(&spool->zbuf, 0);
+        if (Ns_CompressBufsGzip(&spool->stream, &iov, (len > 0u) ? 1 : 0,
+                                &spool->zbuf, spool->compress_level,
+                                flush) != NS_OK) {
+            spool->errnum = EIO;
+            return NS_ERROR;
+        }
+        p = Tcl_DStringValue(&spool->zbuf);
+        len = (size_t)Tcl_DStringLength(&spool->zbuf);
+    }
 
-                oci_status1 = OCIErrorGet(connection->err,
-                                          1,
-                                          NULL,
-                                          &errorcode,
-                                          (OraText *)errorbuf,
-                                          sizeof errorbuf, OCI_HTYPE_ERROR);
-                if (oci_status1) {
-                    snprintf(msgbuf, STACK_BUFFER_SIZE, "%s",
-                             "`OCIErrorGet ()' error");
-                } else {
-                    snprintf(msgbuf, STACK_BUFFER_SIZE, "%s", errorbuf);
-                }
+    while (len > 0u) {
+        written = write(spool->fd, p, len);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            spool->errnum = errno;
+            return NS_ERROR;
+        }
+        p += written;
+        len -= (size_t)written;
+        spool->length += (size_t)written;
+    }
 
-                oci_status1 = OCIAttrGet(connection->stmt,
-                                         OCI_HTYPE_STMT,
-                                         &offset,
-                                         NULL,
-                                         OCI_ATTR_PARSE_ERROR_OFFSET,
-                                         connection->err);
+    return NS_OK;
+}
+/*}}}*/
 
-                if (errorcode == 1041 ||
-                    errorcode == 3113 ||
-                    errorcode == 12571 ||
-                    errorcode == 28 ||
-                    errorcode == 1012 ||
-                    errorcode == 24324) {
+/*{{{ ora_append_buf_to_fd*/
+/* OCILobRead2 callback used when a LOB is spooled into a file by
+   spool_write_lob().  A write error stops the LOB read. */
+static sb4
+ora_append_buf_to_fd(dvoid * ctxp, const dvoid *bufp, oraub8 len,
+                     ub1 piece, dvoid ** UNUSED(changed_bufpp),
+                     oraub8 * UNUSED(changed_lenp))
+{
+    lob_spool_t *spool = (lob_spool_t *) ctxp;
 
-                    /* 3113 is 'end-of-file on communications channel', which
-                     *      happens if the oracle process dies
-                     * 12571 is TNS:packet writer failure, which also happens if
-                     *      the oracle process dies
-                     * 1041 is the dreaded "hostdef extension doesn't exist error,
-                     *      which means the db handle is screwed and can't be used
-                     *      for anything else.
-                     *
-                     * In either case, close and re-open the handle to clear the
-                     * error condition
-                     */
-                    Ns_OracleFlush(dbh);
-                    Ns_OracleCloseDb(dbh);
-               } else if (errorcode == 20 || errorcode == 1034) {
-                    /* ora-00020 means 'maximum number of processes exceeded.
-                     * ora-01034 means 'oracle not available'.
-                     *           we want to make sure the oracleSID process
-                     *           goes away so we don't make the problem worse
-                     */
-                    Ns_OracleCloseDb(dbh);
-                } else if (oci_status1) {
-                    Ns_Log(Warning, "nsoracle: Unhandled error status %d after OCIAttrGet()",errorcode);
-                }
+    switch (piece) {
+        case OCI_LAST_PIECE:
+        case OCI_FIRST_PIECE:
+        case OCI_NEXT_PIECE:
+            if (lob_spool_write(spool, bufp, (size_t)len, NS_FALSE) != NS_OK) {
+                return OCI_ERROR;
             }
-            break;
-        case OCI_INVALID_HANDLE:
-            snprintf(msgbuf, STACK_BUFFER_SIZE, "%s", "Error - OCI_INVALID_HANDLE");
-            break;
-        case OCI_STILL_EXECUTING:
-            snprintf(msgbuf, STACK_BUFFER_SIZE, "%s", "Error - OCI_STILL_EXECUTING");
-            break;
-        case OCI_CONTINUE:
-            snprintf(msgbuf, STACK_BUFFER_SIZE, "%s", "Error - OCI_CONTINUE");
-            break;
+            return OCI_CONTINUE;
+
+        default:
+            return OCI_ERROR;
     }
+}
+/*}}}*/
 
-    if (((errorcode == 900) || (offset > 0)) && (strlen(query) >= offset)) {
-        /* ora-00900 is invalid SQL statement
-         *           it seems to be the msg most likely to be a parse
-         *           error that sets offset to 0
-         */
-        int len;
-        len = snprintf(buf, STACK_BUFFER_SIZE,
-                       "%s:%d:%s: error in `%s ()': %s\nSQL: ",
-                       file, line, fn, ocifn, msgbuf);
-        if (offset > 0)
-            len += snprintf(buf + len, STACK_BUFFER_SIZE - len, "%.*s",
-                            offset - 1, query);
+/*{{{ list_element_put_data*/
+/* For use by OCIBindDynamic: returns the iter'th element (0-relative)
+   of the context pointer taken as an array of strings (char**). */
+static sb4
+list_element_put_data(dvoid * ictxp,
+                      OCIBind * UNUSED(bindp),
+                      ub4 iter,
+                      ub4 UNUSED(index),
+                      dvoid ** bufpp,
+                      ub4 * alenp, ub1 * piecep, dvoid ** indpp)
+{
+    fetch_buffer_t *fetchbuf = ictxp;
+    const char **elements = fetchbuf->array_values;
 
-        snprintf(buf + len, STACK_BUFFER_SIZE - len, " !>>>!%s",
-                 query + offset);
-    } else {
-        snprintf(buf, STACK_BUFFER_SIZE,
-                 "%s:%d:%s: error in `%s ()': %s\nSQL: %s",
-                 file, line, fn, ocifn, msgbuf, query);
-    }
+    *bufpp = (dvoid *)elements[iter];
+    *alenp = (ub4) strlen(elements[iter]);
+    *piecep = OCI_ONE_PIECE;
+    *indpp = NULL;
 
-    Ns_Log(Error, "%s", buf);
+    return OCI_CONTINUE;
+}
+/*}}}*/
 
-    if (dbh != NULL) {
-        char exceptbuf[EXCEPTION_CODE_SIZE + 1];
+/*{{{ get_data*/
+/* another callback to register with Oracle */
+static sb4
+get_data(dvoid * ctxp, OCIBind * bindp,
+         ub4 iter, ub4 index, dvoid ** bufpp, ub4 ** alenp, ub1 * piecep,
+         dvoid ** indpp, ub2 ** rcodepp)
+{
+    Ns_DbHandle      *dbh;
+    ora_connection_t *connection;
+    fetch_buffer_t   *buf;
 
-        /* We need to call this so that AOLserver will print out the relevant
-         * error on pages served to browsers where ClientDebug is set.
-         */
-        snprintf(exceptbuf, EXCEPTION_CODE_SIZE, "%d", (int) errorcode);
-        Ns_DbSetException(dbh, exceptbuf, buf);
+    ns_ora_log(lexpos(), "entry (dbh %p; iter %d, index %d)", ctxp, iter, index);
+
+    if (iter != 0) {
+        error(lexpos(), "iter != 0");
+        return NS_ERROR;
     }
 
-    Ns_Free(msgbuf);
-    Ns_Free(buf);
+    buf = ctxp;
+    connection = buf->connection;
+    dbh = connection->dbh;
 
-    return 1;
-}
-/*}}}*/
+    if (buf->lobs == 0) {
+        oci_status_t oci_status;
+        int i;
 
-/*{{{ tcl_error_p */
-/* tcl_error_p is only used for ns_ora and potentially other new Tcl commands
-   does not log the error and does not Ns_DbSetException but instead just
-   tells the Tcl interpreter about it
- */
-static int
-tcl_error_p(const char *file, int line, const char *fn,
-            Tcl_Interp *interp,
-            Ns_DbHandle *dbh, const char *ocifn, const char *query,
-            oci_status_t oci_status)
-{
-    char *msgbuf;
-    char *buf;
-    ora_connection_t *connection = 0;
-    ub2 offset = 0;
-    sb4 errorcode = 0;
+        oci_status = OCIAttrGet(bindp,
+                                OCI_HTYPE_BIND,
+                                (oci_attribute_t *) & buf->n_rows,
+                                NULL,
+                                OCI_ATTR_ROWS_RETURNED, connection->err);
+        if (oci_error_p(lexpos(), dbh, "OCIAttrGet", 0, oci_status))
+            return NS_ERROR;
 
-    if (dbh)
-        connection = dbh->connection;
+        ns_ora_log(lexpos(), "n_rows %d", buf->n_rows);
 
-    /* success */
-    if (oci_status == OCI_SUCCESS)
-        return 0;
+        buf->lobs = Ns_Malloc(buf->n_rows * sizeof *buf->lobs);
 
-    query = nilp(query);
-    msgbuf = (char *) Ns_Malloc(STACK_BUFFER_SIZE * sizeof(char));
-    buf = (char *) Ns_Malloc(STACK_BUFFER_SIZE * sizeof(char));
-    *msgbuf = 0;
+        for (i = 0; i < (int) buf->n_rows; i++)
+            buf->lobs[i] = 0;
 
-    switch (oci_status) {
-    case OCI_SUCCESS_WITH_INFO:
-        snprintf(msgbuf, STACK_BUFFER_SIZE,"%s",
-                 "Error - OCI_SUCCESS_WITH_INFO");
-        break;
-    case OCI_NEED_DATA:
-        snprintf(msgbuf, STACK_BUFFER_SIZE, "%s", "Error - OCI_NEED_DATA");
-        break;
-    case OCI_NO_DATA:
-        snprintf(msgbuf, STACK_BUFFER_SIZE, "%s", "Error - OCI_NO_DATA");
-        break;
-    case OCI_ERROR:
-        if (connection == 0)
-            snprintf(msgbuf, STACK_BUFFER_SIZE, "%s", "NULL connection");
-        else {
-            char errorbuf[512];
-            oci_status_t oci_status1;
+        for (i = 0; i < (int) buf->n_rows; i++) {
+            oci_status = OCIDescriptorAlloc(connection->env,
+                                            (oci_descriptor_t *) & buf->
+                                            lobs[i], OCI_DTYPE_LOB, 0, 0);
+            if (oci_error_p(lexpos(), dbh, "OCIDescriptorAlloc", 0, oci_status))
+                return NS_ERROR;
+        }
+    }
 
-            oci_status1 = OCIErrorGet(connection->err,
-                                      1,
-                                      NULL,
-                                      &errorcode,
-                                      (OraText *)errorbuf,
-                                      sizeof errorbuf, OCI_HTYPE_ERROR);
+    *bufpp = (dvoid *) buf->lobs[index];
 
-            if (oci_status1) {
-                snprintf(msgbuf, STACK_BUFFER_SIZE, "%s", "`OCIErrorGet ()' error");
-            } else {
-                snprintf(msgbuf, STACK_BUFFER_SIZE, "%s", errorbuf);
-            }
+    *alenp = &rl;
+    null_ind = -1;
+    *indpp = (dvoid *) & null_ind;
+    *piecep = OCI_ONE_PIECE;
+    *rcodepp = &rc;
 
-            oci_status1 = OCIAttrGet(connection->stmt,
-                                     OCI_HTYPE_STMT,
-                                     &offset,
-                                     NULL,
-                                     OCI_ATTR_PARSE_ERROR_OFFSET,
-                                     connection->err);
+    return OCI_CONTINUE;
+}
+/*}}}*/
 
-            if (errorcode == 1041 || errorcode == 3113
-                || errorcode == 12571) {
-                /* 3113 is 'end-of-file on communications channel', which
-                 *      happens if the oracle process dies
-                 * 12571 is TNS:packet writer failure, which also happens if
-                 *      the oracle process dies
-                 * 1041 is the dreaded "hostdef extension doesn't exist error,
-                 *      which means the db handle is screwed and can't be used
-                 *      for anything else.
-                 * In either case, close and re-open the handle to clear the
-                 * error condition
-                 */
-                Ns_OracleFlush(dbh);
-                Ns_OracleCloseDb(dbh);
-                Ns_OracleOpenDb(dbh);
-            } else if (oci_status1) {
-                Ns_Log(Warning, "nsoracle: Unhandled error status %d after OCIAttrGet()",errorcode);
+/*{{{ lob_source_read*/
+/* Provide the next piece of a LOB source: a pointer into the content
+   for sources in memory, the piece read into the source buffer for
+   files. */
+static int
+lob_source_read(lob_source_t * source, void **bufpp, size_t length)
+{
+    if (source->data != NULL) {
+        *bufpp = (void *)(source->data + source->offset);
+    } else {
+        size_t  done = 0u;
+        ssize_t n;
+
+        while (done < length) {
+            n = pread(source->fd, (char *)source->buf + done, length - done,
+                      (off_t)(source->offset + done));
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                source->errnum = (n < 0) ? errno : EIO;
+                return NS_ERROR;
             }
+            done += (size_t)n;
         }
-        break;
-    case OCI_INVALID_HANDLE:
-        snprintf(msgbuf, STACK_BUFFER_SIZE, "%s", "Error - OCI_INVALID_HANDLE");
-        break;
-    case OCI_STILL_EXECUTING:
-        snprintf(msgbuf, STACK_BUFFER_SIZE, "%s", "Error - OCI_STILL_EXECUTING");
-        break;
-    case OCI_CONTINUE:
-        snprintf(msgbuf, STACK_BUFFER_SIZE, "%s", "Error - OCI_CONTINUE");
-        break;
+        *bufpp = source->buf;
     }
+    source->offset += length;
 
-    snprintf(buf, STACK_BUFFER_SIZE,
-             "%s:%d:%s: error in `%s ()': %s\nSQL: %s", file, line, fn,
-             ocifn, msgbuf, query);
+    return NS_OK;
+}
+/*}}}*/
 
-    Ns_Log(Error, "SQL(): %s", buf);
+/*{{{ lob_source_next_piece*/
+/* OCILobWrite2 callback: hand out the next piece of a LOB source. */
+static sb4
+lob_source_next_piece(dvoid * ctxp, dvoid * UNUSED(bufp), oraub8 * lenp,
+                      ub1 * piece, dvoid ** changed_bufpp,
+                      oraub8 * changed_lenp)
+{
+    lob_source_t *source = ctxp;
+    size_t        length = source->length - source->offset;
+    void         *next;
 
-    Tcl_AppendResult(interp, buf, (char*)0L);
+    if (length > lob_buffer_size) {
+        length = lob_buffer_size;
+        *piece = OCI_NEXT_PIECE;
+    } else {
+        *piece = OCI_LAST_PIECE;
+    }
 
-    /* error */
-    Ns_Free(msgbuf);
-    Ns_Free(buf);
+    if (lob_source_read(source, &next, length) != NS_OK) {
+        return OCI_ERROR;
+    }
 
-    return 1;
+    *lenp = (oraub8)length;
+    *changed_bufpp = next;
+    *changed_lenp = (oraub8)length;
+
+    return OCI_CONTINUE;
 }
 /*}}}*/
 
-/*{{{ error */
-/* For logging errors that come from C code rather than
- * Oracle unhappiness.
+/*{{{ stream_write_lob_source*/
+/* Write the whole content of a LOB source into the LOB.  Content in
+   memory goes in one piece straight from where it is, files are fed
+   to OCILobWrite2 piece by piece through a callback.
  */
-static void
-error(const char *file, int line, const char *fn, const char *fmt, ...)
+static int
+stream_write_lob_source(Tcl_Interp * interp, Ns_DbHandle * dbh,
+                        OCILobLocator * lobl, lob_source_t * source,
+                        ora_connection_t * connection)
 {
-    char *buf1;
-    char *buf;
-    va_list ap;
+    oraub8       byte_amt = source->length;
+    oraub8       char_amt = 0;
+    size_t       length;
+    void        *bufp;
+    ub1          piece;
+    oci_status_t oci_status;
+    int          status = NS_ERROR;
 
-    buf1 = (char *) Ns_Malloc(STACK_BUFFER_SIZE * sizeof(char));
-    buf = (char *) Ns_Malloc(STACK_BUFFER_SIZE * sizeof(char));
+    source->offset = 0u;
+    source->errnum = 0;
 
-    va_start(ap, fmt);
-    vsprintf(buf1, fmt, ap);
-    va_end(ap);
+    /* if no bytes, bypass the LobWrite to insert a NULL */
+    if (source->length == 0u) {
+        return NS_OK;
+    }
 
-    snprintf(buf, STACK_BUFFER_SIZE, "%s:%d:%s: %s", file, line, fn, buf1);
+    if (source->data != NULL || source->length <= lob_buffer_size) {
+        length = source->length;
+        piece = OCI_ONE_PIECE;
+    } else {
+        length = lob_buffer_size;
+        piece = OCI_FIRST_PIECE;
+    }
+    if (source->data == NULL) {
+        source->buf = Ns_Malloc(length);
+    }
 
-    Ns_Log(Error, "%s", buf);
+    ns_ora_log(lexpos(), "to do streamed write lob, amount = %lld",
+               (long long) source->length);
 
-    Ns_Free(buf1);
-    Ns_Free(buf);
+    if (lob_source_read(source, &bufp, length) != NS_OK) {
+        goto bailout;
+    }
+
+    oci_status = OCILobWrite2(connection->svc,
+                              connection->err,
+                              lobl,
+                              &byte_amt,
+                              &char_amt,
+                              1,
+                              bufp,
+                              (oraub8)length,
+                              piece,
+                              source,
+                              (piece == OCI_ONE_PIECE)
+                              ? NULL : lob_source_next_piece,
+                              0, SQLCS_IMPLICIT);
+    if (source->errnum == 0
+        && !tcl_error_p(lexpos(), interp, dbh, "OCILobWrite2", 0, oci_status)) {
+        status = NS_OK;
+    }
+
+  bailout:
+    if (source->errnum != 0) {
+        Ns_Log(Error, "%s:%d:%s Error reading LOB source: %d(%s)",
+               lexpos(), source->errnum, strerror(source->errnum));
+        Tcl_AppendResult(interp, "can't read LOB source. received error ",
+                         strerror(source->errnum), (char*)0L);
+    }
+    if (source->buf != NULL) {
+        Ns_Free(source->buf);
+        source->buf = NULL;
+    }
+
+    return status;
 }
 /*}}}*/
 
-/*{{{ log */
-/*  For optional logging of all kinds of random stuff, turn on
- *  debug in the [ns/db/driver/drivername] section of your nsd.ini
+/*{{{ stream_read_lob*/
+/* read a file from the operating system and then stuff it into the lob
  */
-static void
-ns_ora_log(const char *file, int line, const char *fn, const char *fmt, ...)
+static int
+stream_read_lob(Tcl_Interp * interp, Ns_DbHandle * dbh, int UNUSED(rowind),
+                OCILobLocator * lobl, const char *path,
+                ora_connection_t * connection)
 {
-    char   *buf, *buf1;
-    va_list ap;
+    lob_source_t source;
+    struct stat  statbuf;
+    int          status = NS_ERROR;
+    oci_status_t oci_status;
 
-    if (!debug_p) {
-        return;
+    memset(&source, 0, sizeof(source));
+
+    source.fd = open(path, O_RDONLY | EXTRA_OPEN_FLAGS);
+
+    if (source.fd == -1) {
+        Ns_Log(Error, "%s:%d:%s Error opening file %s: %d(%s)",
+               lexpos(), path, errno, strerror(errno));
+        Tcl_AppendResult(interp, "can't open file ", path,
+                         " for reading. ", "received error ",
+                         strerror(errno), (char*)0L);
+        goto bailout;
+    }
+
+    if (fstat(source.fd, &statbuf) == -1) {
+        Ns_Log(Error, "%s:%d:%s Error statting %s: %d(%s)",
+               lexpos(), path, errno, strerror(errno));
+        Tcl_AppendResult(interp, "can't stat ", path, ". ",
+                         "received error ", strerror(errno), (char*)0L);
+        goto bailout;
     }
+    source.length = (size_t)statbuf.st_size;
 
-    buf1 = (char *) Ns_Malloc(STACK_BUFFER_SIZE * sizeof(char));
-    buf = (char *) Ns_Malloc(STACK_BUFFER_SIZE * sizeof(char));
+#ifdef POSIX_FADV_SEQUENTIAL
+    (void) posix_fadvise(source.fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
 
-    va_start(ap, fmt);
-    vsprintf(buf1, fmt, ap);
-    va_end(ap);
+    status = stream_write_lob_source(interp, dbh, lobl, &source, connection);
 
-    snprintf(buf, STACK_BUFFER_SIZE, "%s:%d:%s: %s", file, line, fn, buf1);
+  bailout:
 
-    Ns_Log(Notice, "%s", buf);
+    if (source.fd != -1)
+        close(source.fd);
 
-    Ns_Free(buf1);
-    Ns_Free(buf);
+    if (status != NS_OK && connection->mode == transaction) {
+        ns_ora_log(lexpos(), "error writing lob.  rolling back transaction");
+
+        oci_status = OCITransRollback(connection->svc,
+                                      connection->err, OCI_DEFAULT);
+        tcl_error_p(lexpos(), interp, dbh, "OCITransRollback", 0,
+                    oci_status);
+    }
+
+    return status;
 }
 /*}}}*/
 
-/*{{{ malloc_fetch_buffers*/
-/*
- * malloc_fetch_buffers allocates the fetch_buffers array in the
- * specified connection.  connection->n_columns must be set to the
- * correct number before calling this function.
+/*{{{ stream_read_conn_lob*/
+/* Stuff the content of the current request into the lob, from memory
+   or, for large uploads, from the file NaviServer spooled it to.
  */
-static void
-malloc_fetch_buffers(ora_connection_t * connection)
+static int
+stream_read_conn_lob(Tcl_Interp * interp, Ns_DbHandle * dbh,
+                     OCILobLocator * lobl, ora_connection_t * connection)
 {
-    int i;
+    Ns_Conn     *conn;
+    lob_source_t source;
+    int          status;
+    oci_status_t oci_status;
 
-    connection->fetch_buffers =
-        Ns_Malloc((size_t)connection->n_columns *
-                  sizeof *connection->fetch_buffers);
+    conn = Ns_TclGetConn(interp);
+    if (conn == NULL) {
+        Ns_Log(Error, "%s:%d:%s: No AOLserver conn available", lexpos());
+        Tcl_AppendResult(interp, "No AOLserver conn available", (char*)0L);
+        return NS_ERROR;
+    }
 
-    for (i = 0; i < connection->n_columns; i++) {
-        fetch_buffer_t *fetchbuf = &connection->fetch_buffers[i];
+    memset(&source, 0, sizeof(source));
+    source.fd = -1;
+    source.length = Ns_ConnContentSize(conn);
 
-        fetchbuf->connection = connection;
+    if (Ns_ConnContentFile(conn) != NULL) {
+        source.fd = Ns_ConnContentFd(conn);
+#ifdef POSIX_FADV_SEQUENTIAL
+        if (source.fd != -1) {
+            (void) posix_fadvise(source.fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+        }
+#endif
+    } else {
+        source.data = Ns_ConnContent(conn);
+    }
 
-        fetchbuf->type = 0;
-        fetchbuf->lob = NULL;
-        fetchbuf->bind = NULL;
-        fetchbuf->def = NULL;
-        fetchbuf->size = 0;
-        fetchbuf->buf_size = 0;
-        fetchbuf->buf = NULL;
-        fetchbuf->stmt = NULL;
-        fetchbuf->array_count = 0;
-        fetchbuf->array_values = NULL;
-        fetchbuf->is_null = 0;
-        fetchbuf->fetch_length = 0;
-        fetchbuf->piecewise_fetch_length = 0;
-        fetchbuf->inout = 0;
-        fetchbuf->name = NULL;
+    if (source.length > 0u && source.data == NULL && source.fd == -1) {
+        Tcl_AppendResult(interp, "request content is not available", (char*)0L);
+        status = NS_ERROR;
+    } else {
+        status = stream_write_lob_source(interp, dbh, lobl, &source, connection);
+    }
 
-        fetchbuf->lobs = NULL;
-        fetchbuf->is_lob = 0;
-        fetchbuf->n_rows = 0;
+    if (status != NS_OK && connection->mode == transaction) {
+        ns_ora_log(lexpos(), "error writing lob.  rolling back transaction");
+
+        oci_status = OCITransRollback(connection->svc,
+                                      connection->err, OCI_DEFAULT);
+        tcl_error_p(lexpos(), interp, dbh, "OCITransRollback", 0,
+                    oci_status);
     }
 
+    return status;
 }
 /*}}}*/
 
-/*{{{ free_fetch_buffers*/
-/*
- * free_fetch_buffers frees the fetch_buffers array in the specified
- * connection.  connection->n_columns must have the same value as it
- * did when malloc_fetch_buffers was called.  The non-NULL
- * dynamically-allocated components of each fetchbuf will also be freed.
- */
-static void
-free_fetch_buffers(ora_connection_t * connection)
+/*{{{ stream_actually_write*/
+/* Write a piece of a LOB to the file or the connection.  Pieces that
+   need the output encoding or compression of the connection go
+   through Ns_ConnWriteVChars(), which does both. */
+static ssize_t
+stream_actually_write(int fd, Ns_Conn * conn, void *bufp, size_t length,
+                      int to_conn_p, int chars_p)
 {
-    if (connection != NULL && connection->fetch_buffers != NULL) {
-        Ns_DbHandle *dbh = connection->dbh;
-        int i;
-        unsigned int j;
-        oci_status_t oci_status;
-
-        for (i = 0; i < connection->n_columns; i++) {
-            fetch_buffer_t *fetchbuf = &connection->fetch_buffers[i];
-
-            if (fetchbuf->lob != NULL) {
-                oci_status =
-                    OCIDescriptorFree(fetchbuf->lob, OCI_DTYPE_LOB);
-                oci_error_p(lexpos(), dbh, "OCIDescriptorFree", 0,
-                            oci_status);
-                fetchbuf->lob = NULL;
-            }
+    ssize_t bytes_written = 0;
 
-            /*
-             * fetchbuf->bind is automatically deallocated when its
-             * statement is deallocated.
-             *
-             * Same for fetchbuf->def, I believe, though the manual
-             * doesn't say.
-             */
+    ns_ora_log(lexpos(), "entry (%d, %d, %d)", fd, length, to_conn_p);
 
-            if (fetchbuf->buf != NULL) {
-                Ns_Free(fetchbuf->buf);
-                fetchbuf->buf = NULL;
-                fetchbuf->buf_size = 0;
-            }
+    if (to_conn_p) {
+        struct iovec sbuf;
+        Ns_ReturnCode status;
 
-            if (fetchbuf->array_values != NULL) {
-                /* allocated from Tcl_SplitList so Tcl_Free it */
-                Tcl_Free((char *) fetchbuf->array_values);
-                fetchbuf->array_values = NULL;
-                fetchbuf->array_count = 0;
-            }
+        sbuf.iov_base = bufp;
+        sbuf.iov_len = length;
 
-            if (fetchbuf->lobs != 0) {
-                for (j = 0; j < fetchbuf->n_rows; j++) {
-                    oci_status = OCIDescriptorFree(fetchbuf->lobs[j],
-                                                   OCI_DTYPE_LOB);
-                    oci_error_p(lexpos(), dbh, "OCIDescriptorFree", 0,
-                                oci_status);
-                }
-                Ns_Free(fetchbuf->lobs);
-                fetchbuf->lobs = NULL;
-                fetchbuf->n_rows = 0;
-            }
+        if (!chars_p) {
+            status = Ns_ConnWriteVData(conn, &sbuf, 1, NS_CONN_STREAM);
+        } else {
+            status = Ns_ConnWriteVChars(conn, &sbuf, 1, NS_CONN_STREAM);
         }
 
-        Ns_Free(connection->fetch_buffers);
-        connection->fetch_buffers = NULL;
+        if (status == NS_OK) {
+            bytes_written = (ssize_t)length;
+        } else {
+            bytes_written = 0;
+        }
+    } else {
+        bytes_written = write(fd, bufp, length);
     }
+
+    ns_ora_log(lexpos(), "exit (%d, %d, %d)", bytes_written, fd, length,
+        to_conn_p);
+
+    return bytes_written;
 }
 /*}}}*/
 
-/*{{{ handle_builtins*/
+/*{{{ lob_set_compression*/
+/* Let write_clob output be gzipped when LobCompressLevel is set and the
+   client accepts gzip.  BLOBs are left alone, they are mostly
+   compressed already. */
+static void
+lob_set_compression(Ns_Conn * conn, int blob_p)
+{
+    if (conn == NULL || blob_p || lob_compress_level == 0
+        || (conn->flags & NS_CONN_SENTHDRS) != 0u
+        || (conn->flags & NS_CONN_ZIPACCEPTED) == 0u) {
+        return;
+    }
 
-/* this gets called on every query or DML.  Usually, it will
-   return NS_OK ("I did nothing").  If the SQL is one of our special
-   cases, e.g., "begin transaction", that aren't supposed to go through
-   to Oracle, we handle it and return NS_DML ("I handled it and nobody
-   else has do anything").
+    ns_ora_log(lexpos(), "compressing LOB, level %d", lob_compress_level);
+    Ns_ConnSetCompression(conn, lob_compress_level);
+}
+/*}}}*/
 
-   return NS_ERROR on error
-*/
+/*{{{ lob_compression*/
+/* The gzip level for a LOB that goes out as the whole response of the
+   connection, 0 when it is sent as is.  Streamed pieces are compressed
+   by Ns_ConnWriteVChars(), spooled files by spool_write_lob(). */
 static int
-handle_builtins(Ns_DbHandle * dbh, char *sql)
+lob_compression(Ns_Conn * conn, int blob_p)
 {
-    oci_status_t oci_status;
-    ora_connection_t *connection;
-
-    ns_ora_log(lexpos(), "entry (dbh %p, sql %s)", dbh, nilp(sql));
-
-    /* args should be correct */
-    connection = dbh->connection;
-
-    if (!strcasecmp(sql, "begin transaction")) {
-        ns_ora_log(lexpos(), "builtin `begin transaction`");
-
-        connection->mode = transaction;
-
-        return NS_DML;
+    if (blob_p || (conn->flags & NS_CONN_SENTHDRS) != 0u
+        || (conn->flags & NS_CONN_ZIPACCEPTED) == 0u) {
+        return 0;
+    }
 
-    } else if (!strcasecmp(sql, "end transaction")) {
-        ns_ora_log(lexpos(), "builtin `end transaction`");
+    return Ns_ConnGetCompression(conn);
+}
+/*}}}*/
 
-        oci_status = OCITransCommit(connection->svc,
-                                    connection->err, OCI_DEFAULT);
-        if (oci_error_p(lexpos(), dbh, "OCITransCommit", sql, oci_status)) {
-            Ns_OracleFlush(dbh);
-            return NS_ERROR;
+/*{{{ stream_abort_lob*/
+/* Terminate a LOB read in polling mode that still has pieces pending.
+   A small remainder is cheapest to drain into the void; otherwise, or
+   when draining fails, the read is interrupted with OCIBreak() and
+   OCIReset() and the session is checked with a ping.  Returns NS_OK
+   when the handle can be used again.
+*/
+static int
+stream_abort_lob(Ns_DbHandle * dbh, OCILobLocator * lobl, oraub8 offset,
+                 oraub8 remainder, ub1 * bufp,
+                 OCISvcCtx * svchp, OCIError * errhp)
+{
+    oraub8 byte_amt, char_amt;
+    oci_status_t oci_status = OCI_NEED_DATA;
+
+    ns_ora_log(lexpos(), "aborting LOB read, %lld remaining", (long long) remainder);
+
+    if (remainder <= (oraub8)lob_drain_limit) {
+        while (oci_status == OCI_NEED_DATA) {
+            byte_amt = 0;
+            char_amt = 0;
+            oci_status = OCILobRead2(svchp, errhp, lobl, &byte_amt, &char_amt,
+                                     offset, bufp, lob_buffer_size,
+                                     OCI_NEXT_PIECE, 0, 0, 0, SQLCS_IMPLICIT);
         }
-
-        connection->mode = autocommit;
-        return NS_DML;
-
-    } else if (!strcasecmp(sql, "abort transaction")) {
-        ns_ora_log(lexpos(), "builtin `abort transaction`");
-
-        oci_status = OCITransRollback(connection->svc,
-                                      connection->err, OCI_DEFAULT);
-        if (oci_error_p(lexpos(), dbh, "OCITransRollback", sql, oci_status)) {
-            Ns_OracleFlush(dbh);
-            return NS_ERROR;
+        if (!oci_error_p(lexpos(), dbh, "OCILobRead2", 0, oci_status)) {
+            return NS_OK;
         }
-
-        connection->mode = autocommit;
-        return NS_DML;
     }
 
-    if (!allow_sql_p(dbh, sql, NS_FALSE)) {
-        Ns_OracleFlush(dbh);
+    oci_status = OCIBreak(svchp, errhp);
+    oci_error_p(lexpos(), dbh, "OCIBreak", 0, oci_status);
+
+    oci_status = OCIReset(svchp, errhp);
+    oci_error_p(lexpos(), dbh, "OCIReset", 0, oci_status);
+
+    oci_status = OCIPing(svchp, errhp, OCI_DEFAULT);
+    if (oci_error_p(lexpos(), dbh, "OCIPing", 0, oci_status)) {
         return NS_ERROR;
     }
 
-    /* not handled */
     return NS_OK;
 }
 /*}}}*/
 
-/*{{{ ora_append_buf_to_dstring*/
-/* Callback function for LOB case in ora_get_row. */
-static sb4
-ora_append_buf_to_dstring(dvoid * ctxp, const dvoid *bufp, ub4 len,
-                          ub1 piece)
+/*{{{ parse_range*/
+/* Look for a single byte range in the Range header of the connection
+   and clip it against a content of the given length.  Multiple ranges
+   and conditional (If-Range) requests are answered with the full
+   content, which is a legal response to both.
+*/
+static int
+parse_range(Ns_Conn * conn, oraub8 length, oraub8 * first, oraub8 * last)
 {
-    Tcl_DString *retval = (Tcl_DString *) ctxp;
-
-    switch (piece) {
-        case OCI_LAST_PIECE:
-        case OCI_FIRST_PIECE:
-        case OCI_NEXT_PIECE:
-            Tcl_DStringAppend(retval, (char *) bufp, (TCL_SIZE_T)len);
-            return OCI_CONTINUE;
+    const char *range;
+    char       *end;
+    Tcl_WideInt from, to;
+
+    range = Ns_SetIGet(Ns_ConnHeaders(conn), "range");
+    if (range == NULL
+        || Ns_SetIGet(Ns_ConnHeaders(conn), "if-range") != NULL
+        || strncmp(range, "bytes=", 6u) != 0
+        || strchr(range, ',') != NULL) {
+        return RANGE_NONE;
+    }
+    range += 6;
+
+    if (*range == '-') {
+        /* suffix range: the last n bytes */
+        to = strtoll(range + 1, &end, 10);
+        if (end == range + 1 || *end != '\0' || to < 0) {
+            return RANGE_NONE;
+        }
+        if (to == 0 || length == 0u) {
+            return RANGE_UNSATISFIABLE;
+        }
+        *first = ((oraub8)to >= length) ? 0u : length - (oraub8)to;
+        *last = length - 1u;
+        return RANGE_OK;
+    }
 
-        default:
-            return OCI_ERROR;
+    from = strtoll(range, &end, 10);
+    if (end == range || *end != '-' || from < 0) {
+        return RANGE_NONE;
+    }
+    range = end + 1;
+    if (*range == '\0') {
+        to = (Tcl_WideInt)length - 1;
+    } else {
+        to = strtoll(range, &end, 10);
+        if (*end != '\0' || to < from) {
+            return RANGE_NONE;
+        }
+    }
+    if ((oraub8)from >= length) {
+        return RANGE_UNSATISFIABLE;
+    }
+    if ((oraub8)to >= length) {
+        to = (Tcl_WideInt)length - 1;
     }
+    *first = (oraub8)from;
+    *last = (oraub8)to;
+
+    return RANGE_OK;
 }
 /*}}}*/
 
-/*{{{ no_data*/
+/*{{{ stream_write_lob*/
+/* snarf lobs using stream mode from Oracle into local buffers, then
+   write them to the given file (replacing the file if it exists) or
+   out to the connection.
+
+   When a BLOB goes to a connection that has not sent its headers yet,
+   the length is known in advance: we send a Content-Length and honor
+   a byte range request by reading only the requested window.
+*/
+static int
+stream_write_lob(Tcl_Interp * interp, Ns_DbHandle * dbh, int blob_p,
+                 OCILobLocator * lobl, const char *path, int to_conn_p,
+                 OCISvcCtx * svchp, OCIError * errhp)
+{
+    oraub8 offset = 1;
+    oraub8 loblen = 0;
+    oraub8 byte_amt, char_amt;
+    oraub8 first, last;
+    ub1 *bufp = NULL;
+    oraub8 amount, delivered = 0;
+    ub1 piece = OCI_FIRST_PIECE;
+    int n_pieces = 0;
+    int fd = 0;
+    ssize_t bytes_written;
+    int status = STREAM_WRITE_LOB_ERROR;
+    int chars_p = NS_FALSE, compress_p = NS_FALSE;
+    oci_status_t oci_status = OCI_SUCCESS;
+    Ns_Conn *conn = NULL;
+    char content_range[64];
+
+    if (path == NULL) {
+        path = "to connection";
+    }
 
-/*  This is a function that we register as a callback with Oracle for
- *  DML statements that do RETURNING FOOBAR INTO ... (this was
- *  necessitated by the clob_dml statement which was necessitated by
- *  Oracle's stupid SQL parser that can't handle string literals longer
- *  than 4000 chars)
- */
+    ns_ora_log(lexpos(), "entry (path %s)", path);
 
-static sb4
-no_data(dvoid *UNUSED(ctxp), OCIBind *UNUSED(bindp),
-        ub4 UNUSED(iter), ub4 UNUSED(index), dvoid **bufpp, ub4 *alenpp, ub1 *piecep,
-        dvoid **indpp)
-{
-    ns_ora_log(lexpos(), "entry");
+    if (to_conn_p) {
+        conn = Ns_TclGetConn(interp);
 
-    *bufpp = (dvoid *) 0;
-    *alenpp = 0;
-    null_ind = -1;
-    *indpp = (dvoid *) & null_ind;
-    *piecep = OCI_ONE_PIECE;
+        /* this Shouldn't Happen, but spew an error just in case */
+        if (conn == NULL) {
+            Ns_Log(Error, "%s:%d:%s: No AOLserver conn available",
+                   lexpos());
+            Tcl_AppendResult(interp, "No AOLserver conn available", (char*)0L);
+            goto bailout;
+        }
 
-    return OCI_CONTINUE;
-}
-/*}}}*/
+        /* a compressed stream has to be closed to get the gzip trailer
+           out, so we only compress when the LOB is the whole response */
+        compress_p = (lob_compression(conn, blob_p) > 0);
+        chars_p = compress_p || (conn->flags & NS_CONN_WRITE_ENCODED) != 0u;
+    } else {
+        fd = open(path, O_CREAT | O_TRUNC | O_WRONLY | EXTRA_OPEN_FLAGS,
+                  0600);
 
-/*{{{ list_element_put_data*/
-/* For use by OCIBindDynamic: returns the iter'th element (0-relative)
-   of the context pointer taken as an array of strings (char**). */
-static sb4
-list_element_put_data(dvoid * ictxp,
-                      OCIBind * UNUSED(bindp),
-                      ub4 iter,
-                      ub4 UNUSED(index),
-                      dvoid ** bufpp,
-                      ub4 * alenp, ub1 * piecep, dvoid ** indpp)
-{
-    fetch_buffer_t *fetchbuf = ictxp;
-    const char **elements = fetchbuf->array_values;
+        if (fd < 0) {
+            Ns_Log(Error,
+                   "%s:%d:%s: can't open %s for writing. error %d(%s)",
+                   lexpos(), path, errno, strerror(errno));
+            Tcl_AppendResult(interp, "can't open file ", path,
+                             " for writing. ", "received error ",
+                             strerror(errno), (char*)0L);
+            goto bailout;
+        }
+    }
 
-    *bufpp = (dvoid *)elements[iter];
-    *alenp = (ub4) strlen(elements[iter]);
-    *piecep = OCI_ONE_PIECE;
-    *indpp = NULL;
+    /* in characters for CLOBs and bytes for BLOBs */
+    oci_status = OCILobGetLength2(svchp, errhp, lobl, &loblen);
+    if (tcl_error_p(lexpos(), interp, dbh, "OCILobGetLength2", path, oci_status))
+        goto bailout;
 
-    return OCI_CONTINUE;
-}
-/*}}}*/
+    ns_ora_log(lexpos(), "loblen %lld", (long long) loblen);
+
+    /* the amount is in bytes for BLOBs, in characters for CLOBs */
+    byte_amt = blob_p ? loblen : 0u;
+    char_amt = blob_p ? 0u : loblen;
+
+    if (to_conn_p && blob_p && (conn->flags & NS_CONN_SENTHDRS) == 0u) {
+        Ns_ConnCondSetHeaders(conn, "Accept-Ranges", "bytes");
+
+        switch (parse_range(conn, loblen, &first, &last)) {
+        case RANGE_OK:
+            snprintf(content_range, sizeof(content_range), "bytes %"
+                     TCL_LL_MODIFIER "u-%" TCL_LL_MODIFIER "u/%"
+                     TCL_LL_MODIFIER "u", (Tcl_WideUInt)first,
+                     (Tcl_WideUInt)last, (Tcl_WideUInt)loblen);
+            Ns_ConnUpdateHeaders(conn, "Content-Range", content_range);
+            Ns_ConnSetResponseStatus(conn, 206);
+            offset = first + 1u;
+            byte_amt = last - first + 1u;
+            ns_ora_log(lexpos(), "range %s", content_range);
+            break;
 
-/*{{{ get_data*/
-/* another callback to register with Oracle */
-static sb4
-get_data(dvoid * ctxp, OCIBind * bindp,
-         ub4 iter, ub4 index, dvoid ** bufpp, ub4 ** alenp, ub1 * piecep,
-         dvoid ** indpp, ub2 ** rcodepp)
-{
-    Ns_DbHandle      *dbh;
-    ora_connection_t *connection;
-    fetch_buffer_t   *buf;
+        case RANGE_UNSATISFIABLE:
+            snprintf(content_range, sizeof(content_range), "bytes */%"
+                     TCL_LL_MODIFIER "u", (Tcl_WideUInt)loblen);
+            Ns_ConnUpdateHeaders(conn, "Content-Range", content_range);
+            (void) Ns_ConnReturnStatus(conn, 416);
+            status = STREAM_WRITE_LOB_OK;
+            goto bailout;
 
-    ns_ora_log(lexpos(), "entry (dbh %p; iter %d, index %d)", ctxp, iter, index);
+        default:
+            break;
+        }
+        Ns_ConnSetLengthHeader(conn, (size_t)byte_amt, NS_FALSE);
+    }
 
-    if (iter != 0) {
-        error(lexpos(), "iter != 0");
-        return NS_ERROR;
+    if (loblen == 0u) {
+        /* nothing to read, but flush the headers of the connection */
+        if (to_conn_p) {
+            (void) stream_actually_write(fd, conn, NULL, 0u, to_conn_p, chars_p);
+        }
+        status = STREAM_WRITE_LOB_OK;
+        goto bailout;
     }
 
-    buf = ctxp;
-    connection = buf->connection;
-    dbh = connection->dbh;
+    bufp = (ub1 *) Ns_Malloc(lob_buffer_size);
+    amount = blob_p ? byte_amt : char_amt;
 
-    if (buf->lobs == 0) {
-        oci_status_t oci_status;
-        int i;
+    do {
+        oci_status = OCILobRead2(svchp,
+                                 errhp,
+                                 lobl,
+                                 &byte_amt,
+                                 &char_amt,
+                                 offset,
+                                 bufp,
+                                 lob_buffer_size,
+                                 piece, 0, 0, 0, SQLCS_IMPLICIT);
+        if (oci_status != OCI_NEED_DATA
+            && tcl_error_p(lexpos(), interp, dbh, "OCILobRead2", path,
+                           oci_status)) {
+            goto bailout;
+        }
+        piece = OCI_NEXT_PIECE;
 
-        oci_status = OCIAttrGet(bindp,
-                                OCI_HTYPE_BIND,
-                                (oci_attribute_t *) & buf->n_rows,
-                                NULL,
-                                OCI_ATTR_ROWS_RETURNED, connection->err);
-        if (oci_error_p(lexpos(), dbh, "OCIAttrGet", 0, oci_status))
-            return NS_ERROR;
+        /* in polling mode, byte_amt is the size of the current piece */
+        ns_ora_log(lexpos(), "stream read %d'th piece, %lld bytes",
+                   ++n_pieces, (long long) byte_amt);
 
-        ns_ora_log(lexpos(), "n_rows %d", buf->n_rows);
+        bytes_written =
+            stream_actually_write(fd, conn, bufp, (size_t)byte_amt, to_conn_p,
+                                  chars_p);
 
-        buf->lobs = Ns_Malloc(buf->n_rows * sizeof *buf->lobs);
+        if (bytes_written != (ssize_t)byte_amt) {
+            if (errno == EPIPE) {
+                /* broken pipe means the user hit the stop button.
+                 * if that's the case, lie and say we've completed
+                 * successfully so we don't cause false-positive errors
+                 * in the server.log
+                 * photo.net ticket # 5901
+                 */
+                status = STREAM_WRITE_LOB_PIPE;
+            } else if (bytes_written < 0) {
+                Ns_Log(Error,
+                       "%s:%d:%s error writing %s.  error %d(%s)",
+                       lexpos(), path, errno, strerror(errno));
+                Tcl_AppendResult(interp, "can't write ", path,
+                                 " received error ",
+                                 strerror(errno), (char*)0L);
+            } else {
+                Ns_Log(Error,
+                       "%s:%d:%s error writing %s.  incomplete write of %ld out of %ld",
+                       lexpos(), path, (long) bytes_written, (long) byte_amt);
+                Tcl_AppendResult(interp, "can't write ", path,
+                                 " received error ",
+                                 strerror(errno), (char*)0L);
+            }
+            goto bailout;
+        }
+        delivered += byte_amt;
+    } while (oci_status == OCI_NEED_DATA);
 
-        for (i = 0; i < (int) buf->n_rows; i++)
-            buf->lobs[i] = 0;
+    status = STREAM_WRITE_LOB_OK;
 
-        for (i = 0; i < (int) buf->n_rows; i++) {
-            oci_status = OCIDescriptorAlloc(connection->env,
-                                            (oci_descriptor_t *) & buf->
-                                            lobs[i], OCI_DTYPE_LOB, 0, 0);
-            if (oci_error_p(lexpos(), dbh, "OCIDescriptorAlloc", 0, oci_status))
-                return NS_ERROR;
+  bailout:
+    if (compress_p && status == STREAM_WRITE_LOB_OK
+        && Ns_ConnWriteVChars(conn, NULL, 0, NS_CONN_STREAM_CLOSE) != NS_OK) {
+        ns_ora_log(lexpos(), "closing compressed stream failed, client gone?");
+    }
+
+    /* We gave up in the middle of the LOB, e.g. because the client went
+       away.  Terminate the read, so that the handle can be used again.
+       For CLOBs, the amount is in characters, so the remainder is just
+       an estimate. */
+    if (oci_status == OCI_NEED_DATA) {
+        ora_connection_t *connection = dbh->connection;
+
+        if (stream_abort_lob(dbh, lobl, offset,
+                             amount > delivered ? amount - delivered : 0u,
+                             bufp, svchp, errhp) != NS_OK) {
+            connection->lob_read_pending = NS_TRUE;
         }
     }
 
-    *bufpp = (dvoid *) buf->lobs[index];
+    if (bufp)
+        Ns_Free(bufp);
 
-    *alenp = &rl;
-    null_ind = -1;
-    *indpp = (dvoid *) & null_ind;
-    *piecep = OCI_ONE_PIECE;
-    *rcodepp = &rc;
+    if (!to_conn_p) {
+        close(fd);
+    }
 
-    return OCI_CONTINUE;
+    return status;
 }
 /*}}}*/
 
-/*{{{ stream_read_lob*/
-/* read a file from the operating system and then stuff it into the lob
-   This was cargo-culted from an example in the OCI programmer's
-   guide.
- */
+/*{{{ spool_write_lob*/
+/* Drain the LOB at full speed into memory (small LOBs) or into an
+   unlinked spool file and return it with Ns_ConnReturnData() or
+   Ns_ConnReturnOpenFd(), so that a configured writer thread delivers
+   the content while the db handle is already free again.  When the
+   caller has sent headers already or an output encoding is active,
+   the content can't be returned as a whole and we fall back to
+   stream_write_lob().
+
+   With a cache key, the LOB always goes into a file in the LOB cache
+   directory, which is handed over to the cache after the LOB was read.
+
+   A CLOB to be compressed is returned from memory with
+   Ns_ConnReturnCharData(), which compresses it, or gzipped into the
+   spool file as it is read.
+*/
 static int
-stream_read_lob(Tcl_Interp * interp, Ns_DbHandle * dbh, int UNUSED(rowind),
-                OCILobLocator * lobl, const char *path,
-                ora_connection_t * connection)
+spool_write_lob(Tcl_Interp * interp, Ns_DbHandle * dbh,
+                OCILobLocator * lobl, int blob_p, const char *cache_key,
+                OCISvcCtx * svchp, OCIError * errhp)
 {
-    ub4 offset = 1;
-    ub4 loblen = 0;
-    ub1 *bufp = NULL;
-    ub4 amtp;
-    ub1 piece;
-    size_t nbytes;
-    ub4 remainder;
-    off_t filelen = 0;
-#ifdef WIN32
-    int readlen;
-#else
-    ssize_t readlen;
-#endif
-    int status = NS_ERROR, fd;
-    oci_status_t oci_status = OCI_SUCCESS;
-    struct stat statbuf;
-
-    fd = open(path, O_RDONLY | EXTRA_OPEN_FLAGS);
+    Ns_Conn     *conn;
+    const char  *type;
+    ub1         *bufp = NULL;
+    oraub8       loblen = 0;
+    oraub8       byte_amt, char_amt;
+    lob_spool_t  spool;
+    Tcl_DString  ds;
+    int          status = STREAM_WRITE_LOB_ERROR;
+    int          compress_level;
+    oci_status_t oci_status;
+    Ns_ReturnCode ns_status;
 
-    if (fd == -1) {
-        Ns_Log(Error, "%s:%d:%s Error opening file %s: %d(%s)",
-               lexpos(), path, errno, strerror(errno));
-        Tcl_AppendResult(interp, "can't open file ", path,
-                         " for reading. ", "received error ",
-                         strerror(errno), (char*)0L);
-        goto bailout;
+    conn = Ns_TclGetConn(interp);
+    if (conn == NULL) {
+        Ns_Log(Error, "%s:%d:%s: No AOLserver conn available", lexpos());
+        Tcl_AppendResult(interp, "No AOLserver conn available", (char*)0L);
+        return STREAM_WRITE_LOB_ERROR;
     }
 
-    if (stat(path, &statbuf) == -1) {
-        Ns_Log(Error, "%s:%d:%s Error statting %s: %d(%s)",
-               lexpos(), path, errno, strerror(errno));
-        Tcl_AppendResult(interp, "can't stat ", path, ". ",
-                         "received error ", strerror(errno), (char*)0L);
-        goto bailout;
+    if ((conn->flags & NS_CONN_SENTHDRS) != 0u
+        || (!blob_p && (conn->flags & NS_CONN_WRITE_ENCODED) != 0u)
+        || (blob_p && Ns_SetIGet(Ns_ConnHeaders(conn), "range") != NULL)) {
+        ns_ora_log(lexpos(), "headers sent, encoding active or range requested, streaming LOB");
+        return stream_write_lob(interp, dbh, blob_p, lobl, NULL, NS_TRUE, svchp, errhp);
     }
-    filelen = statbuf.st_size;
 
-    remainder = amtp = (ub4)filelen;
+    /* in characters for CLOBs and bytes for BLOBs */
+    oci_status = OCILobGetLength2(svchp, errhp, lobl, &loblen);
+    if (tcl_error_p(lexpos(), interp, dbh, "OCILobGetLength2", 0, oci_status))
+        return STREAM_WRITE_LOB_ERROR;
 
-    ns_ora_log(lexpos(), "to do streamed write lob, amount = %d", (int) filelen);
+    byte_amt = blob_p ? loblen : 0u;
+    char_amt = blob_p ? 0u : loblen;
 
-    oci_status =
-        OCILobGetLength(connection->svc, connection->err, lobl, &loblen);
+    /* cached LOBs are stored and sent as is */
+    compress_level = (cache_key == NULL) ? lob_compression(conn, blob_p) : 0;
 
-    if (tcl_error_p(lexpos(), interp, dbh, "OCILobGetLength", 0, oci_status))
-        goto bailout;
+    type = lob_content_type(conn, blob_p);
 
+    spool.fd = -1;
+    spool.length = 0u;
+    spool.errnum = 0;
+    spool.compress_level = 0;
+    Tcl_DStringInit(&spool.zbuf);
+    Tcl_DStringInit(&ds);
 
-    ns_ora_log(lexpos(), "before stream write, lob length is %d", (int) loblen);
+    if (loblen > 0) {
+        bufp = (ub1 *) Ns_Malloc(lob_buffer_size);
+    }
 
-    if (filelen > lob_buffer_size)
-        nbytes = lob_buffer_size;
-    else
-        nbytes = (size_t)filelen;
+    /* For CLOBs the length is in characters, so the memory limit is
+       only a rough estimate of the number of bytes we buffer. */
+    if (cache_key == NULL && loblen <= (oraub8)lob_spool_memory) {
+        if (loblen > 0) {
+            oci_status = OCILobRead2(svchp, errhp, lobl, &byte_amt, &char_amt,
+                                     (oraub8) 1, bufp, (oraub8) lob_buffer_size,
+                                     OCI_FIRST_PIECE, &ds,
+                                     ora_append_buf_to_dstring, (ub2) 0,
+                                     (ub1) SQLCS_IMPLICIT);
+            if (tcl_error_p(lexpos(), interp, dbh, "OCILobRead2", 0, oci_status))
+                goto bailout;
+        }
 
-    bufp = (ub1 *) Ns_Malloc(lob_buffer_size);
-    readlen = read(fd, bufp, nbytes);
+        ns_ora_log(lexpos(), "spooled %d bytes to memory", Tcl_DStringLength(&ds));
 
-    if (readlen < 0) {
-        Ns_Log(Error, "%s:%d:%s Error reading file %s: %d(%s)",
-               lexpos(), path, errno, strerror(errno));
-        Tcl_AppendResult(interp, "can't read ", path,
-                         " received error ", strerror(errno), (char*)0L);
-        goto bailout;
-    }
+        if (compress_level > 0) {
+            ns_status = Ns_ConnReturnCharData(conn, 200, Tcl_DStringValue(&ds),
+                                              Tcl_DStringLength(&ds), type);
+        } else {
+            ns_status = Ns_ConnReturnData(conn, 200, Tcl_DStringValue(&ds),
+                                          Tcl_DStringLength(&ds), type);
+        }
+    } else {
+        if (cache_key != NULL) {
+            Tcl_DStringAppend(&ds, lob_cache.dir, TCL_INDEX_NONE);
+            Tcl_DStringAppend(&ds, "/" LOB_CACHE_PREFIX "XXXXXX", TCL_INDEX_NONE);
+        } else {
+            Tcl_DStringAppend(&ds, lob_spool_dir, TCL_INDEX_NONE);
+            Tcl_DStringAppend(&ds, "/nsoracle-XXXXXX", TCL_INDEX_NONE);
+        }
 
-    remainder -= readlen;
+        spool.fd = mkstemp(Tcl_DStringValue(&ds));
+        if (spool.fd == -1) {
+            Ns_Log(Error, "%s:%d:%s: can't create spool file %s. error %d(%s)",
+                   lexpos(), Tcl_DStringValue(&ds), errno, strerror(errno));
+            Tcl_AppendResult(interp, "can't create spool file ",
+                             Tcl_DStringValue(&ds), ". received error ",
+                             strerror(errno), (char*)0L);
+            goto bailout;
+        }
+        if (cache_key == NULL) {
+            unlink(Tcl_DStringValue(&ds));
+        }
 
-    if (remainder == 0) {       /* exactly one piece in the file */
-        if (readlen > 0) {      /* if no bytes, bypass the LobWrite to insert a NULL */
-            ns_ora_log(lexpos(), "only one piece, no need for stream write");
-            oci_status = OCILobWrite(connection->svc,
-                                     connection->err,
-                                     lobl,
-                                     &amtp,
-                                     offset,
-                                     bufp,
-                                     (ub4)readlen,
-                                     OCI_ONE_PIECE, 0, 0, 0,
-                                     SQLCS_IMPLICIT);
-            if (tcl_error_p(lexpos(), interp, dbh, "OCILobWrite", 0, oci_status)) {
-                goto bailout;
+        if (compress_level > 0 && Ns_CompressInit(&spool.stream) == NS_OK) {
+            spool.compress_level = compress_level;
+        }
+
+        oci_status = OCILobRead2(svchp, errhp, lobl, &byte_amt, &char_amt,
+                                 (oraub8) 1, bufp, (oraub8) lob_buffer_size,
+                                 OCI_FIRST_PIECE, &spool,
+                                 ora_append_buf_to_fd, (ub2) 0,
+                                 (ub1) SQLCS_IMPLICIT);
+        if (oci_status == OCI_SUCCESS && spool.compress_level > 0) {
+            (void) lob_spool_write(&spool, NULL, 0u, NS_TRUE);
+        }
+        if (spool.errnum != 0) {
+            Ns_Log(Error, "%s:%d:%s: error writing spool file. error %d(%s)",
+                   lexpos(), spool.errnum, strerror(spool.errnum));
+            Tcl_AppendResult(interp, "can't write spool file. received error ",
+                             strerror(spool.errnum), (char*)0L);
+            if (cache_key != NULL) {
+                unlink(Tcl_DStringValue(&ds));
             }
+            goto bailout;
+        }
+        if (tcl_error_p(lexpos(), interp, dbh, "OCILobRead2", 0, oci_status)) {
+            if (cache_key != NULL) {
+                unlink(Tcl_DStringValue(&ds));
+            }
+            goto bailout;
         }
-    } else {                    /* more than one piece */
 
-        oci_status = OCILobWrite(connection->svc,
-                                 connection->err,
-                                 lobl,
-                                 &amtp,
-                                 offset,
-                                 bufp,
-                                 lob_buffer_size,
-                                 OCI_FIRST_PIECE, 0, 0, 0, SQLCS_IMPLICIT);
+        ns_ora_log(lexpos(), "spooled %d bytes to file", (int) spool.length);
 
-        if (oci_status != OCI_NEED_DATA
-            && tcl_error_p(lexpos(), interp, dbh, "OCILobWrite", 0,
-                           oci_status)) {
-            goto bailout;
+        if (cache_key != NULL) {
+            lob_cache_add(cache_key, Tcl_DStringValue(&ds), spool.length);
         }
 
+        if (spool.compress_level > 0) {
+            /* the file is gzipped already, don't let the server try */
+            Ns_ConnSetCompression(conn, 0);
+            Ns_ConnUpdateHeaders(conn, "Content-Encoding", "gzip");
+            Ns_ConnCondSetHeaders(conn, "Vary", "Accept-Encoding");
+        }
 
-        piece = OCI_NEXT_PIECE;
+        (void) lseek(spool.fd, 0, SEEK_SET);
+        ns_status = Ns_ConnReturnOpenFd(conn, 200, type, spool.fd, spool.length);
+    }
 
-        do {
-            if (remainder > lob_buffer_size)
-                nbytes = lob_buffer_size;
-            else {
-                nbytes = remainder;
-                piece = OCI_LAST_PIECE;
-            }
+    /* The LOB is drained at this point, so a client that went away is no
+       reason to give up the db handle. */
+    if (ns_status != NS_OK) {
+        ns_ora_log(lexpos(), "returning spooled LOB failed, client gone?");
+    }
+    status = STREAM_WRITE_LOB_OK;
 
-            readlen = read(fd, bufp, nbytes);
+  bailout:
+    if (bufp != NULL) {
+        Ns_Free(bufp);
+    }
+    if (spool.fd != -1) {
+        close(spool.fd);
+    }
+    if (spool.compress_level > 0) {
+        Ns_CompressFree(&spool.stream);
+    }
+    Tcl_DStringFree(&spool.zbuf);
+    Tcl_DStringFree(&ds);
 
-            if (readlen < 0) {
-                Ns_Log(Error, "%s:%d:%s Error reading file %s: %d(%s)",
-                       lexpos(), path, errno, strerror(errno));
-                Tcl_AppendResult(interp, "can't read ", path,
-                                 " received error ", strerror(errno),
-                                 (char*)0L);
-                piece = OCI_LAST_PIECE;
-            }
+    return status;
+}
+/*}}}*/
 
-            oci_status = OCILobWrite(connection->svc,
-                                     connection->err,
-                                     lobl,
-                                     &amtp,
-                                     offset,
-                                     bufp,
-                                     (ub4)readlen,
-                                     piece, 0, 0, 0, SQLCS_IMPLICIT);
-            if (oci_status != OCI_NEED_DATA
-                && tcl_error_p(lexpos(), interp, dbh, "OCILobWrite", 0,
-                               oci_status)) {
-                goto bailout;
-            }
-            remainder -= readlen;
+/*{{{ lob_content_type*/
+/* The content type for a LOB returned as a whole: what the caller put
+   into the output headers, or a default depending on the LOB type. */
+static const char *
+lob_content_type(Ns_Conn * conn, int blob_p)
+{
+    const char *type;
 
-        } while (oci_status == OCI_NEED_DATA && remainder > 0);
+    type = Ns_SetIGet(Ns_ConnOutputHeaders(conn), "content-type");
+    if (type == NULL) {
+        type = blob_p ? "application/octet-stream" : "text/plain";
     }
-
-    if (tcl_error_p(lexpos(), interp, dbh, "OCILobWrite", 0, oci_status)) {
-        goto bailout;
+    if (blob_p) {
+        Ns_ConnCondSetHeaders(conn, "Accept-Ranges", "bytes");
     }
 
-    status = NS_OK;
+    return type;
+}
+/*}}}*/
 
-  bailout:
+/*{{{ lob_cache_init*/
+/* Set up the LOB cache.  The index lives in memory only, so files left
+   over from a previous run are removed. */
+static void
+lob_cache_init(const char *dir, Tcl_WideInt max_size)
+{
+    DIR           *dirPtr;
+    struct dirent *entPtr;
+    Tcl_DString    ds;
 
-    if (bufp)
-        Ns_Free(bufp);
-    close(fd);
+    if (lob_cache.dir != NULL) {
+        return;
+    }
 
-    if (status != NS_OK && connection->mode == transaction) {
-        ns_ora_log(lexpos(), "error writing lob.  rolling back transaction");
+    if (mkdir(dir, 0700) != 0 && errno != EEXIST) {
+        Ns_Log(Error, "%s:%d:%s: can't create LOB cache directory %s: %s",
+               lexpos(), dir, strerror(errno));
+        return;
+    }
 
-        oci_status = OCITransRollback(connection->svc,
-                                      connection->err, OCI_DEFAULT);
-        tcl_error_p(lexpos(), interp, dbh, "OCITransRollback", 0,
-                    oci_status);
+    Tcl_DStringInit(&ds);
+    dirPtr = opendir(dir);
+    if (dirPtr != NULL) {
+        while ((entPtr = readdir(dirPtr)) != NULL) {
+            if (strncmp(entPtr->d_name, LOB_CACHE_PREFIX,
+                        sizeof(LOB_CACHE_PREFIX) - 1u) == 0) {
+                Tcl_DStringSetLength(&ds, 0);
+                Tcl_DStringAppend(&ds, dir, TCL_INDEX_NONE);
+                Tcl_DStringAppend(&ds, "/", 1);
+                Tcl_DStringAppend(&ds, entPtr->d_name, TCL_INDEX_NONE);
+                unlink(Tcl_DStringValue(&ds));
+            }
+        }
+        closedir(dirPtr);
     }
+    Tcl_DStringFree(&ds);
 
-    return status;
+    Ns_MutexInit(&lob_cache.lock);
+    Ns_MutexSetName(&lob_cache.lock, "nsoracle:lobcache");
+    Tcl_InitHashTable(&lob_cache.table, TCL_STRING_KEYS);
+    lob_cache.max_size = max_size;
+    lob_cache.dir = dir;
 }
 /*}}}*/
 
-/*{{{ stream_actually_write*/
-static ssize_t
-stream_actually_write(int fd, Ns_Conn * conn, void *bufp, size_t length,
-                      int to_conn_p)
+/*{{{ lob_cache_remove*/
+/* Unlink an entry from the LOB cache and delete its file.  Called with
+   the cache locked. */
+static void
+lob_cache_remove(lob_cache_entry_t * entry)
 {
-    ssize_t bytes_written = 0;
+    if (entry->prev != NULL) {
+        entry->prev->next = entry->next;
+    } else {
+        lob_cache.first = entry->next;
+    }
+    if (entry->next != NULL) {
+        entry->next->prev = entry->prev;
+    } else {
+        lob_cache.last = entry->prev;
+    }
+    Tcl_DeleteHashEntry(entry->hPtr);
+    lob_cache.size -= (Tcl_WideInt)entry->size;
 
-    ns_ora_log(lexpos(), "entry (%d, %d, %d)", fd, length, to_conn_p);
+    unlink(entry->path);
+    Ns_Free(entry->path);
+    Ns_Free(entry);
+}
+/*}}}*/
 
-    if (to_conn_p) {
-        struct iovec sbuf;
-        Ns_ReturnCode status;
+/*{{{ lob_cache_add*/
+/* Take over a completely written file into the LOB cache, replacing
+   an older entry with the same key, and evict the least recently used
+   entries until the cache fits into its size again. */
+static void
+lob_cache_add(const char *key, const char *path, size_t size)
+{
+    lob_cache_entry_t *entry;
+    Tcl_HashEntry     *hPtr;
+    int                new;
 
-        sbuf.iov_base = bufp;
-        sbuf.iov_len = length;
+    if ((Tcl_WideInt)size > lob_cache.max_size) {
+        unlink(path);
+        return;
+    }
 
-        if ((conn->flags & NS_CONN_WRITE_ENCODED) == 0u) {
-            status = Ns_ConnWriteVData(conn, &sbuf, 1, NS_CONN_STREAM);
-        } else {
-            status = Ns_ConnWriteVChars(conn, &sbuf, 1, NS_CONN_STREAM);
-        }
+    Ns_MutexLock(&lob_cache.lock);
 
-        if (status == NS_OK) {
-            bytes_written = (ssize_t)length;
-        } else {
-            bytes_written = 0;
-        }
+    hPtr = Tcl_FindHashEntry(&lob_cache.table, key);
+    if (hPtr != NULL) {
+        lob_cache_remove(Tcl_GetHashValue(hPtr));
+    }
+
+    entry = Ns_Malloc(sizeof(lob_cache_entry_t));
+    entry->path = Ns_StrDup(path);
+    entry->size = size;
+    entry->prev = NULL;
+    entry->next = lob_cache.first;
+    if (lob_cache.first != NULL) {
+        lob_cache.first->prev = entry;
     } else {
-        bytes_written = write(fd, bufp, length);
+        lob_cache.last = entry;
     }
+    lob_cache.first = entry;
+    entry->hPtr = Tcl_CreateHashEntry(&lob_cache.table, key, &new);
+    Tcl_SetHashValue(entry->hPtr, entry);
+    lob_cache.size += (Tcl_WideInt)size;
+    lob_cache.stores++;
 
-    ns_ora_log(lexpos(), "exit (%d, %d, %d)", bytes_written, fd, length,
-        to_conn_p);
+    while (lob_cache.size > lob_cache.max_size && lob_cache.last != entry) {
+        lob_cache_remove(lob_cache.last);
+        lob_cache.evictions++;
+    }
 
-    return bytes_written;
+    Ns_MutexUnlock(&lob_cache.lock);
 }
 /*}}}*/
 
-/*{{{ stream_write_lob*/
-/* snarf lobs using stream mode from Oracle into local buffers, then
-   write them to the given file (replacing the file if it exists) or
-   out to the connection.
-   This was cargo-culted from an example in the OCI programmer's
-   guide.
-*/
+/*{{{ lob_cache_return*/
+/* Return a cached LOB to the connection.  The file is opened while the
+   cache is locked, so a concurrent eviction can't pull it away.
+   Returns NS_TRUE on a cache hit. */
 static int
-stream_write_lob(Tcl_Interp * interp, Ns_DbHandle * dbh, int UNUSED(rowind),
-                 OCILobLocator * lobl, const char *path, int to_conn_p,
-                 OCISvcCtx * svchp, OCIError * errhp)
+lob_cache_return(Ns_Conn * conn, const char *key, int blob_p)
 {
-    ub4 offset = 1;
-    ub4 loblen = 0;
-    ub1 *bufp = NULL;
-    ub4 amtp = 0;
-    ub4 piece = 0;
-    ub4 remainder;              /* the number of bytes for the last piece */
-    int fd = 0;
-    ssize_t bytes_to_write, bytes_written;
-    int status = STREAM_WRITE_LOB_ERROR;
-    oci_status_t oci_status;
-    Ns_Conn *conn = NULL;
-
-    if (path == NULL) {
-        path = "to connection";
-    }
-
-    ns_ora_log(lexpos(), "entry (path %s)", path);
-
-    if (to_conn_p) {
-        conn = Ns_TclGetConn(interp);
-
-        /* this Shouldn't Happen, but spew an error just in case */
-        if (conn == NULL) {
-            Ns_Log(Error, "%s:%d:%s: No AOLserver conn available",
-                   lexpos());
-            Tcl_AppendResult(interp, "No AOLserver conn available", (char*)0L);
-            goto bailout;
+    lob_cache_entry_t *entry;
+    Tcl_HashEntry     *hPtr;
+    size_t             size = 0u;
+    int                fd = -1;
+
+    Ns_MutexLock(&lob_cache.lock);
+
+    hPtr = Tcl_FindHashEntry(&lob_cache.table, key);
+    if (hPtr != NULL) {
+        entry = Tcl_GetHashValue(hPtr);
+        fd = open(entry->path, O_RDONLY | EXTRA_OPEN_FLAGS);
+        if (fd == -1) {
+            Ns_Log(Warning, "%s:%d:%s: can't open LOB cache file %s: %s",
+                   lexpos(), entry->path, strerror(errno));
+            lob_cache_remove(entry);
+        } else {
+            size = entry->size;
+            if (entry != lob_cache.first) {
+                entry->prev->next = entry->next;
+                if (entry->next != NULL) {
+                    entry->next->prev = entry->prev;
+                } else {
+                    lob_cache.last = entry->prev;
+                }
+                entry->prev = NULL;
+                entry->next = lob_cache.first;
+                lob_cache.first->prev = entry;
+                lob_cache.first = entry;
+            }
         }
+    }
+    if (fd == -1) {
+        lob_cache.misses++;
     } else {
-        fd = open(path, O_CREAT | O_TRUNC | O_WRONLY | EXTRA_OPEN_FLAGS,
-                  0600);
+        lob_cache.hits++;
+    }
 
-        if (fd < 0) {
-            Ns_Log(Error,
-                   "%s:%d:%s: can't open %s for writing. error %d(%s)",
-                   lexpos(), path, errno, strerror(errno));
-            Tcl_AppendResult(interp, "can't open file ", path,
-                             " for writing. ", "received error ",
-                             strerror(errno), (char*)0L);
-            goto bailout;
-        }
+    Ns_MutexUnlock(&lob_cache.lock);
+
+    if (fd == -1) {
+        return NS_FALSE;
     }
 
-    oci_status = OCILobGetLength(svchp, errhp, lobl, &loblen);
-    if (tcl_error_p(lexpos(), interp, dbh, "OCILobGetLength", path, oci_status))
-        goto bailout;
+    ns_ora_log(lexpos(), "LOB cache hit, %d bytes", (int) size);
 
-    amtp = loblen;
+    if (Ns_ConnReturnOpenFd(conn, 200, lob_content_type(conn, blob_p),
+                            fd, size) != NS_OK) {
+        ns_ora_log(lexpos(), "returning cached LOB failed, client gone?");
+    }
+    close(fd);
 
-    ns_ora_log(lexpos(), "loblen %d", loblen);
+    return NS_TRUE;
+}
+/*}}}*/
 
-    bufp = (ub1 *) Ns_Malloc(lob_buffer_size);
-    memset((void *) bufp, (int) '\0', (size_t) lob_buffer_size);
-
-    oci_status = OCILobRead(svchp,
-                            errhp,
-                            lobl,
-                            &amtp,
-                            offset,
-                            bufp,
-                            (loblen <
-                             lob_buffer_size ? loblen : lob_buffer_size),
-                            0, 0, 0, SQLCS_IMPLICIT);
+/*{{{ desc_catalog_init*/
+/* Set up the description catalog, loading the entries saved in file.
+   Loaded entries are checked against LAST_DDL_TIME on first use.  The
+   catalog is shared by all pools: it is set up once, and the first
+   file configured is the one used. */
+static void
+desc_catalog_init(const char *file)
+{
+    Tcl_DString  ds;
+    char         buf[8192];
+    const char **entries;
+    TCL_SIZE_T   n, i;
+    ssize_t      got;
+    int          fd;
+
+    if (!desc_catalog.initialized) {
+        desc_catalog.initialized = NS_TRUE;
+        desc_catalog.saved = time(NULL);
+        Ns_MutexInit(&desc_catalog.lock);
+        Ns_MutexSetName(&desc_catalog.lock, "nsoracle:desccatalog");
+        Tcl_InitHashTable(&desc_catalog.table, TCL_STRING_KEYS);
+    }
+
+    if (file == NULL || desc_catalog.file != NULL) {
+        return;
+    }
+    desc_catalog.file = file;
+    Ns_RegisterAtShutdown(desc_catalog_shutdown, NULL);
 
-    switch (oci_status) {
-    case OCI_SUCCESS:          /* only one piece */
-        ns_ora_log(lexpos(), "stream read %d'th piece\n", (int) (++piece));
+    fd = open(file, O_RDONLY | EXTRA_OPEN_FLAGS);
+    if (fd < 0) {
+        return;
+    }
+    Tcl_DStringInit(&ds);
+    while ((got = read(fd, buf, sizeof(buf))) > 0) {
+        Tcl_DStringAppend(&ds, buf, (TCL_SIZE_T)got);
+    }
+    close(fd);
 
-        bytes_written =
-            stream_actually_write(fd, conn, bufp, loblen, to_conn_p);
+    if (Tcl_SplitList(NULL, Tcl_DStringValue(&ds), &n, &entries) == TCL_OK) {
+        for (i = 0; i < n; i++) {
+            desc_catalog_entry_t *entry;
+            Tcl_HashEntry        *hPtr;
+            const char          **fields;
+            TCL_SIZE_T            n_fields;
+            int                   new;
 
-        if (bytes_written != (int) loblen) {
-            if (errno == EPIPE) {
-                status = STREAM_WRITE_LOB_PIPE;
-                goto bailout;
+            if (Tcl_SplitList(NULL, entries[i], &n_fields, &fields) != TCL_OK) {
+                continue;
             }
-            if (bytes_written < 0) {
-                Ns_Log(Error, "%s:%d:%s error writing %s.  error %d(%s)",
-                       lexpos(), path, errno, strerror(errno));
-                Tcl_AppendResult(interp, "can't write ", path,
-                                 " received error ", strerror(errno),
-                                 (char*)0L);
-                goto bailout;
-            } else {
-                Ns_Log(Error,
-                       "%s:%d:%s error writing %s.  incomplete write of %ld out of %d",
-                       lexpos(), path, bytes_written, loblen);
-                Tcl_AppendResult(interp, "can't write ", path,
-                                 " received error ", strerror(errno),
-                                 (char*)0L);
-                goto bailout;
+            if (n_fields == 5) {
+                entry = Ns_Malloc(sizeof(desc_catalog_entry_t));
+                entry->owner = Ns_StrDup(fields[1]);
+                entry->name = Ns_StrDup(fields[2]);
+                entry->ddl_time = Ns_StrDup(fields[3]);
+                entry->desc = Ns_StrDup(fields[4]);
+                entry->checked = 0;
+                hPtr = Tcl_CreateHashEntry(&desc_catalog.table, fields[0], &new);
+                if (!new) {
+                    desc_catalog_entry_free(Tcl_GetHashValue(hPtr));
+                }
+                Tcl_SetHashValue(hPtr, entry);
             }
+            Tcl_Free((char *)fields);
         }
-        break;
+        Tcl_Free((char *)entries);
+    }
+    Tcl_DStringFree(&ds);
 
-    case OCI_ERROR:
-        break;
+    Ns_Log(Notice, "nsoracle: loaded %d package descriptions from %s",
+           desc_catalog.table.numEntries, file);
+}
+/*}}}*/
 
-    case OCI_NEED_DATA:        /* there are 2 or more pieces */
+/*{{{ desc_catalog_key*/
+static void
+desc_catalog_key(Ns_DbHandle * dbh, const char *name, Tcl_DString * dsPtr)
+{
+    const char *p;
 
-        remainder = loblen;
-        /* a full buffer to write */
-        bytes_written =
-            stream_actually_write(fd, conn, bufp, lob_buffer_size,
-                                  to_conn_p);
+    Tcl_DStringInit(dsPtr);
+    Tcl_DStringAppend(dsPtr, nilp(dbh->user), TCL_INDEX_NONE);
+    Tcl_DStringAppend(dsPtr, "@", 1);
+    Tcl_DStringAppend(dsPtr, nilp(dbh->datasource), TCL_INDEX_NONE);
+    Tcl_DStringAppend(dsPtr, "\t", 1);
+    for (p = name; *p != '\0'; p++) {
+        char c = (char)toupper((unsigned char)*p);
 
-        if (bytes_written != lob_buffer_size) {
-            if (errno == EPIPE) {
-                status = STREAM_WRITE_LOB_PIPE;
-                goto bailout;
-            }
-            if (bytes_written < 0) {
-                Ns_Log(Error, "%s:%d:%s error writing %s.  error %d(%s)",
-                       lexpos(), path, errno, strerror(errno));
-                Tcl_AppendResult(interp, "can't write ", path,
-                                 " received error ", strerror(errno),
-                                 (char*)0L);
-                goto bailout;
-            } else {
-                Ns_Log(Error,
-                       "%s:%d:%s error writing %s.  incomplete write of %ld out of %d",
-                       lexpos(), path, bytes_written, lob_buffer_size);
-                Tcl_AppendResult(interp, "can't write ", path,
-                                 " received error ", strerror(errno),
-                                 (char*)0L);
-                goto bailout;
+        Tcl_DStringAppend(dsPtr, &c, 1);
+    }
+}
+/*}}}*/
+
+/*{{{ desc_catalog_get*/
+/* Get the description of a package from the catalog.  An entry that was
+   not checked for desc_catalog_check seconds is used if the package
+   was not changed since it was described. */
+static Tcl_Obj *
+desc_catalog_get(Ns_DbHandle * dbh, const char *name)
+{
+    desc_catalog_entry_t *entry;
+    Tcl_HashEntry        *hPtr;
+    Tcl_DString           key, owner, object, ddl_time;
+    Tcl_Obj              *descObj = NULL;
+    time_t                now = time(NULL);
+    int                   check_p = NS_FALSE;
+    char                  buf[32];
+
+    desc_catalog_key(dbh, name, &key);
+    Tcl_DStringInit(&owner);
+    Tcl_DStringInit(&object);
+    Tcl_DStringInit(&ddl_time);
+
+    Ns_MutexLock(&desc_catalog.lock);
+    hPtr = Tcl_FindHashEntry(&desc_catalog.table, Tcl_DStringValue(&key));
+    if (hPtr != NULL) {
+        entry = Tcl_GetHashValue(hPtr);
+        if (now - entry->checked < (time_t)desc_catalog_check) {
+            descObj = Tcl_NewStringObj(entry->desc, TCL_INDEX_NONE);
+        } else {
+            Tcl_DStringAppend(&owner, entry->owner, TCL_INDEX_NONE);
+            Tcl_DStringAppend(&object, entry->name, TCL_INDEX_NONE);
+            Tcl_DStringAppend(&ddl_time, entry->ddl_time, TCL_INDEX_NONE);
+            check_p = NS_TRUE;
+        }
+    }
+    Ns_MutexUnlock(&desc_catalog.lock);
+
+    if (check_p
+        && desc_catalog_ddl_time(dbh, Tcl_DStringValue(&owner),
+                                 Tcl_DStringValue(&object),
+                                 buf, sizeof(buf)) == NS_OK
+        && strcmp(buf, Tcl_DStringValue(&ddl_time)) == 0) {
+
+        Ns_MutexLock(&desc_catalog.lock);
+        hPtr = Tcl_FindHashEntry(&desc_catalog.table, Tcl_DStringValue(&key));
+        if (hPtr != NULL) {
+            entry = Tcl_GetHashValue(hPtr);
+            if (strcmp(entry->ddl_time, buf) == 0) {
+                entry->checked = now;
+                descObj = Tcl_NewStringObj(entry->desc, TCL_INDEX_NONE);
             }
         }
+        Ns_MutexUnlock(&desc_catalog.lock);
+    }
 
-        do {
-            memset(bufp, '\0', lob_buffer_size);
-            amtp = 0;
+    Tcl_DStringFree(&ddl_time);
+    Tcl_DStringFree(&object);
+    Tcl_DStringFree(&owner);
+    Tcl_DStringFree(&key);
 
-            remainder -= lob_buffer_size;
+    return descObj;
+}
+/*}}}*/
 
-            oci_status = OCILobRead(svchp,
-                                    errhp,
-                                    lobl,
-                                    &amtp,
-                                    offset,
-                                    bufp,
-                                    lob_buffer_size,
-                                    0, 0, 0, SQLCS_IMPLICIT);
-            if (oci_status != OCI_NEED_DATA
-                && tcl_error_p(lexpos(), interp, dbh, "OCILobRead", 0,
-                               oci_status)) {
-                goto bailout;
-            }
+/*{{{ desc_catalog_put*/
+/* Store the description of the package described by param */
+static void
+desc_catalog_put(Ns_DbHandle * dbh, const char *name, OCIParam * param,
+                 Tcl_Obj * descObj)
+{
+    ora_connection_t     *connection = dbh->connection;
+    desc_catalog_entry_t *entry;
+    Tcl_HashEntry        *hPtr;
+    Tcl_DString           key;
+    const char           *owner, *object;
+    ub4                   owner_len = 0, object_len = 0;
+    char                  buf[32];
+    int                   new;
+
+    if (OCIAttrGet(param, OCI_DTYPE_PARAM, (dvoid *)&owner, &owner_len,
+                   OCI_ATTR_OBJ_SCHEMA, connection->err) != OCI_SUCCESS
+        || OCIAttrGet(param, OCI_DTYPE_PARAM, (dvoid *)&object, &object_len,
+                      OCI_ATTR_OBJ_NAME, connection->err) != OCI_SUCCESS) {
+        return;
+    }
 
+    entry = Ns_Malloc(sizeof(desc_catalog_entry_t));
+    entry->owner = Ns_Malloc(owner_len + 1u);
+    memcpy(entry->owner, owner, owner_len);
+    entry->owner[owner_len] = '\0';
+    entry->name = Ns_Malloc(object_len + 1u);
+    memcpy(entry->name, object, object_len);
+    entry->name[object_len] = '\0';
 
-            /* the amount read returned is undefined for FIRST, NEXT pieces */
-            ns_ora_log(lexpos(), "stream read %d'th piece, atmp = %d",
-                (int) (++piece), (int) amtp);
+    if (desc_catalog_ddl_time(dbh, entry->owner, entry->name,
+                              buf, sizeof(buf)) != NS_OK) {
+        Ns_Free(entry->owner);
+        Ns_Free(entry->name);
+        Ns_Free(entry);
+        return;
+    }
+    entry->ddl_time = Ns_StrDup(buf);
+    entry->desc = Ns_StrDup(Tcl_GetString(descObj));
+    entry->checked = time(NULL);
 
-            if (remainder < lob_buffer_size) {  /* last piece not a full buffer piece */
-                bytes_to_write = remainder;
-            } else {
-                bytes_to_write = lob_buffer_size;
-            }
+    desc_catalog_key(dbh, name, &key);
+    Ns_MutexLock(&desc_catalog.lock);
+    hPtr = Tcl_CreateHashEntry(&desc_catalog.table, Tcl_DStringValue(&key), &new);
+    if (!new) {
+        desc_catalog_entry_free(Tcl_GetHashValue(hPtr));
+    }
+    Tcl_SetHashValue(hPtr, entry);
+    desc_catalog.dirty = NS_TRUE;
+    Ns_MutexUnlock(&desc_catalog.lock);
+    Tcl_DStringFree(&key);
 
-            bytes_written =
-                stream_actually_write(fd, conn, bufp, (size_t)bytes_to_write,
-                                      to_conn_p);
+    if (desc_catalog.file != NULL) {
+        desc_catalog_save(NS_FALSE);
+    }
+}
+/*}}}*/
 
-            if (bytes_written != bytes_to_write) {
-                if (errno == EPIPE) {
-                    /* broken pipe means the user hit the stop button.
-                     * if that's the case, lie and say we've completed
-                     * successfully so we don't cause false-positive errors
-                     * in the server.log
-                     * photo.net ticket # 5901
-                     */
-                    status = STREAM_WRITE_LOB_PIPE;
-                } else {
-                    if (bytes_written < 0) {
-                        Ns_Log(Error,
-                               "%s:%d:%s error writing %s.  error %d(%s)",
-                               lexpos(), path, errno, strerror(errno));
-                        Tcl_AppendResult(interp, "can't write ", path,
-                                         " for writing. ",
-                                         " received error ",
-                                         strerror(errno), (char*)0L);
-                    } else {
-                        Ns_Log(Error,
-                               "%s:%d:%s error writing %s.  incomplete write of %ld out of %ld",
-                               lexpos(), path, bytes_written,
-                               bytes_to_write);
-                        Tcl_AppendResult(interp, "can't write ", path,
-                                         " for writing. ",
-                                         " received error ",
-                                         strerror(errno), (char*)0L);
-                    }
-                }
-                goto bailout;
-            }
-        } while (oci_status == OCI_NEED_DATA);
-        break;
+/*{{{ desc_catalog_ddl_time*/
+/* Get the LAST_DDL_TIME of a schema object as YYYYMMDDHH24MISS, empty
+   if the object does not exist.  Uses a statement of its own, so it
+   can run while another statement of the handle is in use. */
+static int
+desc_catalog_ddl_time(Ns_DbHandle * dbh, const char *owner, const char *name,
+                      char *buf, size_t size)
+{
+    static const char sql[] =
+        "select to_char(max(last_ddl_time), 'YYYYMMDDHH24MISS')"
+        " from all_objects where owner = :1 and object_name = :2";
+    ora_connection_t *connection = dbh->connection;
+    oci_status_t      oci_status;
+    OCIStmt          *stmt = NULL;
+    OCIBind          *bind = NULL;
+    OCIDefine        *define = NULL;
+    sb2               ind = -1;
+    int               result = NS_ERROR;
 
-    default:
-        Ns_Log(Error, "%s:%d:%s: Unexpected error from OCILobRead (%d)",
-               lexpos(), oci_status);
+    oci_status = OCIHandleAlloc(connection->env, (oci_handle_t **) &stmt,
+                                OCI_HTYPE_STMT, 0, NULL);
+    if (oci_error_p(lexpos(), dbh, "OCIHandleAlloc", sql, oci_status)) {
+        return NS_ERROR;
+    }
+
+    oci_status = OCIStmtPrepare(stmt, connection->err, (const OraText *)sql,
+                                (ub4) strlen(sql), OCI_NTV_SYNTAX, OCI_DEFAULT);
+    if (oci_error_p(lexpos(), dbh, "OCIStmtPrepare", sql, oci_status)) {
+        goto bailout;
+    }
+    oci_status = OCIBindByPos(stmt, &bind, connection->err, 1,
+                              (dvoid *)owner, (sb4) strlen(owner) + 1,
+                              SQLT_STR, NULL, NULL, NULL, 0, NULL, OCI_DEFAULT);
+    if (oci_error_p(lexpos(), dbh, "OCIBindByPos", sql, oci_status)) {
         goto bailout;
-        break;
     }
+    oci_status = OCIBindByPos(stmt, &bind, connection->err, 2,
+                              (dvoid *)name, (sb4) strlen(name) + 1,
+                              SQLT_STR, NULL, NULL, NULL, 0, NULL, OCI_DEFAULT);
+    if (oci_error_p(lexpos(), dbh, "OCIBindByPos", sql, oci_status)) {
+        goto bailout;
+    }
+    oci_status = OCIDefineByPos(stmt, &define, connection->err, 1,
+                                buf, (sb4) size, SQLT_STR, &ind,
+                                NULL, NULL, OCI_DEFAULT);
+    if (oci_error_p(lexpos(), dbh, "OCIDefineByPos", sql, oci_status)) {
+        goto bailout;
+    }
+    oci_status = OCIStmtExecute(connection->svc, stmt, connection->err,
+                                1, 0, NULL, NULL, OCI_DEFAULT);
+    if (oci_error_p(lexpos(), dbh, "OCIStmtExecute", sql, oci_status)) {
+        goto bailout;
+    }
+    if (ind == -1) {
+        buf[0] = '\0';
+    }
+    result = NS_OK;
 
-    status = STREAM_WRITE_LOB_OK;
+ bailout:
+    if (dbh->connection != NULL) {
+        OCIHandleFree(stmt, OCI_HTYPE_STMT);
+    }
 
-  bailout:
-    if (bufp)
-        Ns_Free(bufp);
+    return result;
+}
+/*}}}*/
 
-    if (!to_conn_p) {
-        close(fd);
+/*{{{ desc_catalog_entry_free*/
+static void
+desc_catalog_entry_free(desc_catalog_entry_t * entry)
+{
+    Ns_Free(entry->owner);
+    Ns_Free(entry->name);
+    Ns_Free(entry->ddl_time);
+    Ns_Free(entry->desc);
+    Ns_Free(entry);
+}
+/*}}}*/
+
+/*{{{ desc_catalog_save*/
+/* Write a changed catalog to its file, as a Tcl list of {key
+   owner name ddl_time desc} lists.  Unless forced, the file is written
+   at most every DESC_CATALOG_SAVE_INTERVAL seconds.  The catalog is
+   locked only while it is copied, not while the file is written. */
+static void
+desc_catalog_save(int force_p)
+{
+    Tcl_HashSearch search;
+    Tcl_HashEntry *hPtr;
+    Tcl_DString    ds, path;
+    time_t         now = time(NULL);
+    int            fd, ok_p = NS_FALSE;
+
+    Ns_MutexLock(&desc_catalog.lock);
+    if (!desc_catalog.dirty || desc_catalog.saving
+        || (!force_p && now - desc_catalog.saved < DESC_CATALOG_SAVE_INTERVAL)) {
+        Ns_MutexUnlock(&desc_catalog.lock);
+        return;
+    }
+    desc_catalog.dirty = NS_FALSE;
+    desc_catalog.saving = NS_TRUE;
+    desc_catalog.saved = now;
+
+    Tcl_DStringInit(&ds);
+    for (hPtr = Tcl_FirstHashEntry(&desc_catalog.table, &search); hPtr != NULL;
+         hPtr = Tcl_NextHashEntry(&search)) {
+        desc_catalog_entry_t *entry = Tcl_GetHashValue(hPtr);
+
+        Tcl_DStringStartSublist(&ds);
+        Tcl_DStringAppendElement(&ds, Tcl_GetHashKey(&desc_catalog.table, hPtr));
+        Tcl_DStringAppendElement(&ds, entry->owner);
+        Tcl_DStringAppendElement(&ds, entry->name);
+        Tcl_DStringAppendElement(&ds, entry->ddl_time);
+        Tcl_DStringAppendElement(&ds, entry->desc);
+        Tcl_DStringEndSublist(&ds);
+        Tcl_DStringAppend(&ds, "\n", 1);
+    }
+    Ns_MutexUnlock(&desc_catalog.lock);
+
+    /* write a new file and rename it, so readers never see half of it */
+    Tcl_DStringInit(&path);
+    Tcl_DStringAppend(&path, desc_catalog.file, TCL_INDEX_NONE);
+    Tcl_DStringAppend(&path, ".new", TCL_INDEX_NONE);
+    fd = open(Tcl_DStringValue(&path), O_CREAT | O_TRUNC | O_WRONLY | EXTRA_OPEN_FLAGS,
+              0644);
+    if (fd < 0) {
+        Ns_Log(Warning, "nsoracle: can't write %s: %s",
+               Tcl_DStringValue(&path), strerror(errno));
+    } else {
+        ok_p = (write(fd, Tcl_DStringValue(&ds), (size_t)Tcl_DStringLength(&ds))
+                == (ssize_t)Tcl_DStringLength(&ds));
+        ok_p = (close(fd) == 0) && ok_p;
+        if (!ok_p || rename(Tcl_DStringValue(&path), desc_catalog.file) != 0) {
+            Ns_Log(Warning, "nsoracle: can't write %s: %s",
+                   desc_catalog.file, strerror(errno));
+            unlink(Tcl_DStringValue(&path));
+            ok_p = NS_FALSE;
+        }
     }
+    Tcl_DStringFree(&path);
+    Tcl_DStringFree(&ds);
 
-    return status;
+    Ns_MutexLock(&desc_catalog.lock);
+    desc_catalog.saving = NS_FALSE;
+    if (!ok_p) {
+        desc_catalog.dirty = NS_TRUE;
+    }
+    Ns_MutexUnlock(&desc_catalog.lock);
+}
+/*}}}*/
+
+/*{{{ desc_catalog_shutdown*/
+/* Save what changed since the last save of the catalog. */
+static void
+desc_catalog_shutdown(const Ns_Time * UNUSED(toPtr), const void *UNUSED(arg))
+{
+    desc_catalog_save(NS_TRUE);
+}
+/*}}}*/
+
+/*{{{ OracleLobCache
+ *----------------------------------------------------------------------
+ * OracleLobCache --
+ *
+ *      Implements [ns_ora lob_cache] command.
+ *
+ *      ns_ora lob_cache stats|flush
+ *
+ * Results:
+ *
+ *      For stats, a list of counters and the hit ratio.
+ *
+ *----------------------------------------------------------------------
+ */
+int
+OracleLobCache(Tcl_Interp *interp, int objc, Tcl_Obj *const* objv, Ns_DbHandle *UNUSED(dbh))
+{
+    static const char *opts[] = {"stats", "flush", NULL};
+    enum {OStats, OFlush} opt;
+    Tcl_Obj *list;
+    double   ratio;
+
+    if (objc != 3) {
+        Tcl_WrongNumArgs(interp, 2, objv, "stats|flush");
+        return TCL_ERROR;
+    }
+    if (Tcl_GetIndexFromObj(interp, objv[2], opts, "option", TCL_EXACT,
+            (int *)&opt) != TCL_OK) {
+        return TCL_ERROR;
+    }
+    if (lob_cache.dir == NULL) {
+        Tcl_SetResult(interp, "LOB cache is not configured", TCL_STATIC);
+        return TCL_ERROR;
+    }
+
+    Ns_MutexLock(&lob_cache.lock);
+
+    if (opt == OFlush) {
+        while (lob_cache.first != NULL) {
+            lob_cache_remove(lob_cache.first);
+        }
+        Ns_MutexUnlock(&lob_cache.lock);
+        return TCL_OK;
+    }
+
+    ratio = (lob_cache.hits + lob_cache.misses) > 0u
+        ? (double)lob_cache.hits / (double)(lob_cache.hits + lob_cache.misses)
+        : 0.0;
+
+    list = Tcl_NewListObj(0, NULL);
+    Tcl_ListObjAppendElement(interp, list, Tcl_NewStringObj("entries", TCL_INDEX_NONE));
+    Tcl_ListObjAppendElement(interp, list, Tcl_NewWideIntObj((Tcl_WideInt)lob_cache.table.numEntries));
+    Tcl_ListObjAppendElement(interp, list, Tcl_NewStringObj("size", TCL_INDEX_NONE));
+    Tcl_ListObjAppendElement(interp, list, Tcl_NewWideIntObj(lob_cache.size));
+    Tcl_ListObjAppendElement(interp, list, Tcl_NewStringObj("maxsize", TCL_INDEX_NONE));
+    Tcl_ListObjAppendElement(interp, list, Tcl_NewWideIntObj(lob_cache.max_size));
+    Tcl_ListObjAppendElement(interp, list, Tcl_NewStringObj("hits", TCL_INDEX_NONE));
+    Tcl_ListObjAppendElement(interp, list, Tcl_NewWideIntObj((Tcl_WideInt)lob_cache.hits));
+    Tcl_ListObjAppendElement(interp, list, Tcl_NewStringObj("misses", TCL_INDEX_NONE));
+    Tcl_ListObjAppendElement(interp, list, Tcl_NewWideIntObj((Tcl_WideInt)lob_cache.misses));
+    Tcl_ListObjAppendElement(interp, list, Tcl_NewStringObj("stores", TCL_INDEX_NONE));
+    Tcl_ListObjAppendElement(interp, list, Tcl_NewWideIntObj((Tcl_WideInt)lob_cache.stores));
+    Tcl_ListObjAppendElement(interp, list, Tcl_NewStringObj("evictions", TCL_INDEX_NONE));
+    Tcl_ListObjAppendElement(interp, list, Tcl_NewWideIntObj((Tcl_WideInt)lob_cache.evictions));
+    Tcl_ListObjAppendElement(interp, list, Tcl_NewStringObj("hitratio", TCL_INDEX_NONE));
+    Tcl_ListObjAppendElement(interp, list, Tcl_NewDoubleObj(ratio));
+
+    Ns_MutexUnlock(&lob_cache.lock);
+
+    Tcl_SetObjResult(interp, list);
+
+    return TCL_OK;
 }
 /*}}}*/
 
@@ -5,6 +5,12 @@
 #define DML_BUFFER_SIZE        4000
 #define MAX_DYNAMIC_BUFFER     5000000 /* FIXME: should be config param? */
 #define EXCEPTION_CODE_SIZE    5
+#define BUFFER_POOL_SIZE       4       /* buffers kept per connection */
+#define BUFFER_POOL_MAX        1048576 /* largest buffer kept */
+#define CURSOR_FETCH_ROWS      100     /* rows per fetch of a REF CURSOR */
+#define CURSOR_FETCH_MAX       1000    /* most rows per fetch of ns_ora fetch */
+#define DBMS_OUTPUT_LINES      32      /* lines per DBMS_OUTPUT.GET_LINES */
+#define DBMS_OUTPUT_LINE_SIZE  32768   /* longest DBMS_OUTPUT line and NUL */
 
 #define BIND_OUT               1
 #define BIND_IN                2
@@ -25,6 +31,7 @@
 
 
 #include <oci.h>
+#include <dirent.h>
 #if 0
 #include <stdlib.h>
 #include <stdio.h>
@@ -85,7 +92,24 @@ OracleCmdProc
     OracleLobDML,
     OracleLobDMLBind,
     OracleDesc,
-    OracleGetCols;
+    OracleGetCols,
+    OracleLobCache,
+    OracleLobOpen,
+    OracleLobAppend,
+    OracleLobClose,
+    OracleLobChannel,
+    OracleLobGet,
+    OracleLazyLobs,
+    OracleCall,
+    OracleDbmsOutput,
+    OraclePrepare,
+    OracleExec,
+    OracleClose,
+    OracleRegister,
+    OracleRun,
+    OracleOpenCursor,
+    OracleGetRow,
+    OracleFetch;
 
 /* When we start a query, we allocate one fetch buffer for each
  * column that we're querying, i.e., if you say "select foo,bar from yow"
@@ -135,6 +159,13 @@ struct fetch_buffer {
     /* these are only used for LONGs; the length of one piece */
     ub4 piecewise_fetch_length;
 
+    /* Dynamic OUT binds: where the current piece goes in buf, the
+       initial size of buf, and whether buf is from the buffer pool of
+       the connection, see DynamicBindOut() */
+    ub4 piece_offset;
+    ub4 size_hint;
+    int pooled;
+
     /* in order to implement the clob_dml API call, we need 1 LOB
        for every row/column intersection inserted.  I.e., if we do an
        insert that results in 4 rows going into the db, with 3 CLOB
@@ -145,12 +176,39 @@ struct fetch_buffer {
     /* this tells us how many lobs we have above (i.e., only for clob_dml) */
     ub4 n_rows;
 
+    /* array fetch of REF CURSORs and array binds of PL/SQL tables:
+       null-ness and length of each row, number of elements bound */
+    sb2 *is_nulls;
+    ub2 *fetch_lengths;
+    ub4  curele;
+
+    /* a Tcl list bound as a collection, see ora_list_bind() */
+    OCIColl *coll;
+
     /* Whether we determined that this column is a LOB during processing. */
     int is_lob;
 };
 
 typedef struct fetch_buffer fetch_buffer_t;
 
+/* A select list as Ns_OracleBindRow resolves it: names downcased,
+   types and sizes as the fetch buffers are planned from them */
+typedef struct ora_column {
+    char        *name;
+    OCITypeCode  type;
+    ub2          size;
+} ora_column_t;
+
+/* The select list of a query, kept per session under the SQL text so
+   that bindrow and getcols do not describe it again, see
+   ora_describe_get().  An entry without hPtr is not cached. */
+typedef struct ora_describe {
+    Tcl_HashEntry *hPtr;
+    int            n_columns;      /* -1 until described */
+    ora_column_t  *columns;
+    struct ora_describe *prev, *next;   /* most recently used first */
+} ora_describe_t;
+
 /* this is our own data structure for keeping track
    of an Oracle connection
 */
@@ -178,15 +236,271 @@ struct ora_connection {
     /* Fetch buffers; these change per query */
     sb4 n_columns;
     fetch_buffer_t *fetch_buffers;
+
+    /* An interrupted piecewise LOB read could not be terminated */
+    int lob_read_pending;
+
+    /* Driver objects (LOB writers, ...) living until the handle is
+       released, see ora_object_new() */
+    Tcl_HashTable objects;
+    unsigned long object_serial;
+
+    /* Rows hold LOB tokens instead of LOB values, see lob_token_new() */
+    int lazy_lobs;
+
+    /* Fetching for [ns_ora rows]: RAW columns are defined as SQLT_BIN
+       and BLOBs are not read by Ns_OracleGetRow */
+    int fetch_objs;
+
+    /* stmt was prepared with OCIStmtPrepare2 and goes back to the
+       statement cache with OCIStmtRelease */
+    int stmt_cached;
+
+    /* Buffers of dynamic OUT binds kept for the next statements, see
+       ora_buffer_get() */
+    struct {
+        char *buf;
+        ub4   size;
+    } buffer_pool[BUFFER_POOL_SIZE];
+
+    /* collection types of -bindlist, looked up on first use */
+    OCIType *number_list_tdo;
+    OCIType *string_list_tdo;
+
+    /* DBMS_OUTPUT was enabled by [ns_ora dbms_output]; its lines are
+       logged after calls taking at least dbms_output_log ms, unless
+       that is negative */
+    int dbms_output_p;
+    int dbms_output_log;
+
+    /* Select lists of the queries run lately; describe is the one of
+       the query of stmt */
+    Tcl_HashTable describes;
+    ora_describe_t *describe_first, *describe_last;
+    ora_describe_t *describe;
 };
 typedef struct ora_connection ora_connection_t;
 
+typedef void (ora_object_free_proc) (ora_connection_t *connection, void *data);
+
+/* A driver object, referred to from Tcl by an id */
+typedef struct ora_object {
+    ora_connection_t     *connection;
+    Tcl_HashEntry        *hPtr;
+    int                   type;
+    void                 *data;
+    ora_object_free_proc *free_proc;
+} ora_object_t;
+
+enum {
+    ORA_OBJECT_LOB_WRITER = 1,
+    ORA_OBJECT_LOB_CHANNEL,
+    ORA_OBJECT_LOB_TOKEN,
+    ORA_OBJECT_STATEMENT,
+    ORA_OBJECT_CURSOR
+};
+
+/* The driver object behind lob_open/lob_append/lob_close */
+typedef struct lob_writer {
+    OCILobLocator *lob;
+    int            blob_p;
+    int            open_p;
+    char          *buf;
+    size_t         buf_size;
+    size_t         fill;
+    oraub8         length;
+} lob_writer_t;
+
+/* The instance data of a lob_channel.  offset and length count
+   characters for CLOBs. */
+typedef struct lob_channel {
+    ora_connection_t *connection;
+    ora_object_t     *object;
+    OCILobLocator    *lob;
+    int               blob_p;
+    oraub8            offset;
+    oraub8            length;
+    Tcl_Channel       chan;
+    Tcl_TimerToken    timer;
+} lob_channel_t;
+
+/* A LOB column value fetched in lazy LOB mode */
+typedef struct lob_token {
+    OCILobLocator *lob;
+    int            blob_p;
+} lob_token_t;
+
+/* Context of the OCILobRead callback used when spooling a LOB to a file. */
+typedef struct lob_spool {
+    int    fd;
+    size_t length;
+    int    errnum;
+    int    compress_level;          /* gzip into the file when > 0 */
+    Ns_CompressStream stream;
+    Tcl_DString zbuf;               /* compressed piece */
+} lob_spool_t;
+
+/* Where the data for a LOB comes from when it is written piecewise:
+   content in memory or an open file. */
+typedef struct lob_source {
+    const char *data;
+    int         fd;
+    size_t      length;
+    size_t      offset;
+    void       *buf;
+    int         errnum;
+} lob_source_t;
+
+/* The LOB cache of write_blob/write_clob -cache: files in a directory,
+   indexed in memory by version and query, evicted in LRU order. */
+#define LOB_CACHE_PREFIX "nsoracle-cache-"
+
+typedef struct lob_cache_entry {
+    Tcl_HashEntry *hPtr;
+    char          *path;
+    size_t         size;
+    struct lob_cache_entry *prev, *next;
+} lob_cache_entry_t;
+
+static struct {
+    const char        *dir;
+    Ns_Mutex           lock;
+    Tcl_HashTable      table;
+    lob_cache_entry_t *first, *last;   /* most recently used first */
+    Tcl_WideInt        size, max_size;
+    unsigned long      hits, misses, stores, evictions;
+} lob_cache;
+
+/* The catalog of package descriptions of [ns_ora desc], shared by all
+   interps.  Entries are keyed by user, datasource and the name as
+   given, and revalidated against the LAST_DDL_TIME of the package. */
+typedef struct desc_catalog_entry {
+    char   *owner;
+    char   *name;
+    char   *ddl_time;
+    char   *desc;
+    time_t  checked;
+} desc_catalog_entry_t;
+
+static struct {
+    Ns_Mutex      lock;
+    Tcl_HashTable table;
+    int           initialized;
+    const char   *file;         /* the first DescCatalogFile configured */
+    int           dirty;        /* changed since the last save */
+    int           saving;       /* a thread is writing the file */
+    time_t        saved;
+} desc_catalog;
+
+/* The signatures of PL/SQL procedures called with [ns_ora call], as
+   described once per pool.  A signature keeps the generated block for
+   each combination of arguments passed, keyed by a y/n mask. */
+typedef struct ora_call_arg {
+    char *name;
+    ub2   type;
+    ub2   elem_type;
+    int   mode;
+    int   has_default;
+} ora_call_arg_t;
+
+typedef struct ora_call_sig {
+    int             n_args;
+    int             n_required;
+    ora_call_arg_t *args;
+    ora_call_arg_t *ret;
+    Tcl_HashTable   blocks;
+} ora_call_sig_t;
+
+typedef struct ora_call_entry {
+    Tcl_HashEntry  *hPtr;
+    char           *name;
+    int             n_sigs;
+    ora_call_sig_t *sigs;
+    int             refcount;
+} ora_call_entry_t;
+
+static struct {
+    Ns_Mutex      lock;
+    Tcl_HashTable table;
+} call_cache;
+
+/* Buffer sizes of OUT arguments of [ns_ora call] */
+#define ORA_CALL_NUMBER_SIZE 82
+#define ORA_CALL_STRING_SIZE 32768
+
+/* One argument of an [ns_ora call] while the call executes */
+typedef struct ora_call_bind {
+    ora_call_arg_t *arg;
+    Tcl_Obj        *varObj;
+    OCIBind        *bind;
+    sb2             ind;
+    char           *buf;
+    sb8             int_value;
+    OCIDate         date_value;
+    OCILobLocator  *lob;
+    boolean         temporary_p;
+    fetch_buffer_t *table;
+} ora_call_bind_t;
+
 /* A linked list to use when parsing SQL. */
 typedef struct _string_list_elt {
     char *string;
     struct _string_list_elt *next;
 } string_list_elt_t;
 
+/* The driver object behind prepare/exec/close: a statement prepared
+   once, with its bind variables bound once to fetch buffers that get
+   new values for every exec */
+typedef struct ora_prepared {
+    OCIStmt           *stmt;
+    char              *query;
+    ub2                type;
+    string_list_elt_t *bind_variables;
+    int                n_binds;
+    fetch_buffer_t    *binds;
+} ora_prepared_t;
+
+/* The driver object behind open_cursor/getrow/close: a query with a
+   statement and fetch buffers of its own, fetched a batch of rows at a
+   time while other statements of the handle come and go */
+typedef struct ora_cursor {
+    OCIStmt        *stmt;
+    char           *query;
+    fetch_buffer_t *fetchbufs;
+    int             n_columns;
+    ub4             array_size;
+    ub4             n_rows;        /* rows of the current batch */
+    ub4             row;           /* next row of the current batch */
+    int             end_p;
+    int             scrollable_p;
+} ora_cursor_t;
+
+/* The named queries of [ns_ora register], shared by all interps.  An
+   entry holds what [ns_ora run] would otherwise derive from the SQL on
+   every call.  The key of the statement in the statement cache of the
+   sessions is the name and the generation of the registration, so that
+   a query registered again under the same name is prepared anew. */
+typedef struct ora_query {
+    Tcl_HashEntry     *hPtr;
+    char              *name;
+    char              *key;
+    char              *sql;
+    string_list_elt_t *bind_variables;
+    int                n_binds;
+    ub2                type;        /* OCI_STMT_*, known after the first run */
+    ub4                prefetch;
+    ub4                array_size;
+    ub4                timeout;     /* ms, 0 for none */
+    int                warm_p;
+    int                refcount;
+} ora_query_t;
+
+static struct {
+    Ns_Mutex      lock;
+    Tcl_HashTable table;
+    unsigned long generation;
+} query_registry;
+
 static const char   *Ns_OracleName(Ns_DbHandle *dummy);
 static const char   *Ns_OracleDbType(Ns_DbHandle *dummy);
 static Ns_Set       *Ns_OracleSelect(Ns_DbHandle *dbh, char *sql);
@@ -204,7 +518,15 @@ static Ns_Set *Oracle0or1Row(Tcl_Interp *interp,
                              Ns_DbHandle *handle, Ns_Set *row, int *nrows);
 
 static sb4     ora_append_buf_to_dstring(dvoid * ctxp, CONST dvoid * bufp,
-                                         ub4 len, ub1 piece);
+                                         oraub8 len, ub1 piece,
+                                         dvoid ** changed_bufpp,
+                                         oraub8 * changed_lenp);
+static sb4     ora_append_buf_to_fd(dvoid * ctxp, CONST dvoid * bufp,
+                                    oraub8 len, ub1 piece,
+                                    dvoid ** changed_bufpp,
+                                    oraub8 * changed_lenp);
+static int     lob_spool_write(lob_spool_t * spool, const char *p, size_t len,
+                               int flush);
 
 NS_EXPORT Ns_ReturnCode Ns_DbDriverInit(const char *hdriver, const char *config_path);
 
@@ -244,6 +566,14 @@ enum {
     STREAM_WRITE_LOB_PIPE       /* user click stop, but we need to do some cleanup */
 };
 
+/* result codes from parse_range
+ */
+enum {
+    RANGE_NONE = 0,
+    RANGE_OK,
+    RANGE_UNSATISFIABLE
+};
+
 enum {
     DYNAMIC_BIND_POSITIONAL = 0,
     DYNAMIC_BIND_NAMED,
@@ -261,19 +591,208 @@ static int tcl_error_p(const char *file, int line, const char *fn, Tcl_Interp *
         oci_status_t oci_status);
 static void downcase(char *s);
 static CONST char *nilp(CONST char *s);
+static void lob_set_compression(Ns_Conn * conn, int blob_p);
+static int lob_compression(Ns_Conn * conn, int blob_p);
+static int stream_abort_lob(Ns_DbHandle * dbh, OCILobLocator * lobl,
+                            oraub8 offset, oraub8 remainder, ub1 * bufp,
+                            OCISvcCtx * svchp, OCIError * errhp);
+static int parse_range(Ns_Conn * conn, oraub8 length,
+                       oraub8 * first, oraub8 * last);
 static int stream_write_lob(Tcl_Interp * interp, Ns_DbHandle * dbh,
-                            int rowind, OCILobLocator * lobl, const char *path,
+                            int blob_p, OCILobLocator * lobl, const char *path,
                             int to_conn_p, OCISvcCtx * svchp,
                             OCIError * errhp);
+static int spool_write_lob(Tcl_Interp * interp, Ns_DbHandle * dbh,
+                           OCILobLocator * lobl, int blob_p,
+                           const char *cache_key,
+                           OCISvcCtx * svchp, OCIError * errhp);
+static const char *lob_content_type(Ns_Conn * conn, int blob_p);
+static void lob_cache_init(const char *dir, Tcl_WideInt max_size);
+static void lob_cache_add(const char *key, const char *path, size_t size);
+static int lob_cache_return(Ns_Conn * conn, const char *key, int blob_p);
 static int stream_read_lob(Tcl_Interp * interp, Ns_DbHandle * dbh,
                            int rowind, OCILobLocator * lobl, const char *path,
                            ora_connection_t * connection);
+static int stream_read_conn_lob(Tcl_Interp * interp, Ns_DbHandle * dbh,
+                                OCILobLocator * lobl,
+                                ora_connection_t * connection);
+static int stream_write_lob_source(Tcl_Interp * interp, Ns_DbHandle * dbh,
+                                   OCILobLocator * lobl,
+                                   lob_source_t * source,
+                                   ora_connection_t * connection);
+static int lob_source_read(lob_source_t * source, void **bufpp, size_t length);
+static sb4 lob_source_next_piece(dvoid * ctxp, dvoid * bufp, oraub8 * lenp,
+                                 ub1 * piece, dvoid ** changed_bufpp,
+                                 oraub8 * changed_lenp);
 
 static string_list_elt_t * parse_bind_variables(char *input);
 static void string_list_free_list(string_list_elt_t * head);
 static int string_list_len(string_list_elt_t * head);
 static string_list_elt_t * string_list_elt_new(char *string);
 
+static ora_object_t *ora_object_new(ora_connection_t * connection,
+                                    const char *handle, int type,
+                                    const char *prefix, void *data,
+                                    ora_object_free_proc * free_proc);
+static Tcl_Obj *ora_object_id(ora_object_t * object);
+static void ora_objects_free_type(ora_connection_t * connection, int type);
+static const char *lob_token_new(Ns_DbHandle * dbh, OCILobLocator * lob,
+                                 int blob_p);
+static ora_object_free_proc lob_token_free;
+static Tcl_Obj *lob_read_obj(Tcl_Interp * interp, Ns_DbHandle * dbh,
+                             OCILobLocator * lob, int blob_p,
+                             oraub8 offset, oraub8 length);
+static const char *lob_value_bytes(Tcl_Obj * valueObj, int blob_p,
+                                   TCL_SIZE_T * lengthPtr);
+static int ora_rows_fetch(Tcl_Interp * interp, Ns_DbHandle * dbh,
+                          Ns_Set * row);
+static fetch_buffer_t *ora_cursor_define(Tcl_Interp * interp, Ns_DbHandle * dbh,
+                                         OCIStmt * stmt, ub4 array_size,
+                                         const char *query, int *n_columnsPtr);
+static Tcl_Obj *ora_cursor_row(Tcl_Interp * interp, Ns_DbHandle * dbh,
+                               fetch_buffer_t * fetchbufs, int n_columns,
+                               ub4 row);
+static Tcl_Obj *ora_cursor_rows(Tcl_Interp * interp, Ns_DbHandle * dbh,
+                                OCIStmt * stmt, ub4 array_size,
+                                const char *query);
+static void ora_cursor_free(Ns_DbHandle * dbh, fetch_buffer_t * fetchbufs,
+                            int n_columns);
+static Tcl_Obj *ora_implicit_results(Tcl_Interp * interp, Ns_DbHandle * dbh,
+                                     OCIStmt * stmt, const char *query);
+static ora_object_t *ora_object_get(Tcl_Interp * interp, Tcl_Obj * idObj,
+                                   int type, const char *what);
+static void ora_object_free(ora_object_t * object);
+static void ora_objects_free_all(ora_connection_t * connection);
+static int lob_writer_flush(Tcl_Interp * interp, ora_connection_t * connection,
+                            lob_writer_t * writer, int final_p);
+static ora_object_free_proc lob_writer_free;
+static OCILobLocator *lob_select_locator(Tcl_Interp * interp,
+                                         Ns_DbHandle * dbh, char *query,
+                                         ub2 * typep);
+static ub4 lob_chunks_per_buffer(ora_connection_t * connection,
+                                 OCILobLocator * lob);
+static ora_object_free_proc lob_channel_release;
+static Tcl_DriverInputProc lob_channel_input;
+static Tcl_DriverClose2Proc lob_channel_close;
+static Tcl_DriverWatchProc lob_channel_watch;
+static Tcl_DriverBlockModeProc lob_channel_block_mode;
+static Tcl_TimerProc lob_channel_notify;
+
+static const Tcl_ChannelType lob_channel_type = {
+    "nsoracle_lob",             /* typeName */
+    TCL_CHANNEL_VERSION_5,      /* version */
+    TCL_CLOSE2PROC,             /* closeProc */
+    lob_channel_input,          /* inputProc */
+    NULL,                       /* outputProc */
+    NULL,                       /* seekProc */
+    NULL,                       /* setOptionProc */
+    NULL,                       /* getOptionProc */
+    lob_channel_watch,          /* watchProc */
+    NULL,                       /* getHandleProc */
+    lob_channel_close,          /* close2Proc */
+    lob_channel_block_mode,     /* blockModeProc */
+    NULL,                       /* flushProc */
+    NULL,                       /* handlerProc */
+    NULL,                       /* wideSeekProc */
+    NULL,                       /* threadActionProc */
+    NULL                        /* truncateProc */
+};
+
+static void desc_catalog_init(const char *file);
+static void desc_catalog_key(Ns_DbHandle * dbh, const char *name,
+                             Tcl_DString * dsPtr);
+static Tcl_Obj *desc_catalog_get(Ns_DbHandle * dbh, const char *name);
+static void desc_catalog_put(Ns_DbHandle * dbh, const char *name,
+                             OCIParam * param, Tcl_Obj * descObj);
+static int desc_catalog_ddl_time(Ns_DbHandle * dbh, const char *owner,
+                                 const char *name, char *buf, size_t size);
+static void desc_catalog_entry_free(desc_catalog_entry_t * entry);
+static void desc_catalog_save(int force_p);
+static void desc_catalog_shutdown(const Ns_Time * toPtr, const void *arg);
+
+static int ora_call_name_p(const char *name);
+static ora_call_entry_t *ora_call_lookup(Tcl_Interp * interp,
+                                         Ns_DbHandle * dbh, const char *name);
+static void ora_call_release(ora_call_entry_t * entry, int forget_p);
+static void ora_call_entry_free(ora_call_entry_t * entry);
+static ora_call_entry_t *ora_call_describe(Tcl_Interp * interp,
+                                           Ns_DbHandle * dbh,
+                                           const char *name);
+static OCIParam *ora_call_describe_object(ora_connection_t * connection,
+                                          OCIDescribe * desc,
+                                          const char *name, ub1 * ptypep);
+static void ora_call_add_sig(ora_connection_t * connection,
+                             ora_call_entry_t * entry, OCIParam * argList);
+static int ora_call_match_p(ora_call_sig_t * sig, int objc,
+                            Tcl_Obj *const* objv);
+static void ora_call_block(ora_call_entry_t * entry, ora_call_sig_t * sig,
+                           int objc, Tcl_Obj *const* objv,
+                           Tcl_DString * dsPtr);
+static int ora_call_bind(Tcl_Interp * interp, Ns_DbHandle * dbh,
+                         ora_call_bind_t * bind, Tcl_Obj * valueObj,
+                         ub4 position, const char *query);
+static Tcl_Obj *ora_call_value(Tcl_Interp * interp, Ns_DbHandle * dbh,
+                               ora_call_bind_t * bind);
+static void ora_call_unbind(ora_connection_t * connection,
+                            ora_call_bind_t * bind);
+static int ora_call_parse_date(const char *value, OCIDate * date);
+static int ora_call_number_type_p(ub2 type);
+static ub2 ora_table_elem_type(ora_connection_t * connection,
+                               OCIParam * argParam);
+static int ora_table_values(Tcl_Interp * interp, fetch_buffer_t * fetchbuf,
+                            Tcl_Obj * listObj, ub2 elem_type,
+                            const char *name);
+static void ora_table_free(fetch_buffer_t * fetchbuf);
+static int ora_list_bind(Tcl_Interp * interp, Ns_DbHandle * dbh,
+                         fetch_buffer_t * fetchbuf, const char *name,
+                         const char *value, int number_p, const char *query);
+static OCIType *ora_list_type(Tcl_Interp * interp, Ns_DbHandle * dbh,
+                              int number_p, const char *query);
+static void fetch_buffer_free_coll(fetch_buffer_t * fetchbuf);
+static int ora_prepared_bind(Tcl_Interp * interp, Ns_DbHandle * dbh,
+                             OCIStmt * stmt, const char *query,
+                             string_list_elt_t * bind_variables,
+                             fetch_buffer_t * binds);
+static int ora_prepared_values(Tcl_Interp * interp,
+                               string_list_elt_t * bind_variables,
+                               fetch_buffer_t * binds,
+                               int n_args, Tcl_Obj *const* args);
+static int ora_prepared_exec(Tcl_Interp * interp, Ns_DbHandle * dbh,
+                             OCIStmt * stmt, ub2 type, const char *query,
+                             string_list_elt_t * bind_variables,
+                             fetch_buffer_t * binds, ub4 array_size,
+                             int n_args, Tcl_Obj *const* args);
+static ora_object_free_proc ora_prepared_free;
+static ora_object_free_proc ora_cursor_object_free;
+static int ora_cursor_fetch(Tcl_Interp * interp, ora_connection_t * connection,
+                            ora_cursor_t * cursor, ub4 n_rows,
+                            ub2 orientation, sb4 offset);
+static ora_query_t *ora_query_get(Tcl_Interp * interp, const char *name);
+static void ora_query_release(ora_query_t * query);
+static void ora_query_free(ora_query_t * query);
+static int ora_queries_warm(Ns_DbHandle * dbh);
+static ora_describe_t *ora_describe_get(ora_connection_t * connection,
+                                        const char *sql);
+static int ora_describe_columns(Ns_DbHandle * dbh, OCIStmt * stmt,
+                                ora_describe_t * describe, const char *query);
+static int ora_describe_current_p(ora_connection_t * connection,
+                                  OCIStmt * stmt, ora_describe_t * describe);
+static void ora_describe_clear(ora_describe_t * describe);
+static void ora_describe_forget(ora_connection_t * connection,
+                                ora_describe_t * describe);
+static void ora_describe_check(ora_connection_t * connection,
+                               oci_status_t oci_status);
+static void ora_describes_free(ora_connection_t * connection);
+static int ora_dbms_output_lines(Ns_DbHandle * dbh, Tcl_Obj * listObj);
+static void ora_dbms_output_log(Ns_DbHandle * dbh, const Ns_Time * start,
+                                const char *query);
+
+static char *ora_buffer_get(ora_connection_t * connection, ub4 size,
+                            ub4 * sizePtr);
+static void ora_buffer_put(ora_connection_t * connection, char *buf, ub4 size);
+static void ora_buffers_free(ora_connection_t * connection);
+static void fetch_buffer_free_buf(fetch_buffer_t * fetchbuf);
+
 static void malloc_fetch_buffers(ora_connection_t * connection);
 static void free_fetch_buffers(ora_connection_t * connection);
 static int handle_builtins(Ns_DbHandle * dbh, char *sql);
@@ -309,11 +828,11 @@ void OracleDescribeSynonym (OCIDescribe *descHandlePtr,
         OCIParam *paramHandlePtr, ora_connection_t *connection,
         Ns_DbHandle *dbh, Tcl_Interp *interp );
 
-void OracleDescribePackage (OCIDescribe *descHandlePtr,
+int OracleDescribePackage (OCIDescribe *descHandlePtr,
         OCIParam *paramHandlePtr, ora_connection_t *connection,
         Ns_DbHandle *dbh, char *package, Tcl_Interp *interp );
 
-void OracleDescribeArguments (OCIDescribe *descHandlePtr,
+int OracleDescribeArguments (OCIDescribe *descHandlePtr,
         OCIParam *paramHandlePtr, ora_connection_t *connection,
         Ns_DbHandle *dbh, Tcl_Interp *interp, Tcl_Obj *list);
 
@@ -327,6 +846,51 @@ static int char_expansion;
 static int prefetch_rows = 0;
 static int prefetch_memory = 0;
 
+/* Rows prefetched with the execute of a query when neither PrefetchRows
+   nor PrefetchMemory is set: the reply then tells 0or1row and 1row
+   whether a second row follows, without another round trip */
+#define MIN_PREFETCH_ROWS 2
+
+/* Spooling of write_clob/write_blob output, see spool_write_lob() */
+static bool lob_spool_p = NS_FALSE;
+static int lob_spool_memory = 65536;
+static const char *lob_spool_dir = NULL;
+static const char *lob_cache_dir = NULL;
+
+/* Up to this many bytes, an interrupted LOB read is drained instead of
+   broken off */
+static int lob_drain_limit = 1048576;
+
+/* Default of the lazy LOB mode of handles, see OracleLazyLobs() */
+static bool lazy_lobs_p = NS_FALSE;
+
+/* To recognize byte array values for BLOBs, see lob_value_bytes() */
+static const Tcl_ObjType *byte_array_type = NULL;
+
+/* gzip level for write_clob, 0 disables, see lob_set_compression() */
+static int lob_compress_level = 0;
+
+/* Package descriptions are kept in a catalog shared by all interps
+   and checked against LAST_DDL_TIME after desc_catalog_check
+   seconds, see desc_catalog_get() */
+static bool desc_catalog_p = NS_FALSE;
+static int desc_catalog_check = 60;
+static const char *desc_catalog_file = NULL;
+
+/* The catalog file is written at most this often, in seconds, and at
+   shutdown */
+#define DESC_CATALOG_SAVE_INTERVAL 60
+
+/* Size of the OCI statement cache of a session, 0 disables it */
+static int statement_cache_size = 20;
+
+/* Number of select lists kept by a session, 0 disables it */
+static int describe_cache_size = 100;
+
+/* Collection types Tcl lists are bound as with -bindlist */
+static const char *number_list_type = "SYS.ODCINUMBERLIST";
+static const char *string_list_type = "SYS.ODCIVARCHAR2LIST";
+
 static Ns_DbProc ora_procs[] = {
     {DbFn_Name,         (ns_funcptr_t) Ns_OracleName},
     {DbFn_DbType,       (ns_funcptr_t) Ns_OracleDbType},
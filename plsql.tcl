@@ -127,7 +127,9 @@ proc plsql::init { args } {
     }
   }
 
-  # get the description of the package.
+  # get the description of the package; the driver keeps it in a catalog
+  # shared by all interps (see DescCatalog), so this is cheap after the
+  # first interp.
   if { [llength $pool] } {
     set dbh [ns_db gethandle $pool]
   } else {
@@ -232,6 +234,7 @@ proc plsql::execute { args } {
   set _signature [lrange $_signature 1 end]
   set _thenames ""
   set _theargs ""
+  set _arrays ""
   set _debug ""
   # for each parg (varname, mode, type, default)
   for { set _i 0 } { $_i < [llength $_signature] } { incr _i } {
@@ -254,6 +257,10 @@ proc plsql::execute { args } {
       # if it's a value, use the appropriate TO_type business
       if { $_mode == "IN" } {
         switch -glob -- [string map {CLOB VARCHAR2} $_type] {
+          TABLE*      {
+            # a list, bound to the index-by table as a whole
+            lappend _arrays $_varname
+          }
           NUMBER      {
             set _bind TO_NUMBER($_bind)
           }
@@ -328,7 +335,7 @@ proc plsql::execute { args } {
           # the ns_oracle plsql call
           if { $_return_type == "REF CURSOR" } {
             # this function returns a ref cursor
-            ns_oracle_plsql _dbh $_call result_bind_variable___
+            ns_oracle_plsql _dbh $_call result_bind_variable___ 1 $_arrays
             if { [catch {
               set _setid [ns_db bindrow $_dbh]
             }] } {
@@ -347,12 +354,12 @@ proc plsql::execute { args } {
             }
             if { [info exists _ref] } {
               # $_ref is the ref cursor argument.
-              ns_oracle_plsql _dbh $_call $_ref
+              ns_oracle_plsql _dbh $_call $_ref 1 $_arrays
               set _setid [ns_db bindrow $_dbh]
               set _release [[::plsql::get_ref_cursor_hook] $_dbh $_setid $_ref 1]
             } else {
               # no ref cursor argument
-              ns_oracle_plsql _dbh $_call
+              ns_oracle_plsql _dbh $_call {} 1 $_arrays
             }
             set _result $result_bind_variable___
           }
@@ -371,12 +378,12 @@ proc plsql::execute { args } {
         }
         if { [info exists _ref] } {
           # $_ref is the ref cursor argument.
-          ns_oracle_plsql _dbh $_call $_ref
+          ns_oracle_plsql _dbh $_call $_ref 1 $_arrays
           set _setid [ns_db bindrow $_dbh]
           set _release [[::plsql::get_ref_cursor_hook] $_dbh $_setid $_ref 1]
         } else {
           # no ref cursor argument
-          ns_oracle_plsql _dbh $_call
+          ns_oracle_plsql _dbh $_call {} 1 $_arrays
         }
         set _result ""
       }
@@ -408,7 +415,7 @@ proc plsql::execute { args } {
 
 #{{{ plsql::ns_oracle_plsql
 #
-proc plsql::ns_oracle_plsql { dbh_var call {bind_variable {}} {loopsafe 1} } {
+proc plsql::ns_oracle_plsql { dbh_var call {bind_variable {}} {loopsafe 1} {arrays {}} } {
 
   # upvar the bind_variable
   if { [llength $bind_variable] } {
@@ -416,7 +423,10 @@ proc plsql::ns_oracle_plsql { dbh_var call {bind_variable {}} {loopsafe 1} } {
   }
   upvar $dbh_var handle
 
-  set caught [catch { uplevel "ns_ora plsql $handle \"$call\" $bind_variable" } oerr]
+  # lists bound to index-by tables
+  set arrays_option [list -arrays $arrays]
+
+  set caught [catch { uplevel "ns_ora plsql $handle $arrays_option \"$call\" $bind_variable" } oerr]
 
   # The following errors are non-fatal and the query *should* work if
   # we just give it another try after bouncing the pool.
@@ -428,7 +438,7 @@ proc plsql::ns_oracle_plsql { dbh_var call {bind_variable {}} {loopsafe 1} } {
       ns_db bouncepool [ns_db poolname $handle]
       ns_db releasehandle $handle
       set handle [ns_db gethandle]
-      uplevel "ns_oracle_plsql $dbh_var \"$call\" \"$bind_variable\" 0"
+      uplevel "ns_oracle_plsql $dbh_var \"$call\" \"$bind_variable\" 0 [list $arrays]"
     }
   } elseif { $caught } {
     error $oerr
@@ -525,6 +535,12 @@ proc plsql::type { var parg } {
         return 2
       }
     }
+    TABLE*     {
+      # a list for an index-by table
+      if { ![catch { llength $myvar }] } {
+        return 1
+      }
+    }
     VARCHAR*   {
       if { [regexp {^'(.*?)'$} $myvar] } {
         # explicitly VARCHAR
@@ -773,6 +773,316 @@ select an_int, chunks, a_varchar
 
 
 
+ns_write "<li> ns_ora call, function and procedure with OUT arguments. "
+
+ns_db dml $db "
+create or replace package markd_call_test as
+    type id_tab is table of number index by pls_integer;
+    function add_days (d in date, n in number default 1) return date;
+    procedure split (s in varchar2, head out varchar2, n in out number);
+    function total (ids in id_tab) return number;
+end;"
+ns_db dml $db "
+create or replace package body markd_call_test as
+    function add_days (d in date, n in number default 1) return date is
+    begin
+        return d + n;
+    end;
+    procedure split (s in varchar2, head out varchar2, n in out number) is
+    begin
+        head := substr(s, 1, n);
+        n := length(s) - n;
+    end;
+    function total (ids in id_tab) return number is
+        t number := 0;
+    begin
+        for i in 1 .. ids.count loop
+            t := t + ids(i);
+        end loop;
+        return t;
+    end;
+end;"
+
+set n 3
+set day [ns_ora call $db markd_call_test.add_days "2024-02-28" 2]
+set default_day [ns_ora call $db markd_call_test.add_days "2024-02-28 10:30:00" --]
+ns_ora call $db markd_call_test.split "abcdef" head n
+if { $day ne "2024-03-01 00:00:00" || $default_day ne "2024-02-29 10:30:00"
+     || $head ne "abc" || $n != 3 } {
+    ns_write "<b><font color=red>got $day, $default_day, $head, $n</font></b>"
+} else {
+    ns_write "got expected results"
+}
+
+ns_write "<li> ns_ora call and ns_ora plsql -arrays, index-by table arguments. "
+
+set ids {5 6}
+set total ""
+set call_total [ns_ora call $db markd_call_test.total {1 2 3 4}]
+ns_ora plsql $db -arrays ids "begin :total := markd_call_test.total(:ids); end;"
+if { $call_total != 10 || $total != 11 } {
+    ns_write "<b><font color=red>got $call_total, $total</font></b>"
+} else {
+    ns_write "got expected results"
+}
+
+ns_db dml $db "drop package markd_call_test"
+
+ns_write "<li> ns_ora desc of a package, again after it changed. "
+
+set desc_catalog_p 0
+set desc_catalog_check 60
+set drivers [ns_configsection ns/db/drivers]
+if { $drivers ne "" } {
+    for { set i 0 } { $i < [ns_set size $drivers] } { incr i } {
+        if { [string match *nsoracle* [ns_set value $drivers $i]] } {
+            set section ns/db/driver/[ns_set key $drivers $i]
+            set desc_catalog_p [ns_config -bool $section DescCatalog 0]
+            set desc_catalog_check [ns_config -int $section DescCatalogCheck 60]
+        }
+    }
+}
+
+ns_db dml $db "
+create or replace package markd_desc_test as
+    procedure first_proc (n in number);
+end;"
+set desc1 [ns_ora desc $db markd_desc_test]
+set desc2 [ns_ora desc $db markd_desc_test]
+ns_db dml $db "
+create or replace package markd_desc_test as
+    procedure first_proc (n in number);
+    procedure second_proc (s in varchar2);
+end;"
+set desc3 [ns_ora desc $db markd_desc_test]
+ns_db dml $db "drop package markd_desc_test"
+
+# a catalog entry is only checked again after DescCatalogCheck seconds
+set changed_p [expr {!$desc_catalog_p || $desc_catalog_check == 0}]
+if { $desc1 ne $desc2
+     || ![string match -nocase *first_proc* $desc1]
+     || [string match -nocase *second_proc* $desc1]
+     || ($changed_p && ![string match -nocase *second_proc* $desc3]) } {
+    ns_write "<b><font color=red>got $desc1, $desc2, $desc3</font></b>"
+} elseif { !$changed_p } {
+    ns_write "got expected results (change not checked, DescCatalogCheck is $desc_catalog_check)"
+} else {
+    ns_write "got expected results"
+}
+
+ns_write "<li> ns_ora plsql -cursors, two REF CURSORs in one call. "
+
+set result [ns_ora plsql $db -cursors {small big} "
+begin
+    open :small for select level n from dual connect by level <= 2;
+    open :big for select level n, 'x' || level s from dual connect by level <= 300;
+end;"]
+set small [dict get $result small]
+set big [dict get $result big]
+if { [lsort [dict keys $result]] ne {big small}
+     || [llength $small] != 2 || [dict get [lindex $small 1] n] != 2
+     || [llength $big] != 300 || [dict get [lindex $big 299] s] ne "x300" } {
+    ns_write "<b><font color=red>got [dict keys $result], [llength $small], [llength $big] rows</font></b>"
+} else {
+    ns_write "got expected results"
+}
+
+ns_write "<li> implicit results of DBMS_SQL.RETURN_RESULT with ns_ora rows and plsql. "
+
+set block "
+declare
+    c1 sys_refcursor;
+    c2 sys_refcursor;
+begin
+    open c1 for select level n from dual connect by level <= 3;
+    dbms_sql.return_result(c1);
+    open c2 for select 'x' || level s from dual connect by level <= 150;
+    dbms_sql.return_result(c2);
+end;"
+if { [catch { ns_ora rows $db $block } results] } {
+    if { [string match "*OCI 12c*" $results] || [string match "*PLS-00302*" $results] } {
+        ns_write "skipped: needs OCI 12c client headers and an Oracle 12c server"
+    } else {
+        ns_write "<b><font color=red>got $results</font></b>"
+    }
+} else {
+    set plsql_results [ns_ora plsql $db $block]
+    set select_error [catch { ns_ora select $db $block }]
+    if { [llength $results] != 2
+         || [llength [lindex $results 0]] != 3
+         || [dict get [lindex [lindex $results 0] 2] n] != 3
+         || [llength [lindex $results 1]] != 150
+         || [dict get [lindex [lindex $results 1] 149] s] ne "x150"
+         || [lsort [dict keys $plsql_results]] ne {:1 :2}
+         || [dict get $plsql_results :1] ne [lindex $results 0]
+         || !$select_error } {
+        ns_write "<b><font color=red>got [llength $results] results, [dict keys $plsql_results], select error $select_error</font></b>"
+    } else {
+        ns_write "got expected results"
+    }
+}
+
+ns_write "<li> ns_ora exec_plsql and exec_plsql_bind, results over 4096 characters. "
+
+set long_value [string repeat "0123456789" 500]
+set exec_value [ns_ora exec_plsql $db "begin :1 := rpad('0123456789', 5000, '0123456789'); end;"]
+set bind_value [ns_ora exec_plsql_bind $db "begin :bound := rpad('0123456789', 5000, '0123456789'); end;" bound]
+if { $exec_value ne $long_value || $bind_value ne $long_value || $bound ne $long_value } {
+    ns_write "<b><font color=red>got [string length $exec_value], [string length $bind_value], [string length $bound] characters</font></b>"
+} else {
+    ns_write "got expected results"
+}
+
+ns_write "<li> ns_ora dbms_output. "
+
+ns_ora dbms_output $db -enable 100000
+ns_ora plsql $db "begin dbms_output.put_line('one'); dbms_output.put_line(null); dbms_output.put_line('three'); end;"
+set lines [ns_ora dbms_output $db -enable 0]
+if { $lines ne {one {} three} } {
+    ns_write "<b><font color=red>got $lines</font></b>"
+} else {
+    ns_write "got expected results"
+}
+
+ns_write "<li> ns_ora -bindlist, lists bound as collections. "
+
+set ids {1 2 {} 3}
+set names {a b}
+set keys {007 42}
+set n_ids [ns_set get [ns_ora 1row $db -bindlist {{ids number}} "select count(column_value) n from table(:ids)"] n]
+set n_names [llength [ns_ora rows $db -bindlist names "select column_value from table(:names)"]]
+set back_keys [ns_ora rows $db -bindlist keys "select column_value k from table(:keys) order by 1"]
+if { $n_ids != 3 || $n_names != 2
+     || [dict get [lindex $back_keys 0] k] ne "007" } {
+    ns_write "<b><font color=red>got $n_ids, $n_names, $back_keys</font></b>"
+} else {
+    ns_write "got expected results"
+}
+
+ns_write "<li> ns_ora prepare, exec and close. "
+
+ns_db dml $db "delete from markd_bind_test"
+set insert [ns_ora prepare $db "insert into markd_bind_test (an_int, a_varchar) values (:1, :a_varchar)"]
+for {set i 1} {$i <= 100} {incr i} {
+    set a_varchar "row $i"
+    ns_ora exec $insert $i
+}
+ns_ora exec $insert -bind [dict create a_varchar "row 101"] 101
+ns_ora close $insert
+set select [ns_ora prepare $db "select a_varchar from markd_bind_test where an_int = :an_int"]
+set rows [ns_ora exec $select -bind {an_int 101}]
+ns_ora close $select
+if { [llength $rows] != 1 || [dict get [lindex $rows 0] a_varchar] ne "row 101"
+     || [ns_set get [ns_db 1row $db "select count(*) n from markd_bind_test"] n] != 101 } {
+    ns_write "<b><font color=red>got $rows</font></b>"
+} else {
+    ns_write "got expected results"
+}
+
+ns_write "<li> ns_ora register and run. "
+
+ns_ora register markd_bind_test.row \
+    "select a_varchar from markd_bind_test where an_int = :1" -prefetch 2 -arraysize 10
+ns_ora register markd_bind_test.range \
+    "select an_int from markd_bind_test where an_int between :low and :high" -warm
+set low 11
+set high 30
+set row [ns_ora run $db markd_bind_test.row 42]
+set range [ns_ora run $db markd_bind_test.range]
+set range2 [ns_ora run $db markd_bind_test.range -bind {low 1 high 5}]
+if { [dict get [lindex $row 0] a_varchar] ne "row 42" || [llength $range] != 20
+     || [llength $range2] != 5 } {
+    ns_write "<b><font color=red>got $row, [llength $range], [llength $range2]</font></b>"
+} else {
+    ns_write "got expected results"
+}
+
+ns_write "<li> ns_ora open_cursor and getrow, nested cursors. "
+
+set outer [ns_ora open_cursor $db "select an_int from markd_bind_test where an_int <= 3 order by an_int"]
+set got {}
+while { [ns_ora getrow $outer row] } {
+    set inner [ns_ora open_cursor $db "select a_varchar from markd_bind_test where an_int = :1" \
+                   [dict get $row an_int]]
+    while { [ns_ora getrow $inner inner_row] } {
+        lappend got [dict get $inner_row a_varchar]
+    }
+    ns_ora close $inner
+}
+ns_ora close $outer
+if { $got ne {{row 1} {row 2} {row 3}} } {
+    ns_write "<b><font color=red>got $got</font></b>"
+} else {
+    ns_write "got expected results"
+}
+
+ns_write "<li> ns_ora fetch, scrollable cursors. "
+
+set cursor [ns_ora open_cursor $db -scrollable "select an_int from markd_bind_test order by an_int"]
+set page3 [ns_ora fetch $cursor -absolute 21 -count 10]
+set page1 [ns_ora fetch $cursor -absolute 1 -count 10]
+set next [ns_ora fetch $cursor -count 10]
+set last [ns_ora fetch $cursor -last]
+ns_ora close $cursor
+if { [llength $page3] != 10 || [dict get [lindex $page3 0] an_int] != 21
+     || [dict get [lindex $page1 9] an_int] != 10
+     || [dict get [lindex $next 0] an_int] != 11
+     || [dict get [lindex $last 0] an_int] != 101 } {
+    ns_write "<b><font color=red>got $page3, $page1, $next, $last</font></b>"
+} else {
+    ns_write "got expected results"
+}
+
+ns_write "<li> ns_ora fetch, counts above one fetch. "
+
+set cursor [ns_ora open_cursor $db "select level n from dual connect by level <= 2500"]
+set first [ns_ora fetch $cursor -count 2400]
+set rest [ns_ora fetch $cursor -count 1000000]
+ns_ora close $cursor
+if { [llength $first] != 2400 || [dict get [lindex $first end] n] != 2400
+     || [llength $rest] != 100 || [dict get [lindex $rest 0] n] != 2401 } {
+    ns_write "<b><font color=red>got [llength $first] and [llength $rest] rows</font></b>"
+} else {
+    ns_write "got expected results"
+}
+
+ns_write "<li> ns_ora getcols and select of a described query. "
+
+set query "select an_int, a_varchar from markd_bind_test where an_int = 1"
+set cols1 [ns_ora getcols $db $query]
+set row [ns_ora 1row $db $query]
+set cols2 [ns_ora getcols $db $query]
+if { $cols1 ne $cols2 || [lindex $cols1 1] ne "an_int"
+     || [ns_set key $row 1] ne "a_varchar" || [ns_set get $row a_varchar] ne "row 1" } {
+    ns_write "<b><font color=red>got $cols1, $cols2, [ns_set array $row]</font></b>"
+} else {
+    ns_write "got expected results"
+}
+
+ns_write "<li> select of a described query after its columns changed. "
+
+catch { ns_db dml $db "drop table markd_describe_test" }
+ns_db dml $db "create table markd_describe_test (a_varchar varchar(2))"
+ns_db dml $db "insert into markd_describe_test values ('ab')"
+set query "select * from markd_describe_test"
+set row1 [ns_set array [ns_ora 1row $db $query]]
+ns_db dml $db "alter table markd_describe_test modify (a_varchar varchar(40))"
+ns_db dml $db "update markd_describe_test set a_varchar = 'a value wider than before'"
+set row2 [ns_set array [ns_ora 1row $db $query]]
+ns_db dml $db "alter table markd_describe_test rename column a_varchar to another_varchar"
+set row3 [ns_set array [ns_ora 1row $db $query]]
+ns_db dml $db "drop table markd_describe_test"
+if { $row1 ne {a_varchar ab}
+     || $row2 ne {a_varchar {a value wider than before}}
+     || $row3 ne {another_varchar {a value wider than before}} } {
+    ns_write "<b><font color=red>got $row1, $row2, $row3</font></b>"
+} else {
+    ns_write "got expected results"
+}
+
+
+
+
 # wrap it up
 
 ns_write "<p><li> cleaning up test table"
@@ -970,6 +970,587 @@ ns_write "\"</pre>"
 
 
 
+# a client going away in the middle of write_clob must leave the handle
+# (and its session) usable.  A helper page streams a large CLOB, our
+# socket client reads part of it and closes the connection.
+
+ns_write "<p><li> <b>Starting interrupted LOB download test</b>"
+
+ns_write "<li> inserting large clob"
+
+ns_ora clob_dml $db "
+insert into markd_lob_test (lob_id, chunks)
+values (700, empty_clob())
+returning chunks into :1" [string repeat "0123456789abcdef" 262144]
+
+ns_register_proc GET /nsoracle-test/write-clob {
+    set db [ns_db gethandle]
+    set sid [ns_db 0or1row $db "select sys_context('userenv', 'sid') sid from dual"]
+    nsv_set nsoracle_test sid_before [ns_set get $sid sid]
+    ns_set update [ns_conn outputheaders] Content-Type text/plain
+    if {[catch {
+        ns_write [string repeat " " 1024]
+        ns_ora write_clob $db "select chunks from markd_lob_test where lob_id = 700"
+        set sid [ns_db 0or1row $db "select sys_context('userenv', 'sid') sid from dual"]
+        nsv_set nsoracle_test sid_after [ns_set get $sid sid]
+    } errmsg]} {
+        nsv_set nsoracle_test sid_after "error: $errmsg"
+    }
+    ns_db releasehandle $db
+}
+
+nsv_unset -nocomplain nsoracle_test
+
+ns_write "<li> reading half of the clob and closing the connection"
+
+set sock [socket [ns_info address] [ns_config ns/server/[ns_info server]/module/nssock port 80]]
+fconfigure $sock -translation binary
+puts -nonewline $sock "GET /nsoracle-test/write-clob HTTP/1.0\r\n\r\n"
+flush $sock
+read $sock [expr {2 * 1024 * 1024}]
+close $sock
+
+for {set i 0} {$i < 100 && ![nsv_exists nsoracle_test sid_after]} {incr i} {
+    after 100
+}
+
+ns_write "<li> making sure the handle survived with the same session. "
+
+if { [nsv_exists nsoracle_test sid_after]
+     && [nsv_get nsoracle_test sid_before] eq [nsv_get nsoracle_test sid_after] } {
+    ns_write "it did"
+} elseif { [nsv_exists nsoracle_test sid_after] } {
+    ns_write "<font color=red>it didn't: [ns_quotehtml [nsv_get nsoracle_test sid_after]]</font>"
+} else {
+    ns_write "<font color=red>helper page did not finish</font>"
+}
+
+ns_unregister_op GET /nsoracle-test/write-clob
+
+
+
+# write_blob answers a Range request with the requested bytes only
+
+ns_write "<p><li> <b>Starting write_blob range test</b>"
+
+ns_register_proc GET /nsoracle-test/write-blob {
+    set db [ns_db gethandle]
+    ns_set update [ns_conn outputheaders] Content-Type application/octet-stream
+    ns_ora write_blob $db "select blunks from markd_lob_test where lob_id = 602"
+    ns_db releasehandle $db
+}
+
+# returns {status headers body}, the header names in lower case
+proc nsoracle_test_get {url {request_headers ""} {method GET} {content ""}} {
+    set sock [socket [ns_info address] [ns_config ns/server/[ns_info server]/module/nssock port 80]]
+    fconfigure $sock -translation binary
+    puts -nonewline $sock "$method $url HTTP/1.0\r\n$request_headers\r\n$content"
+    flush $sock
+    set response [read $sock]
+    close $sock
+
+    set split [string first "\r\n\r\n" $response]
+    set lines [split [string range $response 0 [expr {$split - 1}]] "\n"]
+    set status [lindex [lindex $lines 0] 1]
+    set headers {}
+    foreach line [lrange $lines 1 end] {
+        set colon [string first ":" $line]
+        dict set headers [string tolower [string range $line 0 [expr {$colon - 1}]]] \
+            [string trim [string range $line [expr {$colon + 1}] end]]
+    }
+    return [list $status $headers [string range $response [expr {$split + 4}] end]]
+}
+
+proc nsoracle_test_range_get {range} {
+    return [nsoracle_test_get /nsoracle-test/write-blob "Range: $range\r\n"]
+}
+
+set blob_length [string length $large_enough_lob]
+
+ns_write "<li> requesting bytes 10-19 of blob 602. "
+
+lassign [nsoracle_test_range_get "bytes=10-19"] status headers body
+
+if { $status == 206
+     && [dict exists $headers content-range]
+     && [dict get $headers content-range] eq "bytes 10-19/$blob_length"
+     && [string length $body] == 10
+     && $body eq [string range $large_enough_lob 10 19] } {
+    ns_write "got expected results"
+} else {
+    ns_write "<font color=red>got $status, [ns_quotehtml $headers], [string length $body] bytes</font>"
+}
+
+ns_write "<li> requesting bytes past the end of blob 602. "
+
+lassign [nsoracle_test_range_get "bytes=$blob_length-[expr {$blob_length + 9}]"] status headers body
+
+if { $status == 416
+     && [dict exists $headers content-range]
+     && [dict get $headers content-range] eq "bytes */$blob_length" } {
+    ns_write "got expected results"
+} else {
+    ns_write "<font color=red>got $status, [ns_quotehtml $headers]</font>"
+}
+
+ns_unregister_op GET /nsoracle-test/write-blob
+
+
+
+# write_clob/write_blob to the connection, below and above LobSpoolMemory.
+# With LobSpool on, this exercises spooling into memory and into a file,
+# otherwise both go through the streaming code.
+
+ns_write "<p><li> <b>Starting LOB spool test</b>"
+
+set spool_p 0
+set spool_memory 65536
+set compress_level 0
+set drivers [ns_configsection ns/db/drivers]
+if { $drivers ne "" } {
+    for { set i 0 } { $i < [ns_set size $drivers] } { incr i } {
+        if { [string match *nsoracle* [ns_set value $drivers $i]] } {
+            set section ns/db/driver/[ns_set key $drivers $i]
+            set spool_p [ns_config -bool $section LobSpool 0]
+            set spool_memory [ns_config -int $section LobSpoolMemory 65536]
+            set compress_level [ns_config -int $section LobCompressLevel 0]
+        }
+    }
+}
+
+ns_write "<li> LobSpool is [expr {$spool_p ? "on" : "off"}], LobSpoolMemory is $spool_memory"
+
+set spool_small [string range [string repeat "spool me\n" [expr {$spool_memory / 18 + 1}]] 0 [expr {$spool_memory / 2}]]
+set spool_large [string repeat "spool me\n" [expr {$spool_memory / 4 + 1}]]
+
+ns_ora clob_dml $db "
+insert into markd_lob_test (lob_id, chunks)
+values (1000, empty_clob())
+returning chunks into :1" $spool_small
+
+ns_ora clob_dml $db "
+insert into markd_lob_test (lob_id, chunks)
+values (1001, empty_clob())
+returning chunks into :1" $spool_large
+
+ns_ora blob_dml $db "
+insert into markd_lob_test (lob_id, blunks)
+values (1002, empty_blob())
+returning blunks into :1" $spool_small
+
+ns_ora blob_dml $db "
+insert into markd_lob_test (lob_id, blunks)
+values (1003, empty_blob())
+returning blunks into :1" $spool_large
+
+ns_register_proc GET /nsoracle-test/write-lob {
+    set db [ns_db gethandle]
+    set id [expr {int([ns_queryget id 0])}]
+    if { [ns_queryget type] eq "blob" } {
+        ns_set update [ns_conn outputheaders] Content-Type application/octet-stream
+        ns_ora write_blob $db "select blunks from markd_lob_test where lob_id = $id"
+    } else {
+        ns_set update [ns_conn outputheaders] Content-Type text/plain
+        ns_ora write_clob $db "select chunks from markd_lob_test where lob_id = $id"
+    }
+    ns_db releasehandle $db
+}
+
+foreach { type id expected what } [list \
+        clob 1000 $spool_small "clob below LobSpoolMemory" \
+        clob 1001 $spool_large "clob above LobSpoolMemory" \
+        blob 1002 $spool_small "blob below LobSpoolMemory" \
+        blob 1003 $spool_large "blob above LobSpoolMemory"] {
+
+    ns_write "<li> $what ([string length $expected] bytes). "
+
+    lassign [nsoracle_test_get "/nsoracle-test/write-lob?type=$type&id=$id"] status headers body
+
+    if { $status == 200 && $body eq $expected
+         && (![dict exists $headers content-length]
+             || [dict get $headers content-length] == [string length $expected]) } {
+        ns_write "got expected results"
+    } else {
+        ns_write "<font color=red>got $status, [ns_quotehtml $headers], [string length $body] bytes</font>"
+    }
+}
+
+
+
+# with LobCompressLevel, write_clob output is a complete gzip stream for
+# clients accepting gzip, and left alone for the others
+
+ns_write "<p><li> <b>Starting LOB compression test</b>"
+
+if { $compress_level == 0 } {
+
+    ns_write "<li> skipped: LobCompressLevel is not set"
+
+} else {
+
+    foreach { id expected what } [list \
+            1000 $spool_small "clob below LobSpoolMemory" \
+            1001 $spool_large "clob above LobSpoolMemory"] {
+
+        ns_write "<li> $what, gzip accepted. "
+
+        lassign [nsoracle_test_get "/nsoracle-test/write-lob?type=clob&id=$id" \
+                     "Accept-Encoding: gzip\r\n"] status headers body
+
+        if { $status == 200
+             && [dict exists $headers content-encoding]
+             && [dict get $headers content-encoding] eq "gzip"
+             && ![catch { zlib gunzip $body } unzipped]
+             && $unzipped eq $expected } {
+            ns_write "got expected results ([string length $body] bytes)"
+        } else {
+            ns_write "<font color=red>got $status, [ns_quotehtml $headers], [string length $body] bytes</font>"
+        }
+
+        ns_write "<li> $what, gzip refused with q=0. "
+
+        lassign [nsoracle_test_get "/nsoracle-test/write-lob?type=clob&id=$id" \
+                     "Accept-Encoding: gzip;q=0\r\n"] status headers body
+
+        if { $status == 200 && ![dict exists $headers content-encoding]
+             && $body eq $expected } {
+            ns_write "got expected results"
+        } else {
+            ns_write "<font color=red>got $status, [ns_quotehtml $headers], [string length $body] bytes</font>"
+        }
+    }
+}
+
+ns_unregister_op GET /nsoracle-test/write-lob
+
+
+
+
+# write_blob -cache: hits don't touch the database, entries are keyed by
+# datasource, user, version and query, and the least recently used ones
+# are evicted when LobCacheSize is exceeded
+
+ns_write "<p><li> <b>Starting LOB cache test</b>"
+
+if { [catch { ns_ora lob_cache stats }] } {
+
+    ns_write "<li> skipped: LobCacheDir is not configured"
+
+} else {
+
+    ns_register_proc GET /nsoracle-test/write-lob-cached {
+        set db [ns_db gethandle [ns_queryget pool]]
+        set id [expr {int([ns_queryget id 0])}]
+        ns_set update [ns_conn outputheaders] Content-Type application/octet-stream
+        ns_ora write_blob $db -cache [ns_queryget version] \
+            "select blunks from markd_lob_test where lob_id = $id"
+        ns_db releasehandle $db
+    }
+
+    proc nsoracle_test_cache_stat {name} {
+        return [dict get [ns_ora lob_cache stats] $name]
+    }
+
+    set pool [ns_db poolname $db]
+
+    ns_ora lob_cache flush
+
+    ns_ora blob_dml $db "
+    insert into markd_lob_test (lob_id, blunks)
+    values (1100, empty_blob())
+    returning blunks into :1" "version one"
+
+    ns_write "<li> first request is a miss and stores the blob. "
+
+    set stores [nsoracle_test_cache_stat stores]
+    lassign [nsoracle_test_get "/nsoracle-test/write-lob-cached?pool=$pool&id=1100&version=1"] status headers body
+
+    if { $status == 200 && $body eq "version one"
+         && [nsoracle_test_cache_stat stores] == $stores + 1 } {
+        ns_write "got expected results"
+    } else {
+        ns_write "<font color=red>got $status, [string length $body] bytes, [ns_quotehtml [ns_ora lob_cache stats]]</font>"
+    }
+
+    ns_write "<li> same version after an update is a hit with the old content. "
+
+    ns_ora blob_dml $db "
+    update markd_lob_test set blunks = empty_blob() where lob_id = 1100
+    returning blunks into :1" "version two"
+
+    set hits [nsoracle_test_cache_stat hits]
+    lassign [nsoracle_test_get "/nsoracle-test/write-lob-cached?pool=$pool&id=1100&version=1"] status headers body
+
+    if { $status == 200 && $body eq "version one"
+         && [nsoracle_test_cache_stat hits] == $hits + 1 } {
+        ns_write "got expected results"
+    } else {
+        ns_write "<font color=red>got $status, [ns_quotehtml $body], [ns_quotehtml [ns_ora lob_cache stats]]</font>"
+    }
+
+    ns_write "<li> a new version reads the new content. "
+
+    lassign [nsoracle_test_get "/nsoracle-test/write-lob-cached?pool=$pool&id=1100&version=2"] status headers body
+
+    if { $status == 200 && $body eq "version two"
+         && [nsoracle_test_cache_stat hits] == $hits + 1 } {
+        ns_write "got expected results"
+    } else {
+        ns_write "<font color=red>got $status, [ns_quotehtml $body], [ns_quotehtml [ns_ora lob_cache stats]]</font>"
+    }
+
+    ns_write "<li> a pool with another datasource or user doesn't share the entry. "
+
+    set other_pool ""
+    foreach p [ns_db pools] {
+        if { $p eq $pool || [catch { set h [ns_db gethandle -timeout 5 $p] }] } {
+            continue
+        }
+        if { [ns_db driver $h] eq [ns_db driver $db]
+             && ([ns_db datasource $h] ne [ns_db datasource $db]
+                 || [ns_db user $h] ne [ns_db user $db]) } {
+            set other_pool $p
+        }
+        ns_db releasehandle $h
+        if { $other_pool ne "" } {
+            break
+        }
+    }
+
+    if { $other_pool eq "" } {
+        ns_write "skipped: no such pool configured"
+    } else {
+        # the table may not even exist there, but it must not be a hit
+        set hits [nsoracle_test_cache_stat hits]
+        lassign [nsoracle_test_get "/nsoracle-test/write-lob-cached?pool=$other_pool&id=1100&version=2"] status headers body
+
+        if { [nsoracle_test_cache_stat hits] == $hits && $body ne "version two" } {
+            ns_write "got expected results"
+        } else {
+            ns_write "<font color=red>got a hit from pool $pool in pool $other_pool</font>"
+        }
+    }
+
+    ns_write "<li> storing more than LobCacheSize evicts the oldest entry. "
+
+    set max_size [nsoracle_test_cache_stat maxsize]
+
+    if { $max_size > 8 * 1024 * 1024 } {
+        ns_write "skipped: set LobCacheSize below 8MB to run it"
+    } else {
+        set cache_lob [string repeat "x" [expr {$max_size * 2 / 3}]]
+
+        ns_ora blob_dml $db "
+        update markd_lob_test set blunks = empty_blob() where lob_id = 1100
+        returning blunks into :1" $cache_lob
+
+        ns_ora lob_cache flush
+        set evictions [nsoracle_test_cache_stat evictions]
+
+        nsoracle_test_get "/nsoracle-test/write-lob-cached?pool=$pool&id=1100&version=3"
+        lassign [nsoracle_test_get "/nsoracle-test/write-lob-cached?pool=$pool&id=1100&version=4"] status headers body
+        set evicted [expr {[nsoracle_test_cache_stat evictions] - $evictions}]
+        set entries [nsoracle_test_cache_stat entries]
+
+        # version 3 is gone, so this is a miss
+        set hits [nsoracle_test_cache_stat hits]
+        nsoracle_test_get "/nsoracle-test/write-lob-cached?pool=$pool&id=1100&version=3"
+
+        if { $status == 200 && $body eq $cache_lob
+             && $evicted == 1 && $entries == 1
+             && [nsoracle_test_cache_stat hits] == $hits } {
+            ns_write "got expected results"
+        } else {
+            ns_write "<font color=red>got $status, [string length $body] bytes, [ns_quotehtml [ns_ora lob_cache stats]]</font>"
+        }
+    }
+
+    ns_ora lob_cache flush
+    ns_unregister_op GET /nsoracle-test/write-lob-cached
+}
+
+
+
+
+# clob_dml_conn/blob_dml_conn insert the content of the request.  Uploads
+# above maxupload of the driver are spooled to a file by the server and
+# streamed from there.
+
+ns_write "<p><li> <b>Starting LOB upload test</b>"
+
+ns_register_proc POST /nsoracle-test/dml-conn {
+    set db [ns_db gethandle]
+    set id [expr {int([ns_queryget id 0])}]
+    if { [ns_queryget type] eq "blob" } {
+        ns_ora blob_dml_conn $db "
+        insert into markd_lob_test (lob_id, blunks)
+        values ($id, empty_blob())
+        returning blunks into :1"
+    } else {
+        ns_ora clob_dml_conn $db "
+        insert into markd_lob_test (lob_id, chunks)
+        values ($id, empty_clob())
+        returning chunks into :1"
+    }
+    ns_db releasehandle $db
+    ns_return 200 text/plain ok
+}
+
+set upload_small "This is a small upload."
+set upload_large [string repeat "0123456789abcdef\n" 20000]
+set upload_binary [string repeat [binary format c* {0 1 2 0 255 254 0 10 13 0}] 30000]
+
+foreach { type id content what } [list \
+        clob 1200 $upload_small "small clob" \
+        clob 1201 $upload_large "large clob" \
+        blob 1202 $upload_small "small blob" \
+        blob 1203 $upload_binary "large binary blob"] {
+
+    ns_write "<li> uploading a $what ([string length $content] bytes). "
+
+    lassign [nsoracle_test_get "/nsoracle-test/dml-conn?type=$type&id=$id" \
+                 "Content-Type: application/octet-stream\r\nContent-Length: [string length $content]\r\n" \
+                 POST $content] status headers body
+
+    if { $type eq "blob" } {
+        set rows [ns_ora rows $db "select blunks from markd_lob_test where lob_id = $id"]
+        set back_lob [dict get [lindex $rows 0] blunks]
+    } else {
+        set back_lob [database_to_tcl_string $db "select chunks from markd_lob_test where lob_id = $id"]
+    }
+
+    if { $status == 200 && $back_lob eq $content } {
+        ns_write "they match"
+    } else {
+        ns_write "<font color=red>got $status, [string length $back_lob] bytes back</font>"
+    }
+}
+
+ns_unregister_op POST /nsoracle-test/dml-conn
+
+
+
+# writing a clob in many small pieces with lob_open/lob_append/lob_close
+
+ns_write "<p><li> <b>Starting incremental LOB writer test</b>"
+
+ns_write "<li> appending 10000 small pieces"
+
+ns_db dml $db "insert into markd_lob_test (lob_id, chunks) values (800, empty_clob())"
+
+set lob [ns_ora lob_open $db "select chunks from markd_lob_test where lob_id = 800 for update"]
+set written_lob ""
+for { set i 0 } { $i < 10000 } { incr i } {
+    ns_ora lob_append $lob "$i \u00e4\u20ac "
+    append written_lob "$i \u00e4\u20ac "
+}
+set nbytes [ns_ora lob_close $lob]
+
+ns_write "<li> making sure we get the same clob back. "
+
+set back_lob [database_to_tcl_string $db "select chunks from markd_lob_test where lob_id = 800"]
+
+if { [string compare $back_lob $written_lob] == 0
+     && $nbytes == [string length [encoding convertto utf-8 $written_lob]] } {
+    ns_write "they match"
+} else {
+    ns_write "<font color=red>they don't match</font>"
+}
+
+ns_write "<li> making sure the lob id is gone. "
+
+if { [catch { ns_ora lob_append $lob "more" }] } {
+    ns_write "it is"
+} else {
+    ns_write "<font color=red>it isn't</font>"
+}
+
+
+
+# reading a clob line by line through a channel
+
+ns_write "<p><li> <b>Starting LOB channel test</b>"
+
+ns_write "<li> reading clob 800 through a channel"
+
+set chan [ns_ora lob_channel $db "select chunks from markd_lob_test where lob_id = 800"]
+set back_lob [read $chan]
+close $chan
+
+if { [string compare $back_lob $written_lob] == 0 } {
+    ns_write "they match"
+} else {
+    ns_write "<font color=red>they don't match</font>"
+}
+
+ns_write "<li> reading blob 602 through a channel"
+
+set chan [ns_ora lob_channel $db "select blunks from markd_lob_test where lob_id = 602"]
+set lines 0
+while { [gets $chan line] >= 0 } {
+    incr lines
+}
+close $chan
+
+set expected [llength [split $large_enough_lob "\n"]]
+if { $lines == $expected } {
+    ns_write "got $lines lines"
+} else {
+    ns_write "<font color=red>got $lines lines instead of $expected</font>"
+}
+
+
+
+# lazy LOB mode: rows contain tokens, lob_get reads them
+
+ns_write "<p><li> <b>Starting lazy LOB test</b>"
+
+ns_write "<li> fetching clob 800 lazily"
+
+ns_ora lazy_lobs $db 1
+set row [ns_db 1row $db "select lob_id, chunks from markd_lob_test where lob_id = 800"]
+set token [ns_set get $row chunks]
+set back_lob [ns_ora lob_get $db $token]
+set back_part [ns_ora lob_get $db $token -offset 10 -length 20]
+ns_ora lazy_lobs $db 0
+
+if { [string compare $back_lob $written_lob] == 0
+     && [string compare $back_part [string range $written_lob 10 29]] == 0 } {
+    ns_write "they match"
+} else {
+    ns_write "<font color=red>they don't match</font>"
+}
+
+
+
+# binary data round trip through blob_dml and ns_ora rows
+
+ns_write "<p><li> <b>Starting binary BLOB/RAW test</b>"
+
+ns_write "<li> inserting a blob with NUL bytes"
+
+set binary_lob [binary format c* {0 1 2 0 255 254 0 10 13 0}]
+
+ns_ora blob_dml $db "
+insert into markd_lob_test (lob_id, blunks)
+values (900, empty_blob())
+returning blunks into :1" $binary_lob
+
+ns_write "<li> making sure we get the same bytes back. "
+
+set rows [ns_ora rows $db "select blunks, hextoraw('00FF00') raw_value from markd_lob_test where lob_id = 900"]
+set back_row [lindex $rows 0]
+
+if { [llength $rows] == 1
+     && [dict get $back_row blunks] eq $binary_lob
+     && [dict get $back_row raw_value] eq [binary format H* 00FF00] } {
+    ns_write "they match"
+} else {
+    ns_write "<font color=red>they don't match</font>"
+}
+
+
+
 # wrap it up
 
 ns_write "<p><li> cleaning up test table"